@@ -0,0 +1,113 @@
+##-*-makefile-*-########################################################################################################
+# Copyright 2016 - 2022 Inesonic, LLC
+#
+# This file is licensed under two licenses.
+#
+# Inesonic Commercial License, Version 1:
+#   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+#   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+#   strictly prohibited.
+#
+# GNU Public License, Version 2:
+#   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+#   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+#   version.
+#
+#   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+#   details.
+#
+#   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+#   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+########################################################################################################################
+
+########################################################################################################################
+# Basic build characteristics
+#
+
+TEMPLATE = app
+QT += core testlib network
+CONFIG += c++14
+
+HEADERS = bench_payload_format.h \
+          bench_usage_data.h \
+          bench_reporting.h \
+          ../test/loopback_collector.h \
+
+SOURCES = bench_ineud.cpp \
+          bench_payload_format.cpp \
+          bench_usage_data.cpp \
+          bench_reporting.cpp \
+          ../test/loopback_collector.cpp \
+
+########################################################################################################################
+# ineud library:
+#
+
+UD_BASE = $${OUT_PWD}/../ineud/
+INCLUDEPATH = $${PWD}/../ineud/include/
+INCLUDEPATH += $${PWD}/../test/
+
+unix {
+    CONFIG(debug, debug|release) {
+        LIBS += -L$${UD_BASE}/build/debug/ -lineud
+
+        macx {
+            PRE_TARGETDEPS += $${UD_BASE}/build/debug/libineud.dylib
+        } else {
+            PRE_TARGETDEPS += $${UD_BASE}/build/debug/libineud.so
+        }
+    } else {
+        LIBS += -L$${UD_BASE}/build/release/ -lineud
+
+        macx {
+            PRE_TARGETDEPS += $${UD_BASE}/build/release/libineud.dylib
+        } else {
+            PRE_TARGETDEPS += $${UD_BASE}/build/release/libineud.so
+        }
+    }
+}
+
+win32 {
+    CONFIG(debug, debug|release) {
+        LIBS += $${UD_BASE}/build/Debug/ineud.lib
+        PRE_TARGETDEPS += $${UD_BASE}/build/Debug/ineud.lib
+    } else {
+        LIBS += $${UD_BASE}/build/Release/ineud.lib
+        PRE_TARGETDEPS += $${UD_BASE}/build/Release/ineud.lib
+    }
+}
+
+########################################################################################################################
+# Libraries
+#
+
+defined(SETTINGS_PRI, var) {
+    include($${SETTINGS_PRI})
+}
+
+INCLUDEPATH += $${INECRYPTO_INCLUDE}
+INCLUDEPATH += $${INEWH_INCLUDE}
+INCLUDEPATH += $${BOOST_INCLUDE}
+
+LIBS += -L$${INECRYPTO_LIBDIR} -linecrypto
+LIBS += -L$${INEWH_LIBDIR} -linewh
+
+########################################################################################################################
+# Locate build intermediate and output products
+#
+
+TARGET = bench_ineud
+
+CONFIG(debug, debug|release) {
+    unix:DESTDIR = build/debug
+    win32:DESTDIR = build/Debug
+} else {
+    unix:DESTDIR = build/release
+    win32:DESTDIR = build/Release
+}
+
+OBJECTS_DIR = $${DESTDIR}/objects
+MOC_DIR = $${DESTDIR}/moc
+RCC_DIR = $${DESTDIR}/rcc
+UI_DIR = $${DESTDIR}/ui
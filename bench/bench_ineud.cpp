@@ -0,0 +1,96 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file is the main entry point for the ineud benchmarks.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "bench_payload_format.h"
+#include "bench_usage_data.h"
+#include "bench_reporting.h"
+
+/**
+ * Runs the benchmarks in one class.  QtTest writes each "-o filename,format" output afresh for every class so the
+ * class name is inserted into each output filename, giving one machine-readable file per class.  For example,
+ * "-o results.csv,csv" writes results_BenchUsageData.csv.
+ *
+ * \param[in] benchmark The object holding the benchmarks.
+ *
+ * \param[in] arguments The command line arguments.
+ *
+ * \return Returns the QTest::qExec status.
+ */
+int runBenchmark(QObject* benchmark, const QStringList& arguments) {
+    QStringList classArguments;
+    QString     className = QString::fromLatin1(benchmark->metaObject()->className());
+
+    for (int i=0 ; i<arguments.size() ; ++i) {
+        QString argument = arguments.at(i);
+        if (i > 0 && arguments.at(i - 1) == QString("-o")) {
+            int     formatSeparator = argument.lastIndexOf(',');
+            QString filename        = formatSeparator >= 0 ? argument.left(formatSeparator) : argument;
+            QString format          = formatSeparator >= 0 ? argument.mid(formatSeparator) : QString();
+
+            if (filename != QString("-")) {
+                int extension = filename.lastIndexOf('.');
+                if (extension > filename.lastIndexOf('/')) {
+                    filename.insert(extension, QString("_") + className);
+                } else {
+                    filename += QString("_") + className;
+                }
+            }
+
+            argument = filename + format;
+        }
+
+        classArguments.append(argument);
+    }
+
+    return QTest::qExec(benchmark, classArguments);
+}
+
+
+int main(int argumentCount, char** argumentValues) {
+    QCoreApplication application(argumentCount, argumentValues);
+    QStringList      arguments = application.arguments();
+
+    int status = 0;
+
+    BenchPayloadFormat benchPayloadFormat;
+    status |= runBenchmark(&benchPayloadFormat, arguments);
+
+    BenchUsageData benchUsageData;
+    status |= runBenchmark(&benchUsageData, arguments);
+
+    BenchReporting benchReporting;
+    status |= runBenchmark(&benchReporting, arguments);
+
+    return status;
+}
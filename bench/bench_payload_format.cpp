@@ -0,0 +1,136 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements benchmarks comparing the JSON and CBOR report formats.  Each benchmark encodes a report
+* holding the requested number of event counters, either by building a document or by streaming through a
+* \ref Ud::PayloadWriter.  Rows ending in "_bytes" record the encoded size as an event count, one event per byte.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QCborValue>
+#include <QCborMap>
+
+#include <cstdint>
+
+#include <ud_payload_writer.h>
+
+#include "bench_payload_format.h"
+
+BenchPayloadFormat::BenchPayloadFormat() {}
+
+
+BenchPayloadFormat::~BenchPayloadFormat() {}
+
+
+void BenchPayloadFormat::benchEncode_data() {
+    QTest::addColumn<bool>("cbor");
+    QTest::addColumn<bool>("streaming");
+    QTest::addColumn<int>("numberKeys");
+    QTest::addColumn<bool>("measureSize");
+
+    static const int  keyCounts[] = { 10, 1000, 100000 };
+    static const char* keyLabels[] = { "10", "1k", "100k" };
+
+    for (unsigned i=0 ; i<3 ; ++i) {
+        QByteArray label(keyLabels[i]);
+
+        QTest::newRow(QByteArray("json_document_" + label).constData())  << false << false << keyCounts[i] << false;
+        QTest::newRow(QByteArray("json_streaming_" + label).constData()) << false << true  << keyCounts[i] << false;
+        QTest::newRow(QByteArray("cbor_document_" + label).constData())  << true  << false << keyCounts[i] << false;
+        QTest::newRow(QByteArray("cbor_streaming_" + label).constData()) << true  << true  << keyCounts[i] << false;
+        QTest::newRow(QByteArray("json_" + label + "_bytes").constData()) << false << true  << keyCounts[i] << true;
+        QTest::newRow(QByteArray("cbor_" + label + "_bytes").constData()) << true  << true  << keyCounts[i] << true;
+    }
+}
+
+
+void BenchPayloadFormat::benchEncode() {
+    QFETCH(bool, cbor);
+    QFETCH(bool, streaming);
+    QFETCH(int, numberKeys);
+    QFETCH(bool, measureSize);
+
+    QHash<QString, std::uint64_t> snapshot;
+    for (int i=0 ; i<numberKeys ; ++i) {
+        std::uint64_t value = (static_cast<std::uint64_t>(i) * 2654435761ULL) % 100000;
+        snapshot.insert(QString("application_event_%1").arg(i), value);
+    }
+
+    Ud::PayloadWriter::Format format = cbor ? Ud::PayloadWriter::Format::CBOR : Ud::PayloadWriter::Format::JSON;
+    QByteArray                payload;
+
+    auto stream = [&]() {
+        Ud::PayloadWriter writer(format, 1024 + 48 * snapshot.size());
+        writer.startMap();
+        writer.writeKey("events");
+        writer.startMap();
+        for (auto it=snapshot.constBegin(),end=snapshot.constEnd() ; it!=end ; ++it) {
+            writer.writeKey(it.key());
+            writer.writeUnsigned(it.value());
+        }
+        writer.endMap();
+        writer.endMap();
+
+        return writer.data();
+    };
+
+    if (measureSize) {
+        QTest::setBenchmarkResult(stream().size(), QTest::Events);
+    } else if (streaming) {
+        QBENCHMARK {
+            payload = stream();
+        }
+    } else if (cbor) {
+        QBENCHMARK {
+            QCborMap events;
+            for (auto it=snapshot.constBegin(),end=snapshot.constEnd() ; it!=end ; ++it) {
+                events.insert(it.key(), static_cast<qint64>(it.value()));
+            }
+
+            QCborMap report;
+            report.insert(QStringLiteral("events"), events);
+
+            payload = report.toCborValue().toCbor();
+        }
+    } else {
+        QBENCHMARK {
+            QJsonObject events;
+            for (auto it=snapshot.constBegin(),end=snapshot.constEnd() ; it!=end ; ++it) {
+                events.insert(it.key(), static_cast<double>(it.value()));
+            }
+
+            QJsonObject report;
+            report.insert("events", events);
+
+            payload = QJsonDocument(report).toJson(QJsonDocument::Compact);
+        }
+    }
+}
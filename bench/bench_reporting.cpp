@@ -0,0 +1,151 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements end-to-end reporting benchmarks.  Each benchmark fills the requested number of counters,
+* triggers a report, and measures the time from the start of the report to the collector's acknowledgement.  The
+* counters are refilled between reports outside of the measured time.  The mean latency is recorded as the benchmark
+* result; its inverse is the report throughput.  Rows ending in "_bytes" instead record the size of the report body
+* received by the collector as an event count, one event per byte.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QMetaObject>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+
+#include <ud_usage_data.h>
+
+#include "loopback_collector.h"
+#include "bench_reporting.h"
+
+namespace {
+    /**
+     * The HMAC secret shared by the reporter and the collector.
+     */
+    const char benchSecret[] = "bench_reporting_secret";
+}
+
+BenchReporting::BenchReporting() {
+    settingsDirectory    = Q_NULLPTR;
+    settings             = Q_NULLPTR;
+    networkAccessManager = Q_NULLPTR;
+    collector            = Q_NULLPTR;
+}
+
+
+BenchReporting::~BenchReporting() {}
+
+
+void BenchReporting::initTestCase() {
+    settingsDirectory    = new QTemporaryDir;
+    settings             = new QSettings(settingsDirectory->filePath("bench.ini"), QSettings::IniFormat, this);
+    networkAccessManager = new QNetworkAccessManager(this);
+    collector            = new LoopbackCollector(QByteArray(benchSecret), this);
+
+    QVERIFY(collector->listen());
+}
+
+
+void BenchReporting::benchRoundTrip_data() {
+    QTest::addColumn<int>("numberKeys");
+    QTest::addColumn<unsigned>("latency");
+    QTest::addColumn<bool>("measureSize");
+
+    static const int   keyCounts[] = { 10, 1000, 10000, 100000 };
+    static const char* keyLabels[] = { "10", "1k", "10k", "100k" };
+
+    for (unsigned i=0 ; i<4 ; ++i) {
+        QByteArray label(keyLabels[i]);
+
+        QTest::newRow(QByteArray(label + "_keys").constData())         << keyCounts[i] << 0U  << false;
+        QTest::newRow(QByteArray(label + "_keys_latency").constData()) << keyCounts[i] << 25U << false;
+        QTest::newRow(QByteArray(label + "_keys_bytes").constData())   << keyCounts[i] << 0U  << true;
+    }
+}
+
+
+void BenchReporting::benchRoundTrip() {
+    QFETCH(int, numberKeys);
+    QFETCH(unsigned, latency);
+    QFETCH(bool, measureSize);
+
+    collector->setLatency(latency);
+
+    Ud::UsageData usageData(settings, networkAccessManager, QByteArray(benchSecret), collector->url());
+    usageData.setBackgroundReporting();
+    usageData.setReportingEnabled();
+
+    QVector<Ud::UsageData::EventId> eventIds;
+    eventIds.reserve(numberKeys);
+    for (int i=0 ; i<numberKeys ; ++i) {
+        eventIds.append(usageData.registerEvent(QString("bench_round_trip_key_%1").arg(i)));
+    }
+
+    QSignalSpy finishedSpy(&usageData, &Ud::UsageData::reportingFinished);
+
+    int           numberReports      = measureSize ? 1 : qMax(5, keysPerRow / numberKeys);
+    qint64        elapsedNanoseconds = 0;
+    QElapsedTimer elapsedTimer;
+
+    for (int report=0 ; report<numberReports ; ++report) {
+        for (int i=0 ; i<numberKeys ; ++i) {
+            usageData.adjustEventById(eventIds.at(i), 1 + (i + report) % 100);
+        }
+
+        finishedSpy.clear();
+        elapsedTimer.start();
+
+        QMetaObject::invokeMethod(&usageData, "reportUsageData");
+        QVERIFY(finishedSpy.wait(reportTimeout));
+
+        elapsedNanoseconds += elapsedTimer.nsecsElapsed();
+
+        QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+    }
+
+    usageData.setReportingDisabled();
+
+    if (measureSize) {
+        QTest::setBenchmarkResult(collector->lastBody().size(), QTest::Events);
+    } else {
+        double meanMilliseconds = 1.0E-6 * static_cast<double>(elapsedNanoseconds) / numberReports;
+        QTest::setBenchmarkResult(meanMilliseconds, QTest::WalltimeMilliseconds);
+    }
+}
+
+
+void BenchReporting::cleanupTestCase() {
+    collector->close();
+
+    delete settingsDirectory;
+    settingsDirectory = Q_NULLPTR;
+}
@@ -0,0 +1,322 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements benchmarks for the \ref Ud::UsageData hot paths.  Hot key benchmarks update a single counter
+* repeatedly.  Cold key benchmarks cycle through enough distinct counters that each update is likely to miss the
+* cache.  Contention benchmarks split a fixed number of updates across 1 to 64 threads, started ahead of time and
+* released together for each round, and record the mean wall time per update, the inverse of the aggregate throughput.
+* Report rows ending in "_bytes" record the size of the report body as an event count, one event per byte.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+#include <QUrl>
+#include <QThread>
+#include <QSemaphore>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+
+#include <cstdint>
+#include <atomic>
+
+#include <ud_usage_data.h>
+
+#include "bench_usage_data.h"
+
+BenchUsageData::BenchUsageData() {
+    settingsDirectory    = Q_NULLPTR;
+    settings             = Q_NULLPTR;
+    networkAccessManager = Q_NULLPTR;
+    usageData            = Q_NULLPTR;
+}
+
+
+BenchUsageData::~BenchUsageData() {}
+
+
+void BenchUsageData::initTestCase() {
+    settingsDirectory    = new QTemporaryDir;
+    settings             = new QSettings(settingsDirectory->filePath("bench.ini"), QSettings::IniFormat, this);
+    networkAccessManager = new QNetworkAccessManager(this);
+    usageData            = createUsageData();
+
+    coldKeys.reserve(numberColdKeys);
+    for (int i=0 ; i<numberColdKeys ; ++i) {
+        coldKeys.append(QString("bench_cold_key_%1").arg(i));
+    }
+}
+
+
+void BenchUsageData::benchAdjustEvent_data() {
+    QTest::addColumn<bool>("cold");
+    QTest::addColumn<bool>("byId");
+    QTest::addColumn<unsigned>("samplingRate");
+
+    QTest::newRow("hot_name")           << false << false << 1U;
+    QTest::newRow("hot_id")             << false << true  << 1U;
+    QTest::newRow("cold_name")          << true  << false << 1U;
+    QTest::newRow("cold_id")            << true  << true  << 1U;
+    QTest::newRow("hot_id_sampled_64")  << false << true  << 64U;
+}
+
+
+void BenchUsageData::benchAdjustEvent() {
+    QFETCH(bool, cold);
+    QFETCH(bool, byId);
+    QFETCH(unsigned, samplingRate);
+
+    QVector<Ud::UsageData::EventId> coldIds;
+    if (cold && byId) {
+        coldIds.reserve(numberColdKeys);
+        for (int i=0 ; i<numberColdKeys ; ++i) {
+            coldIds.append(usageData->registerEvent(coldKeys.at(i)));
+        }
+    }
+
+    QString                hotKey("bench_hot_event");
+    Ud::UsageData::EventId hotId = usageData->registerEvent(hotKey);
+
+    if (samplingRate > 1) {
+        usageData->setEventSampling(hotId, samplingRate);
+    }
+
+    // Each iteration makes one update per cold key so hot and cold rows are directly comparable.
+    QBENCHMARK {
+        for (int i=0 ; i<numberColdKeys ; ++i) {
+            if (cold) {
+                if (byId) {
+                    usageData->adjustEventById(coldIds.at(i));
+                } else {
+                    usageData->adjustEvent(coldKeys.at(i));
+                }
+            } else {
+                if (byId) {
+                    usageData->adjustEventById(hotId);
+                } else {
+                    usageData->adjustEvent(hotKey);
+                }
+            }
+        }
+    }
+
+    usageData->setEventSampling(hotId, 1);
+}
+
+
+void BenchUsageData::benchAdjustActivity_data() {
+    QTest::addColumn<bool>("byId");
+
+    QTest::newRow("name") << false;
+    QTest::newRow("id")   << true;
+}
+
+
+void BenchUsageData::benchAdjustActivity() {
+    QFETCH(bool, byId);
+
+    QString                   activityName("bench_activity");
+    Ud::UsageData::ActivityId activityId = usageData->registerActivity(activityName);
+
+    QBENCHMARK {
+        for (int i=0 ; i<numberColdKeys ; ++i) {
+            if (byId) {
+                usageData->adjustActivityById(activityId, 1);
+            } else {
+                usageData->adjustActivity(activityName, 1);
+            }
+        }
+    }
+}
+
+
+void BenchUsageData::benchTimerPair() {
+    QString timerName("bench_timer");
+
+    QBENCHMARK {
+        usageData->startTimer(timerName);
+        usageData->stopTimer(timerName);
+    }
+}
+
+
+void BenchUsageData::benchReport_data() {
+    QTest::addColumn<bool>("cbor");
+    QTest::addColumn<int>("numberKeys");
+    QTest::addColumn<bool>("measureSize");
+
+    static const int   keyCounts[] = { 10, 1000, 100000 };
+    static const char* keyLabels[] = { "10", "1k", "100k" };
+
+    for (unsigned i=0 ; i<3 ; ++i) {
+        QByteArray label(keyLabels[i]);
+
+        QTest::newRow(QByteArray("json_" + label).constData())            << false << keyCounts[i] << false;
+        QTest::newRow(QByteArray("cbor_" + label).constData())            << true  << keyCounts[i] << false;
+        QTest::newRow(QByteArray("json_" + label + "_bytes").constData()) << false << keyCounts[i] << true;
+        QTest::newRow(QByteArray("cbor_" + label + "_bytes").constData()) << true  << keyCounts[i] << true;
+    }
+}
+
+
+void BenchUsageData::benchReport() {
+    QFETCH(bool, cbor);
+    QFETCH(int, numberKeys);
+    QFETCH(bool, measureSize);
+
+    // A fresh instance keeps counters from the other benchmarks out of the report.
+    Ud::UsageData* reportUsageData = createUsageData();
+    reportUsageData->setPayloadFormat(cbor ? Ud::UsageData::PayloadFormat::CBOR : Ud::UsageData::PayloadFormat::JSON);
+
+    for (int i=0 ; i<numberKeys ; ++i) {
+        QString name = QString("bench_report_key_%1").arg(i);
+        if (i % 4 == 0) {
+            reportUsageData->adjustActivity(name, 1 + i);
+        } else {
+            reportUsageData->adjustEvent(name, 1 + i % 1000);
+        }
+    }
+
+    if (measureSize) {
+        QTest::setBenchmarkResult(reportUsageData->previewReport().size(), QTest::Events);
+    } else {
+        QBENCHMARK {
+            reportUsageData->previewReport();
+        }
+    }
+
+    delete reportUsageData;
+}
+
+
+void BenchUsageData::benchContention_data() {
+    QTest::addColumn<int>("numberThreads");
+    QTest::addColumn<bool>("sharedKey");
+
+    for (int numberThreads=1 ; numberThreads<=64 ; numberThreads*=2) {
+        QByteArray label = QByteArray::number(numberThreads);
+
+        QTest::newRow(QByteArray("shared_" + label).constData())     << numberThreads << true;
+        QTest::newRow(QByteArray("per_thread_" + label).constData()) << numberThreads << false;
+    }
+}
+
+
+void BenchUsageData::benchContention() {
+    QFETCH(int, numberThreads);
+    QFETCH(bool, sharedKey);
+
+    QVector<Ud::UsageData::EventId> eventIds;
+    for (int i=0 ; i<numberThreads ; ++i) {
+        QString name = sharedKey ? QString("bench_contention_shared") : QString("bench_contention_%1").arg(i);
+        eventIds.append(usageData->registerEvent(name));
+    }
+
+    int               operationsPerThread = contentionOperations / numberThreads;
+    std::atomic<bool> stopping(false);
+    QSemaphore        doneSemaphore;
+
+    // Threads are started once and released together for each round so thread creation is not measured.
+    QList<QSemaphore*> startSemaphores;
+    QList<QThread*>    threads;
+    for (int i=0 ; i<numberThreads ; ++i) {
+        QSemaphore*            startSemaphore = new QSemaphore;
+        Ud::UsageData::EventId eventId        = eventIds.at(i);
+
+        startSemaphores.append(startSemaphore);
+        threads.append(QThread::create([&, startSemaphore, eventId]() {
+            startSemaphore->acquire();
+            while (!stopping.load(std::memory_order_acquire)) {
+                for (int j=0 ; j<operationsPerThread ; ++j) {
+                    usageData->adjustEventById(eventId);
+                }
+
+                doneSemaphore.release();
+                startSemaphore->acquire();
+            }
+        }));
+
+        threads.last()->start();
+    }
+
+    QElapsedTimer elapsedTimer;
+    qint64        elapsedNanoseconds = 0;
+
+    // The first round warms up the threads and the counters and is not measured.
+    for (unsigned round=0 ; round<=contentionRounds ; ++round) {
+        elapsedTimer.start();
+
+        for (auto it=startSemaphores.begin(),end=startSemaphores.end() ; it!=end ; ++it) {
+            (*it)->release();
+        }
+
+        doneSemaphore.acquire(numberThreads);
+
+        if (round > 0) {
+            elapsedNanoseconds += elapsedTimer.nsecsElapsed();
+        }
+    }
+
+    stopping.store(true, std::memory_order_release);
+    for (int i=0 ; i<numberThreads ; ++i) {
+        startSemaphores.at(i)->release();
+        threads.at(i)->wait();
+
+        delete threads.at(i);
+        delete startSemaphores.at(i);
+    }
+
+    double numberOperations = static_cast<double>(operationsPerThread) * numberThreads * contentionRounds;
+    QTest::setBenchmarkResult(
+        static_cast<double>(elapsedNanoseconds) / numberOperations,
+        QTest::WalltimeNanoseconds
+    );
+}
+
+
+void BenchUsageData::cleanupTestCase() {
+    delete usageData;
+    delete settingsDirectory;
+
+    usageData         = Q_NULLPTR;
+    settingsDirectory = Q_NULLPTR;
+}
+
+
+Ud::UsageData* BenchUsageData::createUsageData() {
+    Ud::UsageData* result = new Ud::UsageData(
+        settings,
+        networkAccessManager,
+        QByteArray("bench_ineud"),
+        QUrl("http://127.0.0.1/")
+    );
+
+    return result;
+}
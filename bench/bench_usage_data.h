@@ -0,0 +1,105 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header provides benchmarks for the \ref Ud::UsageData hot paths.
+***********************************************************************************************************************/
+
+#ifndef BENCH_USAGE_DATA_H
+#define BENCH_USAGE_DATA_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QVector>
+
+class QNetworkAccessManager;
+class QSettings;
+class QTemporaryDir;
+
+namespace Ud {
+    class UsageData;
+}
+
+class BenchUsageData:public QObject {
+    Q_OBJECT
+
+    public:
+        BenchUsageData();
+
+        ~BenchUsageData() override;
+
+    private slots:
+        void initTestCase();
+
+        void benchAdjustEvent_data();
+
+        void benchAdjustEvent();
+
+        void benchAdjustActivity_data();
+
+        void benchAdjustActivity();
+
+        void benchTimerPair();
+
+        void benchReport_data();
+
+        void benchReport();
+
+        void benchContention_data();
+
+        void benchContention();
+
+        void cleanupTestCase();
+
+    private:
+        /**
+         * The number of distinct keys cycled through by the cold key benchmarks.
+         */
+        static const int numberColdKeys = 16384;
+
+        /**
+         * The total number of adjustments made by each contention benchmark, split evenly across the threads.
+         */
+        static const int contentionOperations = 1 << 20;
+
+        /**
+         * The number of measured rounds made by each contention benchmark.
+         */
+        static const unsigned contentionRounds = 8;
+
+        /**
+         * Creates a usage data instance backed by a private settings file.
+         *
+         * \return Returns the new instance.  The caller owns the instance.
+         */
+        Ud::UsageData* createUsageData();
+
+        QTemporaryDir*         settingsDirectory;
+        QSettings*             settings;
+        QNetworkAccessManager* networkAccessManager;
+        Ud::UsageData*         usageData;
+        QVector<QString>       coldKeys;
+};
+
+#endif
@@ -22,6 +22,7 @@
 ########################################################################################################################
 
 TEMPLATE = subdirs
-SUBDIRS = ineud test
+SUBDIRS = ineud test bench
 
 test.depends = ineud
+bench.depends = ineud
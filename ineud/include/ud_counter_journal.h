@@ -0,0 +1,235 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::CounterJournal class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_COUNTER_JOURNAL_H
+#define UD_COUNTER_JOURNAL_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that persists named counters to an append-only binary journal.
+     *
+     * Each save appends one record per counter that changed since the previous save, so the cost of a save is
+     * proportional to the number of changes rather than the number of counters.  The journal is periodically
+     * compacted into a file holding one record per non-zero counter.  Compaction writes a new file and atomically
+     * replaces the old one.
+     *
+     * Every record carries a checksum.  A torn or corrupt tail, such as one left by a crash during a save, is
+     * discarded when the journal is loaded.
+     *
+     * This class is not thread-safe.
+     */
+    class UD_PUBLIC_API CounterJournal {
+        public:
+            /**
+             * Enumeration of the tables held by the journal.
+             */
+            enum class Table : std::uint8_t {
+                /**
+                 * Indicates the table of event counts.
+                 */
+                EVENTS = 0,
+
+                /**
+                 * Indicates the table of activity times, in nanoseconds.
+                 */
+                ACTIVITIES = 1
+            };
+
+            /**
+             * The number of tables held by the journal.
+             */
+            static const unsigned numberTables = 2;
+
+            /**
+             * The default journal size, in bytes, above which the journal is considered for compaction.
+             */
+            static const qint64 defaultCompactionThreshold;
+
+            /**
+             * Constructor
+             *
+             * \param[in] filename The journal filename.  An empty filename disables the journal.
+             */
+            explicit CounterJournal(const QString& filename = QString());
+
+            ~CounterJournal();
+
+            /**
+             * Determines the journal filename.
+             *
+             * \return Returns the journal filename.  An empty string is returned if the journal is disabled.
+             */
+            QString filename() const;
+
+            /**
+             * Sets the journal filename.  Any state loaded from a previous file is discarded.
+             *
+             * \param[in] newFilename The new journal filename.  An empty filename disables the journal.
+             */
+            void setFilename(const QString& newFilename);
+
+            /**
+             * Determines if the journal is enabled.
+             *
+             * \return Returns true if a journal filename has been set.
+             */
+            bool isEnabled() const;
+
+            /**
+             * Determines if the journal has been loaded since the filename was last set.
+             *
+             * \return Returns true if the journal has been loaded or started by a save.
+             */
+            bool isLoaded() const;
+
+            /**
+             * Sets the journal size, in bytes, above which the journal is compacted.  The journal is only compacted if
+             * it is also more than twice the size it had after the last compaction.
+             *
+             * \param[in] newCompactionThreshold The new compaction threshold, in bytes.
+             */
+            void setCompactionThreshold(qint64 newCompactionThreshold);
+
+            /**
+             * Loads the journal, replaying every record.  A missing journal is treated as empty.  A torn or corrupt
+             * tail following a valid header is discarded.
+             *
+             * \return Returns true on success.  Returns false if the journal could not be read or does not start with
+             *         a header this version recognizes, in which case the file is left untouched.
+             */
+            bool load();
+
+            /**
+             * Obtains the counter values held by the journal.
+             *
+             * \param[in] table The table of interest.
+             *
+             * \return Returns a hash of non-zero counter values by name.
+             */
+            QHash<QString, std::uint64_t> values(Table table) const;
+
+            /**
+             * Appends the changes needed to bring the journal up to date with a set of counter values.  Counters
+             * missing from the supplied values are treated as zero.  The journal is compacted afterward if needed.
+             *
+             * A journal file that exists and has not been loaded is never written, because its values have not been
+             * seen.  Call \ref CounterJournal::load first.
+             *
+             * \param[in] events     The current event counts by name.
+             *
+             * \param[in] activities The current activity times, in nanoseconds, by name.
+             *
+             * \return Returns true on success.  Returns false if the journal could not be written or holds values that
+             *         have not been loaded.
+             */
+            bool save(const QHash<QString, std::uint64_t>& events, const QHash<QString, std::uint64_t>& activities);
+
+            /**
+             * Rewrites the journal with one record per non-zero counter.
+             *
+             * \return Returns true on success.  Returns false if the journal could not be written or has not been
+             *         loaded.
+             */
+            bool compact();
+
+        private:
+            /**
+             * Appends a name record to a buffer, assigning an identifier to the name if needed.
+             *
+             * \param[in,out] buffer The buffer to append to.
+             *
+             * \param[in]     name   The name to be identified.
+             *
+             * \return Returns the identifier assigned to the name.
+             */
+            std::uint32_t nameId(QByteArray& buffer, const QString& name);
+
+            /**
+             * Appends the delta records needed to bring one table up to date with a set of counter values.
+             *
+             * \param[in,out] buffer        The buffer to append to.
+             *
+             * \param[in]     table         The table being updated.
+             *
+             * \param[in]     currentValues The current counter values by name.
+             */
+            void appendDeltas(QByteArray& buffer, Table table, const QHash<QString, std::uint64_t>& currentValues);
+
+            /**
+             * Clears the in-memory state.
+             */
+            void reset();
+
+            /**
+             * The journal filename.
+             */
+            QString currentFilename;
+
+            /**
+             * The compaction threshold, in bytes.
+             */
+            qint64 compactionThreshold;
+
+            /**
+             * The size of the journal after the last compaction or load, in bytes.
+             */
+            qint64 compactedSize;
+
+            /**
+             * The current size of the journal, in bytes.
+             */
+            qint64 currentSize;
+
+            /**
+             * Flag indicating that the in-memory state matches the journal file.
+             */
+            bool loaded;
+
+            /**
+             * Hash mapping names to journal identifiers.
+             */
+            QHash<QString, std::uint32_t> nameIds;
+
+            /**
+             * The counter values held by the journal, per table.
+             */
+            QHash<QString, std::uint64_t> persistedValues[numberTables];
+    };
+}
+
+#endif
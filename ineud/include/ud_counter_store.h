@@ -0,0 +1,547 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::CounterStore class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_COUNTER_STORE_H
+#define UD_COUNTER_STORE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+#include "ud_key_registry.h"
+#include "ud_space_saving.h"
+#include "ud_update_counter.h"
+
+class QFile;
+
+namespace Ud {
+    /**
+     * Class that maintains a set of named 64-bit counters that can be updated from many threads at once.
+     *
+     * Counters are indexed by the dense slots assigned by \ref Ud::KeyRegistry.  Counter values are held in a small
+     * number of shards, each holding one atomic counter per slot.  Every thread is bound to a single shard so that
+     * updates from different threads land on different cache lines and never wait on each other.  Counters are
+     * updated using relaxed atomic operations; the shards are only summed when a snapshot of the store is taken.
+     *
+     * Each shard is double buffered.  Updates land in the active buffer at the cost of one relaxed load and one
+     * relaxed atomic add.  When a report is generated, the active buffer is retired with a single atomic store (see
+     * \ref CounterStore::retire) so the retired values can be serialized without blocking updates.  Once the report
+     * is resolved, the values read from the retired buffer are either discarded (see
+     * \ref CounterStore::releaseRetired) or merged back into the active buffer (see
+     * \ref CounterStore::restoreRetired).  Retired values are subtracted rather than zeroed, so an update that races
+     * the swap and lands in the retired buffer is carried into the active buffer instead of being lost.
+     *
+     * Optionally, the counters for the first slots can be placed in a memory-mapped file (see
+     * \ref CounterStore::attach).  Counters in the file are updated in place so they survive an application crash
+     * without an explicit save.  The file holds a fixed header, a table of slot names, and the counters for every
+     * shard and buffer.
+     *
+     * The number of keys held by a store can be bounded (see \ref CounterStore::setMaximumKeys).  Keys admitted while
+     * the store has room are counted exactly.  Once the store is full, updates to other keys are added to the
+     * \ref CounterStore::otherName counter and tracked by a Space-Saving summary.  When counters are retired, tracked
+     * keys that are guaranteed to have outgrown the smallest admitted keys replace them, so the store converges on
+     * the most frequent keys.  Keys that are not admitted are never given a counter, bounding both memory and the
+     * size of reports.
+     *
+     * Counter values are treated as unsigned 64-bit integers with modular arithmetic.  Negative adjustments can be
+     * applied by casting a signed value to an unsigned value.  Values in individual shards may wrap, only the sum
+     * across all shards is meaningful.
+     */
+    class UD_PUBLIC_API CounterStore {
+        public:
+            /**
+             * Type used to represent a counter slot index.
+             */
+            typedef KeyRegistry::Slot Slot;
+
+            /**
+             * The number of counters held in each chunk of a shard.
+             */
+            static const unsigned slotsPerChunk = 512;
+
+            /**
+             * The maximum number of chunks held by each shard.
+             */
+            static const unsigned maximumChunks = 512;
+
+            /**
+             * Value used to indicate an invalid slot.
+             */
+            static const Slot invalidSlot = KeyRegistry::invalidSlot;
+
+            /**
+             * The default number of slots placed in a memory-mapped file.
+             */
+            static const Slot defaultMappedSlots = 8192;
+
+            /**
+             * The name of the counter holding updates to keys beyond the key limit.
+             */
+            static const char otherName[];
+
+            CounterStore();
+
+            ~CounterStore();
+
+            /**
+             * Adds a value to a counter.  This method is thread-safe and lock-free.  Adjustments to
+             * \ref CounterStore::invalidSlot are ignored.
+             *
+             * \param[in] slot  The slot of the counter to be adjusted.
+             *
+             * \param[in] value The value to add to the counter.
+             *
+             * \return Returns the slot the value was added to.  This is the \ref CounterStore::otherName slot if the
+             *         value was folded into the overflow counter.
+             */
+            Slot add(Slot slot, std::uint64_t value);
+
+            /**
+             * Adds a value to a counter by name, registering the name if needed.  If the store is full, names that
+             * are not admitted are not registered.  This method is thread-safe.
+             *
+             * \param[in] name  The name of the counter to be adjusted.
+             *
+             * \param[in] value The value to add to the counter.
+             *
+             * \return Returns the slot the value was added to.  This is the \ref CounterStore::otherName slot if the
+             *         value was folded into the overflow counter.
+             */
+            Slot add(const QString& name, std::uint64_t value);
+
+            /**
+             * Determines the slot a value should be added to by name, registering the name if needed.  If the store
+             * is full, names that are not admitted are not registered and the \ref CounterStore::otherName slot is
+             * returned instead.  This method is thread-safe.
+             *
+             * \param[in] name  The name of the counter to be adjusted.
+             *
+             * \param[in] value The value that will be added to the counter, used to decide admission.
+             *
+             * \return Returns the slot to add the value to.
+             */
+            Slot admittedSlot(const QString& name, std::uint64_t value);
+
+            /**
+             * Determines the current value of a counter.  This method is thread-safe.
+             *
+             * \param[in] slot The slot of the counter to read.
+             *
+             * \return Returns the sum of the counter across all shards, including any retired value.
+             */
+            std::uint64_t value(Slot slot) const;
+
+            /**
+             * Creates a snapshot of all non-zero counters, including any retired values.  This method is thread-safe.
+             *
+             * \return Returns a hash of counter values by name.
+             */
+            QHash<QString, std::uint64_t> snapshot() const;
+
+            /**
+             * Retires the active buffer, making the other buffer active.  Updates made after this call land in the
+             * newly active buffer.  This method never waits for or blocks updates.  If a previously retired buffer has
+             * not been released, it is first restored.
+             *
+             * Only one thread should manage retired buffers at a time.
+             *
+             * \return Returns a hash of the non-zero counter values held by the retired buffer, by name.
+             */
+            QHash<QString, std::uint64_t> retire();
+
+            /**
+             * Discards the values held by the retired buffer.  Call this method once the values returned by
+             * \ref CounterStore::retire have been consumed.
+             */
+            void releaseRetired();
+
+            /**
+             * Merges the values held by the retired buffer back into the active buffer.  Call this method if the
+             * values returned by \ref CounterStore::retire could not be consumed.
+             */
+            void restoreRetired();
+
+            /**
+             * Resets every counter to zero.  Slot assignments are preserved.  Updates performed concurrently with this
+             * method may be lost.
+             */
+            void clear();
+
+            /**
+             * Places the counters for the first slots in a memory-mapped file.  Values already held by the file are
+             * added to the current values, and the file is rewritten to match the slots assigned in this process.
+             * Counters retired but never released or restored when the file was last used are treated as unreported.
+             * The rewritten file is built under a temporary name and then renamed over the old file, so a crash during
+             * this call leaves either the old or the new counters on disk.
+             *
+             * This method must not be called while other threads are updating the store.
+             *
+             * \param[in] filename    The file to hold the counters.  The file is created if needed.
+             *
+             * \param[in] mappedSlots The number of slots to place in the file.  Counters for later slots are held in
+             *                        memory only.
+             *
+             * \return Returns true on success.  Returns false if the file could not be created or mapped, or if a name
+             *         held by the file could not be registered, in which case the store continues to use memory only.
+             */
+            bool attach(const QString& filename, Slot mappedSlots = defaultMappedSlots);
+
+            /**
+             * Moves counters held in a memory-mapped file back into memory and releases the file.  Retired values are
+             * merged into the active buffer.  This method must not be called while other threads are updating the
+             * store.
+             */
+            void detach();
+
+            /**
+             * Determines if the store is attached to a memory-mapped file.
+             *
+             * \return Returns true if the store is attached to a file.
+             */
+            bool isAttached() const;
+
+            /**
+             * Determines the number of non-zero counters held in memory only while the store is attached to a
+             * memory-mapped file.  Counters for slots beyond those placed in the file are not crash-safe.
+             *
+             * \return Returns the number of counters not held by the file.  Zero is returned if no file is attached.
+             */
+            unsigned unmappedKeys() const;
+
+            /**
+             * Determines the number of updates made to the store.  Updates are counted by a \ref UpdateCounter, so
+             * counting adds no atomic read-modify-write to an update.  This method is thread-safe.
+             *
+             * \return Returns the number of calls to \ref CounterStore::add since the store was created.
+             */
+            std::uint64_t numberUpdates() const;
+
+            /**
+             * Estimates the memory held by the store, including any counters placed in a memory-mapped file.  This
+             * method is thread-safe.
+             *
+             * \return Returns the approximate memory use, in bytes.
+             */
+            std::uint64_t memoryUsage() const;
+
+            /**
+             * Determines the maximum number of keys held by the store.
+             *
+             * \return Returns the maximum number of keys.  A value of zero indicates no limit.
+             */
+            unsigned maximumKeys() const;
+
+            /**
+             * Sets the maximum number of keys held by the store, not counting \ref CounterStore::otherName.  Reducing
+             * the limit takes effect the next time counters are retired.  This method is thread-safe.
+             *
+             * \param[in] newMaximumKeys The new maximum number of keys.  A value of zero removes the limit.
+             */
+            void setMaximumKeys(unsigned newMaximumKeys);
+
+            /**
+             * Determines the number of keys admitted to the store.  This method is thread-safe.
+             *
+             * \return Returns the number of admitted keys.  Zero is returned if the number of keys is not limited.
+             */
+            unsigned numberKeys() const;
+
+            /**
+             * Determines an upper bound on the value of any single key folded into the \ref CounterStore::otherName
+             * counter returned by the last call to \ref CounterStore::retire.  This method is thread-safe.
+             *
+             * \return Returns the upper bound.  Zero is returned if no keys were folded.
+             */
+            std::uint64_t otherBound() const;
+
+        private:
+            Q_DISABLE_COPY(CounterStore)
+
+            static_assert(
+                slotsPerChunk * maximumChunks >= KeyRegistry::maximumSlots,
+                "Counter store capacity must cover every registry slot."
+            );
+
+            /**
+             * Structure holding a contiguous block of counters.
+             */
+            struct Chunk {
+                Chunk();
+
+                std::atomic<std::uint64_t> counters[slotsPerChunk];
+            };
+
+            /**
+             * The number of buffers held by each shard.
+             */
+            static const unsigned numberBuffers = 2;
+
+            /**
+             * Structure holding a single shard.  Chunks are allocated on first use.
+             */
+            struct Shard {
+                Shard();
+
+                ~Shard();
+
+                /**
+                 * Obtains the counter for a slot, allocating the containing chunk if needed.
+                 *
+                 * \param[in] buffer The buffer of interest.
+                 *
+                 * \param[in] slot   The slot of interest.
+                 *
+                 * \return Returns a pointer to the counter.
+                 */
+                std::atomic<std::uint64_t>* counter(unsigned buffer, Slot slot);
+
+                /**
+                 * Obtains the value of a counter for a slot without allocating.
+                 *
+                 * \param[in] buffer The buffer of interest.
+                 *
+                 * \param[in] slot   The slot of interest.
+                 *
+                 * \return Returns the counter value.  Zero is returned if the chunk has not been allocated.
+                 */
+                std::uint64_t value(unsigned buffer, Slot slot) const;
+
+                /**
+                 * Zeros every allocated counter in a buffer.
+                 *
+                 * \param[in] buffer The buffer to be cleared.
+                 */
+                void clear(unsigned buffer);
+
+                /**
+                 * Raises the number of chunks in use.
+                 *
+                 * \param[in] newNumberChunks The number of chunks that must be covered.
+                 */
+                void useChunks(unsigned newNumberChunks);
+
+                std::atomic<Chunk*>   chunks[numberBuffers][maximumChunks];
+
+                /**
+                 * One more than the highest chunk index ever allocated or mapped in this shard.
+                 */
+                std::atomic<unsigned> numberChunks;
+            };
+
+            /**
+             * Writes the names of newly assigned slots to the memory-mapped file.
+             */
+            void syncMappedNames();
+
+            /**
+             * Points the chunks covering the mapped slots at the memory-mapped file, releasing any chunks allocated
+             * on the heap.
+             */
+            void mapChunks();
+
+            /**
+             * Points the chunks covering the mapped slots away from the memory-mapped file.
+             */
+            void unmapChunks();
+
+            /**
+             * Empties the retired buffer by subtracting its current values, moving anything not consumed into the
+             * active buffer.  Only the thread managing retired buffers may call this method.
+             *
+             * \param[in] consumed If true, the values returned by \ref CounterStore::retire were consumed and only
+             *                     updates made to the retired buffer since are moved.  If false, every retired value
+             *                     is moved.
+             */
+            void drainRetired(bool consumed);
+
+            /**
+             * Obtains the shard assigned to the calling thread.
+             *
+             * \return Returns the shard for the calling thread.
+             */
+            Shard* currentShard();
+
+            /**
+             * Determines the value of a counter in one buffer, summed across all shards.
+             *
+             * \param[in] buffer The buffer of interest.
+             *
+             * \param[in] slot   The slot of interest.
+             *
+             * \return Returns the counter value.
+             */
+            std::uint64_t bufferValue(unsigned buffer, Slot slot) const;
+
+            /**
+             * Determines the number of slots covered by the chunks this store has allocated.  Only these slots can
+             * hold non-zero values, so scans over the store stop here rather than at the last slot in the registry.
+             *
+             * \return Returns the number of slots covered.
+             */
+            Slot allocatedSlots() const;
+
+            /**
+             * Determines if a slot has been admitted to a bounded store.
+             *
+             * \param[in] slot The slot of interest.
+             *
+             * \return Returns true if the slot is admitted.
+             */
+            bool isAdmitted(Slot slot) const;
+
+            /**
+             * Admits a key to a bounded store if there is room, otherwise records the update in the overflow summary.
+             *
+             * \param[in] slot  The slot of the key.  The value \ref CounterStore::invalidSlot indicates a name that
+             *                  has not been registered.
+             *
+             * \param[in] name  The name of the key.  Only used if the slot is invalid.
+             *
+             * \param[in] value The value being added.
+             *
+             * \return Returns the slot the value should be added to.
+             */
+            Slot admit(Slot slot, const QString& name, std::uint64_t value);
+
+            /**
+             * Replaces the admitted keys with the smallest retired values by overflow keys known to be larger, and
+             * trims the admitted keys to the key limit.  The overflow mutex must be held.
+             *
+             * \param[in] retiredBuffer The buffer holding the retired values.
+             *
+             * \param[in] numberSlots   The number of assigned registry slots.
+             */
+            void rebalance(unsigned retiredBuffer, Slot numberSlots);
+
+            /**
+             * The number of shards, always a power of two.
+             */
+            unsigned numberShards;
+
+            /**
+             * The shards.
+             */
+            Shard* shards;
+
+            /**
+             * The index of the buffer receiving updates.
+             */
+            std::atomic<unsigned> activeBuffer;
+
+            /**
+             * Flag indicating that the inactive buffer holds values that have not been released or restored.
+             */
+            bool retiredPending;
+
+            /**
+             * The values returned by the last call to \ref CounterStore::retire, by slot.
+             */
+            QVector<std::uint64_t> retiredValues;
+
+            /**
+             * The memory-mapped counter file.  A null pointer indicates the store is held in memory only.
+             */
+            QFile* mappedFile;
+
+            /**
+             * Pointer to the start of the memory-mapped counter file.
+             */
+            std::uint8_t* mappedData;
+
+            /**
+             * The number of slots placed in the memory-mapped file.  The value is zero if no file is attached.  Only
+             * changed by \ref CounterStore::attach and \ref CounterStore::detach, but read on every update.
+             */
+            std::atomic<Slot> mappedSlots;
+
+            /**
+             * The number of slots whose names have been written to the memory-mapped file.
+             */
+            std::atomic<Slot> namedSlots;
+
+            /**
+             * Mutex serializing updates to the name table in the memory-mapped file.
+             */
+            QMutex mappedNamesMutex;
+
+            /**
+             * The maximum number of keys.  A value of zero indicates no limit.
+             */
+            std::atomic<unsigned> currentMaximumKeys;
+
+            /**
+             * Bitmap of admitted slots.  Only maintained while the number of keys is limited.
+             */
+            std::atomic<std::uint64_t> admittedSlots[KeyRegistry::maximumSlots / 64];
+
+            /**
+             * The number of admitted slots.
+             */
+            unsigned numberAdmittedSlots;
+
+            /**
+             * The slot of the \ref CounterStore::otherName counter.
+             */
+            Slot otherSlot;
+
+            /**
+             * Summary of the keys folded into the \ref CounterStore::otherName counter since counters were last
+             * retired.
+             */
+            SpaceSaving overflow;
+
+            /**
+             * The bound reported by \ref CounterStore::otherBound.
+             */
+            std::uint64_t retiredOtherBound;
+
+            /**
+             * Bound for retired values that were restored, carried into the next retired values.
+             */
+            std::uint64_t restoredOtherBound;
+
+            /**
+             * Mutex protecting key admission and the overflow summary.
+             */
+            mutable QMutex overflowMutex;
+
+            /**
+             * The number of calls to \ref CounterStore::add.  Only used for statistics.
+             */
+            UpdateCounter updates;
+    };
+}
+
+#endif
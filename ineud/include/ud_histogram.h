@@ -0,0 +1,215 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::Histogram class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_HISTOGRAM_H
+#define UD_HISTOGRAM_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+#include <QVector>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that records the distribution of 64-bit values, typically latencies in nanoseconds, using a fixed set of
+     * log-linear buckets in the style of an HDR histogram.
+     *
+     * Values below \ref Histogram::subBucketCount are recorded exactly.  Above that, every power of two is split into
+     * \ref Histogram::subBucketCount linear buckets, bounding the relative error of any reported value to
+     * 1 / \ref Histogram::subBucketCount.  Memory use is fixed at \ref Histogram::numberBuckets counters.
+     *
+     * Recording is lock-free.  Threads record into separate shards of bucket counts, the way \ref Ud::CounterStore
+     * shards counters, so concurrent recording into one histogram does not contend on shared cache lines.  Shards
+     * are allocated on first use and summed by \ref Histogram::snapshot.  Histograms with the same layout can be
+     * merged by adding bucket counts.
+     */
+    class UD_PUBLIC_API Histogram {
+        public:
+            /**
+             * The number of bits used to select a linear sub-bucket within each power of two.
+             */
+            static const unsigned subBucketBits = 4;
+
+            /**
+             * The number of linear sub-buckets within each power of two.
+             */
+            static const unsigned subBucketCount = 1U << subBucketBits;
+
+            /**
+             * The total number of buckets.
+             */
+            static const unsigned numberBuckets = (64 - subBucketBits + 1) * subBucketCount;
+
+            /**
+             * The maximum number of shards.  Each shard holds \ref Histogram::numberBuckets counters.
+             */
+            static const unsigned maximumShards = 16;
+
+            Histogram();
+
+            ~Histogram();
+
+            /**
+             * Records a value in the calling thread's shard.  This method is thread-safe and lock-free.
+             *
+             * \param[in] value The value to record.
+             *
+             * \param[in] count The number of times to record the value.
+             */
+            void record(std::uint64_t value, std::uint64_t count = 1);
+
+            /**
+             * Obtains a copy of the bucket counts, summed over every shard.  This method is thread-safe.
+             *
+             * \return Returns a vector holding \ref Histogram::numberBuckets bucket counts.
+             */
+            QVector<std::uint64_t> snapshot() const;
+
+            /**
+             * Adds a set of bucket counts to this histogram.  This method is thread-safe.
+             *
+             * \param[in] bucketCounts The bucket counts to add, as returned by \ref Histogram::snapshot.
+             */
+            void merge(const QVector<std::uint64_t>& bucketCounts);
+
+            /**
+             * Adds another histogram to this histogram.  This method is thread-safe.
+             *
+             * \param[in] other The histogram to add.
+             */
+            void merge(const Histogram& other);
+
+            /**
+             * Subtracts a set of bucket counts from this histogram.  This method is thread-safe.
+             *
+             * \param[in] bucketCounts The bucket counts to subtract, as returned by \ref Histogram::snapshot.
+             */
+            void subtract(const QVector<std::uint64_t>& bucketCounts);
+
+            /**
+             * Resets every bucket to zero.
+             */
+            void clear();
+
+            /**
+             * Determines the approximate memory held by the histogram.
+             *
+             * \return Returns the memory held, in bytes.
+             */
+            std::uint64_t memoryUsage() const;
+
+            /**
+             * Determines the bucket that a value is recorded in.
+             *
+             * \param[in] value The value of interest.
+             *
+             * \return Returns the bucket index.
+             */
+            static inline unsigned bucketIndex(std::uint64_t value) {
+                unsigned result;
+
+                if (value < subBucketCount) {
+                    result = static_cast<unsigned>(value);
+                } else {
+                    unsigned mostSignificantBit = 63 - qCountLeadingZeroBits(static_cast<quint64>(value));
+                    unsigned shift = mostSignificantBit - subBucketBits;
+                    result = (shift + 1) * subBucketCount + static_cast<unsigned>((value >> shift) - subBucketCount);
+                }
+
+                return result;
+            }
+
+            /**
+             * Determines the smallest value recorded in a bucket.
+             *
+             * \param[in] index The bucket index.
+             *
+             * \return Returns the smallest value that maps to the bucket.
+             */
+            static std::uint64_t bucketLowerBound(unsigned index);
+
+            /**
+             * Determines the largest value recorded in a bucket.
+             *
+             * \param[in] index The bucket index.
+             *
+             * \return Returns the largest value that maps to the bucket.
+             */
+            static std::uint64_t bucketUpperBound(unsigned index);
+
+            /**
+             * Estimates a quantile from a set of bucket counts.
+             *
+             * \param[in] bucketCounts The bucket counts, as returned by \ref Histogram::snapshot.
+             *
+             * \param[in] quantile     The desired quantile, between 0 and 1.
+             *
+             * \return Returns the midpoint of the bucket holding the quantile.  Zero is returned if no values have
+             *         been recorded.
+             */
+            static std::uint64_t valueAtQuantile(const QVector<std::uint64_t>& bucketCounts, double quantile);
+
+        private:
+            Q_DISABLE_COPY(Histogram)
+
+            /**
+             * Structure holding one shard of bucket counts.  Counts in a single shard may wrap after a subtraction;
+             * only the sum over every shard is meaningful.
+             */
+            struct Shard {
+                Shard();
+
+                std::atomic<std::uint64_t> counts[numberBuckets];
+            };
+
+            /**
+             * Obtains the calling thread's shard, allocating it if needed.
+             *
+             * \return Returns a pointer to the shard.
+             */
+            Shard* threadShard();
+
+            /**
+             * The number of shards in use, a power of two.
+             */
+            unsigned numberShards;
+
+            /**
+             * The shards, allocated on first use.  The first shard is always allocated and receives merged and
+             * subtracted counts.
+             */
+            std::atomic<Shard*> shards[maximumShards];
+    };
+}
+
+#endif
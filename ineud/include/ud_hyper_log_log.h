@@ -0,0 +1,176 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::HyperLogLog class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_HYPER_LOG_LOG_H
+#define UD_HYPER_LOG_LOG_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that estimates the number of distinct values observed using a HyperLogLog sketch.
+     *
+     * The sketch holds \ref HyperLogLog::numberRegisters single byte registers giving a standard error of roughly
+     * 1.04 / sqrt(\ref HyperLogLog::numberRegisters), about 1.6%.  Values are hashed with a stable 64-bit hash so
+     * sketches can be persisted and merged across runs and across installations.  Observations are lock-free.
+     */
+    class UD_PUBLIC_API HyperLogLog {
+        public:
+            /**
+             * The number of hash bits used to select a register.
+             */
+            static const unsigned precision = 12;
+
+            /**
+             * The number of registers.
+             */
+            static const unsigned numberRegisters = 1U << precision;
+
+            HyperLogLog();
+
+            ~HyperLogLog();
+
+            /**
+             * Observes a value.  This method is thread-safe and lock-free.
+             *
+             * \param[in] value The value to observe.
+             */
+            void observe(const QString& value);
+
+            /**
+             * Observes a value.  This method is thread-safe and lock-free.
+             *
+             * \param[in] value The value to observe.
+             */
+            void observe(const QByteArray& value);
+
+            /**
+             * Observes a pre-computed 64-bit hash.  This method is thread-safe and lock-free.
+             *
+             * \param[in] hash The hash of the value to observe.  The hash should be uniformly distributed.
+             */
+            inline void observeHash(std::uint64_t hash) {
+                unsigned      index = static_cast<unsigned>(hash >> (64 - precision));
+                std::uint64_t rest  = (hash << precision) | (static_cast<std::uint64_t>(1) << (precision - 1));
+                std::uint8_t  rank  = static_cast<std::uint8_t>(qCountLeadingZeroBits(static_cast<quint64>(rest)) + 1);
+
+                std::uint8_t current = registers[index].load(std::memory_order_relaxed);
+                while (rank > current
+                       && !registers[index].compare_exchange_weak(current, rank, std::memory_order_relaxed)) {}
+            }
+
+            /**
+             * Obtains a copy of the registers.  This method is thread-safe.
+             *
+             * \return Returns a byte array holding \ref HyperLogLog::numberRegisters registers.
+             */
+            QByteArray registerData() const;
+
+            /**
+             * Merges a set of registers into this sketch.  This method is thread-safe.
+             *
+             * \param[in] data The registers to merge, as returned by \ref HyperLogLog::registerData.  Data of the
+             *                 wrong size is ignored.
+             */
+            void merge(const QByteArray& data);
+
+            /**
+             * Removes a set of registers, typically an earlier copy of this sketch, from this sketch.  Registers
+             * that have grown since the copy was taken are retained so observations made after the copy are not
+             * lost.  This method is thread-safe.
+             *
+             * Registers still equal to the copy are cleared, so a value observed after the copy whose rank does not
+             * exceed its register's copied rank is dropped.  Later estimates undercount such values.
+             *
+             * \param[in] data The registers to remove, as returned by \ref HyperLogLog::registerData.
+             */
+            void subtract(const QByteArray& data);
+
+            /**
+             * Resets this sketch.
+             */
+            void clear();
+
+            /**
+             * Estimates the number of distinct values observed.  This method is thread-safe.
+             *
+             * \return Returns the estimated number of distinct values.
+             */
+            double estimate() const;
+
+            /**
+             * Estimates the number of distinct values represented by a set of registers.
+             *
+             * \param[in] data The registers, as returned by \ref HyperLogLog::registerData.
+             *
+             * \return Returns the estimated number of distinct values.
+             */
+            static double estimate(const QByteArray& data);
+
+            /**
+             * Merges one set of registers into another by taking the element-wise maximum.  The loop is written so
+             * that compilers vectorize it.  Used by \ref HyperLogLog::merge.
+             *
+             * \param[in,out] target The registers to be updated.
+             *
+             * \param[in]     source The registers to merge into the target.
+             *
+             * \param[in]     count  The number of registers.
+             */
+            static void mergeRegisters(std::uint8_t* target, const std::uint8_t* source, unsigned count);
+
+            /**
+             * Calculates the stable 64-bit hash used for observed values.
+             *
+             * \param[in] data   The data to hash.
+             *
+             * \param[in] length The length of the data, in bytes.
+             *
+             * \return Returns the hash.
+             */
+            static std::uint64_t hash(const char* data, unsigned long length);
+
+        private:
+            Q_DISABLE_COPY(HyperLogLog)
+
+            /**
+             * The registers.
+             */
+            std::atomic<std::uint8_t> registers[numberRegisters];
+    };
+}
+
+#endif
@@ -0,0 +1,192 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::KeyRegistry class, the \ref Ud::StaticKey template, and the \ref UD_EVENT and
+* \ref UD_ACTIVITY macros.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_KEY_REGISTRY_H
+#define UD_KEY_REGISTRY_H
+
+#include <QString>
+#include <QtGlobal>
+#include <QVector>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that maintains the process-wide mapping between event or activity names and dense slot indexes.  Slots
+     * are shared by every \ref Ud::UsageData instance so that handles, including handles generated at compile time,
+     * are valid for any instance.
+     *
+     * Slot 0 is reserved and is never assigned to a name.  Updates made to slot 0 are discarded when reports are
+     * generated.
+     */
+    class UD_PUBLIC_API KeyRegistry {
+        public:
+            /**
+             * Type used to represent a slot index.
+             */
+            typedef std::uint32_t Slot;
+
+            /**
+             * The maximum number of slots supported by the registry, including the reserved slot.
+             */
+            static const Slot maximumSlots = 512 * 512;
+
+            /**
+             * The reserved slot.  It is never assigned to a name.
+             */
+            static const Slot reservedSlot = 0;
+
+            /**
+             * Value returned to indicate an invalid slot.
+             */
+            static const Slot invalidSlot = static_cast<Slot>(-1);
+
+            /**
+             * Calculates a 64-bit FNV-1a hash of a name.  The hash is calculated at compile time when the name is a
+             * string literal.
+             *
+             * \param[in] name The name to be hashed.
+             *
+             * \return Returns the hash of the name.
+             */
+            static constexpr std::uint64_t hash(const char* name) {
+                std::uint64_t result = 0xCBF29CE484222325ULL;
+                while (*name != '\0') {
+                    result = (result ^ static_cast<unsigned char>(*name)) * 0x100000001B3ULL;
+                    ++name;
+                }
+
+                return result;
+            }
+
+            /**
+             * Determines the slot associated with a name, assigning a new slot if needed.  This method is
+             * thread-safe.
+             *
+             * \param[in] name The name of interest.
+             *
+             * \return Returns the slot associated with the name.  The value \ref KeyRegistry::invalidSlot is returned
+             *         if the registry is full.
+             */
+            static Slot slot(const QString& name);
+
+            /**
+             * Determines the slot associated with a static, UTF-8 encoded name, assigning a new slot if needed.
+             * This method is used by \ref StaticKey and is thread-safe.
+             *
+             * \param[in] name     The name of interest.
+             *
+             * \param[in] nameHash The hash of the name as calculated by \ref KeyRegistry::hash.
+             *
+             * \return Returns the slot associated with the name.  The value \ref KeyRegistry::invalidSlot is returned
+             *         if the registry is full.
+             */
+            static Slot staticSlot(const char* name, std::uint64_t nameHash);
+
+            /**
+             * Determines the slot associated with a name.  This method is thread-safe.
+             *
+             * \param[in] name The name of interest.
+             *
+             * \return Returns the slot associated with the name.  The value \ref KeyRegistry::invalidSlot is returned
+             *         if the name has not been assigned a slot.
+             */
+            static Slot find(const QString& name);
+
+            /**
+             * Determines the name associated with a slot.  This method is thread-safe.
+             *
+             * \param[in] slot The slot of interest.
+             *
+             * \return Returns the name associated with the slot.  An empty string is returned if the slot has not
+             *         been assigned.
+             */
+            static QString name(Slot slot);
+
+            /**
+             * Obtains the names of every assigned slot, indexed by slot.  The reserved slot holds an empty name.  This
+             * method is thread-safe.
+             *
+             * \return Returns a vector of names indexed by slot.
+             */
+            static QVector<QString> names();
+    };
+
+    /**
+     * Template class that assigns a slot to a compile-time name on first use.  You should generally use the
+     * \ref UD_EVENT or \ref UD_ACTIVITY macros rather than this class directly.
+     *
+     * \param NameType A type providing a static constexpr method value() returning the name.
+     *
+     * \param nameHash The compile-time hash of the name.
+     */
+    template<typename NameType, std::uint64_t nameHash> class StaticKey {
+        public:
+            /**
+             * Obtains the slot assigned to the name.  The slot is held in a function-local static so it is assigned
+             * the first time it is needed, including from static initializers in any translation unit.
+             *
+             * \return Returns the slot assigned to the name.
+             */
+            static KeyRegistry::Slot slot() {
+                static const KeyRegistry::Slot assignedSlot = KeyRegistry::staticSlot(NameType::value(), nameHash);
+                return assignedSlot;
+            }
+    };
+}
+
+/** \def UD_EVENT
+ *
+ * Macro that resolves a string literal event name to a \ref Ud::UsageData::EventId handle.  The name is hashed at
+ * compile time and the handle is assigned on first use so each later use costs a guard check and a load.  Handles
+ * can safely be obtained from static initializers.  Example:
+ *
+ *     usageData->adjustEventById(UD_EVENT("document_opened"));
+ *
+ * \param[in] _name The string literal name of the event.
+ */
+#define UD_EVENT(_name)                                                                                               \
+    ([]() -> ::Ud::KeyRegistry::Slot {                                                                                \
+        struct UdStaticKeyName { static constexpr const char* value() { return _name; } };                            \
+        return ::Ud::StaticKey<UdStaticKeyName, ::Ud::KeyRegistry::hash(_name)>::slot();                              \
+    }())
+
+/** \def UD_ACTIVITY
+ *
+ * Macro that resolves a string literal activity name to a \ref Ud::UsageData::ActivityId handle.  See
+ * \ref UD_EVENT for details.
+ *
+ * \param[in] _name The string literal name of the activity.
+ */
+#define UD_ACTIVITY(_name) UD_EVENT(_name)
+
+#endif
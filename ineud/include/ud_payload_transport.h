@@ -0,0 +1,307 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::PayloadTransport class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_PAYLOAD_TRANSPORT_H
+#define UD_PAYLOAD_TRANSPORT_H
+
+#include <QObject>
+#include <QtGlobal>
+#include <QByteArray>
+#include <QUrl>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QJsonDocument;
+
+namespace Ud {
+    /**
+     * Class that posts report payloads, optionally compressed, to a collector.
+     *
+     * The body is compressed before it is signed so the collector can verify the signature before spending any
+     * effort decompressing it.  Each request carries the following headers:
+     *
+     *     * Content-Encoding - The compression applied to the body, omitted if the body is not compressed.
+     *     * X-Inesonic-Timestamp - The time the request was sent, in seconds since the Unix epoch.
+     *     * X-Inesonic-Signature - The hex encoded HMAC-SHA256 of the timestamp, a period, and the body as sent.
+     *
+     * The collector is expected to respond with a JSON document.
+     *
+     * Compression and signing can be done ahead of time, on any thread, using \ref PayloadTransport::prepare.  The
+     * prepared request is then posted from the thread owning the network access manager using
+     * \ref PayloadTransport::post.
+     */
+    class UD_PUBLIC_API PayloadTransport:public QObject {
+        Q_OBJECT
+
+        public:
+            /**
+             * Enumeration of supported body compression schemes.
+             */
+            enum class Compression : std::uint8_t {
+                /**
+                 * Indicates the body is sent as is.
+                 */
+                NONE = 0,
+
+                /**
+                 * Indicates the body is sent as a zlib stream, the HTTP "deflate" content encoding.
+                 */
+                DEFLATE = 1
+            };
+
+            /**
+             * Structure holding a compressed and signed request, ready to be posted.
+             */
+            struct Request {
+                /**
+                 * The MIME type of the uncompressed payload.
+                 */
+                QByteArray contentType;
+
+                /**
+                 * The HTTP content encoding of the body.  Empty if the body is not compressed.
+                 */
+                QByteArray contentEncoding;
+
+                /**
+                 * The request timestamp, in seconds since the Unix epoch.
+                 */
+                QByteArray timestamp;
+
+                /**
+                 * The hex encoded request signature.
+                 */
+                QByteArray signature;
+
+                /**
+                 * The body as sent, after compression.
+                 */
+                QByteArray body;
+            };
+
+            /**
+             * The name of the header holding the request timestamp.
+             */
+            static const char timestampHeader[];
+
+            /**
+             * The name of the header holding the request signature.
+             */
+            static const char signatureHeader[];
+
+            /**
+             * The zlib compression level used for deflated bodies.
+             */
+            static const int compressionLevel;
+
+            /**
+             * Constructor
+             *
+             * \param[in] networkAccessManager The network access manager used to send requests.
+             *
+             * \param[in] sharedSecret         The HMAC secret used to sign requests.
+             *
+             * \param[in] parent               Pointer to the parent object.
+             */
+            PayloadTransport(
+                QNetworkAccessManager* networkAccessManager,
+                const QByteArray&      sharedSecret,
+                QObject*               parent = Q_NULLPTR
+            );
+
+            ~PayloadTransport() override;
+
+            /**
+             * Determines the compression applied to request bodies.
+             *
+             * \return Returns the current compression scheme.
+             */
+            Compression compression() const;
+
+            /**
+             * Sets the compression applied to request bodies.
+             *
+             * \param[in] newCompression The new compression scheme.
+             */
+            void setCompression(Compression newCompression);
+
+            /**
+             * Sends a payload.  Either \ref PayloadTransport::responseReceived or \ref PayloadTransport::failed is
+             * emitted once the request completes.
+             *
+             * \param[in] url         The URL to post the payload to.
+             *
+             * \param[in] payload     The uncompressed payload.
+             *
+             * \param[in] contentType The MIME type of the uncompressed payload.
+             */
+            void send(
+                const QUrl&       url,
+                const QByteArray& payload,
+                const QByteArray& contentType = QByteArray("application/json")
+            );
+
+            /**
+             * Posts a prepared request.  Either \ref PayloadTransport::responseReceived or
+             * \ref PayloadTransport::failed is emitted once the request completes.  This method must be called from
+             * the thread owning the network access manager.
+             *
+             * \param[in] url     The URL to post the request to.
+             *
+             * \param[in] request The prepared request.
+             */
+            void post(const QUrl& url, const Request& request);
+
+            /**
+             * Compresses and signs a payload.  This method is thread-safe.
+             *
+             * \param[in] payload      The uncompressed payload.
+             *
+             * \param[in] contentType  The MIME type of the uncompressed payload.
+             *
+             * \param[in] compression  The compression scheme to apply.
+             *
+             * \param[in] sharedSecret The HMAC secret used to sign the request.
+             *
+             * \return Returns the prepared request.
+             */
+            static Request prepare(
+                const QByteArray& payload,
+                const QByteArray& contentType,
+                Compression       compression,
+                const QByteArray& sharedSecret
+            );
+
+            /**
+             * Compresses a body.
+             *
+             * \param[in] body        The body to be compressed.
+             *
+             * \param[in] compression The compression scheme to apply.
+             *
+             * \return Returns the compressed body.
+             */
+            static QByteArray compress(const QByteArray& body, Compression compression);
+
+            /**
+             * Decompresses a body.
+             *
+             * \param[in]  body        The compressed body.
+             *
+             * \param[in]  compression The compression scheme applied to the body.
+             *
+             * \param[out] ok          Optional pointer to a boolean set to true on success or false if the body is
+             *                         not valid.
+             *
+             * \return Returns the decompressed body.
+             */
+            static QByteArray decompress(const QByteArray& body, Compression compression, bool* ok = Q_NULLPTR);
+
+            /**
+             * Determines the HTTP content encoding for a compression scheme.
+             *
+             * \param[in] compression The compression scheme of interest.
+             *
+             * \return Returns the content encoding.  An empty array is returned if the body is not compressed.
+             */
+            static QByteArray contentEncoding(Compression compression);
+
+            /**
+             * Determines the compression scheme for an HTTP content encoding.
+             *
+             * \param[in]  encoding The content encoding.  An empty array indicates an uncompressed body.
+             *
+             * \param[out] ok       Optional pointer to a boolean set to false if the encoding is not supported.
+             *
+             * \return Returns the compression scheme.
+             */
+            static Compression compressionForEncoding(const QByteArray& encoding, bool* ok = Q_NULLPTR);
+
+            /**
+             * Calculates a request signature.
+             *
+             * \param[in] sharedSecret The HMAC secret.
+             *
+             * \param[in] timestamp    The request timestamp, as sent in the timestamp header.
+             *
+             * \param[in] body         The body as sent, after compression.
+             *
+             * \return Returns the hex encoded signature.
+             */
+            static QByteArray signature(
+                const QByteArray& sharedSecret,
+                const QByteArray& timestamp,
+                const QByteArray& body
+            );
+
+        signals:
+            /**
+             * Signal that is emitted when the collector responds with a JSON document.
+             *
+             * \param[out] response The response from the collector.
+             */
+            void responseReceived(const QJsonDocument& response);
+
+            /**
+             * Signal that is emitted when a request fails.
+             *
+             * \param[out] networkError The QNetworkReply::NetworkError code describing the failure.
+             */
+            void failed(int networkError);
+
+        private:
+            /**
+             * Processes a completed request.
+             *
+             * \param[in] reply The reply to the request.
+             */
+            void processReply(QNetworkReply* reply);
+
+            /**
+             * The network access manager used to send requests.
+             */
+            QNetworkAccessManager* currentNetworkAccessManager;
+
+            /**
+             * The HMAC secret.
+             */
+            QByteArray currentSharedSecret;
+
+            /**
+             * The compression applied to request bodies.
+             */
+            Compression currentCompression;
+    };
+}
+
+#endif
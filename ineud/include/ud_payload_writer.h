@@ -0,0 +1,272 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::PayloadWriter class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_PAYLOAD_WRITER_H
+#define UD_PAYLOAD_WRITER_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QStringList>
+#include <QScopedPointer>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+class QCborStreamWriter;
+class QJsonValue;
+
+namespace Ud {
+    /**
+     * Class that streams a report body directly into a byte array as either compact JSON or CBOR.  No intermediate
+     * document is built, so the cost of a report is one pass over the data being reported.
+     *
+     * Values inside a map must be preceded by a call to \ref PayloadWriter::writeKey.  The writer does not validate
+     * the structure it is given.
+     *
+     * The writer can also fill a QJsonObject for consumers, such as the web hook, that only accept a document.  That
+     * mode still builds the document an insertion at a time and exists so a report is described once, not to make
+     * the document cheaper.
+     *
+     * This class is not thread-safe.
+     */
+    class UD_PUBLIC_API PayloadWriter {
+        public:
+            /**
+             * Enumeration of supported output formats.
+             */
+            enum class Format : std::uint8_t {
+                /**
+                 * Indicates compact JSON.  Integers are written exactly, however many JSON parsers will read
+                 * integers above 2^53 as doubles.
+                 */
+                JSON = 0,
+
+                /**
+                 * Indicates CBOR.  Integers are written as native 64-bit integers and byte arrays as byte strings.
+                 */
+                CBOR = 1
+            };
+
+            /**
+             * Constructor
+             *
+             * \param[in] format        The output format.
+             *
+             * \param[in] reservedBytes The number of bytes to preallocate for the output.
+             */
+            PayloadWriter(Format format, int reservedBytes = 0);
+
+            /**
+             * Constructor.  The writer fills a JSON object rather than a byte array.  The top level value must be a
+             * map.  Integers are stored as doubles, as required by QJsonValue.
+             *
+             * \param[in] object The object to receive the top level map.  The object is assigned when the top level
+             *                   map is ended.
+             */
+            PayloadWriter(QJsonObject* object);
+
+            ~PayloadWriter();
+
+            /**
+             * Determines the output format.
+             *
+             * \return Returns the output format.
+             */
+            Format format() const;
+
+            /**
+             * Starts a map.
+             */
+            void startMap();
+
+            /**
+             * Ends the most recently started map.
+             */
+            void endMap();
+
+            /**
+             * Starts an array.
+             */
+            void startArray();
+
+            /**
+             * Ends the most recently started array.
+             */
+            void endArray();
+
+            /**
+             * Writes a map key.  The next value written is associated with the key.
+             *
+             * \param[in] key The key to be written.
+             */
+            void writeKey(const QString& key);
+
+            /**
+             * Writes an unsigned integer.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeUnsigned(std::uint64_t value);
+
+            /**
+             * Writes a signed integer.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeInteger(std::int64_t value);
+
+            /**
+             * Writes a floating point value.  Non-finite values are written as null in JSON.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeDouble(double value);
+
+            /**
+             * Writes a boolean value.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeBoolean(bool value);
+
+            /**
+             * Writes a string.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeString(const QString& value);
+
+            /**
+             * Writes binary data.  The data is written as a byte string in CBOR and as a base 64 encoded string in
+             * JSON.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeBytes(const QByteArray& value);
+
+            /**
+             * Writes a JSON value.  Integral numbers are written as integers.
+             *
+             * \param[in] value The value to be written.
+             */
+            void writeJson(const QJsonValue& value);
+
+            /**
+             * Obtains the output written so far.
+             *
+             * \return Returns the output.  The output is always empty when the writer fills a JSON object.
+             */
+            const QByteArray& data() const;
+
+        private:
+            Q_DISABLE_COPY(PayloadWriter)
+
+            /**
+             * Writes the separator needed before a JSON value or key.
+             */
+            void separate();
+
+            /**
+             * Writes a quoted, escaped JSON string.
+             *
+             * \param[in] value The string to be written.
+             */
+            void writeQuoted(const QString& value);
+
+            /**
+             * Adds a value to the innermost open map or array of the JSON object being filled.
+             *
+             * \param[in] value The value to be added.
+             */
+            void appendValue(const QJsonValue& value);
+
+            /**
+             * The output format.
+             */
+            Format currentFormat;
+
+            /**
+             * The output.
+             */
+            QByteArray buffer;
+
+            /**
+             * The CBOR encoder, used only for CBOR output.
+             */
+            QScopedPointer<QCborStreamWriter> cborWriter;
+
+            /**
+             * Stack holding, for each open JSON map or array, true until the first member is written.
+             */
+            QVector<bool> emptyContainers;
+
+            /**
+             * Flag indicating a JSON key was just written.
+             */
+            bool keyWritten;
+
+            /**
+             * The object being filled.  A null pointer if the writer produces a byte array.
+             */
+            QJsonObject* targetObject;
+
+            /**
+             * The most recently written key, used only when filling a JSON object.
+             */
+            QString currentKey;
+
+            /**
+             * Stack of the keys the open containers will be stored under, used only when filling a JSON object.
+             */
+            QStringList containerKeys;
+
+            /**
+             * Stack holding, for each open container, true if the container is an array.  Used only when filling a
+             * JSON object.
+             */
+            QVector<bool> arrayContainers;
+
+            /**
+             * The open maps, innermost last.  Used only when filling a JSON object.
+             */
+            QVector<QJsonObject> openObjects;
+
+            /**
+             * The open arrays, innermost last.  Used only when filling a JSON object.
+             */
+            QVector<QJsonArray> openArrays;
+    };
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::QuantileSketch class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_QUANTILE_SKETCH_H
+#define UD_QUANTILE_SKETCH_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QMutex>
+#include <QJsonObject>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that estimates quantiles of a stream of 64-bit values using a DDSketch.  Every reported quantile is within
+     * a configurable relative error of the true value.
+     *
+     * Values are mapped to logarithmically spaced bins.  Memory use is bounded by \ref QuantileSketch::maximumBins;
+     * if values span more bins than allowed, the lowest bins are collapsed so that accuracy is preserved for the
+     * upper quantiles.  Sketches with the same relative accuracy can be merged.
+     */
+    class UD_PUBLIC_API QuantileSketch {
+        public:
+            /**
+             * The default relative accuracy.
+             */
+            static const double defaultRelativeAccuracy;
+
+            /**
+             * The default maximum number of bins.  At 8 bytes per bin, this bounds each sketch to roughly 4 KB.
+             */
+            static const unsigned defaultMaximumBins;
+
+            /**
+             * Constructor
+             *
+             * \param[in] relativeAccuracy The desired relative accuracy, between 0 and 1, exclusive.
+             *
+             * \param[in] maximumBins      The maximum number of bins to maintain.
+             */
+            QuantileSketch(
+                double   relativeAccuracy = defaultRelativeAccuracy,
+                unsigned maximumBins = defaultMaximumBins
+            );
+
+            /**
+             * Copy constructor
+             *
+             * \param[in] other The instance to be copied.
+             */
+            QuantileSketch(const QuantileSketch& other);
+
+            ~QuantileSketch();
+
+            /**
+             * Obtains the relative accuracy of this sketch.
+             *
+             * \return Returns the relative accuracy.
+             */
+            double relativeAccuracy() const;
+
+            /**
+             * Obtains the maximum number of bins this sketch will maintain.
+             *
+             * \return Returns the maximum number of bins.
+             */
+            unsigned maximumBins() const;
+
+            /**
+             * Records a value.  This method is thread-safe.
+             *
+             * \param[in] value The value to record.
+             *
+             * \param[in] count The number of times to record the value.
+             */
+            void record(std::uint64_t value, std::uint64_t count = 1);
+
+            /**
+             * Obtains the number of recorded values.  This method is thread-safe.
+             *
+             * \return Returns the number of recorded values.
+             */
+            std::uint64_t count() const;
+
+            /**
+             * Estimates a quantile.  This method is thread-safe.
+             *
+             * \param[in] quantile The desired quantile, between 0 and 1.
+             *
+             * \return Returns the estimated value.  Zero is returned if no values have been recorded.
+             */
+            double valueAtQuantile(double quantile) const;
+
+            /**
+             * Adds another sketch to this sketch.  Both sketches should use the same relative accuracy.  This method
+             * is thread-safe.
+             *
+             * \param[in] other The sketch to add.
+             */
+            void merge(const QuantileSketch& other);
+
+            /**
+             * Removes the values held by another sketch, typically an earlier copy of this sketch, from this sketch.
+             * This method is thread-safe.
+             *
+             * \param[in] other The sketch to remove.
+             */
+            void subtract(const QuantileSketch& other);
+
+            /**
+             * Removes every recorded value.  This method is thread-safe.
+             */
+            void clear();
+
+            /**
+             * Serializes this sketch to a compact JSON object.  The object holds the relative accuracy, the number of
+             * zero values, the index of the first non-empty bin, and the dense bin counts from that bin onward.  The
+             * value represented by bin i is 2 * gamma^i / (gamma + 1) where gamma is
+             * (1 + relative_accuracy) / (1 - relative_accuracy).  This method is thread-safe.
+             *
+             * \return Returns the serialized sketch.
+             */
+            QJsonObject toJson() const;
+
+            /**
+             * Assignment operator.
+             *
+             * \param[in] other The instance to be copied.
+             *
+             * \return Returns a reference to this instance.
+             */
+            QuantileSketch& operator=(const QuantileSketch& other);
+
+        private:
+            /**
+             * Determines the bin index associated with a non-zero value.
+             *
+             * \param[in] value The value of interest.
+             *
+             * \return Returns the bin index.
+             */
+            int binIndex(std::uint64_t value) const;
+
+            /**
+             * Determines the value represented by a bin index.
+             *
+             * \param[in] index The bin index.
+             *
+             * \return Returns the representative value.
+             */
+            double binValue(int index) const;
+
+            /**
+             * Locates the position of a bin in the count vector, growing or collapsing the vector as needed.  The
+             * mutex must be held.
+             *
+             * \param[in] index The bin index.
+             *
+             * \return Returns the position of the bin in the count vector.
+             */
+            unsigned position(int index);
+
+            /**
+             * The relative accuracy.
+             */
+            double currentRelativeAccuracy;
+
+            /**
+             * The maximum number of bins.
+             */
+            unsigned currentMaximumBins;
+
+            /**
+             * The logarithm base, gamma.
+             */
+            double gamma;
+
+            /**
+             * The reciprocal of the natural logarithm of gamma.
+             */
+            double inverseLogGamma;
+
+            /**
+             * The bin index of the first entry in the count vector.
+             */
+            int minimumIndex;
+
+            /**
+             * The dense bin counts, starting at \ref QuantileSketch::minimumIndex.
+             */
+            QVector<std::uint64_t> counts;
+
+            /**
+             * The number of zero values recorded.
+             */
+            std::uint64_t zeroCount;
+
+            /**
+             * The total number of values recorded.
+             */
+            std::uint64_t totalCount;
+
+            /**
+             * Mutex protecting the sketch state.
+             */
+            mutable QMutex mutex;
+    };
+}
+
+#endif
@@ -0,0 +1,296 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::ReportSpool class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_REPORT_SPOOL_H
+#define UD_REPORT_SPOOL_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QFileInfoList>
+
+#include <cstdint>
+
+#include "ud_common.h"
+#include "ud_payload_writer.h"
+
+namespace Ud {
+    /**
+     * Class that keeps unsent reports in a directory so they survive application restarts.
+     *
+     * Each report is written atomically to its own file and sealed with an HMAC-SHA256 of its contents.  Files that
+     * fail the seal check, such as ones left truncated by a crash or edited on disk, are discarded when the spool is
+     * read.  The spool is bounded by both a total size and a number of reports; when either bound is exceeded the
+     * oldest reports are evicted first.  A report is also dropped once it has been part of too many failed uploads so
+     * a report the collector will never accept cannot hold up the reports behind it.  Failure counts are kept in
+     * memory only.
+     *
+     * This class is not thread-safe.
+     */
+    class UD_PUBLIC_API ReportSpool {
+        public:
+            /**
+             * Structure holding one spooled report.
+             */
+            struct Entry {
+                /**
+                 * The file holding the report.
+                 */
+                QString filename;
+
+                /**
+                 * The report body.
+                 */
+                QByteArray payload;
+            };
+
+            /**
+             * The default maximum total size of the spool, in bytes.
+             */
+            static const qint64 defaultMaximumBytes;
+
+            /**
+             * The default maximum number of reports held by the spool.
+             */
+            static const unsigned defaultMaximumEntries;
+
+            /**
+             * The default number of failed uploads after which a report is dropped.
+             */
+            static const unsigned defaultMaximumFailures;
+
+            /**
+             * The suffix used for spool files.
+             */
+            static const char fileSuffix[];
+
+            /**
+             * Constructor
+             *
+             * \param[in] directory The spool directory.  An empty string disables the spool.
+             *
+             * \param[in] sealKey   The key used to seal spooled reports.
+             */
+            ReportSpool(const QString& directory = QString(), const QByteArray& sealKey = QByteArray());
+
+            ~ReportSpool();
+
+            /**
+             * Determines the spool directory.
+             *
+             * \return Returns the spool directory.  An empty string is returned if the spool is disabled.
+             */
+            QString directory() const;
+
+            /**
+             * Sets the spool directory.  The directory is created if needed.
+             *
+             * \param[in] newDirectory The new spool directory.  An empty string disables the spool.
+             */
+            void setDirectory(const QString& newDirectory);
+
+            /**
+             * Sets the key used to seal spooled reports.  Reports sealed with a different key are discarded.
+             *
+             * \param[in] newSealKey The new seal key.
+             */
+            void setSealKey(const QByteArray& newSealKey);
+
+            /**
+             * Determines if the spool is enabled.
+             *
+             * \return Returns true if a spool directory is set.  Returns false if the spool is disabled.
+             */
+            bool isEnabled() const;
+
+            /**
+             * Determines the maximum total size of the spool.
+             *
+             * \return Returns the maximum size, in bytes.
+             */
+            qint64 maximumBytes() const;
+
+            /**
+             * Sets the maximum total size of the spool.
+             *
+             * \param[in] newMaximumBytes The new maximum size, in bytes.
+             */
+            void setMaximumBytes(qint64 newMaximumBytes);
+
+            /**
+             * Determines the maximum number of reports held by the spool.
+             *
+             * \return Returns the maximum number of reports.
+             */
+            unsigned maximumEntries() const;
+
+            /**
+             * Sets the maximum number of reports held by the spool.
+             *
+             * \param[in] newMaximumEntries The new maximum number of reports.
+             */
+            void setMaximumEntries(unsigned newMaximumEntries);
+
+            /**
+             * Determines the number of failed uploads after which a report is dropped.
+             *
+             * \return Returns the maximum number of failed uploads.
+             */
+            unsigned maximumFailures() const;
+
+            /**
+             * Sets the number of failed uploads after which a report is dropped.
+             *
+             * \param[in] newMaximumFailures The new maximum number of failed uploads.  A value of zero keeps reports
+             *                               until they are evicted.
+             */
+            void setMaximumFailures(unsigned newMaximumFailures);
+
+            /**
+             * Adds a report to the spool, evicting the oldest reports if the spool is over its bounds.
+             *
+             * \param[in] payload The report body.
+             *
+             * \param[in] format  The format of the report body.
+             *
+             * \return Returns true on success.  Returns false if the spool is disabled, the report alone exceeds the
+             *         size bound, or the report could not be written.
+             */
+            bool add(const QByteArray& payload, PayloadWriter::Format format);
+
+            /**
+             * Reads the oldest spooled reports of a given format.  Reports that fail the seal check are removed.
+             *
+             * \param[in] format         The format of the reports to read.
+             *
+             * \param[in] maximumEntries The maximum number of reports to read.
+             *
+             * \return Returns the reports, oldest first.
+             */
+            QList<Entry> entries(PayloadWriter::Format format, unsigned maximumEntries);
+
+            /**
+             * Removes reports from the spool, typically once they have been accepted by the collector.
+             *
+             * \param[in] filenames The files holding the reports to remove.
+             */
+            void remove(const QStringList& filenames);
+
+            /**
+             * Records that an upload holding reports failed.  Reports that have reached the maximum number of failed
+             * uploads are removed.
+             *
+             * \param[in] filenames The files holding the reports that were part of the failed upload.
+             *
+             * \return Returns the number of reports removed.
+             */
+            unsigned recordFailure(const QStringList& filenames);
+
+            /**
+             * Determines the number of reports in the spool.
+             *
+             * \return Returns the number of spooled reports.
+             */
+            unsigned numberEntries() const;
+
+            /**
+             * Combines several report bodies into a single batch body.  A JSON batch is an array of report objects.
+             * A CBOR batch is an indefinite length array of report maps.
+             *
+             * \param[in] payloads The report bodies, in the order they should appear.
+             *
+             * \param[in] format   The format of the report bodies.
+             *
+             * \return Returns the batch body.
+             */
+            static QByteArray combine(const QList<QByteArray>& payloads, PayloadWriter::Format format);
+
+        private:
+            /**
+             * Lists the spool files, oldest first.
+             *
+             * \return Returns the spool files.
+             */
+            QFileInfoList files() const;
+
+            /**
+             * Removes the oldest reports until the spool is within its bounds.
+             */
+            void evict();
+
+            /**
+             * Calculates the seal for a spool file.
+             *
+             * \param[in] contents The spool file contents preceding the seal.
+             *
+             * \return Returns the seal.
+             */
+            QByteArray seal(const QByteArray& contents) const;
+
+            /**
+             * The spool directory.
+             */
+            QString currentDirectory;
+
+            /**
+             * The seal key.
+             */
+            QByteArray currentSealKey;
+
+            /**
+             * The maximum total size of the spool, in bytes.
+             */
+            qint64 currentMaximumBytes;
+
+            /**
+             * The maximum number of reports held by the spool.
+             */
+            unsigned currentMaximumEntries;
+
+            /**
+             * The number of failed uploads after which a report is dropped.
+             */
+            unsigned currentMaximumFailures;
+
+            /**
+             * The number of failed uploads of each report, by file.
+             */
+            QHash<QString, unsigned> failureCounts;
+
+            /**
+             * Sequence number used to order reports spooled within the same millisecond.
+             */
+            std::uint32_t sequenceNumber;
+    };
+}
+
+#endif
@@ -0,0 +1,226 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::RetryPolicy class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_RETRY_POLICY_H
+#define UD_RETRY_POLICY_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that decides how long to wait before retrying a failed report.
+     *
+     * Retries use exponential backoff with full jitter.  After the n-th consecutive failure the delay is drawn
+     * uniformly from one second up to the smaller of the maximum delay and the base delay times 2^(n-1).  Drawing the
+     * whole delay at random keeps a fleet of clients that failed together from retrying together.
+     *
+     * The policy also acts as a circuit breaker.  Once the number of consecutive failures reaches the failure
+     * threshold the circuit opens and no attempts are made for the open period, drawn between half and all of the
+     * configured value.  The first attempt after the open period is a trial, with the circuit half open.  A
+     * successful trial closes the circuit.  A failed trial opens it again.
+     *
+     * This class is not thread-safe.
+     */
+    class UD_PUBLIC_API RetryPolicy {
+        public:
+            /**
+             * Enumeration of circuit breaker states.
+             */
+            enum class CircuitState : std::uint8_t {
+                /**
+                 * Indicates reports are sent normally and failures are retried with backoff.
+                 */
+                CLOSED = 0,
+
+                /**
+                 * Indicates the failure threshold was reached and attempts are suspended for the open period.
+                 */
+                OPEN = 1,
+
+                /**
+                 * Indicates a trial attempt is being made after the open period.
+                 */
+                HALF_OPEN = 2
+            };
+
+            /**
+             * The default delay before the first retry, in seconds.
+             */
+            static const unsigned long long defaultBaseDelay;
+
+            /**
+             * The default maximum delay between retries, in seconds.
+             */
+            static const unsigned long long defaultMaximumDelay;
+
+            /**
+             * The default number of consecutive failures that opens the circuit.
+             */
+            static const unsigned defaultFailureThreshold;
+
+            /**
+             * The default time attempts are suspended once the circuit opens, in seconds.
+             */
+            static const unsigned long long defaultOpenPeriod;
+
+            RetryPolicy();
+
+            ~RetryPolicy();
+
+            /**
+             * Determines the delay before the first retry.
+             *
+             * \return Returns the base delay, in seconds.
+             */
+            unsigned long long baseDelay() const;
+
+            /**
+             * Determines the maximum delay between retries.
+             *
+             * \return Returns the maximum delay, in seconds.
+             */
+            unsigned long long maximumDelay() const;
+
+            /**
+             * Sets the retry delays.
+             *
+             * \param[in] newBaseDelay    The delay before the first retry, in seconds.
+             *
+             * \param[in] newMaximumDelay The maximum delay between retries, in seconds.
+             */
+            void setDelays(unsigned long long newBaseDelay, unsigned long long newMaximumDelay);
+
+            /**
+             * Determines the number of consecutive failures that opens the circuit.
+             *
+             * \return Returns the failure threshold.  A value of 0 indicates the circuit breaker is disabled.
+             */
+            unsigned failureThreshold() const;
+
+            /**
+             * Sets the number of consecutive failures that opens the circuit.
+             *
+             * \param[in] newFailureThreshold The new failure threshold.  A value of 0 disables the circuit breaker.
+             */
+            void setFailureThreshold(unsigned newFailureThreshold);
+
+            /**
+             * Determines the time attempts are suspended once the circuit opens.
+             *
+             * \return Returns the open period, in seconds.
+             */
+            unsigned long long openPeriod() const;
+
+            /**
+             * Sets the time attempts are suspended once the circuit opens.
+             *
+             * \param[in] newOpenPeriod The new open period, in seconds.
+             */
+            void setOpenPeriod(unsigned long long newOpenPeriod);
+
+            /**
+             * Determines the current circuit breaker state.
+             *
+             * \return Returns the circuit breaker state.
+             */
+            CircuitState circuitState() const;
+
+            /**
+             * Determines the number of consecutive failed attempts.
+             *
+             * \return Returns the number of failures since the last success.
+             */
+            unsigned consecutiveFailures() const;
+
+            /**
+             * Records that an attempt is starting.  An open circuit becomes half open.
+             */
+            void attemptStarted();
+
+            /**
+             * Records a successful attempt.  The failure count is cleared and the circuit closes.
+             */
+            void recordSuccess();
+
+            /**
+             * Records a failed attempt.
+             *
+             * \return Returns the delay before the next attempt, in seconds.
+             */
+            unsigned long long recordFailure();
+
+        private:
+            /**
+             * Draws a uniformly distributed value.
+             *
+             * \param[in] minimum The smallest value to return.
+             *
+             * \param[in] maximum The largest value to return.
+             *
+             * \return Returns a value between minimum and maximum, inclusive.
+             */
+            static unsigned long long uniform(unsigned long long minimum, unsigned long long maximum);
+
+            /**
+             * The base delay, in seconds.
+             */
+            unsigned long long currentBaseDelay;
+
+            /**
+             * The maximum delay, in seconds.
+             */
+            unsigned long long currentMaximumDelay;
+
+            /**
+             * The failure threshold.
+             */
+            unsigned currentFailureThreshold;
+
+            /**
+             * The open period, in seconds.
+             */
+            unsigned long long currentOpenPeriod;
+
+            /**
+             * The circuit breaker state.
+             */
+            CircuitState currentCircuitState;
+
+            /**
+             * The number of consecutive failures.
+             */
+            unsigned currentConsecutiveFailures;
+    };
+}
+
+#endif
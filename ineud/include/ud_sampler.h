@@ -0,0 +1,183 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::Sampler class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_SAMPLER_H
+#define UD_SAMPLER_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that decides which updates to a very frequently updated key are recorded.
+     *
+     * With a sampling rate of N, each update is recorded with probability 1/N and recorded updates are weighted by N
+     * so totals remain unbiased.  Weighting at the time of the update keeps totals unbiased when the rate changes.
+     * Decisions use a per-thread xorshift generator so unrecorded updates touch no shared memory.
+     *
+     * The rate can be fixed or can adapt to the observed update rate.  In adaptive mode the rate is recalculated after
+     * every \ref Sampler::adaptationSamples recorded updates so that roughly a target number of updates are recorded
+     * per second.
+     */
+    class UD_PUBLIC_API Sampler {
+        public:
+            /**
+             * The number of recorded updates between adaptive rate calculations.
+             */
+            static const unsigned adaptationSamples = 256;
+
+            /**
+             * The default upper limit on adaptive sampling rates.
+             */
+            static const std::uint32_t defaultMaximumRate = 1U << 16;
+
+            Sampler();
+
+            ~Sampler();
+
+            /**
+             * Determines the current sampling rate.  This method is thread-safe.
+             *
+             * \return Returns the current sampling rate.  A value of 1 indicates every update is recorded.
+             */
+            std::uint32_t rate() const;
+
+            /**
+             * Sets a fixed sampling rate, disabling adaptive sampling.  This method is thread-safe.
+             *
+             * \param[in] newRate The new sampling rate.  One update in newRate is recorded.  Values below 1 are
+             *                    treated as 1.
+             */
+            void setRate(std::uint32_t newRate);
+
+            /**
+             * Enables adaptive sampling.  This method is thread-safe.
+             *
+             * \param[in] targetPerSecond The target number of recorded updates per second.  A value of zero disables
+             *                            adaptive sampling, leaving the current rate in place.
+             *
+             * \param[in] maximumRate     The largest sampling rate that may be selected.
+             */
+            void setAdaptive(std::uint32_t targetPerSecond, std::uint32_t maximumRate = defaultMaximumRate);
+
+            /**
+             * Determines if adaptive sampling is enabled.  This method is thread-safe.
+             *
+             * \return Returns true if the rate adapts to the observed update rate.
+             */
+            bool isAdaptive() const;
+
+            /**
+             * Decides if an update should be recorded.  This method is thread-safe and lock-free.
+             *
+             * \return Returns the weight to apply to the update.  A value of zero indicates the update should be
+             *         discarded.
+             */
+            inline std::uint32_t sample() {
+                std::uint32_t currentRate = rate();
+                bool          recorded    = (
+                       currentRate <= 1
+                    || nextRandom() < currentThreshold.load(std::memory_order_relaxed)
+                );
+
+                if (recorded && currentTarget.load(std::memory_order_relaxed) != 0) {
+                    adapt(currentRate);
+                }
+
+                return recorded ? currentRate : 0;
+            }
+
+        private:
+            Q_DISABLE_COPY(Sampler)
+
+            /**
+             * Obtains the next value from the calling thread's random number generator.
+             *
+             * \return Returns a uniformly distributed 64-bit value.
+             */
+            static std::uint64_t nextRandom();
+
+            /**
+             * Obtains a monotonic time stamp.
+             *
+             * \return Returns the time in nanoseconds from an arbitrary origin.
+             */
+            static std::int64_t now();
+
+            /**
+             * Stores a new rate and the matching threshold.
+             *
+             * \param[in] newRate The new sampling rate.
+             */
+            void storeRate(std::uint32_t newRate);
+
+            /**
+             * Counts a recorded update and recalculates the rate at the end of each adaptation window.
+             *
+             * \param[in] sampledRate The rate the update was recorded at.
+             */
+            void adapt(std::uint32_t sampledRate);
+
+            /**
+             * The sampling rate.
+             */
+            std::atomic<std::uint32_t> currentRate;
+
+            /**
+             * Random values below this threshold are recorded.
+             */
+            std::atomic<std::uint64_t> currentThreshold;
+
+            /**
+             * The target number of recorded updates per second.  A value of zero indicates a fixed rate.
+             */
+            std::atomic<std::uint32_t> currentTarget;
+
+            /**
+             * The largest rate the adaptive mode may select.
+             */
+            std::atomic<std::uint32_t> currentMaximumRate;
+
+            /**
+             * The number of updates recorded in adaptive mode.
+             */
+            std::atomic<std::uint64_t> recordedSamples;
+
+            /**
+             * The time the current adaptation window started.
+             */
+            std::atomic<std::int64_t> windowStartTime;
+    };
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::ScopedActivity class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_SCOPED_ACTIVITY_H
+#define UD_SCOPED_ACTIVITY_H
+
+#include <QString>
+#include <QtGlobal>
+#include <QElapsedTimer>
+
+#include <cstdint>
+
+#include "ud_common.h"
+#include "ud_usage_data.h"
+
+namespace Ud {
+    /**
+     * Class that times an activity for the lifetime of the object.  The start time is held by the object itself so
+     * no shared timer state is touched.  On destruction the elapsed time is added directly to the activity.
+     *
+     * Instances can be freely nested, including nested or recursive instances timing the same activity.  Each
+     * instance contributes its own elapsed time so the time spent in a recursive call is counted once per level.
+     *
+     *     void Document::render() {
+     *         Ud::ScopedActivity activity(usageData, UD_ACTIVITY("render"));
+     *         ...
+     *     }
+     */
+    class ScopedActivity {
+        public:
+            /**
+             * Constructor
+             *
+             * \param[in] usageData  The usage data instance to report to.  A null pointer disables timing.
+             *
+             * \param[in] activityId The handle of the activity to be timed.
+             */
+            inline ScopedActivity(UsageData* usageData, UsageData::ActivityId activityId):
+                currentUsageData(usageData),
+                currentActivityId(activityId) {
+                clock.start();
+            }
+
+            /**
+             * Constructor
+             *
+             * \param[in] usageData    The usage data instance to report to.  A null pointer disables timing.
+             *
+             * \param[in] activityName The name of the activity to be timed.  The name is only registered once the
+             *                         activity is admitted under the activity key limit.
+             */
+            inline ScopedActivity(UsageData* usageData, const QString& activityName):
+                currentUsageData(usageData),
+                currentActivityId(UsageData::invalidId),
+                currentActivityName(activityName) {
+                clock.start();
+            }
+
+            inline ~ScopedActivity() {
+                if (currentUsageData != Q_NULLPTR) {
+                    if (currentActivityName.isEmpty()) {
+                        currentUsageData->addActivityTime(currentActivityId, elapsed());
+                    } else {
+                        currentUsageData->addActivityTime(currentActivityName, elapsed());
+                    }
+                }
+            }
+
+            /**
+             * Determines the time elapsed since this object was created.
+             *
+             * \return Returns the elapsed time, in nanoseconds.
+             */
+            inline std::uint64_t elapsed() const {
+                return static_cast<std::uint64_t>(clock.nsecsElapsed());
+            }
+
+        private:
+            Q_DISABLE_COPY(ScopedActivity)
+
+            /**
+             * The usage data instance to report to.
+             */
+            UsageData* currentUsageData;
+
+            /**
+             * The activity being timed.
+             */
+            UsageData::ActivityId currentActivityId;
+
+            /**
+             * The name of the activity being timed.  Only used if the activity was given by name.
+             */
+            QString currentActivityName;
+
+            /**
+             * Clock holding the start time.
+             */
+            QElapsedTimer clock;
+    };
+}
+
+#endif
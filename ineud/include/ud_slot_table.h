@@ -0,0 +1,190 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::SlotTable template class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_SLOT_TABLE_H
+#define UD_SLOT_TABLE_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+#include "ud_key_registry.h"
+
+namespace Ud {
+    /**
+     * Template class that associates an optional, heap allocated object with each \ref Ud::KeyRegistry slot.
+     * Lookups are lock-free and cost two atomic loads.  Entries can be added concurrently with lookups but are never
+     * removed until the table is destroyed, at which point all entries are deleted.
+     *
+     * \param T The type of object held by the table.
+     */
+    template<typename T> class SlotTable {
+        public:
+            /**
+             * Type used to represent a slot.
+             */
+            typedef KeyRegistry::Slot Slot;
+
+            /**
+             * The number of entries held in each chunk.
+             */
+            static const unsigned slotsPerChunk = 512;
+
+            /**
+             * The maximum number of chunks.
+             */
+            static const unsigned maximumChunks = (KeyRegistry::maximumSlots + slotsPerChunk - 1) / slotsPerChunk;
+
+            SlotTable() {
+                for (unsigned i=0 ; i<maximumChunks ; ++i) {
+                    chunks[i].store(Q_NULLPTR, std::memory_order_relaxed);
+                }
+            }
+
+            ~SlotTable() {
+                for (unsigned chunkIndex=0 ; chunkIndex<maximumChunks ; ++chunkIndex) {
+                    Chunk* chunk = chunks[chunkIndex].load(std::memory_order_relaxed);
+                    if (chunk != Q_NULLPTR) {
+                        for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+                            delete chunk->entries[i].load(std::memory_order_relaxed);
+                        }
+
+                        delete chunk;
+                    }
+                }
+            }
+
+            /**
+             * Obtains the entry associated with a slot.  This method is thread-safe and lock-free.
+             *
+             * \param[in] slot The slot of interest.
+             *
+             * \return Returns the entry.  A null pointer is returned if the slot has no entry.
+             */
+            inline T* at(Slot slot) const {
+                T* result = Q_NULLPTR;
+
+                if (slot < KeyRegistry::maximumSlots) {
+                    const Chunk* chunk = chunks[slot / slotsPerChunk].load(std::memory_order_acquire);
+                    if (chunk != Q_NULLPTR) {
+                        result = chunk->entries[slot % slotsPerChunk].load(std::memory_order_acquire);
+                    }
+                }
+
+                return result;
+            }
+
+            /**
+             * Adds an entry for a slot.  If the slot already has an entry, the supplied entry is deleted.  This method
+             * is thread-safe.
+             *
+             * \param[in] slot  The slot of interest.
+             *
+             * \param[in] entry The entry to add.  The table takes ownership of the entry.
+             *
+             * \return Returns the entry now associated with the slot.
+             */
+            T* insert(Slot slot, T* entry) {
+                T* result = Q_NULLPTR;
+
+                if (slot < KeyRegistry::maximumSlots) {
+                    std::atomic<Chunk*>& chunkPointer = chunks[slot / slotsPerChunk];
+                    Chunk*               chunk        = chunkPointer.load(std::memory_order_acquire);
+
+                    if (chunk == Q_NULLPTR) {
+                        Chunk* newChunk = new Chunk;
+                        if (chunkPointer.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel)) {
+                            chunk = newChunk;
+                        } else {
+                            delete newChunk;
+                        }
+                    }
+
+                    result = Q_NULLPTR;
+                    if (chunk->entries[slot % slotsPerChunk].compare_exchange_strong(
+                            result,
+                            entry,
+                            std::memory_order_acq_rel
+                        )) {
+                        result = entry;
+                    } else {
+                        delete entry;
+                    }
+                } else {
+                    delete entry;
+                }
+
+                return result;
+            }
+
+            /**
+             * Calls a function for every slot that holds an entry.  This method is thread-safe.
+             *
+             * \param[in] function A function or functor accepting a slot and a pointer to the entry.
+             */
+            template<typename F> void forEach(F function) const {
+                for (unsigned chunkIndex=0 ; chunkIndex<maximumChunks ; ++chunkIndex) {
+                    const Chunk* chunk = chunks[chunkIndex].load(std::memory_order_acquire);
+                    if (chunk != Q_NULLPTR) {
+                        for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+                            T* entry = chunk->entries[i].load(std::memory_order_acquire);
+                            if (entry != Q_NULLPTR) {
+                                function(static_cast<Slot>(chunkIndex * slotsPerChunk + i), entry);
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            Q_DISABLE_COPY(SlotTable)
+
+            /**
+             * Structure holding a contiguous block of entries.
+             */
+            struct Chunk {
+                Chunk() {
+                    for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+                        entries[i].store(Q_NULLPTR, std::memory_order_relaxed);
+                    }
+                }
+
+                std::atomic<T*> entries[slotsPerChunk];
+            };
+
+            /**
+             * The chunks, allocated on first use.
+             */
+            std::atomic<Chunk*> chunks[maximumChunks];
+    };
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::SpaceSaving class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_SPACE_SAVING_H
+#define UD_SPACE_SAVING_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QList>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that tracks the most frequent keys in a stream using the Space-Saving algorithm of Metwally, Agrawal and
+     * El Abbadi.
+     *
+     * At most \ref SpaceSaving::capacity keys are monitored.  When a key that is not monitored arrives and the summary
+     * is full, the monitored key with the smallest count is replaced.  The new key inherits that count as its error.
+     * The count of every monitored key is therefore an upper bound on its true count, overestimated by at most its
+     * error, and no key that is not monitored can have a true count above \ref SpaceSaving::minimumCount.
+     *
+     * Monitored keys are kept in a min-heap so each update costs O(log capacity).
+     *
+     * This class is not thread-safe.
+     */
+    class UD_PUBLIC_API SpaceSaving {
+        public:
+            /**
+             * Structure holding one monitored key.
+             */
+            struct Entry {
+                /**
+                 * The key.
+                 */
+                QString key;
+
+                /**
+                 * The estimated count.  The true count lies between count - error and count.
+                 */
+                std::uint64_t count;
+
+                /**
+                 * The maximum overestimate of the count.
+                 */
+                std::uint64_t error;
+            };
+
+            /**
+             * The default number of monitored keys.
+             */
+            static const unsigned defaultCapacity = 1024;
+
+            /**
+             * Constructor
+             *
+             * \param[in] capacity The maximum number of monitored keys.
+             */
+            SpaceSaving(unsigned capacity = defaultCapacity);
+
+            ~SpaceSaving();
+
+            /**
+             * Determines the maximum number of monitored keys.
+             *
+             * \return Returns the capacity.
+             */
+            unsigned capacity() const;
+
+            /**
+             * Sets the maximum number of monitored keys.  Changing the capacity clears the summary.
+             *
+             * \param[in] newCapacity The new capacity.
+             */
+            void setCapacity(unsigned newCapacity);
+
+            /**
+             * Adds to the count of a key.
+             *
+             * \param[in] key   The key to be counted.
+             *
+             * \param[in] value The value to add to the count.
+             */
+            void add(const QString& key, std::uint64_t value = 1);
+
+            /**
+             * Obtains the monitored keys.
+             *
+             * \return Returns the monitored keys, largest count first.
+             */
+            QList<Entry> entries() const;
+
+            /**
+             * Determines the number of monitored keys.
+             *
+             * \return Returns the number of monitored keys.
+             */
+            unsigned size() const;
+
+            /**
+             * Determines if no keys are monitored.
+             *
+             * \return Returns true if the summary is empty.
+             */
+            bool isEmpty() const;
+
+            /**
+             * Determines the smallest monitored count.  Keys that are not monitored have a true count no larger than
+             * this value.
+             *
+             * \return Returns the smallest count.  Zero is returned if the summary is not full, since every key seen
+             *         is then monitored exactly.
+             */
+            std::uint64_t minimumCount() const;
+
+            /**
+             * Determines the largest monitored count.  No key, monitored or not, has a true count above this value.
+             *
+             * \return Returns the largest count.
+             */
+            std::uint64_t maximumCount() const;
+
+            /**
+             * Determines the total of every value added.
+             *
+             * \return Returns the total.
+             */
+            std::uint64_t total() const;
+
+            /**
+             * Removes every key.
+             */
+            void clear();
+
+        private:
+            /**
+             * Moves a heap entry toward the root until the heap is ordered.
+             *
+             * \param[in] index The index of the entry to be moved.
+             */
+            void siftUp(unsigned index);
+
+            /**
+             * Moves a heap entry away from the root until the heap is ordered.
+             *
+             * \param[in] index The index of the entry to be moved.
+             */
+            void siftDown(unsigned index);
+
+            /**
+             * Exchanges two heap entries.
+             *
+             * \param[in] first  The index of the first entry.
+             *
+             * \param[in] second The index of the second entry.
+             */
+            void swapEntries(unsigned first, unsigned second);
+
+            /**
+             * The maximum number of monitored keys.
+             */
+            unsigned currentCapacity;
+
+            /**
+             * The monitored keys, as a min-heap ordered by count.
+             */
+            QVector<Entry> heap;
+
+            /**
+             * Hash mapping keys to their index in the heap.
+             */
+            QHash<QString, unsigned> indexes;
+
+            /**
+             * The total of every value added.
+             */
+            std::uint64_t currentTotal;
+    };
+}
+
+#endif
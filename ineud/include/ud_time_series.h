@@ -0,0 +1,223 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::TimeSeries class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_TIME_SERIES_H
+#define UD_TIME_SERIES_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+#include "ud_key_registry.h"
+
+namespace Ud {
+    /**
+     * Class that keeps a rolling window of per-bucket totals for every \ref Ud::KeyRegistry slot, such as the last
+     * 168 hourly totals.
+     *
+     * Buckets are aligned to multiples of the bucket length since the Unix epoch so series from different
+     * installations line up.  Each key holds a fixed ring of buckets.  Keys are grouped into chunks stored as a
+     * struct of arrays: each bucket of a chunk is one contiguous array holding that bucket for every key in the
+     * chunk.  Updates made during the same bucket therefore land next to each other and recycling a bucket clears
+     * one contiguous array per chunk.
+     *
+     * Buckets are rotated lazily by the first update that falls in a new bucket, so no timer is needed.  Updates
+     * within the current bucket are lock-free; the update that rotates to a new bucket briefly holds a mutex while
+     * the recycled buckets are cleared.  Chunks are allocated on first use.
+     */
+    class UD_PUBLIC_API TimeSeries {
+        public:
+            /**
+             * Type used to represent a slot.
+             */
+            typedef KeyRegistry::Slot Slot;
+
+            /**
+             * The number of keys held in each chunk.
+             */
+            static const unsigned slotsPerChunk = 512;
+
+            /**
+             * The maximum number of chunks.
+             */
+            static const unsigned maximumChunks = (KeyRegistry::maximumSlots + slotsPerChunk - 1) / slotsPerChunk;
+
+            /**
+             * The default bucket length, in seconds.
+             */
+            static const unsigned defaultBucketSeconds = 60 * 60;
+
+            /**
+             * The default number of buckets, one week of hourly buckets.
+             */
+            static const unsigned defaultNumberBuckets = 7 * 24;
+
+            /**
+             * Constructor
+             *
+             * \param[in] bucketSeconds The length of each bucket, in seconds.
+             *
+             * \param[in] numberBuckets The number of buckets kept for each key.
+             */
+            TimeSeries(unsigned bucketSeconds = defaultBucketSeconds, unsigned numberBuckets = defaultNumberBuckets);
+
+            ~TimeSeries();
+
+            /**
+             * Determines the length of each bucket.
+             *
+             * \return Returns the bucket length, in seconds.
+             */
+            unsigned bucketSeconds() const;
+
+            /**
+             * Determines the number of buckets kept for each key.
+             *
+             * \return Returns the number of buckets.
+             */
+            unsigned numberBuckets() const;
+
+            /**
+             * Adds a value to the current bucket of a key.  The current time is read from the coarse system clock.
+             * This method is thread-safe.
+             *
+             * \param[in] slot  The slot of the key.  Invalid slots are ignored.
+             *
+             * \param[in] value The value to add.
+             */
+            void add(Slot slot, std::uint64_t value);
+
+            /**
+             * Adds a value to the bucket holding a given time.  Times older than the window are ignored.  This method
+             * is thread-safe.
+             *
+             * \param[in] slot  The slot of the key.  Invalid slots are ignored.
+             *
+             * \param[in] value The value to add.
+             *
+             * \param[in] time  The time of the update, in seconds since the Unix epoch.
+             */
+            void add(Slot slot, std::uint64_t value, std::int64_t time);
+
+            /**
+             * Obtains the window ending with the bucket holding a given time.  This method is thread-safe.
+             *
+             * \param[in]  time            The time of interest, in seconds since the Unix epoch.
+             *
+             * \param[out] firstBucketTime Optional pointer to a value set to the start of the oldest bucket, in
+             *                             seconds since the Unix epoch.
+             *
+             * \return Returns the buckets, oldest first, for each key holding a non-zero bucket.
+             */
+            QHash<Slot, QVector<std::uint64_t>> snapshot(std::int64_t time, std::int64_t* firstBucketTime = Q_NULLPTR);
+
+            /**
+             * Estimates the memory held by the series.  This method is thread-safe.
+             *
+             * \return Returns the approximate memory use, in bytes.
+             */
+            std::uint64_t memoryUsage() const;
+
+            /**
+             * Obtains the current time as used by \ref TimeSeries::add.
+             *
+             * \return Returns the current time, in seconds since the Unix epoch.
+             */
+            static std::int64_t currentTime();
+
+        private:
+            Q_DISABLE_COPY(TimeSeries)
+
+            /**
+             * Structure holding the buckets for a contiguous block of keys.  Buckets are stored bucket-major.
+             */
+            struct Chunk {
+                /**
+                 * Constructor
+                 *
+                 * \param[in] numberBuckets The number of buckets held for each key.
+                 */
+                Chunk(unsigned numberBuckets);
+
+                ~Chunk();
+
+                std::atomic<std::uint64_t>* values;
+            };
+
+            /**
+             * Advances the window so it ends with a given bucket, clearing the buckets being recycled.
+             *
+             * \param[in] bucket The index of the new current bucket, counted from the Unix epoch.
+             */
+            void rotate(std::int64_t bucket);
+
+            /**
+             * Determines the ring position of a bucket.
+             *
+             * \param[in] bucket The index of the bucket, counted from the Unix epoch.
+             *
+             * \return Returns the position of the bucket within each chunk.
+             */
+            inline unsigned position(std::int64_t bucket) const {
+                return static_cast<unsigned>(static_cast<std::uint64_t>(bucket) % currentNumberBuckets);
+            }
+
+            /**
+             * The length of each bucket, in seconds.
+             */
+            unsigned currentBucketSeconds;
+
+            /**
+             * The number of buckets kept for each key.
+             */
+            unsigned currentNumberBuckets;
+
+            /**
+             * The index of the newest bucket in the window, counted from the Unix epoch.
+             */
+            std::atomic<std::int64_t> currentBucket;
+
+            /**
+             * Mutex serializing bucket rotation.
+             */
+            QMutex rotationMutex;
+
+            /**
+             * The chunks, allocated on first use.
+             */
+            std::atomic<Chunk*> chunks[maximumChunks];
+    };
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::TimerTable class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_TIMER_TABLE_H
+#define UD_TIMER_TABLE_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QElapsedTimer>
+
+#include <cstdint>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that tracks named timers per thread.
+     *
+     * Each thread keeps its timers in its own table, found through thread local storage, so starting and lapping a
+     * timer on the thread that started it takes no lock.  Each timer carries an atomic state that lets other threads
+     * briefly claim it.  A mutex is only taken when a thread first uses the table, when a timer is stopped, and when
+     * every thread's timers are visited at report time.  A stopped timer is erased from its table, so dynamically
+     * named timers do not grow the tables without bound.  Timers stopped by another thread are erased by the owning
+     * thread once its table has doubled in size.
+     *
+     * Tables of threads that have exited are kept so their running timers are still reported and are reused by new
+     * threads once no timer in them is running.  Times are measured in nanoseconds on a monotonic clock owned by the
+     * table.
+     */
+    class UD_PUBLIC_API TimerTable {
+        public:
+            /**
+             * Type used to report elapsed times, in nanoseconds, by timer name.
+             */
+            typedef QList<QPair<QString, std::uint64_t>> ElapsedTimes;
+
+            TimerTable();
+
+            ~TimerTable();
+
+            /**
+             * Starts a timer on the calling thread.  The function will assert if the timer is already running on the
+             * calling thread.
+             *
+             * \param[in] timerName The name of the timer.
+             */
+            void start(const QString& timerName);
+
+            /**
+             * Stops or laps a timer.  The timer started by the calling thread is used.  If the calling thread has no
+             * such timer, a timer with the same name started by another thread is used.
+             *
+             * \param[in]  timerName   The name of the timer.
+             *
+             * \param[in]  doStop      If true, the timer is stopped.  If false, the timer keeps running from now.
+             *
+             * \param[out] elapsedTime The time since the timer was started or last lapped, in nanoseconds.
+             *
+             * \return Returns true if a running timer was found.  Returns false if no such timer is running.
+             */
+            bool stop(const QString& timerName, bool doStop, std::uint64_t& elapsedTime);
+
+            /**
+             * Determines if a timer is running on the calling thread.
+             *
+             * \param[in] timerName The name of the timer.
+             *
+             * \return Returns true if the timer is running on the calling thread.
+             */
+            bool isActive(const QString& timerName) const;
+
+            /**
+             * Laps every running timer on every thread.  The timers keep running from now.
+             *
+             * \return Returns the time accumulated by each running timer.
+             */
+            ElapsedTimes lapAll();
+
+            /**
+             * Stops every running timer on every thread.
+             *
+             * \return Returns the time accumulated by each running timer.
+             */
+            ElapsedTimes stopAll();
+
+            /**
+             * Determines the approximate memory held by the table.
+             *
+             * \return Returns the memory held, in bytes.
+             */
+            std::uint64_t memoryUsage() const;
+
+        private:
+            Q_DISABLE_COPY(TimerTable)
+
+            struct Timer;
+            struct ThreadTimers;
+            class ThreadHandle;
+
+            /**
+             * Obtains the timers of the calling thread, assigning a table to the thread if needed.
+             *
+             * \return Returns the calling thread's timers.
+             */
+            ThreadTimers* threadTimers();
+
+            /**
+             * Finishes a timer claimed by the caller.
+             *
+             * \param[in] timer  The claimed timer.
+             *
+             * \param[in] doStop If true, the timer is stopped.  If false, the timer keeps running from now.
+             *
+             * \return Returns the time since the timer was started or last lapped, in nanoseconds.
+             */
+            std::uint64_t finish(Timer* timer, bool doStop);
+
+            /**
+             * Finishes every running timer on every thread.
+             *
+             * \param[in] doStop If true, the timers are stopped.  If false, the timers keep running from now.
+             *
+             * \return Returns the time accumulated by each running timer.
+             */
+            ElapsedTimes finishAll(bool doStop);
+
+            /**
+             * Mutex protecting the list of thread tables.
+             */
+            mutable QMutex tablesMutex;
+
+            /**
+             * The first thread table.  Tables are never removed before this object is destroyed.
+             */
+            ThreadTimers* firstTable;
+
+            /**
+             * Per-thread handle referencing the calling thread's table.
+             */
+            QThreadStorage<ThreadHandle*> handles;
+
+            /**
+             * The monotonic clock used to time activities.
+             */
+            QElapsedTimer clock;
+    };
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref Ud::UpdateCounter class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineud */
+
+#ifndef UD_UPDATE_COUNTER_H
+#define UD_UPDATE_COUNTER_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_common.h"
+
+namespace Ud {
+    /**
+     * Class that counts calls made from any number of threads without an atomic read-modify-write.
+     *
+     * Each thread owns a block of counts, one per counter, found through thread local storage.  Only the owning
+     * thread writes its block, so an increment is a relaxed load and store to memory no other thread writes.  The
+     * counter's value is summed across every thread's block when it is read.  Blocks of threads that have exited keep
+     * their counts and are reused by new threads.
+     *
+     * At most \ref UpdateCounter::maximumCounters counters can use per-thread blocks at once.  Counters created beyond
+     * that limit fall back to a shared atomic count, which stays exact but costs an atomic read-modify-write per
+     * increment.
+     */
+    class UD_PUBLIC_API UpdateCounter {
+        public:
+            /**
+             * The maximum number of counters that can use per-thread blocks at once.
+             */
+            static const unsigned maximumCounters = 128;
+
+            UpdateCounter();
+
+            ~UpdateCounter();
+
+            /**
+             * Adds one to the counter.  This method is thread-safe.
+             */
+            void increment();
+
+            /**
+             * Determines the value of the counter.  This method is thread-safe but takes a mutex, so it should only
+             * be used to report statistics.
+             *
+             * \return Returns the number of calls to \ref UpdateCounter::increment since the counter was created.
+             */
+            std::uint64_t value() const;
+
+        private:
+            Q_DISABLE_COPY(UpdateCounter)
+
+            /**
+             * Sums the counts held by every thread for this counter.  The counts mutex must be held.
+             *
+             * \return Returns the sum of the counts.
+             */
+            std::uint64_t sum() const;
+
+            /**
+             * The index of this counter's count within each thread's block.  Equal to \ref maximumCounters if no
+             * index was available.
+             */
+            unsigned index;
+
+            /**
+             * The sum of the counts at the index when the counter was created, left by an earlier counter.
+             */
+            std::uint64_t baseline;
+
+            /**
+             * The count used once every index is taken.
+             */
+            std::atomic<std::uint64_t> overflowCount;
+    };
+}
+
+#endif
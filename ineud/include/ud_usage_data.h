@@ -36,14 +36,37 @@
 #include <QDateTime>
 #include <QMutex>
 #include <QHash>
+#include <QVector>
+#include <QPair>
+#include <QByteArray>
+#include <QStringList>
+#include <QVariant>
 #include <QJsonObject>
 #include <QUrl>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QMetaType>
 
 #include <cstdint>
+#include <atomic>
 
 #include <wh_web_hook.h>
 
 #include "ud_common.h"
+#include "ud_key_registry.h"
+#include "ud_counter_store.h"
+#include "ud_payload_transport.h"
+#include "ud_payload_writer.h"
+#include "ud_report_spool.h"
+#include "ud_retry_policy.h"
+#include "ud_slot_table.h"
+#include "ud_histogram.h"
+#include "ud_quantile_sketch.h"
+#include "ud_hyper_log_log.h"
+#include "ud_sampler.h"
+#include "ud_time_series.h"
+#include "ud_timer_table.h"
+#include "ud_counter_journal.h"
 
 class QTimer;
 class QDate;
@@ -68,7 +91,26 @@ namespace Ud {
      *
      * To assist in tracking time spent on certain activities, the class provides methods to automatically start and
      * stop timers.  Stopping a timer automatically calculates the time spent and adds the value to an activity tracker
-     * with the same name.
+     * with the same name.  Timers use a monotonic clock and activities are accumulated internally in nanoseconds.
+     * Activities are reported in units of the activity resolution, one second by default.  Any time below the
+     * resolution is carried forward to the next report.  For timing within a single scope, \ref Ud::ScopedActivity
+     * avoids the timer table entirely.
+     *
+     * Activities can optionally track a latency histogram (see \ref enableHistogram) so that percentiles, and not
+     * just a mean, can be derived from reports.
+     *
+     * The number of distinct values, such as distinct documents or feature combinations, can be tracked per report
+     * interval using \ref observeDistinct.  Distinct counts are estimated using a fixed size \ref Ud::HyperLogLog
+     * sketch per name.
+     *
+     * Reports can optionally carry a rolling window of per-bucket totals for every event and activity, such as the
+     * last week of hourly totals (see \ref enableTimeSeries).
+     *
+     * Events and activities are saved with the other settings by default.  Applications with many counters should
+     * set a journal file (see \ref setJournalFilename) so that saves append only the counters that changed to a
+     * compact binary journal.  With a journal, \ref checkpoint can be called every few seconds.  Alternatively,
+     * events and activities can be held in memory-mapped files (see \ref setCounterDirectory) so that they survive an
+     * application crash with no explicit save.
      *
      * The class provides a mechanism to enable or disable reporting.  Reporting status is maintained persistently.
      *
@@ -84,6 +126,103 @@ namespace Ud {
         Q_OBJECT
 
         public:
+            /**
+             * Type used to represent a pre-registered event.  Handles are obtained through \ref registerEvent or the
+             * \ref UD_EVENT macro and are valid for every instance of this class.
+             */
+            typedef KeyRegistry::Slot EventId;
+
+            /**
+             * Type used to represent a pre-registered activity.  Handles are obtained through
+             * \ref registerActivity or the \ref UD_ACTIVITY macro and are valid for every instance of this class.
+             */
+            typedef KeyRegistry::Slot ActivityId;
+
+            /**
+             * Type used to select the report serialization format.  JSON is the default.  CBOR reports carry counters
+             * as native 64-bit integers and distinct count registers as byte strings.
+             */
+            typedef PayloadWriter::Format PayloadFormat;
+
+            /**
+             * Type used to report the state of the reporting circuit breaker.  See \ref Ud::RetryPolicy.
+             */
+            typedef RetryPolicy::CircuitState CircuitState;
+
+            /**
+             * Structure holding measurements of the cost of usage tracking itself.  The measurements are cheap enough
+             * to be collected at all times.  Times are in nanoseconds.
+             */
+            struct Statistics {
+                /**
+                 * The number of event and activity adjustments, including stopped timers, since this object was
+                 * created.  Counters restored after a failed report are included.
+                 */
+                std::uint64_t adjustCalls;
+
+                /**
+                 * The average number of adjustments per second since the last report completed, or since this object
+                 * was created if no report has completed.
+                 */
+                double adjustCallsPerSecond;
+
+                /**
+                 * The total time threads spent waiting for the internal journal mutex.  Waits on other internal
+                 * mutexes, such as the key registry and counter store locks, are not included.
+                 */
+                std::uint64_t mutexWaitTime;
+
+                /**
+                 * The number of times a thread had to wait for the internal journal mutex.  Waits on other internal
+                 * mutexes are not included.
+                 */
+                std::uint64_t contendedLocks;
+
+                /**
+                 * The time spent snapshotting counters and serializing the last report.
+                 */
+                std::uint64_t snapshotTime;
+
+                /**
+                 * The size of the last report body, in bytes, before compression and batching.  Zero if the last
+                 * report was sent through the web hook, which serializes the report itself.
+                 */
+                std::uint64_t payloadBytes;
+
+                /**
+                 * The size of the last request body as sent, in bytes, after compression and batching.  Zero if the
+                 * last report was sent through the web hook.
+                 */
+                std::uint64_t encodedBytes;
+
+                /**
+                 * The time spent in the last call to \ref loadSettings.
+                 */
+                std::uint64_t loadTime;
+
+                /**
+                 * The time spent in the last call to \ref saveSettings.
+                 */
+                std::uint64_t saveTime;
+
+                /**
+                 * The approximate memory held by counters, timers, histograms, sketches and distinct counts, in
+                 * bytes.
+                 */
+                std::uint64_t memoryBytes;
+
+                /**
+                 * The number of event and activity counters held in memory only while a counter directory is set.
+                 * These counters do not fit in the memory-mapped files and are not crash-safe.
+                 */
+                unsigned unmappedKeys;
+            };
+
+            /**
+             * Value used to indicate an invalid event or activity handle.
+             */
+            static const EventId invalidId;
+
             /**
              * The default usage statistics reporting interval, in seconds.
              */
@@ -96,7 +235,8 @@ namespace Ud {
             static const unsigned enableReportDelay;
 
             /**
-             * Delay between reporting retry attempts.  Value is in seconds.
+             * The default maximum delay between reporting retry attempts.  Retries back off exponentially, with
+             * jitter, up to this delay.  Value is in seconds.
              */
             static const unsigned reportRetrialPeriod;
 
@@ -105,6 +245,18 @@ namespace Ud {
              */
             static const QString defaultSettingsGroup;
 
+            /**
+             * The default activity resolution, in nanoseconds per reported unit.  Activities are reported in seconds
+             * by default.
+             */
+            static const std::uint64_t defaultActivityResolution;
+
+            /**
+             * The maximum number of spooled reports uploaded with a single request.  Each request carries reports of
+             * a single format.
+             */
+            static const unsigned maximumSpooledReportsPerUpload;
+
             /**
              * Constructor
              *
@@ -188,6 +340,16 @@ namespace Ud {
              */
             bool isNotReporting() const;
 
+            /**
+             * Builds the report that would be sent next without sending it.  The counters are left unchanged.  This
+             * method lets applications show users exactly what will be reported and is also used to benchmark report
+             * generation.  This method must be called from the thread owning this object.
+             *
+             * \return Returns the report body in the current report format.  An empty array is returned if a report
+             *         is in progress.
+             */
+            QByteArray previewReport();
+
             /**
              * Reports the secret value used to report information about this user's statistics.
              *
@@ -209,6 +371,56 @@ namespace Ud {
              */
             void setUrl(const QUrl& newUrl);
 
+            /**
+             * Determines the compression applied to reports.
+             *
+             * \return Returns the report compression scheme.
+             */
+            PayloadTransport::Compression payloadCompression() const;
+
+            /**
+             * Sets the compression applied to reports.  Compressed reports are signed after compression and sent
+             * through a \ref Ud::PayloadTransport rather than the web hook, so the receiving server must verify the
+             * signature headers described there.  Reports are not compressed by default.
+             *
+             * \param[in] newCompression The new report compression scheme.
+             */
+            void setPayloadCompression(PayloadTransport::Compression newCompression);
+
+            /**
+             * Determines the format used to serialize reports.
+             *
+             * \return Returns the report format.
+             */
+            PayloadFormat payloadFormat() const;
+
+            /**
+             * Sets the format used to serialize reports.  CBOR reports are sent through a \ref Ud::PayloadTransport
+             * with a content type of application/cbor.  Reports are serialized as JSON by default.
+             *
+             * \param[in] newPayloadFormat The new report format.
+             */
+            void setPayloadFormat(PayloadFormat newPayloadFormat);
+
+            /**
+             * Determines if reports are built on a worker thread.
+             *
+             * \return Returns true if reports are built on a worker thread.  Returns false if reports are built on
+             *         the thread owning this object.
+             */
+            bool backgroundReporting() const;
+
+            /**
+             * Sets whether reports are built on a worker thread.  When enabled, serialization, compression and
+             * signing run on the global thread pool.  Counters are still snapshotted and retired, and the finished
+             * request posted, on the thread owning this object and the network access manager, so no other method
+             * races the worker.  Reports built in the background are always sent through a \ref Ud::PayloadTransport.
+             * Reports are built on the owning thread by default.
+             *
+             * \param[in] nowEnabled If true, reports are built on a worker thread.
+             */
+            void setBackgroundReporting(bool nowEnabled = true);
+
             /**
              * Determines the settings group that will be used to load and save settings.
              *
@@ -223,6 +435,78 @@ namespace Ud {
              */
             void setSettingsGroup(const QString& newSettingsGroup);
 
+            /**
+             * Determines the file used to journal events and activities.
+             *
+             * \return Returns the journal filename.  An empty string is returned if events and activities are saved
+             *         with the other settings.
+             */
+            QString journalFilename() const;
+
+            /**
+             * Sets the file used to journal events and activities.  You should set the journal file before calling
+             * \ref loadSettings.  If settings have already been loaded, the counters held by the journal are added to
+             * the current counters immediately.  Events and activities previously saved with the other settings are
+             * moved to the journal on the next save.
+             *
+             * \param[in] newJournalFilename The new journal filename.  An empty filename causes events and activities
+             *                               to be saved with the other settings.
+             */
+            void setJournalFilename(const QString& newJournalFilename);
+
+            /**
+             * Determines the directory holding the memory-mapped event and activity files.
+             *
+             * \return Returns the counter directory.  An empty string is returned if memory-mapped files are not used.
+             */
+            QString counterDirectory() const;
+
+            /**
+             * Sets the directory holding memory-mapped event and activity files.  When set, events and activities are
+             * updated in place in the files, survive an application crash without an explicit save, and take
+             * precedence over the journal (see \ref setJournalFilename).  The files are attached by
+             * \ref loadSettings so you should set the directory before calling \ref loadSettings.  Events and
+             * activities previously saved with the other settings or in the journal are moved into the files.
+             *
+             * \param[in] newCounterDirectory The new counter directory.  An empty string detaches any attached files.
+             */
+            void setCounterDirectory(const QString& newCounterDirectory);
+
+            /**
+             * Determines the directory holding reports that could not be sent.
+             *
+             * \return Returns the spool directory.  An empty string is returned if unsent reports are not spooled.
+             */
+            QString spoolDirectory() const;
+
+            /**
+             * Sets the directory holding reports that could not be sent.  When set, a report that fails is sealed
+             * into the directory rather than folded back into the counters, so it survives an application exit.
+             * Spooled reports in the current format are uploaded together with the next report, as a single batch
+             * request, once the collector is reachable again.  Reports left over, including any spooled in another
+             * format, follow in batches of one format each.  A spooled report is dropped once it has been part of
+             * \ref Ud::ReportSpool::defaultMaximumFailures failed uploads or of an upload the collector rejected with
+             * an HTTP 4xx status.  Enabling the spool routes reports through the \ref Ud::PayloadTransport.
+             *
+             * \param[in] newSpoolDirectory The new spool directory.  An empty string disables the spool.
+             */
+            void setSpoolDirectory(const QString& newSpoolDirectory);
+
+            /**
+             * Determines the maximum total size of the spooled reports.
+             *
+             * \return Returns the maximum size, in bytes.
+             */
+            qint64 spoolLimit() const;
+
+            /**
+             * Sets the maximum total size of the spooled reports.  The oldest reports are discarded first once the
+             * limit is reached.
+             *
+             * \param[in] newSpoolLimit The new maximum size, in bytes.
+             */
+            void setSpoolLimit(qint64 newSpoolLimit);
+
             /**
              * Determines the current reporting interval, in seconds.
              *
@@ -239,6 +523,54 @@ namespace Ud {
              */
             void setInterval(unsigned long long newInterval);
 
+            /**
+             * Determines the resolution used to report activities.
+             *
+             * \return Returns the number of nanoseconds represented by one reported activity unit.
+             */
+            std::uint64_t activityResolution() const;
+
+            /**
+             * Sets the resolution used to report activities.  Values supplied to \ref adjustActivity are also
+             * interpreted in this unit.  You should set the resolution before recording any activities.
+             *
+             * \param[in] nanosecondsPerUnit The number of nanoseconds represented by one reported activity unit.  A
+             *                               value of 1000 will cause activities to be reported in microseconds.
+             */
+            void setActivityResolution(std::uint64_t nanosecondsPerUnit);
+
+            /**
+             * Determines the maximum number of distinct events held and reported.
+             *
+             * \return Returns the maximum number of events.  A value of zero indicates no limit.
+             */
+            unsigned maximumEventKeys() const;
+
+            /**
+             * Sets the maximum number of distinct events held and reported.  Once the limit is reached, the most
+             * frequent events are kept exactly and the rest are reported together under the name "__other__".  The
+             * report's "other_bound" object holds an upper bound on the count of any single event folded into
+             * "__other__".  The number of events is not limited by default.
+             *
+             * \param[in] newMaximumKeys The new maximum number of events.  A value of zero removes the limit.
+             */
+            void setMaximumEventKeys(unsigned newMaximumKeys);
+
+            /**
+             * Determines the maximum number of distinct activities held and reported.
+             *
+             * \return Returns the maximum number of activities.  A value of zero indicates no limit.
+             */
+            unsigned maximumActivityKeys() const;
+
+            /**
+             * Sets the maximum number of distinct activities held and reported.  See
+             * \ref UsageData::setMaximumEventKeys for details.
+             *
+             * \param[in] newMaximumKeys The new maximum number of activities.  A value of zero removes the limit.
+             */
+            void setMaximumActivityKeys(unsigned newMaximumKeys);
+
             /**
              * Returns the date and time that the last report was made regarding user activity.
              *
@@ -262,232 +594,1129 @@ namespace Ud {
             bool reportingSuccessful() const;
 
             /**
-             * Determines if a specified timer is active.
+             * Determines the delay before the first retry of a failed report.
              *
-             * \param[in] timerName The name of the timer to start.
+             * \return Returns the base retry delay, in seconds.
              */
-            bool isTimerActive(const QString& timerName) const;
+            unsigned long long retryBaseDelay() const;
 
             /**
-             * Loads stateful information related to customer usage.  This method is thread-safe.
+             * Determines the maximum delay between retries of a failed report.
+             *
+             * \return Returns the maximum retry delay, in seconds.
              */
-            void loadSettings();
+            unsigned long long maximumRetryDelay() const;
 
             /**
-             * Saves stateful information related to customer usage.  This method is thread safe.  Note that you may
-             * want to call \ref stopTimers to terminate any running timers before calling this method.
+             * Sets the retry delays.  Each consecutive failure doubles the range the next delay is drawn from, up to
+             * the maximum delay.
+             *
+             * \param[in] newBaseDelay    The delay before the first retry, in seconds.
+             *
+             * \param[in] newMaximumDelay The maximum delay between retries, in seconds.
              */
-            void saveSettings();
+            void setRetryDelays(unsigned long long newBaseDelay, unsigned long long newMaximumDelay);
 
-        public slots:
             /**
-             * Enables or disables reporting of usage statistics.
+             * Determines the number of consecutive failed reports that suspends reporting.
              *
-             * \param[in] nowEnabled If true, reporting will be enabled.  If false, reporting will be disabled.
+             * \return Returns the failure threshold.  A value of 0 indicates the circuit breaker is disabled.
              */
-            void setReportingEnabled(bool nowEnabled = true);
+            unsigned circuitBreakerThreshold() const;
 
             /**
-             * Disables or enables reporting of usage statistics.
+             * Sets the number of consecutive failed reports that suspends reporting.
              *
-             * \param[in] nowDisabled If true, reporting will be disabled.  If false, reporting will be enabled.
+             * \param[in] newThreshold The new failure threshold.  A value of 0 disables the circuit breaker.
              */
-            void setReportingDisabled(bool nowDisabled = true);
+            void setCircuitBreakerThreshold(unsigned newThreshold);
 
             /**
-             * Increments a usage event tracker.  This method is thread-safe.
-             *
-             * \param[in] eventName  The name of the event to be adjusted.
+             * Determines how long reporting is suspended once the circuit breaker opens.
              *
-             * \param[in] adjustment The adjustment to apply to the counter.
+             * \return Returns the open period, in seconds.
              */
-            void adjustEvent(const QString& eventName, unsigned adjustment = 1);
+            unsigned long long circuitBreakerOpenPeriod() const;
 
             /**
-             * Adds a value to a usage time tracker.  This method is thread-safe.
+             * Sets how long reporting is suspended once the circuit breaker opens.
              *
-             * \param[in] activityName The name of the activity being tracked.
+             * \param[in] newOpenPeriod The new open period, in seconds.
+             */
+            void setCircuitBreakerOpenPeriod(unsigned long long newOpenPeriod);
+
+            /**
+             * Determines the state of the reporting circuit breaker.
              *
-             * \param[in] adjustment   The adjustment amount.
+             * \return Returns the circuit breaker state.
              */
-            void adjustActivity(const QString& activityName, std::int64_t adjustment);
+            CircuitState circuitState() const;
 
             /**
-             * Starts an activity timer.  The function will assert if the timer is already running.
+             * Obtains measurements of the cost of usage tracking.  This method is thread-safe.
              *
-             * \param[in] timerName The name of the timer to start.
+             * \return Returns the current statistics.
              */
-            void startTimer(const QString& timerName);
+            Statistics stats() const;
 
             /**
-             * Stop or updates an activity timer, updating the activity with the time delta, in seconds.
+             * Determines if a specified timer is active on the calling thread.
              *
              * \param[in] timerName The name of the timer to start.
-             *
-             * \param[in] doStop    If true, the timer will be stopped.  If false, elapsed time will be accounted for
-             *                      and the timer will continue to run.
              */
-            void stopTimer(const QString& timerName, bool doStop = true);
+            bool isTimerActive(const QString& timerName) const;
 
             /**
-             * Stops and processes all active timers.
+             * Loads stateful information related to customer usage.  This method is thread-safe.
              */
-            void stopTimers();
+            void loadSettings();
 
-        signals:
             /**
-             * Signal that is emitted when reporting is started.  This signal exists primary for test purposes.
+             * Saves stateful information related to customer usage.  This method is thread safe.  Note that you may
+             * want to call \ref stopTimers to terminate any running timers before calling this method.
              */
-            void reportingStarted();
+            void saveSettings();
 
             /**
-             * Signal that is emitted when reporting has finished.  This signal exists primarily for test purposes.
+             * Registers an event, returning a handle that can be used to adjust the event without hashing the event
+             * name on every call.  Registering the same name more than once returns the same handle.  This method is
+             * thread-safe.
              *
-             * \param[in] successful Holds true if the reporting operation was successful.  Holds false if the
-             *                      reporting operation failed.
+             * \param[in] eventName The name of the event to be registered.
+             *
+             * \return Returns a handle to the event.  The value \ref invalidId is returned if no more events can be
+             *         tracked.
              */
-            void reportingFinished(bool successful);
+            EventId registerEvent(const QString& eventName);
 
-        protected:
             /**
-             * Method you can overload to intercept valid responses.
+             * Registers an activity, returning a handle that can be used to adjust the activity without hashing the
+             * activity name on every call.  Registering the same name more than once returns the same handle.  This
+             * method is thread-safe.
              *
-             * \param[in] jsonDocument A JSON document holding the received response.
+             * \param[in] activityName The name of the activity to be registered.
+             *
+             * \return Returns a handle to the activity.  The value \ref invalidId is returned if no more activities
+             *         can be tracked.
              */
-            void jsonResponseWasReceived(const QJsonDocument& jsonDocument) override;
+            ActivityId registerActivity(const QString& activityName);
 
             /**
-             * Method you can overload to intercept failure notifications.  The default implementation triggers the
-             * \ref Wh::WebHook::failedToSend signal.
+             * Increments a pre-registered usage event tracker.  This method is thread-safe and lock-free.  It is
+             * named apart from \ref adjustEvent so the slot can still be connected by member function pointer.
              *
-             * \param[in] networkError The last reported network error.  This is the value of
-             *                         QNetworkReply::NetworkError cast to an integer.
+             * \param[in] eventId    The handle of the event to be adjusted.
+             *
+             * \param[in] adjustment The adjustment to apply to the counter.
              */
-            void failed(int networkError) override;
+            void adjustEventById(EventId eventId, unsigned adjustment = 1);
 
-        private slots:
             /**
-             * Slot that triggers reporting of user activity.
+             * Adds a value to a pre-registered usage time tracker.  This method is thread-safe and lock-free.  It is
+             * named apart from \ref adjustActivity so the slot can still be connected by member function pointer.
+             *
+             * \param[in] activityId The handle of the activity being tracked.
+             *
+             * \param[in] adjustment The adjustment amount, in units of the activity resolution.
              */
-            void reportUsageData();
+            void adjustActivityById(ActivityId activityId, std::int64_t adjustment);
 
-        private:
             /**
-             * Schedules reports to occur at a specified time.
+             * Adds elapsed time to a pre-registered usage time tracker.  This method is thread-safe and lock-free and
+             * is used by \ref Ud::ScopedActivity.
              *
-             * \param[in] reportTime The time for the report to be issued.
+             * \param[in] activityId  The handle of the activity being tracked.
+             *
+             * \param[in] nanoseconds The elapsed time to add, in nanoseconds.
              */
-            void scheduleReport(const QDateTime& reportTime);
+            void addActivityTime(ActivityId activityId, std::uint64_t nanoseconds);
 
             /**
-             * Method called to perform configuration that is common to all constructors.
+             * Adds elapsed time to a usage time tracker by name.  The name is subject to the activity key limit (see
+             * \ref setMaximumActivityKeys).  This method is thread-safe and is used by \ref Ud::ScopedActivity.
              *
-             * \param[in] settings       The settings group to load/store settings to.
+             * \param[in] activityName The name of the activity being tracked.
              *
-             * \param[in] destinationUrl The destination URL for the webhook.
+             * \param[in] nanoseconds  The elapsed time to add, in nanoseconds.
              */
-            void configure(QSettings* settings, const QUrl& destinationUrl);
+            void addActivityTime(const QString& activityName, std::uint64_t nanoseconds);
 
             /**
-             * Adjusts the events and activities values downward after reporting.  If the resulting value is zero, the
-             * event or activity is removed from the database.
+             * Enables a latency histogram for an activity.  Once enabled, every timed span or positive adjustment
+             * applied to the activity is also recorded in a \ref Ud::Histogram and the histogram is included with the
+             * activity in reports.  Histograms remain enabled for the lifetime of this object.  This method is
+             * thread-safe.
+             *
+             * \param[in] activityId The handle of the activity.
              */
-            void adjustEventsAndActivities();
+            void enableHistogram(ActivityId activityId);
 
             /**
-             * The settings class used to load/store data.
+             * Enables a latency histogram for an activity.  This method is thread-safe.
+             *
+             * \param[in] activityName The name of the activity.
              */
-            QSettings* currentSettings;
+            void enableHistogram(const QString& activityName);
 
             /**
-             * The group within the settings class to hold the usage data between reports.
+             * Enables a quantile sketch for an activity.  Sketches use far less memory than histograms for a given
+             * accuracy and are the preferred way to track tail latencies across many activities.  Once enabled, every
+             * timed span or positive adjustment applied to the activity is also recorded in a
+             * \ref Ud::QuantileSketch and the serialized sketch is included with the activity in reports.  Sketches
+             * remain enabled for the lifetime of this object.  This method is thread-safe.
+             *
+             * \param[in] activityId       The handle of the activity.
+             *
+             * \param[in] relativeAccuracy The relative accuracy of the reported quantiles.
              */
-            QString currentSettingsGroup;
+            void enableSketch(
+                ActivityId activityId,
+                double     relativeAccuracy = QuantileSketch::defaultRelativeAccuracy
+            );
 
             /**
-             * The network access manager.
+             * Enables a quantile sketch for an activity.  This method is thread-safe.
+             *
+             * \param[in] activityName     The name of the activity.
+             *
+             * \param[in] relativeAccuracy The relative accuracy of the reported quantiles.
              */
-            QNetworkAccessManager* currentNetworkAccessManager;
+            void enableSketch(
+                const QString& activityName,
+                double         relativeAccuracy = QuantileSketch::defaultRelativeAccuracy
+            );
 
             /**
-             * The destination URL.
+             * Observes a value for a distinct count.  The report includes an estimate of the number of distinct values
+             * observed under each name during the report interval along with the underlying \ref Ud::HyperLogLog
+             * registers.  This method is thread-safe and lock-free once the name has been observed.
+             *
+             * \param[in] name  The name of the distinct count.
+             *
+             * \param[in] value The observed value.
              */
-            QUrl currentDestinationUrl;
+            void observeDistinct(const QString& name, const QString& value);
 
             /**
-             * Flag indicating if usage data reporting is enabled.
+             * Samples updates to an event.  With a rate of N, each call to \ref UsageData::adjustEvent records the
+             * adjustment with probability 1/N, multiplied by N, so reported totals are unbiased estimates.  The rates
+             * of sampled events are listed in the report's "sampling" object.  This method is thread-safe.
+             *
+             * \param[in] eventId The handle of the event.
+             *
+             * \param[in] rate    The sampling rate.  A value of 1 records every update.
              */
-            bool enabled;
+            void setEventSampling(EventId eventId, std::uint32_t rate);
 
             /**
-             * Secret used to identify this machine in an anonymous way.
+             * Samples updates to an event.  This method is thread-safe.
+             *
+             * \param[in] eventName The name of the event.
+             *
+             * \param[in] rate      The sampling rate.  A value of 1 records every update.
              */
-            std::uint64_t secret;
+            void setEventSampling(const QString& eventName, std::uint32_t rate);
 
             /**
-             * Mutex used to allow multi-threaded access to the usage data events.
+             * Samples updates to an event at a rate that adapts to how often the event is adjusted.  This method is
+             * thread-safe.
+             *
+             * \param[in] eventId         The handle of the event.
+             *
+             * \param[in] targetPerSecond The target number of recorded updates per second.
+             *
+             * \param[in] maximumRate     The largest sampling rate that may be selected.
              */
-            mutable QMutex eventsMutex;
+            void setAdaptiveEventSampling(
+                EventId       eventId,
+                std::uint32_t targetPerSecond,
+                std::uint32_t maximumRate = Sampler::defaultMaximumRate
+            );
 
             /**
-             * Mutex used to allow multi-threaded access to the usage data activities.
+             * Samples updates to an event at a rate that adapts to how often the event is adjusted.  This method is
+             * thread-safe.
+             *
+             * \param[in] eventName       The name of the event.
+             *
+             * \param[in] targetPerSecond The target number of recorded updates per second.
+             *
+             * \param[in] maximumRate     The largest sampling rate that may be selected.
              */
-            mutable QMutex activitiesMutex;
+            void setAdaptiveEventSampling(
+                const QString& eventName,
+                std::uint32_t  targetPerSecond,
+                std::uint32_t  maximumRate = Sampler::defaultMaximumRate
+            );
 
             /**
-             * Mutex used to allow multi-threaded access to the usage data timers.
+             * Determines the current sampling rate of an event.  This method is thread-safe.
+             *
+             * \param[in] eventId The handle of the event.
+             *
+             * \return Returns the current sampling rate.  A value of 1 indicates the event is not sampled.
              */
-            mutable QMutex timersMutex;
+            std::uint32_t eventSamplingRate(EventId eventId) const;
 
             /**
-             * Value indicating when the last update was performed.
+             * Samples updates to an activity made through \ref UsageData::adjustActivity.  Sampled adjustments are
+             * also weighted in the activity's histogram and sketch.  See \ref UsageData::setEventSampling for details.
+             * This method is thread-safe.
+             *
+             * \param[in] activityId The handle of the activity.
+             *
+             * \param[in] rate       The sampling rate.  A value of 1 records every update.
              */
-            QDateTime lastOperation;
+            void setActivitySampling(ActivityId activityId, std::uint32_t rate);
 
             /**
-             * Value indicating when the next update will be performed.
+             * Samples updates to an activity.  This method is thread-safe.
+             *
+             * \param[in] activityName The name of the activity.
+             *
+             * \param[in] rate         The sampling rate.  A value of 1 records every update.
              */
-            QDateTime nextOperation;
+            void setActivitySampling(const QString& activityName, std::uint32_t rate);
 
             /**
-             * Hash tracking count of events by event name.
+             * Samples updates to an activity at a rate that adapts to how often the activity is adjusted.  This
+             * method is thread-safe.
+             *
+             * \param[in] activityId      The handle of the activity.
+             *
+             * \param[in] targetPerSecond The target number of recorded updates per second.
+             *
+             * \param[in] maximumRate     The largest sampling rate that may be selected.
              */
-            QHash<QString, std::uint64_t> events;
+            void setAdaptiveActivitySampling(
+                ActivityId    activityId,
+                std::uint32_t targetPerSecond,
+                std::uint32_t maximumRate = Sampler::defaultMaximumRate
+            );
 
             /**
-             * Hash tracking activity counts.
+             * Samples updates to an activity at a rate that adapts to how often the activity is adjusted.  This
+             * method is thread-safe.
+             *
+             * \param[in] activityName    The name of the activity.
+             *
+             * \param[in] targetPerSecond The target number of recorded updates per second.
+             *
+             * \param[in] maximumRate     The largest sampling rate that may be selected.
              */
-            QHash<QString, std::uint64_t> activities;
+            void setAdaptiveActivitySampling(
+                const QString& activityName,
+                std::uint32_t  targetPerSecond,
+                std::uint32_t  maximumRate = Sampler::defaultMaximumRate
+            );
 
             /**
-             * Hash tracking timer start date/times.
+             * Determines the current sampling rate of an activity.  This method is thread-safe.
+             *
+             * \param[in] activityId The handle of the activity.
+             *
+             * \return Returns the current sampling rate.  A value of 1 indicates the activity is not sampled.
              */
-            QHash<QString, QDateTime> timers;
+            std::uint32_t activitySamplingRate(ActivityId activityId) const;
 
             /**
-             * Hash used to track adjustments to events during updates.  This hash exists so we don't need to block
-             * updates to the tracking mechanisms during reporting.
+             * Enables time-bucketed rollups of events and activities.  Once enabled, every update is also added to
+             * the current bucket of a \ref Ud::TimeSeries and each report carries a "time_series" object holding the
+             * window of bucket totals, oldest first, for every key updated within the window.  The window is kept in
+             * memory only and is not retired by reports.  Time series remain enabled for the lifetime of this object;
+             * later calls are ignored.  This method is thread-safe.
+             *
+             * \param[in] bucketSeconds The length of each bucket, in seconds.
+             *
+             * \param[in] numberBuckets The number of buckets kept for each key.
              */
-            QHash<QString, std::uint64_t> eventsAdjustment;
+            void enableTimeSeries(
+                unsigned bucketSeconds = TimeSeries::defaultBucketSeconds,
+                unsigned numberBuckets = TimeSeries::defaultNumberBuckets
+            );
 
             /**
-             * Hash used to track adjustments to activities during updates.  This hash exists so we don't need to block
-             * updates to the tracking mechanisms during reporting.
+             * Determines if time-bucketed rollups are enabled.  This method is thread-safe.
+             *
+             * \return Returns true if time series are enabled.  Returns false if time series are disabled.
              */
-            QHash<QString, std::uint64_t> activitiesAdjustment;
+            bool timeSeriesEnabled() const;
 
+        public slots:
             /**
-             * Timer used to trigger updates.
+             * Enables or disables reporting of usage statistics.
+             *
+             * \param[in] nowEnabled If true, reporting will be enabled.  If false, reporting will be disabled.
              */
-            QTimer* timer;
+            void setReportingEnabled(bool nowEnabled = true);
 
             /**
-             * The desired interval between reports, in seconds.
+             * Disables or enables reporting of usage statistics.
+             *
+             * \param[in] nowDisabled If true, reporting will be disabled.  If false, reporting will be enabled.
              */
-            std::uint64_t reportInterval;
+            void setReportingDisabled(bool nowDisabled = true);
 
             /**
-             * Flag that indicates if this class is actively reporting.
+             * Increments a usage event tracker.  This method is thread-safe and will not block other threads updating
+             * events that have already been seen.
+             *
+             * \param[in] eventName  The name of the event to be adjusted.
+             *
+             * \param[in] adjustment The adjustment to apply to the counter.
+             */
+            void adjustEvent(const QString& eventName, unsigned adjustment = 1);
+
+            /**
+             * Adds a value to a usage time tracker.  This method is thread-safe and will not block other threads
+             * updating activities that have already been seen.
+             *
+             * \param[in] activityName The name of the activity being tracked.
+             *
+             * \param[in] adjustment   The adjustment amount, in units of the activity resolution.
+             */
+            void adjustActivity(const QString& activityName, std::int64_t adjustment);
+
+            /**
+             * Starts an activity timer.  Timers are tracked per thread so multiple threads can time the same activity
+             * concurrently and starting or stopping a timer on the thread that started it takes no lock.  The function
+             * will assert if the timer is already running on the calling thread.
+             *
+             * \param[in] timerName The name of the timer to start.
+             */
+            void startTimer(const QString& timerName);
+
+            /**
+             * Stop or updates an activity timer, updating the activity with the time delta.  The timer started by the
+             * calling thread is used.  If the calling thread has no such timer, a timer with the same name started by
+             * another thread is used.
+             *
+             * \param[in] timerName The name of the timer to start.
+             *
+             * \param[in] doStop    If true, the timer will be stopped.  If false, elapsed time will be accounted for
+             *                      and the timer will continue to run.
+             */
+            void stopTimer(const QString& timerName, bool doStop = true);
+
+            /**
+             * Stops and processes all active timers on all threads.
+             */
+            void stopTimers();
+
+            /**
+             * Saves events and activities to the journal.  Only counters that changed since the last save are written.
+             * This method does nothing if no journal file has been set.  This method is thread-safe.
+             */
+            void checkpoint();
+
+        signals:
+            /**
+             * Signal that is emitted when reporting is started.  This signal exists primary for test purposes.
+             */
+            void reportingStarted();
+
+            /**
+             * Signal that is emitted when reporting has finished.  This signal exists primarily for test purposes.
+             *
+             * \param[in] successful Holds true if the reporting operation was successful.  Holds false if the
+             *                      reporting operation failed.
+             */
+            void reportingFinished(bool successful);
+
+            /**
+             * Signal that is emitted when the reporting circuit breaker changes state.
+             *
+             * \param[out] newState The new circuit breaker state.
+             */
+            void circuitStateChanged(CircuitState newState);
+
+            /**
+             * Signal that is emitted each time a report completes.  Statistics are only gathered for this signal if
+             * it is connected.
+             *
+             * \param[out] statistics The current statistics.
+             */
+            void statisticsUpdated(const Ud::UsageData::Statistics& statistics);
+
+        protected:
+            /**
+             * Method you can overload to intercept valid responses.
+             *
+             * \param[in] jsonDocument A JSON document holding the received response.
+             */
+            void jsonResponseWasReceived(const QJsonDocument& jsonDocument) override;
+
+            /**
+             * Method you can overload to intercept failure notifications.  The default implementation triggers the
+             * \ref Wh::WebHook::failedToSend signal.
+             *
+             * \param[in] networkError The last reported network error.  This is the value of
+             *                         QNetworkReply::NetworkError cast to an integer.
+             */
+            void failed(int networkError) override;
+
+        private slots:
+            /**
+             * Slot that triggers reporting of user activity.
+             */
+            void reportUsageData();
+
+        private:
+            /**
+             * Structure holding a report that is ready to be sent.
+             */
+            struct PreparedReport {
+                /**
+                 * The report body, kept so the report can be spooled if it fails.  Only used if the report is sent
+                 * through the payload transport.
+                 */
+                QByteArray payload;
+
+                /**
+                 * The report as a JSON object.  Only used if the report is sent through the web hook.
+                 */
+                QJsonObject object;
+
+                /**
+                 * The spool files batched with the report.
+                 */
+                QStringList spoolFiles;
+
+                /**
+                 * Flag indicating the report is sent through the payload transport rather than the web hook.
+                 */
+                bool useTransport;
+
+                /**
+                 * The compressed and signed request.  Only used if the report is sent through the payload transport.
+                 */
+                PayloadTransport::Request request;
+            };
+
+            /**
+             * Structure holding everything a report needs, captured on the thread owning this object so the report
+             * can be serialized on a worker thread without touching any other state.
+             */
+            struct ReportSnapshot {
+                /**
+                 * The report format.
+                 */
+                PayloadFormat format;
+
+                /**
+                 * The time covered by the report, in seconds.
+                 */
+                qint64 elapsedTime;
+
+                /**
+                 * The user secret.
+                 */
+                std::uint64_t secret;
+
+                /**
+                 * The name of every registered slot, by slot.
+                 */
+                QVector<QString> names;
+
+                /**
+                 * The retired event counts, by name.
+                 */
+                QHash<QString, std::uint64_t> eventCounts;
+
+                /**
+                 * The retired activity times, by name, in nanoseconds.
+                 */
+                QHash<QString, std::uint64_t> activityTimes;
+
+                /**
+                 * The activity resolution, in nanoseconds per reported unit.
+                 */
+                std::uint64_t resolution;
+
+                /**
+                 * The activities reported with a histogram or sketch, by name.
+                 */
+                QHash<QString, ActivityId> detailedActivities;
+
+                /**
+                 * The histogram bucket counts, by activity.
+                 */
+                QHash<ActivityId, QVector<std::uint64_t>> histograms;
+
+                /**
+                 * The quantile sketches, by activity.
+                 */
+                QHash<ActivityId, QuantileSketch> sketches;
+
+                /**
+                 * The distinct count registers, by slot.
+                 */
+                QHash<KeyRegistry::Slot, QByteArray> distinct;
+
+                /**
+                 * Flag indicating sampling rates are reported.
+                 */
+                bool sampling;
+
+                /**
+                 * The event sampling rates above one, by name.
+                 */
+                QVector<QPair<QString, std::uint32_t>> eventRates;
+
+                /**
+                 * The activity sampling rates above one, by name.
+                 */
+                QVector<QPair<QString, std::uint32_t>> activityRates;
+
+                /**
+                 * Flag indicating time series are reported.
+                 */
+                bool timeSeries;
+
+                /**
+                 * The width of each time series bucket, in seconds.
+                 */
+                unsigned bucketSeconds;
+
+                /**
+                 * The time of the first time series bucket.
+                 */
+                std::int64_t firstTime;
+
+                /**
+                 * The event time series buckets, by slot.
+                 */
+                QHash<KeyRegistry::Slot, QVector<std::uint64_t>> eventBuckets;
+
+                /**
+                 * The activity time series buckets, by slot.
+                 */
+                QHash<KeyRegistry::Slot, QVector<std::uint64_t>> activityBuckets;
+
+                /**
+                 * The upper bound on any single event folded into "__other__".
+                 */
+                std::uint64_t eventsBound;
+
+                /**
+                 * The upper bound on any single activity folded into "__other__", in reported units.
+                 */
+                std::uint64_t activitiesBound;
+
+                /**
+                 * The spooled reports batched with the report.
+                 */
+                QList<ReportSpool::Entry> spooled;
+
+                /**
+                 * The time spent taking the snapshot, in nanoseconds.
+                 */
+                std::uint64_t snapshotTime;
+            };
+
+            /**
+             * Adds time to an activity, also recording the time in the activity's histogram and sketch, if enabled.
+             *
+             * \param[in] activityId  The handle of the activity.
+             *
+             * \param[in] nanoseconds The time to add, in nanoseconds.
+             *
+             * \param[in] weight      The number of occurrences the time represents, greater than one for sampled
+             *                        updates.
+             */
+            void recordActivity(ActivityId activityId, std::uint64_t nanoseconds, std::uint64_t weight = 1);
+
+            /**
+             * Adds a sampled adjustment to an activity.
+             *
+             * \param[in] activityId The handle of the activity.
+             *
+             * \param[in] adjustment The adjustment amount, in units of the activity resolution.
+             *
+             * \param[in] resolution The activity resolution, in nanoseconds per unit.
+             *
+             * \param[in] weight     The sampling weight of the adjustment.
+             */
+            void recordAdjustment(
+                ActivityId    activityId,
+                std::int64_t  adjustment,
+                std::uint64_t resolution,
+                std::uint64_t weight
+            );
+
+            /**
+             * Obtains the sampler associated with a slot, creating it if needed.
+             *
+             * \param[in] samplers The table holding the sampler.
+             *
+             * \param[in] slot     The slot of the event or activity.
+             *
+             * \return Returns the sampler.  A null pointer is returned if the slot is invalid.
+             */
+            Sampler* sampler(SlotTable<Sampler>& samplers, KeyRegistry::Slot slot);
+
+            /**
+             * Obtains the distinct count sketch associated with a slot, creating it if needed.
+             *
+             * \param[in] slot The slot of the distinct count.
+             *
+             * \return Returns the sketch.  A null pointer is returned if the slot is invalid.
+             */
+            HyperLogLog* distinctCounter(KeyRegistry::Slot slot);
+
+            /**
+             * Loads the journal and adds the counters it holds to the events and activities.  The journal mutex must
+             * be held.
+             */
+            void importJournal();
+
+            /**
+             * Accounts for the elapsed time of every running timer without stopping them.
+             */
+            void updateTimers();
+
+            /**
+             * Schedules reports to occur at a specified time.
+             *
+             * \param[in] reportTime The time for the report to be issued.
+             */
+            void scheduleReport(const QDateTime& reportTime);
+
+            /**
+             * Method called to perform configuration that is common to all constructors.
+             *
+             * \param[in] settings             The settings group to load/store settings to.
+             *
+             * \param[in] networkAccessManager The network settings manager.
+             *
+             * \param[in] sharedSecret         The HMAC secret used to validate messages.
+             *
+             * \param[in] destinationUrl       The destination URL for the webhook.
+             */
+            void configure(
+                QSettings*             settings,
+                QNetworkAccessManager* networkAccessManager,
+                const QByteArray&      sharedSecret,
+                const QUrl&            destinationUrl
+            );
+
+            /**
+             * Retires the events and activities and captures everything else a report holds.  This method must be
+             * called from the thread owning this object.
+             *
+             * \param[in] format      The report format.
+             *
+             * \param[in] elapsedTime The time covered by the report, in seconds.
+             *
+             * \return Returns the snapshot.
+             */
+            ReportSnapshot snapshotReport(PayloadFormat format, qint64 elapsedTime);
+
+            /**
+             * Serializes a snapshot into a report body.  Only the snapshot is read so this method may run on a worker
+             * thread.
+             *
+             * \param[in] snapshot The snapshot to serialize.
+             *
+             * \param[in] object   If not null, the report is built into this object rather than serialized.  The
+             *                     web hook only accepts a JSON object so only reports sent through the payload
+             *                     transport are streamed.
+             *
+             * \return Returns the report body.  An empty body is returned if the report is built into an object.
+             */
+            QByteArray writeReport(const ReportSnapshot& snapshot, QJsonObject* object = Q_NULLPTR);
+
+            /**
+             * Snapshots the events and activities and serializes them into a report body.  This method must be
+             * called from the thread owning this object.
+             *
+             * \param[in] format      The report format.
+             *
+             * \param[in] elapsedTime The time covered by the report, in seconds.
+             *
+             * \return Returns the report body.
+             */
+            QByteArray buildReport(PayloadFormat format, qint64 elapsedTime);
+
+            /**
+             * Serializes a snapshot, batches it with the spooled reports it holds, and compresses and signs the
+             * result.  Only the snapshot is read so this method may run on a worker thread.
+             *
+             * \param[in] snapshot     The snapshot to report.
+             *
+             * \param[in] compression  The compression applied to the request body.
+             *
+             * \param[in] useTransport If true, the report is prepared for the payload transport.
+             *
+             * \return Returns the prepared report.
+             */
+            PreparedReport prepareReport(
+                const ReportSnapshot&         snapshot,
+                PayloadTransport::Compression compression,
+                bool                          useTransport
+            );
+
+            /**
+             * Sends a prepared report.  This method must be called from the thread owning the network access manager.
+             *
+             * \param[in] report The prepared report.
+             */
+            void sendReport(const PreparedReport& report);
+
+            /**
+             * Emits \ref statisticsUpdated, if connected, and starts a new adjustment rate period.  Called each time a
+             * report completes.
+             */
+            void publishStatistics();
+
+            /**
+             * Uploads the oldest spooled reports of one format as a batch, if any remain.  Called after a report
+             * succeeds, so reports spooled in a format other than the current one are uploaded too.
+             *
+             * \return Returns true if a batch was posted.  Returns false if the spool holds no reports.
+             */
+            bool uploadSpool();
+
+            /**
+             * Removes the spooled reports in a batch once the collector accepts the batch and uploads the next batch.
+             *
+             * \param[in] jsonDocument The collector's response.
+             */
+            void spoolUploadFinished(const QJsonDocument& jsonDocument);
+
+            /**
+             * Records a failed upload of a batch of spooled reports.  Reports the collector rejected are dropped.
+             *
+             * \param[in] networkError The QNetworkReply::NetworkError code describing the failure.
+             */
+            void spoolUploadFailed(int networkError);
+
+            /**
+             * Completes a reporting cycle, scheduling the next report and emitting \ref reportingFinished.
+             */
+            void finishReport();
+
+            /**
+             * Discards the reported events and activities after a report has been accepted.
+             */
+            void adjustEventsAndActivities();
+
+            /**
+             * Merges the reported events and activities back into the live values after a report has failed.
+             */
+            void restoreEventsAndActivities();
+
+            /**
+             * Writes a setting in the current group if the setting does not already hold the value.
+             *
+             * \param[in] key   The setting key.
+             *
+             * \param[in] value The value to be written.
+             */
+            void setSettingIfChanged(const QString& key, const QVariant& value);
+
+            /**
+             * Removes a setting or group of settings from the current group if present.
+             *
+             * \param[in] key The setting key or group name.
+             */
+            void removeSettingIfPresent(const QString& key);
+
+            /**
+             * Saves a group of counters, writing only counters that changed since they were last loaded or saved and
+             * removing counters that are now zero.
+             *
+             * \param[in]     group       The settings group holding the counters.
+             *
+             * \param[in]     values      The current non-zero counter values by name.
+             *
+             * \param[in,out] savedValues The counter values held by the settings.  Updated to match the values.
+             */
+            void saveCounterGroup(
+                const QString&                       group,
+                const QHash<QString, std::uint64_t>& values,
+                QHash<QString, std::uint64_t>&       savedValues
+            );
+
+            /**
+             * The settings class used to load/store data.
+             */
+            QSettings* currentSettings;
+
+            /**
+             * The group within the settings class to hold the usage data between reports.
+             */
+            QString currentSettingsGroup;
+
+            /**
+             * The network access manager.
+             */
+            QNetworkAccessManager* currentNetworkAccessManager;
+
+            /**
+             * The destination URL.
+             */
+            QUrl currentDestinationUrl;
+
+            /**
+             * The transport used to send compressed reports.
+             */
+            PayloadTransport* payloadTransport;
+
+            /**
+             * The transport used to upload batches of spooled reports between reports.
+             */
+            PayloadTransport* spoolTransport;
+
+            /**
+             * The format used to serialize reports.
+             */
+            PayloadFormat currentPayloadFormat;
+
+            /**
+             * The HMAC secret used to sign reports sent through the payload transport.
+             */
+            QByteArray currentSharedSecret;
+
+            /**
+             * Flag indicating if reports are built on a worker thread.
+             */
+            bool currentBackgroundReporting;
+
+            /**
+             * Watcher used to hand reports built on a worker thread back to the owning thread.
+             */
+            QFutureWatcher<PreparedReport>* reportWatcher;
+
+            /**
+             * Flag indicating if usage data reporting is enabled.
+             */
+            bool enabled;
+
+            /**
+             * Flag indicating that \ref loadSettings has been called.
+             */
+            bool settingsLoaded;
+
+            /**
+             * Secret used to identify this machine in an anonymous way.
+             */
+            std::uint64_t secret;
+
+            /**
+             * Value indicating when the last update was performed.
+             */
+            QDateTime lastOperation;
+
+            /**
+             * Value indicating when the next update will be performed.
+             */
+            QDateTime nextOperation;
+
+            /**
+             * Sharded store tracking count of events by event name.
+             */
+            CounterStore events;
+
+            /**
+             * Sharded store tracking activity times, in nanoseconds.
+             */
+            CounterStore activities;
+
+            /**
+             * The number of nanoseconds per reported activity unit.
+             */
+            std::atomic<std::uint64_t> currentActivityResolution;
+
+            /**
+             * The total time spent waiting for internal mutexes, in nanoseconds.
+             */
+            mutable std::atomic<std::uint64_t> mutexWaitTime;
+
+            /**
+             * The number of contended internal mutex acquisitions.
+             */
+            mutable std::atomic<std::uint64_t> contendedLocks;
+
+            /**
+             * The time spent building the last report, in nanoseconds.
+             */
+            std::atomic<std::uint64_t> lastSnapshotTime;
+
+            /**
+             * The size of the last report body, in bytes.
+             */
+            std::atomic<std::uint64_t> lastPayloadBytes;
+
+            /**
+             * The size of the last request body as sent, in bytes.
+             */
+            std::atomic<std::uint64_t> lastEncodedBytes;
+
+            /**
+             * The time spent in the last call to \ref loadSettings, in nanoseconds.
+             */
+            std::atomic<std::uint64_t> lastLoadTime;
+
+            /**
+             * The time spent in the last call to \ref saveSettings, in nanoseconds.
+             */
+            std::atomic<std::uint64_t> lastSaveTime;
+
+            /**
+             * The monotonic clock time at the start of the current adjustment rate period, in nanoseconds.
+             */
+            std::atomic<std::int64_t> rateStartTime;
+
+            /**
+             * The number of adjustments at the start of the current adjustment rate period.
+             */
+            std::atomic<std::uint64_t> rateStartCount;
+
+            /**
+             * Table of activity histograms, indexed by activity.
+             */
+            SlotTable<Histogram> histograms;
+
+            /**
+             * Table of activity quantile sketches, indexed by activity.
+             */
+            SlotTable<QuantileSketch> sketches;
+
+            /**
+             * Table of distinct count sketches, indexed by name.
+             */
+            SlotTable<HyperLogLog> distinctCounters;
+
+            /**
+             * Table of event samplers, indexed by event.
+             */
+            SlotTable<Sampler> eventSamplers;
+
+            /**
+             * Table of activity samplers, indexed by activity.
+             */
+            SlotTable<Sampler> activitySamplers;
+
+            /**
+             * Flag indicating that at least one sampler exists.  Adjustments skip the sampler lookup until then.
+             */
+            std::atomic<bool> samplingEnabled;
+
+            /**
+             * Time series of event totals.  A null pointer indicates time series are disabled.
+             */
+            std::atomic<TimeSeries*> eventSeries;
+
+            /**
+             * Time series of activity totals, in nanoseconds.  A null pointer indicates time series are disabled.
+             */
+            std::atomic<TimeSeries*> activitySeries;
+
+            /**
+             * Monotonic clock used to time activities.
+             */
+            QElapsedTimer monotonicClock;
+
+            /**
+             * Table tracking running timers per thread.
+             */
+            TimerTable timers;
+
+            /**
+             * Journal used to persist events and activities.
+             */
+            CounterJournal journal;
+
+            /**
+             * Mutex protecting the journal.
+             */
+            mutable QMutex journalMutex;
+
+            /**
+             * Directory holding the memory-mapped event and activity files.
+             */
+            QString currentCounterDirectory;
+
+            /**
+             * The spool holding reports that could not be sent.
+             */
+            ReportSpool spool;
+
+            /**
+             * The body of the report in flight, kept so the report can be spooled if it fails.  Empty if the spool is
+             * disabled.
+             */
+            QByteArray inFlightPayload;
+
+            /**
+             * The format of the report in flight.
+             */
+            PayloadFormat inFlightFormat;
+
+            /**
+             * The spool files uploaded with the report in flight.
+             */
+            QStringList inFlightSpoolFiles;
+
+            /**
+             * The spool files in the batch of spooled reports being uploaded.
+             */
+            QStringList inFlightSpoolBatch;
+
+            /**
+             * The policy used to schedule retries of failed reports.
+             */
+            RetryPolicy retryPolicy;
+
+            /**
+             * The event values held by the settings, used to write only changed events.
+             */
+            QHash<QString, std::uint64_t> savedEvents;
+
+            /**
+             * The activity times held by the settings, used to write only changed activities.
+             */
+            QHash<QString, std::uint64_t> savedActivityTimes;
+
+            /**
+             * The distinct count registers held by the settings, used to write only changed distinct counts.
+             */
+            QHash<QString, QByteArray> savedDistinct;
+
+            /**
+             * Hash holding the time below the activity resolution, in nanoseconds, that was retired with the last
+             * report.  The time is carried forward once the report is accepted.
+             */
+            QHash<QString, std::uint64_t> activitiesRemainder;
+
+            /**
+             * Hash used to track adjustments to histograms during updates.
+             */
+            QHash<ActivityId, QVector<std::uint64_t>> histogramsAdjustment;
+
+            /**
+             * Hash used to track adjustments to quantile sketches during updates.
+             */
+            QHash<ActivityId, QuantileSketch> sketchesAdjustment;
+
+            /**
+             * Hash used to track adjustments to distinct count sketches during updates.
+             */
+            QHash<KeyRegistry::Slot, QByteArray> distinctAdjustment;
+
+            /**
+             * Timer used to trigger updates.
+             */
+            QTimer* timer;
+
+            /**
+             * The desired interval between reports, in seconds.
+             */
+            std::uint64_t reportInterval;
+
+            /**
+             * Flag that indicates if this class is actively reporting.
              */
             bool currentlyIsReporting;
 
@@ -498,4 +1727,6 @@ namespace Ud {
     };
 }
 
+Q_DECLARE_METATYPE(Ud::UsageData::Statistics)
+
 #endif
@@ -27,7 +27,7 @@
 
 TEMPLATE = lib
 
-QT += core network
+QT += core network concurrent
 CONFIG += shared c++14
 
 DEFINES += INEUD_BUILD
@@ -38,13 +38,47 @@ DEFINES += INEUD_BUILD
 
 INCLUDEPATH += include
 HEADERS = include/ud_common.h \
+          include/ud_key_registry.h \
+          include/ud_thread_index.h \
+          include/ud_update_counter.h \
+          include/ud_counter_store.h \
+          include/ud_slot_table.h \
+          include/ud_histogram.h \
+          include/ud_quantile_sketch.h \
+          include/ud_hyper_log_log.h \
+          include/ud_space_saving.h \
+          include/ud_sampler.h \
+          include/ud_time_series.h \
+          include/ud_timer_table.h \
+          include/ud_counter_journal.h \
+          include/ud_payload_transport.h \
+          include/ud_payload_writer.h \
+          include/ud_report_spool.h \
+          include/ud_retry_policy.h \
           include/ud_usage_data.h \
+          include/ud_scoped_activity.h \
 
 ########################################################################################################################
 # Source files
 #
 
-SOURCES = source/ud_usage_data.cpp \
+SOURCES = source/ud_key_registry.cpp \
+          source/ud_thread_index.cpp \
+          source/ud_update_counter.cpp \
+          source/ud_counter_store.cpp \
+          source/ud_histogram.cpp \
+          source/ud_quantile_sketch.cpp \
+          source/ud_hyper_log_log.cpp \
+          source/ud_space_saving.cpp \
+          source/ud_sampler.cpp \
+          source/ud_time_series.cpp \
+          source/ud_timer_table.cpp \
+          source/ud_counter_journal.cpp \
+          source/ud_payload_transport.cpp \
+          source/ud_payload_writer.cpp \
+          source/ud_report_spool.cpp \
+          source/ud_retry_policy.cpp \
+          source/ud_usage_data.cpp \
 
 ########################################################################################################################
 # Libraries
@@ -0,0 +1,430 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::CounterJournal class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstdint>
+
+#include "ud_counter_journal.h"
+
+namespace {
+    /**
+     * Bytes placed at the start of every journal.  The last byte is the journal format version.
+     */
+    const char journalMagic[] = { 'U', 'D', 'J', '\x01' };
+
+    /**
+     * The length of the journal header, in bytes.
+     */
+    const int headerLength = static_cast<int>(sizeof(journalMagic));
+
+    /**
+     * Record type used to assign an identifier to a name.  Payload is a 32-bit identifier, a 16-bit length, and the
+     * UTF-8 encoded name.
+     */
+    const std::uint8_t nameRecord = 1;
+
+    /**
+     * Record type used to adjust a counter.  Payload is an 8-bit table, a 32-bit name identifier, and a 64-bit
+     * modular delta.
+     */
+    const std::uint8_t deltaRecord = 2;
+
+    /**
+     * The length of a delta record, including the type and checksum, in bytes.
+     */
+    const int deltaRecordLength = 1 + 1 + 4 + 8 + 2;
+
+    /**
+     * Appends a little-endian unsigned value to a buffer.
+     *
+     * \param[in,out] buffer        The buffer to append to.
+     *
+     * \param[in]     value         The value to append.
+     *
+     * \param[in]     numberBytes   The number of bytes to append.
+     */
+    void appendValue(QByteArray& buffer, std::uint64_t value, unsigned numberBytes) {
+        for (unsigned i=0 ; i<numberBytes ; ++i) {
+            buffer.append(static_cast<char>(static_cast<std::uint8_t>(value >> (8 * i))));
+        }
+    }
+
+    /**
+     * Reads a little-endian unsigned value from a buffer.
+     *
+     * \param[in] data        Pointer to the first byte of the value.
+     *
+     * \param[in] numberBytes The number of bytes to read.
+     *
+     * \return Returns the value.
+     */
+    std::uint64_t readValue(const char* data, unsigned numberBytes) {
+        std::uint64_t result = 0;
+        for (unsigned i=0 ; i<numberBytes ; ++i) {
+            result |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[i])) << (8 * i);
+        }
+
+        return result;
+    }
+
+    /**
+     * Appends the checksum of a record to a buffer.
+     *
+     * \param[in,out] buffer      The buffer holding the record.
+     *
+     * \param[in]     recordStart The offset of the first byte of the record.
+     */
+    void appendChecksum(QByteArray& buffer, int recordStart) {
+        uint    length   = static_cast<uint>(buffer.size() - recordStart);
+        quint16 checksum = qChecksum(buffer.constData() + recordStart, length);
+
+        appendValue(buffer, checksum, 2);
+    }
+
+    /**
+     * Appends a delta record to a buffer.
+     *
+     * \param[in,out] buffer The buffer to append to.
+     *
+     * \param[in]     table  The table holding the counter.
+     *
+     * \param[in]     id     The identifier of the counter name.
+     *
+     * \param[in]     delta  The modular delta to apply.
+     */
+    void appendDelta(QByteArray& buffer, Ud::CounterJournal::Table table, std::uint32_t id, std::uint64_t delta) {
+        int recordStart = buffer.size();
+
+        appendValue(buffer, deltaRecord, 1);
+        appendValue(buffer, static_cast<std::uint8_t>(table), 1);
+        appendValue(buffer, id, 4);
+        appendValue(buffer, delta, 8);
+        appendChecksum(buffer, recordStart);
+    }
+}
+
+namespace Ud {
+    const unsigned CounterJournal::numberTables;
+    const qint64   CounterJournal::defaultCompactionThreshold = 256 * 1024;
+
+    CounterJournal::CounterJournal(const QString& filename) {
+        currentFilename     = filename;
+        compactionThreshold = defaultCompactionThreshold;
+        compactedSize       = 0;
+        currentSize         = 0;
+        loaded              = false;
+    }
+
+
+    CounterJournal::~CounterJournal() {}
+
+
+    QString CounterJournal::filename() const {
+        return currentFilename;
+    }
+
+
+    void CounterJournal::setFilename(const QString& newFilename) {
+        currentFilename = newFilename;
+        reset();
+    }
+
+
+    bool CounterJournal::isEnabled() const {
+        return !currentFilename.isEmpty();
+    }
+
+
+    bool CounterJournal::isLoaded() const {
+        return loaded;
+    }
+
+
+    void CounterJournal::setCompactionThreshold(qint64 newCompactionThreshold) {
+        compactionThreshold = newCompactionThreshold;
+    }
+
+
+    bool CounterJournal::load() {
+        reset();
+
+        bool success = true;
+        if (isEnabled() && QFile::exists(currentFilename)) {
+            QFile file(currentFilename);
+            success = file.open(QFile::ReadOnly);
+            if (success) {
+                QByteArray data = file.readAll();
+                file.close();
+
+                const char* bytes      = data.constData();
+                int         dataLength = data.size();
+                int         validEnd   = 0;
+                QByteArray  header(journalMagic, headerLength);
+
+                // A file that holds a torn header is an empty journal.  Any other file that does not start with the
+                // header is not a journal this version can read, so it is left untouched.
+                success = header.startsWith(data) || data.startsWith(header);
+
+                if (success && dataLength >= headerLength) {
+                    QHash<std::uint32_t, QString> namesById;
+
+                    int  position = headerLength;
+                    bool valid    = true;
+                    validEnd      = position;
+
+                    while (valid && position < dataLength) {
+                        std::uint8_t recordType   = static_cast<std::uint8_t>(bytes[position]);
+                        int          recordLength = 0;
+
+                        if (recordType == nameRecord && position + 7 <= dataLength) {
+                            recordLength = 1 + 4 + 2 + static_cast<int>(readValue(bytes + position + 5, 2)) + 2;
+                        } else if (recordType == deltaRecord) {
+                            recordLength = deltaRecordLength;
+                        }
+
+                        int checksumOffset = position + recordLength - 2;
+                        valid = (
+                               recordLength > 0
+                            && position + recordLength <= dataLength
+                            && qChecksum(bytes + position, static_cast<uint>(recordLength - 2))
+                               == readValue(bytes + checksumOffset, 2)
+                        );
+
+                        if (valid) {
+                            if (recordType == nameRecord) {
+                                std::uint32_t id   = static_cast<std::uint32_t>(readValue(bytes + position + 1, 4));
+                                QString       name = QString::fromUtf8(bytes + position + 7, recordLength - 9);
+
+                                namesById.insert(id, name);
+                                nameIds.insert(name, id);
+                            } else {
+                                unsigned      table = static_cast<std::uint8_t>(bytes[position + 1]);
+                                std::uint32_t id    = static_cast<std::uint32_t>(readValue(bytes + position + 2, 4));
+                                std::uint64_t delta = readValue(bytes + position + 6, 8);
+
+                                valid = table < numberTables && namesById.contains(id);
+                                if (valid) {
+                                    QHash<QString, std::uint64_t>& persisted = persistedValues[table];
+                                    const QString&                 name      = namesById[id];
+                                    std::uint64_t                  newValue  = persisted.value(name, 0) + delta;
+
+                                    if (newValue != 0) {
+                                        persisted.insert(name, newValue);
+                                    } else {
+                                        persisted.remove(name);
+                                    }
+                                }
+                            }
+
+                            if (valid) {
+                                position += recordLength;
+                                validEnd  = position;
+                            }
+                        }
+                    }
+                }
+
+                if (success && validEnd < dataLength) {
+                    // Discard the torn or corrupt tail so that new records follow the last valid record.
+                    success = QFile::resize(currentFilename, validEnd);
+                }
+
+                currentSize   = validEnd;
+                compactedSize = validEnd;
+            }
+        }
+
+        loaded = success;
+        return success;
+    }
+
+
+    QHash<QString, std::uint64_t> CounterJournal::values(CounterJournal::Table table) const {
+        return persistedValues[static_cast<unsigned>(table)];
+    }
+
+
+    bool CounterJournal::save(
+            const QHash<QString, std::uint64_t>& events,
+            const QHash<QString, std::uint64_t>& activities
+        ) {
+        bool success = true;
+
+        if (isEnabled() && !loaded) {
+            // Appending to a journal that was never read would leave a second header mid-file, and the deltas would
+            // erase values that were never seen.  Only a missing or empty journal can safely be started.
+            QFileInfo fileInformation(currentFilename);
+            success = !fileInformation.exists() || fileInformation.size() == 0;
+            loaded  = success;
+        }
+
+        if (success && isEnabled()) {
+            QByteArray buffer;
+            if (currentSize == 0) {
+                buffer.append(journalMagic, headerLength);
+            }
+
+            int emptyLength = buffer.size();
+            appendDeltas(buffer, Table::EVENTS, events);
+            appendDeltas(buffer, Table::ACTIVITIES, activities);
+
+            if (buffer.size() > emptyLength) {
+                QFile file(currentFilename);
+                success = file.open(QFile::WriteOnly | QFile::Append);
+                if (success) {
+                    success = (file.write(buffer) == buffer.size() && file.flush());
+                    file.close();
+                }
+
+                if (success) {
+                    currentSize += buffer.size();
+                } else {
+                    // Resynchronize with whatever portion of the journal actually reached the disk.
+                    load();
+                }
+            }
+
+            if (success && currentSize > compactionThreshold && currentSize > 2 * compactedSize) {
+                success = compact();
+            }
+        }
+
+        return success;
+    }
+
+
+    bool CounterJournal::compact() {
+        bool success = loaded || !isEnabled();
+
+        if (success && isEnabled()) {
+            QByteArray buffer(journalMagic, headerLength);
+
+            nameIds.clear();
+            for (unsigned table=0 ; table<numberTables ; ++table) {
+                const QHash<QString, std::uint64_t>& persisted = persistedValues[table];
+                for (auto it=persisted.constBegin(),end=persisted.constEnd() ; it!=end ; ++it) {
+                    std::uint32_t id = nameId(buffer, it.key());
+                    appendDelta(buffer, static_cast<Table>(table), id, it.value());
+                }
+            }
+
+            QSaveFile file(currentFilename);
+            success = file.open(QFile::WriteOnly);
+            if (success) {
+                success = (file.write(buffer) == buffer.size() && file.commit());
+            }
+
+            if (success) {
+                currentSize   = buffer.size();
+                compactedSize = buffer.size();
+            } else {
+                load();
+            }
+        }
+
+        return success;
+    }
+
+
+    std::uint32_t CounterJournal::nameId(QByteArray& buffer, const QString& name) {
+        std::uint32_t result;
+
+        auto it = nameIds.constFind(name);
+        if (it != nameIds.constEnd()) {
+            result = it.value();
+        } else {
+            QByteArray utf8Name    = name.toUtf8().left(0xFFFF);
+            int        recordStart = buffer.size();
+
+            result = static_cast<std::uint32_t>(nameIds.size());
+
+            appendValue(buffer, nameRecord, 1);
+            appendValue(buffer, result, 4);
+            appendValue(buffer, static_cast<std::uint64_t>(utf8Name.size()), 2);
+            buffer.append(utf8Name);
+            appendChecksum(buffer, recordStart);
+
+            nameIds.insert(name, result);
+        }
+
+        return result;
+    }
+
+
+    void CounterJournal::appendDeltas(
+            QByteArray&                          buffer,
+            CounterJournal::Table                table,
+            const QHash<QString, std::uint64_t>& currentValues
+        ) {
+        QHash<QString, std::uint64_t>& persisted = persistedValues[static_cast<unsigned>(table)];
+
+        QList<QString> removedNames;
+        for (auto it=persisted.constBegin(),end=persisted.constEnd() ; it!=end ; ++it) {
+            if (!currentValues.contains(it.key())) {
+                removedNames.append(it.key());
+            }
+        }
+
+        for (auto it=removedNames.constBegin(),end=removedNames.constEnd() ; it!=end ; ++it) {
+            appendDelta(buffer, table, nameId(buffer, *it), std::uint64_t(0) - persisted.value(*it));
+            persisted.remove(*it);
+        }
+
+        for (auto it=currentValues.constBegin(),end=currentValues.constEnd() ; it!=end ; ++it) {
+            std::uint64_t persistedValue = persisted.value(it.key(), 0);
+            if (it.value() != persistedValue) {
+                appendDelta(buffer, table, nameId(buffer, it.key()), it.value() - persistedValue);
+
+                if (it.value() != 0) {
+                    persisted.insert(it.key(), it.value());
+                } else {
+                    persisted.remove(it.key());
+                }
+            }
+        }
+    }
+
+
+    void CounterJournal::reset() {
+        compactedSize = 0;
+        currentSize   = 0;
+        loaded        = false;
+
+        nameIds.clear();
+        for (unsigned table=0 ; table<numberTables ; ++table) {
+            persistedValues[table].clear();
+        }
+    }
+}
@@ -0,0 +1,993 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::CounterStore class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <QThread>
+#include <QFile>
+#include <QSaveFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QByteArray>
+
+#include <cstdint>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#include "ud_key_registry.h"
+#include "ud_space_saving.h"
+#include "ud_thread_index.h"
+#include "ud_counter_store.h"
+
+namespace {
+    /**
+     * Structure placed at the start of a memory-mapped counter file.
+     */
+    struct MappedHeader {
+        char          magic[4];
+        std::uint32_t version;
+        std::uint32_t numberShards;
+        std::uint32_t numberBuffers;
+        std::uint32_t mappedSlots;
+        std::uint32_t numberNames;
+        std::uint32_t stringCapacity;
+        std::uint32_t stringUsed;
+        std::uint32_t reserved[8];
+    };
+
+    /**
+     * Structure holding the location of a slot name within the string area of a memory-mapped counter file.
+     */
+    struct MappedName {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    /**
+     * Structure describing the layout of a memory-mapped counter file.
+     */
+    struct MappedLayout {
+        MappedLayout(std::uint32_t numberShards, std::uint32_t numberBuffers, std::uint32_t mappedSlots) {
+            namesOffset    = sizeof(MappedHeader);
+            stringsOffset  = namesOffset + static_cast<qint64>(sizeof(MappedName)) * mappedSlots;
+            stringCapacity = static_cast<qint64>(averageNameLength) * mappedSlots;
+            countersOffset = (stringsOffset + stringCapacity + pageSize - 1) / pageSize * pageSize;
+            size           = countersOffset + 8LL * numberShards * numberBuffers * mappedSlots;
+        }
+
+        static const qint64 averageNameLength = 48;
+        static const qint64 pageSize = 4096;
+
+        qint64 namesOffset;
+        qint64 stringsOffset;
+        qint64 stringCapacity;
+        qint64 countersOffset;
+        qint64 size;
+    };
+
+    /**
+     * Magic value placed at the start of a memory-mapped counter file.
+     */
+    const char mappedMagic[4] = { 'U', 'D', 'C', 'F' };
+
+    /**
+     * The memory-mapped counter file format version.
+     */
+    const std::uint32_t mappedVersion = 1;
+
+    /**
+     * Name length used to mark a slot whose name did not fit in the string area.
+     */
+    const std::uint32_t unnamedLength = static_cast<std::uint32_t>(-1);
+
+    /**
+     * Reads the non-zero counters held by a memory-mapped counter file, summed across every shard and buffer.
+     *
+     * \param[in] file The open file to be read.
+     *
+     * \return Returns a hash of counter values by name.  An empty hash is returned if the file is empty or invalid.
+     */
+    QHash<QString, std::uint64_t> readMappedCounters(QFile& file) {
+        QHash<QString, std::uint64_t> result;
+
+        qint64 fileSize = file.size();
+        if (fileSize >= static_cast<qint64>(sizeof(MappedHeader))) {
+            uchar* data = file.map(0, fileSize);
+            if (data != Q_NULLPTR) {
+                const MappedHeader* header = reinterpret_cast<const MappedHeader*>(data);
+                if (std::memcmp(header->magic, mappedMagic, sizeof(mappedMagic)) == 0
+                    && header->version == mappedVersion
+                    && header->mappedSlots <= Ud::KeyRegistry::maximumSlots
+                    && header->numberShards <= 1024
+                    && header->numberBuffers <= 16) {
+                    MappedLayout layout(header->numberShards, header->numberBuffers, header->mappedSlots);
+                    if (fileSize >= layout.size
+                        && header->stringUsed <= header->stringCapacity
+                        && header->stringCapacity <= layout.stringCapacity) {
+                        const MappedName*    names    = reinterpret_cast<const MappedName*>(data + layout.namesOffset);
+                        const char*          strings  = reinterpret_cast<const char*>(data + layout.stringsOffset);
+                        const std::uint64_t* counters = reinterpret_cast<const std::uint64_t*>(
+                            data + layout.countersOffset
+                        );
+
+                        std::uint32_t numberNames       = qMin(header->numberNames, header->mappedSlots);
+                        std::uint32_t numberCounterSets = header->numberShards * header->numberBuffers;
+                        for (std::uint32_t slot=1 ; slot<numberNames ; ++slot) {
+                            const MappedName& name = names[slot];
+                            if (name.length != unnamedLength
+                                && name.offset <= header->stringUsed
+                                && name.length <= header->stringUsed - name.offset) {
+                                std::uint64_t value = 0;
+                                for (std::uint32_t set=0 ; set<numberCounterSets ; ++set) {
+                                    value += counters[static_cast<qint64>(set) * header->mappedSlots + slot];
+                                }
+
+                                if (value != 0) {
+                                    QString nameText = QString::fromUtf8(strings + name.offset, name.length);
+                                    result.insert(nameText, result.value(nameText, 0) + value);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                file.unmap(data);
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Writes the names of newly assigned slots to the name table of a counter file.
+     *
+     * \param[in,out] header       The counter file header.  The number of names and string use are updated.
+     *
+     * \param[in]     names        The counter file name table.
+     *
+     * \param[in]     strings      The counter file string area.
+     *
+     * \param[in]     currentNames The names of every assigned slot, by slot.
+     *
+     * \param[in]     limit        One past the last slot to be named.
+     */
+    void appendMappedNames(
+            MappedHeader*           header,
+            MappedName*             names,
+            char*                   strings,
+            const QVector<QString>& currentNames,
+            std::uint32_t           limit
+        ) {
+        for (std::uint32_t s=header->numberNames ; s<limit ; ++s) {
+            QByteArray    utf8Name = currentNames.at(s).toUtf8();
+            std::uint32_t length   = static_cast<std::uint32_t>(utf8Name.size());
+
+            if (length <= header->stringCapacity - header->stringUsed) {
+                std::memcpy(strings + header->stringUsed, utf8Name.constData(), length);
+                names[s].offset     = header->stringUsed;
+                names[s].length     = length;
+                header->stringUsed += length;
+            } else {
+                // Counters for this slot stay in the file but can not be recovered by name.
+                names[s].offset = 0;
+                names[s].length = unnamedLength;
+            }
+        }
+
+        if (limit > header->numberNames) {
+            header->numberNames = limit;
+        }
+    }
+
+    /**
+     * Writes a complete counter file, replacing any existing file only once the new file has been fully written.
+     *
+     * \param[in] filename      The file to be written.
+     *
+     * \param[in] numberShards  The number of shards held by the file.
+     *
+     * \param[in] numberBuffers The number of buffers held by each shard.
+     *
+     * \param[in] mappedSlots   The number of slots held by the file.
+     *
+     * \param[in] valueSet      The shard and buffer to hold the values, as an index into the counter sets.
+     *
+     * \param[in] currentNames  The names of every assigned slot, by slot.
+     *
+     * \param[in] values        The counter values, by slot, for the first mapped slots.
+     *
+     * \return Returns true on success.  Returns false if the file could not be written, in which case any existing
+     *         file is left untouched.
+     */
+    bool writeMappedFile(
+            const QString&                filename,
+            std::uint32_t                 numberShards,
+            std::uint32_t                 numberBuffers,
+            std::uint32_t                 mappedSlots,
+            std::uint32_t                 valueSet,
+            const QVector<QString>&       currentNames,
+            const QVector<std::uint64_t>& values
+        ) {
+        MappedLayout layout(numberShards, numberBuffers, mappedSlots);
+        QByteArray   prefix(static_cast<int>(layout.countersOffset), '\0');
+
+        MappedHeader* header = reinterpret_cast<MappedHeader*>(prefix.data());
+        std::memcpy(header->magic, mappedMagic, sizeof(mappedMagic));
+        header->version        = mappedVersion;
+        header->numberShards   = numberShards;
+        header->numberBuffers  = numberBuffers;
+        header->mappedSlots    = mappedSlots;
+        header->numberNames    = 0;
+        header->stringCapacity = static_cast<std::uint32_t>(layout.stringCapacity);
+        header->stringUsed     = 0;
+
+        appendMappedNames(
+            header,
+            reinterpret_cast<MappedName*>(prefix.data() + layout.namesOffset),
+            prefix.data() + layout.stringsOffset,
+            currentNames,
+            qMin(static_cast<std::uint32_t>(currentNames.size()), mappedSlots)
+        );
+
+        qint64     setBytes   = 8LL * mappedSlots;
+        QByteArray valueBytes = QByteArray::fromRawData(
+            reinterpret_cast<const char*>(values.constData()),
+            static_cast<int>(setBytes)
+        );
+        QByteArray emptyBytes(static_cast<int>(setBytes), '\0');
+
+        QSaveFile file(filename);
+        bool      success = file.open(QFile::WriteOnly) && file.write(prefix) == prefix.size();
+
+        std::uint32_t numberSets = numberShards * numberBuffers;
+        for (std::uint32_t set=0 ; success && set<numberSets ; ++set) {
+            success = (file.write(set == valueSet ? valueBytes : emptyBytes) == setBytes);
+        }
+
+        if (success) {
+            success = file.commit();
+        } else {
+            file.cancelWriting();
+        }
+
+        return success;
+    }
+}
+
+namespace Ud {
+    const unsigned           CounterStore::slotsPerChunk;
+    const unsigned           CounterStore::maximumChunks;
+    const CounterStore::Slot CounterStore::invalidSlot;
+    const unsigned           CounterStore::numberBuffers;
+    const CounterStore::Slot CounterStore::defaultMappedSlots;
+    const char               CounterStore::otherName[] = "__other__";
+
+    CounterStore::Chunk::Chunk() {
+        for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+            counters[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+
+    CounterStore::Shard::Shard() {
+        for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+            for (unsigned i=0 ; i<maximumChunks ; ++i) {
+                chunks[buffer][i].store(Q_NULLPTR, std::memory_order_relaxed);
+            }
+        }
+
+        numberChunks.store(0, std::memory_order_relaxed);
+    }
+
+
+    CounterStore::Shard::~Shard() {
+        for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+            for (unsigned i=0 ; i<maximumChunks ; ++i) {
+                delete chunks[buffer][i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    std::atomic<std::uint64_t>* CounterStore::Shard::counter(unsigned buffer, CounterStore::Slot slot) {
+        std::atomic<Chunk*>& chunkPointer = chunks[buffer][slot / slotsPerChunk];
+        Chunk*               chunk        = chunkPointer.load(std::memory_order_acquire);
+
+        if (chunk == Q_NULLPTR) {
+            Chunk* newChunk = new Chunk;
+            if (chunkPointer.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel)) {
+                chunk = newChunk;
+                useChunks(slot / slotsPerChunk + 1);
+            } else {
+                delete newChunk;
+            }
+        }
+
+        return &chunk->counters[slot % slotsPerChunk];
+    }
+
+
+    std::uint64_t CounterStore::Shard::value(unsigned buffer, CounterStore::Slot slot) const {
+        const Chunk* chunk = chunks[buffer][slot / slotsPerChunk].load(std::memory_order_acquire);
+        return chunk == Q_NULLPTR ? 0 : chunk->counters[slot % slotsPerChunk].load(std::memory_order_relaxed);
+    }
+
+
+    void CounterStore::Shard::clear(unsigned buffer) {
+        for (unsigned chunkIndex=0 ; chunkIndex<maximumChunks ; ++chunkIndex) {
+            Chunk* chunk = chunks[buffer][chunkIndex].load(std::memory_order_acquire);
+            if (chunk != Q_NULLPTR) {
+                for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+                    chunk->counters[i].store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+
+    void CounterStore::Shard::useChunks(unsigned newNumberChunks) {
+        unsigned current = numberChunks.load(std::memory_order_relaxed);
+        while (current < newNumberChunks
+               && !numberChunks.compare_exchange_weak(current, newNumberChunks, std::memory_order_release)) {}
+    }
+
+
+    CounterStore::CounterStore() {
+        unsigned desiredShards = static_cast<unsigned>(qMax(1, QThread::idealThreadCount()));
+        if (desiredShards > 64) {
+            desiredShards = 64;
+        }
+
+        numberShards = 1;
+        while (numberShards < desiredShards) {
+            numberShards <<= 1;
+        }
+
+        shards = new Shard[numberShards];
+
+        activeBuffer.store(0, std::memory_order_relaxed);
+        retiredPending = false;
+
+        mappedFile = Q_NULLPTR;
+        mappedData = Q_NULLPTR;
+        mappedSlots.store(0, std::memory_order_relaxed);
+        namedSlots.store(0, std::memory_order_relaxed);
+
+        currentMaximumKeys.store(0, std::memory_order_relaxed);
+        for (unsigned i=0 ; i<KeyRegistry::maximumSlots / 64 ; ++i) {
+            admittedSlots[i].store(0, std::memory_order_relaxed);
+        }
+
+        numberAdmittedSlots = 0;
+        otherSlot           = KeyRegistry::slot(QString::fromLatin1(otherName));
+        retiredOtherBound   = 0;
+        restoredOtherBound  = 0;
+
+        overflow.setCapacity(0);
+    }
+
+
+    CounterStore::~CounterStore() {
+        if (mappedFile != Q_NULLPTR) {
+            // The file keeps its counters so they are picked up the next time the file is attached.
+            unmapChunks();
+            mappedFile->unmap(mappedData);
+            delete mappedFile;
+        }
+
+        delete[] shards;
+    }
+
+
+    CounterStore::Slot CounterStore::add(CounterStore::Slot slot, std::uint64_t value) {
+        bool bounded = (currentMaximumKeys.load(std::memory_order_relaxed) != 0);
+        if (bounded && slot < KeyRegistry::maximumSlots && slot != otherSlot && !isAdmitted(slot)) {
+            slot = admit(slot, QString(), value);
+        }
+
+        if (slot < KeyRegistry::maximumSlots) {
+            if (slot < mappedSlots.load(std::memory_order_acquire)
+                && slot >= namedSlots.load(std::memory_order_acquire)) {
+                syncMappedNames();
+            }
+
+            // An update that races a swap may land in the retired buffer.  It is carried over when the retired
+            // buffer is released or restored, so no ordering with retire() is needed.
+            unsigned buffer = activeBuffer.load(std::memory_order_relaxed);
+            Shard*   shard  = currentShard();
+
+            shard->counter(buffer, slot)->fetch_add(value, std::memory_order_relaxed);
+            updates.increment();
+        }
+
+        return slot;
+    }
+
+
+    CounterStore::Slot CounterStore::add(const QString& name, std::uint64_t value) {
+        return add(admittedSlot(name, value), value);
+    }
+
+
+    CounterStore::Slot CounterStore::admittedSlot(const QString& name, std::uint64_t value) {
+        Slot slot;
+        if (currentMaximumKeys.load(std::memory_order_relaxed) == 0) {
+            slot = KeyRegistry::slot(name);
+        } else {
+            // Names that are not admitted are never registered so a flood of distinct names can not grow the
+            // registry.
+            slot = KeyRegistry::find(name);
+            if (slot == invalidSlot || (slot != otherSlot && !isAdmitted(slot))) {
+                slot = admit(slot, name, value);
+            }
+        }
+
+        return slot;
+    }
+
+
+    std::uint64_t CounterStore::value(CounterStore::Slot slot) const {
+        std::uint64_t result = 0;
+        for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+            result += bufferValue(buffer, slot);
+        }
+
+        return result;
+    }
+
+
+    QHash<QString, std::uint64_t> CounterStore::snapshot() const {
+        QVector<QString> currentNames = KeyRegistry::names();
+
+        QHash<QString, std::uint64_t> result;
+        Slot numberSlots = qMin(static_cast<Slot>(currentNames.size()), allocatedSlots());
+        for (Slot s=KeyRegistry::reservedSlot+1 ; s<numberSlots ; ++s) {
+            std::uint64_t v = value(s);
+            if (v != 0) {
+                result.insert(currentNames.at(s), v);
+            }
+        }
+
+        return result;
+    }
+
+
+    QHash<QString, std::uint64_t> CounterStore::retire() {
+        if (retiredPending) {
+            restoreRetired();
+        }
+
+        unsigned retiredBuffer = activeBuffer.load(std::memory_order_relaxed);
+        activeBuffer.store(retiredBuffer ^ 1, std::memory_order_relaxed);
+        retiredPending = true;
+
+        QVector<QString> currentNames = KeyRegistry::names();
+
+        QHash<QString, std::uint64_t> result;
+        Slot numberSlots = qMin(static_cast<Slot>(currentNames.size()), allocatedSlots());
+
+        retiredValues.fill(0, numberSlots);
+        for (Slot s=KeyRegistry::reservedSlot+1 ; s<numberSlots ; ++s) {
+            std::uint64_t v = bufferValue(retiredBuffer, s);
+            if (v != 0) {
+                result.insert(currentNames.at(s), v);
+                retiredValues[s] = v;
+            }
+        }
+
+        {
+            QMutexLocker locker(&overflowMutex);
+
+            retiredOtherBound  = overflow.maximumCount() + restoredOtherBound;
+            restoredOtherBound = 0;
+
+            if (currentMaximumKeys.load(std::memory_order_relaxed) != 0) {
+                rebalance(retiredBuffer, numberSlots);
+            }
+
+            overflow.clear();
+        }
+
+        return result;
+    }
+
+
+    void CounterStore::releaseRetired() {
+        if (retiredPending) {
+            drainRetired(true);
+            retiredPending = false;
+        }
+    }
+
+
+    void CounterStore::restoreRetired() {
+        if (retiredPending) {
+            drainRetired(false);
+            retiredPending = false;
+
+            QMutexLocker locker(&overflowMutex);
+            restoredOtherBound += retiredOtherBound;
+            retiredOtherBound   = 0;
+        }
+    }
+
+
+    void CounterStore::clear() {
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+                shards[i].clear(buffer);
+            }
+        }
+
+        retiredPending = false;
+        retiredValues.clear();
+
+        QMutexLocker locker(&overflowMutex);
+        overflow.clear();
+        retiredOtherBound  = 0;
+        restoredOtherBound = 0;
+    }
+
+
+    bool CounterStore::attach(const QString& filename, CounterStore::Slot requestedSlots) {
+        detach();
+
+        Slot newMappedSlots = (qMin(requestedSlots, KeyRegistry::maximumSlots) + slotsPerChunk - 1) / slotsPerChunk;
+        newMappedSlots *= slotsPerChunk;
+
+        // Gather every value, including values recorded before the file was attached.
+        restoreRetired();
+
+        bool                       success = true;
+        QHash<Slot, std::uint64_t> fileValues;
+        QFile                      existingFile(filename);
+
+        if (existingFile.exists()) {
+            success = existingFile.open(QFile::ReadOnly);
+            if (success) {
+                QHash<QString, std::uint64_t> namedValues = readMappedCounters(existingFile);
+                for (auto it=namedValues.constBegin(),end=namedValues.constEnd() ; success && it!=end ; ++it) {
+                    // A name that can not be registered would lose its value, so the file is left as it is.
+                    Slot s = KeyRegistry::slot(it.key());
+                    if (s != invalidSlot) {
+                        fileValues.insert(s, fileValues.value(s, 0) + it.value());
+                    } else {
+                        success = false;
+                    }
+                }
+
+                existingFile.close();
+            }
+        }
+
+        QVector<QString>           currentNames = KeyRegistry::names();
+        Slot                       numberSlots  = qMin(static_cast<Slot>(currentNames.size()), allocatedSlots());
+        QVector<std::uint64_t>     mappedValues(static_cast<int>(newMappedSlots), 0);
+        QHash<Slot, std::uint64_t> heapValues;
+        QHash<Slot, std::uint64_t> values       = fileValues;
+
+        for (Slot s=KeyRegistry::reservedSlot+1 ; s<numberSlots ; ++s) {
+            std::uint64_t v = value(s);
+            if (v != 0) {
+                values.insert(s, values.value(s, 0) + v);
+            }
+        }
+
+        // Only slots holding a value are visited, so the cost follows this store's keys rather than the registry.
+        for (auto it=values.constBegin(),end=values.constEnd() ; it!=end ; ++it) {
+            Slot          s = it.key();
+            std::uint64_t v = it.value();
+            if (v != 0) {
+                if (s < newMappedSlots) {
+                    mappedValues[s] = v;
+                } else {
+                    heapValues.insert(s, v);
+                }
+            }
+        }
+
+        // The new file is written in full before it replaces the old one, so a crash at any point leaves either the
+        // old or the new counters on disk.
+        unsigned valueSet = activeBuffer.load(std::memory_order_relaxed);
+        if (success) {
+            success = writeMappedFile(
+                filename,
+                numberShards,
+                numberBuffers,
+                newMappedSlots,
+                valueSet,
+                currentNames,
+                mappedValues
+            );
+        }
+
+        if (success) {
+            MappedLayout  layout(numberShards, numberBuffers, newMappedSlots);
+            QFile*        file = new QFile(filename);
+            std::uint8_t* data = Q_NULLPTR;
+
+            if (file->open(QFile::ReadWrite) && file->size() == layout.size) {
+                data = reinterpret_cast<std::uint8_t*>(file->map(0, layout.size));
+            }
+
+            if (data != Q_NULLPTR) {
+                clear();
+
+                mappedFile = file;
+                mappedData = data;
+                mappedSlots.store(newMappedSlots, std::memory_order_release);
+                namedSlots.store(reinterpret_cast<MappedHeader*>(data)->numberNames, std::memory_order_release);
+
+                mapChunks();
+                syncMappedNames();
+
+                for (auto it=heapValues.constBegin(),end=heapValues.constEnd() ; it!=end ; ++it) {
+                    add(it.key(), it.value());
+                }
+            } else {
+                // The values read from the old file now live only in the new file, so they are moved into memory
+                // and the file is removed to keep them from being counted twice.
+                delete file;
+                QFile::remove(filename);
+
+                for (auto it=fileValues.constBegin(),end=fileValues.constEnd() ; it!=end ; ++it) {
+                    add(it.key(), it.value());
+                }
+
+                success = false;
+            }
+        }
+
+        return success;
+    }
+
+
+    void CounterStore::detach() {
+        if (mappedFile != Q_NULLPTR) {
+            restoreRetired();
+
+            QHash<Slot, std::uint64_t> values;
+            Slot                       numberMapped = mappedSlots.load(std::memory_order_relaxed);
+            for (Slot s=KeyRegistry::reservedSlot+1 ; s<numberMapped ; ++s) {
+                std::uint64_t v = value(s);
+                if (v != 0) {
+                    values.insert(s, v);
+                }
+            }
+
+            // The values now live in memory so they are removed from the file.
+            clear();
+            unmapChunks();
+
+            mappedFile->unmap(mappedData);
+            delete mappedFile;
+
+            mappedFile = Q_NULLPTR;
+            mappedData = Q_NULLPTR;
+            mappedSlots.store(0, std::memory_order_release);
+            namedSlots.store(0, std::memory_order_relaxed);
+
+            for (auto it=values.constBegin(),end=values.constEnd() ; it!=end ; ++it) {
+                add(it.key(), it.value());
+            }
+        }
+    }
+
+
+    bool CounterStore::isAttached() const {
+        return mappedFile != Q_NULLPTR;
+    }
+
+
+    unsigned CounterStore::unmappedKeys() const {
+        unsigned result = 0;
+        if (mappedFile != Q_NULLPTR) {
+            Slot numberSlots = allocatedSlots();
+            for (Slot s=mappedSlots.load(std::memory_order_relaxed) ; s<numberSlots ; ++s) {
+                if (value(s) != 0) {
+                    ++result;
+                }
+            }
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t CounterStore::numberUpdates() const {
+        return updates.value();
+    }
+
+
+    std::uint64_t CounterStore::memoryUsage() const {
+        std::uint64_t result = sizeof(CounterStore) + static_cast<std::uint64_t>(numberShards) * sizeof(Shard);
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+                for (unsigned chunkIndex=0 ; chunkIndex<maximumChunks ; ++chunkIndex) {
+                    if (shards[i].chunks[buffer][chunkIndex].load(std::memory_order_relaxed) != Q_NULLPTR) {
+                        result += sizeof(Chunk);
+                    }
+                }
+            }
+        }
+
+        // Each overflow key is held once in the heap and once in the index.
+        QMutexLocker locker(&overflowMutex);
+        result += 2ULL * overflow.size() * sizeof(SpaceSaving::Entry);
+
+        return result;
+    }
+
+
+    unsigned CounterStore::maximumKeys() const {
+        return currentMaximumKeys.load(std::memory_order_relaxed);
+    }
+
+
+    void CounterStore::setMaximumKeys(unsigned newMaximumKeys) {
+        QMutexLocker locker(&overflowMutex);
+
+        unsigned previousMaximumKeys = currentMaximumKeys.exchange(newMaximumKeys, std::memory_order_relaxed);
+        if (newMaximumKeys == 0 || previousMaximumKeys == 0) {
+            for (unsigned i=0 ; i<KeyRegistry::maximumSlots / 64 ; ++i) {
+                admittedSlots[i].store(0, std::memory_order_relaxed);
+            }
+
+            numberAdmittedSlots = 0;
+        }
+
+        overflow.setCapacity(newMaximumKeys);
+    }
+
+
+    unsigned CounterStore::numberKeys() const {
+        QMutexLocker locker(&overflowMutex);
+        return numberAdmittedSlots;
+    }
+
+
+    std::uint64_t CounterStore::otherBound() const {
+        QMutexLocker locker(&overflowMutex);
+        return retiredOtherBound;
+    }
+
+
+    void CounterStore::syncMappedNames() {
+        QMutexLocker locker(&mappedNamesMutex);
+
+        if (mappedData != Q_NULLPTR) {
+            Slot          numberMapped = mappedSlots.load(std::memory_order_relaxed);
+            MappedHeader* header       = reinterpret_cast<MappedHeader*>(mappedData);
+            MappedLayout  layout(numberShards, numberBuffers, numberMapped);
+
+            QVector<QString> currentNames = KeyRegistry::names();
+            appendMappedNames(
+                header,
+                reinterpret_cast<MappedName*>(mappedData + layout.namesOffset),
+                reinterpret_cast<char*>(mappedData + layout.stringsOffset),
+                currentNames,
+                qMin(static_cast<Slot>(currentNames.size()), numberMapped)
+            );
+
+            namedSlots.store(header->numberNames, std::memory_order_release);
+        }
+    }
+
+
+    void CounterStore::mapChunks() {
+        static_assert(
+            sizeof(Chunk) == slotsPerChunk * sizeof(std::uint64_t),
+            "Chunks must match the counter layout of memory-mapped files."
+        );
+
+        Slot         numberMapped = mappedSlots.load(std::memory_order_relaxed);
+        MappedLayout layout(numberShards, numberBuffers, numberMapped);
+        unsigned     mappedChunks = numberMapped / slotsPerChunk;
+        Chunk*       fileChunks   = reinterpret_cast<Chunk*>(mappedData + layout.countersOffset);
+
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+                Chunk* setChunks = fileChunks + (i * numberBuffers + buffer) * mappedChunks;
+                for (unsigned chunkIndex=0 ; chunkIndex<mappedChunks ; ++chunkIndex) {
+                    delete shards[i].chunks[buffer][chunkIndex].exchange(
+                        setChunks + chunkIndex,
+                        std::memory_order_acq_rel
+                    );
+                }
+            }
+
+            shards[i].useChunks(mappedChunks);
+        }
+    }
+
+
+    void CounterStore::unmapChunks() {
+        unsigned mappedChunks = mappedSlots.load(std::memory_order_relaxed) / slotsPerChunk;
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            for (unsigned buffer=0 ; buffer<numberBuffers ; ++buffer) {
+                for (unsigned chunkIndex=0 ; chunkIndex<mappedChunks ; ++chunkIndex) {
+                    shards[i].chunks[buffer][chunkIndex].store(Q_NULLPTR, std::memory_order_release);
+                }
+            }
+        }
+    }
+
+
+    void CounterStore::drainRetired(bool consumed) {
+        unsigned activeIndex   = activeBuffer.load(std::memory_order_relaxed);
+        unsigned retiredBuffer = activeIndex ^ 1;
+        Slot     numberSlots   = allocatedSlots();
+        Slot     numberRetired = static_cast<Slot>(retiredValues.size());
+        Shard*   shard         = currentShard();
+
+        // Subtracting exactly what was read, rather than zeroing, keeps any update that raced the swap.  Values in
+        // single shards may wrap; only sums are meaningful.
+        for (Slot s=KeyRegistry::reservedSlot+1 ; s<numberSlots ; ++s) {
+            std::uint64_t v = bufferValue(retiredBuffer, s);
+            if (v != 0) {
+                std::uint64_t carried = v;
+                if (consumed && s < numberRetired) {
+                    carried -= retiredValues.at(s);
+                }
+
+                shards[0].counter(retiredBuffer, s)->fetch_sub(v, std::memory_order_relaxed);
+                if (carried != 0) {
+                    shard->counter(activeIndex, s)->fetch_add(carried, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        retiredValues.clear();
+    }
+
+
+    CounterStore::Shard* CounterStore::currentShard() {
+        return shards + (threadIndex() & (numberShards - 1));
+    }
+
+
+    std::uint64_t CounterStore::bufferValue(unsigned buffer, CounterStore::Slot slot) const {
+        std::uint64_t result = 0;
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            result += shards[i].value(buffer, slot);
+        }
+
+        return result;
+    }
+
+
+    CounterStore::Slot CounterStore::allocatedSlots() const {
+        unsigned numberChunks = 0;
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            numberChunks = qMax(numberChunks, shards[i].numberChunks.load(std::memory_order_acquire));
+        }
+
+        return static_cast<Slot>(numberChunks * slotsPerChunk);
+    }
+
+
+    bool CounterStore::isAdmitted(CounterStore::Slot slot) const {
+        std::uint64_t bit = static_cast<std::uint64_t>(1) << (slot % 64);
+        return (admittedSlots[slot / 64].load(std::memory_order_relaxed) & bit) != 0;
+    }
+
+
+    CounterStore::Slot CounterStore::admit(CounterStore::Slot slot, const QString& name, std::uint64_t value) {
+        QMutexLocker locker(&overflowMutex);
+
+        Slot     result          = slot;
+        unsigned maximumKeys     = currentMaximumKeys.load(std::memory_order_relaxed);
+        bool     alreadyAdmitted = (slot != invalidSlot && isAdmitted(slot));
+
+        if (maximumKeys == 0 || alreadyAdmitted) {
+            if (result == invalidSlot) {
+                result = KeyRegistry::slot(name);
+            }
+        } else if (numberAdmittedSlots < maximumKeys) {
+            if (result == invalidSlot) {
+                result = KeyRegistry::slot(name);
+            }
+
+            if (result < KeyRegistry::maximumSlots) {
+                admittedSlots[result / 64].fetch_or(
+                    static_cast<std::uint64_t>(1) << (result % 64),
+                    std::memory_order_relaxed
+                );
+                ++numberAdmittedSlots;
+            }
+        } else {
+            overflow.add(slot == invalidSlot ? name : KeyRegistry::name(slot), value);
+            result = otherSlot;
+        }
+
+        return result;
+    }
+
+
+    void CounterStore::rebalance(unsigned retiredBuffer, CounterStore::Slot numberSlots) {
+        unsigned maximumKeys = currentMaximumKeys.load(std::memory_order_relaxed);
+
+        // Admitted keys ordered by their retired value, smallest first.
+        QVector<QPair<std::uint64_t, Slot>> admitted;
+        for (Slot s=KeyRegistry::reservedSlot+1 ; s<numberSlots ; ++s) {
+            if (isAdmitted(s)) {
+                admitted.append(qMakePair(bufferValue(retiredBuffer, s), s));
+            }
+        }
+
+        std::sort(admitted.begin(), admitted.end());
+
+        int  nextVictim = 0;
+        auto demote     = [&]() {
+            Slot victim = admitted.at(nextVictim++).second;
+            admittedSlots[victim / 64].fetch_and(
+                ~(static_cast<std::uint64_t>(1) << (victim % 64)),
+                std::memory_order_relaxed
+            );
+            --numberAdmittedSlots;
+        };
+
+        while (numberAdmittedSlots > maximumKeys && nextVictim < admitted.size()) {
+            demote();
+        }
+
+        // Overflow keys are promoted only when their guaranteed count exceeds the value of the key they replace.
+        QList<SpaceSaving::Entry> candidates = overflow.entries();
+        for (auto it=candidates.constBegin(),end=candidates.constEnd() ; it!=end ; ++it) {
+            std::uint64_t guaranteedCount = it->count - it->error;
+            Slot          slot            = KeyRegistry::find(it->key);
+
+            if (slot == invalidSlot || !isAdmitted(slot)) {
+                bool promote = false;
+                if (numberAdmittedSlots < maximumKeys) {
+                    promote = (guaranteedCount > 0);
+                } else if (nextVictim < admitted.size() && guaranteedCount > admitted.at(nextVictim).first) {
+                    demote();
+                    promote = true;
+                }
+
+                if (promote) {
+                    if (slot == invalidSlot) {
+                        slot = KeyRegistry::slot(it->key);
+                    }
+
+                    if (slot < KeyRegistry::maximumSlots) {
+                        admittedSlots[slot / 64].fetch_or(
+                            static_cast<std::uint64_t>(1) << (slot % 64),
+                            std::memory_order_relaxed
+                        );
+                        ++numberAdmittedSlots;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,228 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::Histogram class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QVector>
+#include <QThread>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_thread_index.h"
+#include "ud_histogram.h"
+
+namespace Ud {
+    const unsigned Histogram::subBucketBits;
+    const unsigned Histogram::subBucketCount;
+    const unsigned Histogram::numberBuckets;
+    const unsigned Histogram::maximumShards;
+
+    Histogram::Shard::Shard() {
+        for (unsigned i=0 ; i<numberBuckets ; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+
+    Histogram::Histogram() {
+        unsigned desiredShards = static_cast<unsigned>(qMax(1, QThread::idealThreadCount()));
+        if (desiredShards > maximumShards) {
+            desiredShards = maximumShards;
+        }
+
+        numberShards = 1;
+        while (numberShards < desiredShards) {
+            numberShards <<= 1;
+        }
+
+        shards[0].store(new Shard, std::memory_order_relaxed);
+        for (unsigned i=1 ; i<maximumShards ; ++i) {
+            shards[i].store(Q_NULLPTR, std::memory_order_relaxed);
+        }
+    }
+
+
+    Histogram::~Histogram() {
+        for (unsigned i=0 ; i<maximumShards ; ++i) {
+            delete shards[i].load(std::memory_order_relaxed);
+        }
+    }
+
+
+    void Histogram::record(std::uint64_t value, std::uint64_t count) {
+        threadShard()->counts[bucketIndex(value)].fetch_add(count, std::memory_order_relaxed);
+    }
+
+
+    QVector<std::uint64_t> Histogram::snapshot() const {
+        QVector<std::uint64_t> result(numberBuckets, 0);
+
+        for (unsigned shardIndex=0 ; shardIndex<numberShards ; ++shardIndex) {
+            const Shard* shard = shards[shardIndex].load(std::memory_order_acquire);
+            if (shard != Q_NULLPTR) {
+                for (unsigned i=0 ; i<numberBuckets ; ++i) {
+                    result[i] += shard->counts[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        return result;
+    }
+
+
+    void Histogram::merge(const QVector<std::uint64_t>& bucketCounts) {
+        Q_ASSERT(static_cast<unsigned>(bucketCounts.size()) == numberBuckets);
+
+        Shard* shard = shards[0].load(std::memory_order_relaxed);
+        for (unsigned i=0 ; i<numberBuckets ; ++i) {
+            std::uint64_t count = bucketCounts.at(i);
+            if (count != 0) {
+                shard->counts[i].fetch_add(count, std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    void Histogram::merge(const Histogram& other) {
+        merge(other.snapshot());
+    }
+
+
+    void Histogram::subtract(const QVector<std::uint64_t>& bucketCounts) {
+        Q_ASSERT(static_cast<unsigned>(bucketCounts.size()) == numberBuckets);
+
+        // Counts recorded by other threads live in other shards so the first shard may wrap.  The sum stays exact.
+        Shard* shard = shards[0].load(std::memory_order_relaxed);
+        for (unsigned i=0 ; i<numberBuckets ; ++i) {
+            std::uint64_t count = bucketCounts.at(i);
+            if (count != 0) {
+                shard->counts[i].fetch_sub(count, std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    void Histogram::clear() {
+        for (unsigned shardIndex=0 ; shardIndex<numberShards ; ++shardIndex) {
+            Shard* shard = shards[shardIndex].load(std::memory_order_acquire);
+            if (shard != Q_NULLPTR) {
+                for (unsigned i=0 ; i<numberBuckets ; ++i) {
+                    shard->counts[i].store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+
+    std::uint64_t Histogram::memoryUsage() const {
+        std::uint64_t result = sizeof(Histogram);
+        for (unsigned i=0 ; i<numberShards ; ++i) {
+            if (shards[i].load(std::memory_order_relaxed) != Q_NULLPTR) {
+                result += sizeof(Shard);
+            }
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t Histogram::bucketLowerBound(unsigned index) {
+        std::uint64_t result;
+
+        if (index < subBucketCount) {
+            result = index;
+        } else {
+            unsigned shift     = index / subBucketCount - 1;
+            unsigned subBucket = index % subBucketCount;
+
+            result = static_cast<std::uint64_t>(subBucketCount + subBucket) << shift;
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t Histogram::bucketUpperBound(unsigned index) {
+        std::uint64_t result;
+
+        if (index < subBucketCount) {
+            result = index;
+        } else {
+            unsigned shift = index / subBucketCount - 1;
+            result = bucketLowerBound(index) + ((static_cast<std::uint64_t>(1) << shift) - 1);
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t Histogram::valueAtQuantile(const QVector<std::uint64_t>& bucketCounts, double quantile) {
+        std::uint64_t total = 0;
+        for (auto it=bucketCounts.constBegin(),end=bucketCounts.constEnd() ; it!=end ; ++it) {
+            total += *it;
+        }
+
+        std::uint64_t result = 0;
+        if (total > 0) {
+            double        clampedQuantile = qBound(0.0, quantile, 1.0);
+            std::uint64_t rank            = static_cast<std::uint64_t>(clampedQuantile * (total - 1)) + 1;
+
+            std::uint64_t cumulative = 0;
+            unsigned      index      = 0;
+            unsigned      count      = static_cast<unsigned>(bucketCounts.size());
+            while (index < count && cumulative + bucketCounts.at(index) < rank) {
+                cumulative += bucketCounts.at(index);
+                ++index;
+            }
+
+            if (index < count) {
+                std::uint64_t lower = bucketLowerBound(index);
+                std::uint64_t upper = bucketUpperBound(index);
+                result = lower + (upper - lower) / 2;
+            }
+        }
+
+        return result;
+    }
+
+
+    Histogram::Shard* Histogram::threadShard() {
+        std::atomic<Shard*>& shardPointer = shards[threadIndex() & (numberShards - 1)];
+        Shard*               shard        = shardPointer.load(std::memory_order_acquire);
+
+        if (shard == Q_NULLPTR) {
+            Shard* newShard = new Shard;
+            if (shardPointer.compare_exchange_strong(shard, newShard, std::memory_order_acq_rel)) {
+                shard = newShard;
+            } else {
+                delete newShard;
+            }
+        }
+
+        return shard;
+    }
+}
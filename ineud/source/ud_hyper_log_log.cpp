@@ -0,0 +1,169 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::HyperLogLog class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+
+#include "ud_hyper_log_log.h"
+
+namespace Ud {
+    const unsigned HyperLogLog::precision;
+    const unsigned HyperLogLog::numberRegisters;
+
+    HyperLogLog::HyperLogLog() {
+        clear();
+    }
+
+
+    HyperLogLog::~HyperLogLog() {}
+
+
+    void HyperLogLog::observe(const QString& value) {
+        observe(value.toUtf8());
+    }
+
+
+    void HyperLogLog::observe(const QByteArray& value) {
+        observeHash(hash(value.constData(), static_cast<unsigned long>(value.size())));
+    }
+
+
+    QByteArray HyperLogLog::registerData() const {
+        QByteArray result(numberRegisters, '\0');
+        std::uint8_t* data = reinterpret_cast<std::uint8_t*>(result.data());
+        for (unsigned i=0 ; i<numberRegisters ; ++i) {
+            data[i] = registers[i].load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+
+    void HyperLogLog::merge(const QByteArray& data) {
+        if (static_cast<unsigned>(data.size()) == numberRegisters) {
+            // The maximum is taken on a snapshot in bulk so that only registers that grow need an atomic update.
+            QByteArray    snapshot = registerData();
+            QByteArray    merged   = snapshot;
+            std::uint8_t* target   = reinterpret_cast<std::uint8_t*>(merged.data());
+
+            mergeRegisters(target, reinterpret_cast<const std::uint8_t*>(data.constData()), numberRegisters);
+
+            const std::uint8_t* original = reinterpret_cast<const std::uint8_t*>(snapshot.constData());
+            for (unsigned i=0 ; i<numberRegisters ; ++i) {
+                if (target[i] != original[i]) {
+                    std::uint8_t rank    = target[i];
+                    std::uint8_t current = registers[i].load(std::memory_order_relaxed);
+                    while (rank > current
+                           && !registers[i].compare_exchange_weak(current, rank, std::memory_order_relaxed)) {}
+                }
+            }
+        }
+    }
+
+
+    void HyperLogLog::subtract(const QByteArray& data) {
+        if (static_cast<unsigned>(data.size()) == numberRegisters) {
+            const std::uint8_t* source = reinterpret_cast<const std::uint8_t*>(data.constData());
+            for (unsigned i=0 ; i<numberRegisters ; ++i) {
+                std::uint8_t expected = source[i];
+                if (expected != 0) {
+                    registers[i].compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+
+    void HyperLogLog::clear() {
+        for (unsigned i=0 ; i<numberRegisters ; ++i) {
+            registers[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+
+    double HyperLogLog::estimate() const {
+        return estimate(registerData());
+    }
+
+
+    double HyperLogLog::estimate(const QByteArray& data) {
+        double result = 0;
+
+        if (static_cast<unsigned>(data.size()) == numberRegisters) {
+            const std::uint8_t* source = reinterpret_cast<const std::uint8_t*>(data.constData());
+
+            double   sum        = 0;
+            unsigned zeroValues = 0;
+            for (unsigned i=0 ; i<numberRegisters ; ++i) {
+                sum += std::ldexp(1.0, -static_cast<int>(source[i]));
+                if (source[i] == 0) {
+                    ++zeroValues;
+                }
+            }
+
+            double m     = static_cast<double>(numberRegisters);
+            double alpha = 0.7213 / (1.0 + 1.079 / m);
+
+            result = alpha * m * m / sum;
+            if (result <= 2.5 * m && zeroValues != 0) {
+                // Linear counting is more accurate for small cardinalities.
+                result = m * std::log(m / zeroValues);
+            }
+        }
+
+        return result;
+    }
+
+
+    void HyperLogLog::mergeRegisters(std::uint8_t* target, const std::uint8_t* source, unsigned count) {
+        for (unsigned i=0 ; i<count ; ++i) {
+            target[i] = target[i] > source[i] ? target[i] : source[i];
+        }
+    }
+
+
+    std::uint64_t HyperLogLog::hash(const char* data, unsigned long length) {
+        // FNV-1a followed by the MurmurHash3 finalizer so that every output bit depends on every input bit.
+        std::uint64_t result = 0xCBF29CE484222325ULL;
+        for (unsigned long i=0 ; i<length ; ++i) {
+            result = (result ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ULL;
+        }
+
+        result ^= result >> 33;
+        result *= 0xFF51AFD7ED558CCDULL;
+        result ^= result >> 33;
+        result *= 0xC4CEB9FE1A85EC53ULL;
+        result ^= result >> 33;
+
+        return result;
+    }
+}
@@ -0,0 +1,172 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+*
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::KeyRegistry class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#include <cstdint>
+
+#include "ud_key_registry.h"
+
+namespace {
+    /**
+     * Structure holding the registry state.
+     */
+    struct Registry {
+        Registry() {
+            names.append(QString());
+        }
+
+        /**
+         * Assigns a slot to a name.  The write lock must be held.
+         *
+         * \param[in] name The name to assign a slot to.
+         *
+         * \return Returns the assigned slot.
+         */
+        Ud::KeyRegistry::Slot assign(const QString& name) {
+            Ud::KeyRegistry::Slot result = slotsByName.value(name, Ud::KeyRegistry::invalidSlot);
+            Ud::KeyRegistry::Slot nextSlot = static_cast<Ud::KeyRegistry::Slot>(names.size());
+            if (result == Ud::KeyRegistry::invalidSlot && nextSlot < Ud::KeyRegistry::maximumSlots) {
+                result = nextSlot;
+                names.append(name);
+                slotsByName.insert(name, result);
+            }
+
+            return result;
+        }
+
+        /**
+         * Lock protecting the registry.  Lookups take a shared lock so readers never block each other.
+         */
+        QReadWriteLock lock;
+
+        /**
+         * Hash mapping names to slots.
+         */
+        QHash<QString, Ud::KeyRegistry::Slot> slotsByName;
+
+        /**
+         * Hash mapping compile-time name hashes to slots.
+         */
+        QHash<std::uint64_t, Ud::KeyRegistry::Slot> slotsByHash;
+
+        /**
+         * Vector mapping slots to names.
+         */
+        QVector<QString> names;
+    };
+
+    /**
+     * Obtains the registry state.  The state is constructed on first use so that static keys can be registered from
+     * static initializers.
+     *
+     * \return Returns the registry state.
+     */
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+}
+
+namespace Ud {
+    const KeyRegistry::Slot KeyRegistry::maximumSlots;
+    const KeyRegistry::Slot KeyRegistry::reservedSlot;
+    const KeyRegistry::Slot KeyRegistry::invalidSlot;
+
+    KeyRegistry::Slot KeyRegistry::slot(const QString& name) {
+        Slot result = find(name);
+
+        if (result == invalidSlot) {
+            Registry&    state = registry();
+            QWriteLocker locker(&state.lock);
+
+            result = state.assign(name);
+        }
+
+        return result;
+    }
+
+
+    KeyRegistry::Slot KeyRegistry::staticSlot(const char* name, std::uint64_t nameHash) {
+        Registry& state    = registry();
+        QString   nameText = QString::fromUtf8(name);
+        Slot      result;
+
+        {
+            QReadLocker locker(&state.lock);
+
+            result = state.slotsByHash.value(nameHash, invalidSlot);
+            if (result != invalidSlot && state.names.at(result) != nameText) {
+                result = invalidSlot;
+            }
+        }
+
+        if (result == invalidSlot) {
+            QWriteLocker locker(&state.lock);
+
+            result = state.slotsByHash.value(nameHash, invalidSlot);
+            if (result == invalidSlot || state.names.at(result) != nameText) {
+                result = state.assign(nameText);
+                if (result != invalidSlot && !state.slotsByHash.contains(nameHash)) {
+                    state.slotsByHash.insert(nameHash, result);
+                }
+            }
+        }
+
+        return result;
+    }
+
+
+    KeyRegistry::Slot KeyRegistry::find(const QString& name) {
+        Registry&   state = registry();
+        QReadLocker locker(&state.lock);
+
+        return state.slotsByName.value(name, invalidSlot);
+    }
+
+
+    QString KeyRegistry::name(KeyRegistry::Slot slot) {
+        Registry&   state = registry();
+        QReadLocker locker(&state.lock);
+
+        return slot < static_cast<Slot>(state.names.size()) ? state.names.at(slot) : QString();
+    }
+
+
+    QVector<QString> KeyRegistry::names() {
+        Registry&   state = registry();
+        QReadLocker locker(&state.lock);
+
+        return state.names;
+    }
+}
@@ -0,0 +1,221 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::PayloadTransport class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QtGlobal>
+#include <QByteArray>
+#include <QUrl>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QCryptographicHash>
+#include <QMessageAuthenticationCode>
+
+#include <cstdint>
+
+#include "ud_payload_transport.h"
+
+namespace Ud {
+    const char PayloadTransport::timestampHeader[] = "X-Inesonic-Timestamp";
+    const char PayloadTransport::signatureHeader[] = "X-Inesonic-Signature";
+    const int  PayloadTransport::compressionLevel = 6;
+
+    PayloadTransport::PayloadTransport(
+            QNetworkAccessManager* networkAccessManager,
+            const QByteArray&      sharedSecret,
+            QObject*               parent
+        ):QObject(
+            parent
+        ) {
+        currentNetworkAccessManager = networkAccessManager;
+        currentSharedSecret         = sharedSecret;
+        currentCompression          = Compression::NONE;
+    }
+
+
+    PayloadTransport::~PayloadTransport() {}
+
+
+    PayloadTransport::Compression PayloadTransport::compression() const {
+        return currentCompression;
+    }
+
+
+    void PayloadTransport::setCompression(PayloadTransport::Compression newCompression) {
+        currentCompression = newCompression;
+    }
+
+
+    void PayloadTransport::send(const QUrl& url, const QByteArray& payload, const QByteArray& contentType) {
+        post(url, prepare(payload, contentType, currentCompression, currentSharedSecret));
+    }
+
+
+    void PayloadTransport::post(const QUrl& url, const PayloadTransport::Request& request) {
+        QNetworkRequest networkRequest(url);
+        networkRequest.setHeader(QNetworkRequest::ContentTypeHeader, request.contentType);
+        if (!request.contentEncoding.isEmpty()) {
+            networkRequest.setRawHeader("Content-Encoding", request.contentEncoding);
+        }
+
+        networkRequest.setRawHeader(timestampHeader, request.timestamp);
+        networkRequest.setRawHeader(signatureHeader, request.signature);
+
+        QNetworkReply* reply = currentNetworkAccessManager->post(networkRequest, request.body);
+        connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+            processReply(reply);
+        });
+    }
+
+
+    PayloadTransport::Request PayloadTransport::prepare(
+            const QByteArray&             payload,
+            const QByteArray&             contentType,
+            PayloadTransport::Compression compression,
+            const QByteArray&             sharedSecret
+        ) {
+        Request result;
+
+        result.contentType     = contentType;
+        result.contentEncoding = contentEncoding(compression);
+        result.timestamp       = QByteArray::number(QDateTime::currentSecsSinceEpoch());
+        result.body            = compress(payload, compression);
+        result.signature       = signature(sharedSecret, result.timestamp, result.body);
+
+        return result;
+    }
+
+
+    QByteArray PayloadTransport::compress(const QByteArray& body, PayloadTransport::Compression compression) {
+        QByteArray result;
+
+        if (compression == Compression::DEFLATE) {
+            // qCompress prefixes the zlib stream with the uncompressed length, which is not part of the encoding.
+            result = qCompress(body, compressionLevel).mid(4);
+        } else {
+            result = body;
+        }
+
+        return result;
+    }
+
+
+    QByteArray PayloadTransport::decompress(
+            const QByteArray&             body,
+            PayloadTransport::Compression compression,
+            bool*                         ok
+        ) {
+        QByteArray result;
+        bool       success;
+
+        if (compression == Compression::DEFLATE && !body.isEmpty()) {
+            // qUncompress treats the length prefix as a hint and grows its buffer as needed.
+            std::uint32_t sizeHint = static_cast<std::uint32_t>(qMin(4LL * body.size(), 1LL << 24));
+
+            QByteArray prefixed;
+            prefixed.reserve(body.size() + 4);
+            prefixed.append(static_cast<char>(sizeHint >> 24));
+            prefixed.append(static_cast<char>(sizeHint >> 16));
+            prefixed.append(static_cast<char>(sizeHint >>  8));
+            prefixed.append(static_cast<char>(sizeHint      ));
+            prefixed.append(body);
+
+            result  = qUncompress(prefixed);
+            success = !result.isEmpty();
+        } else {
+            result  = body;
+            success = true;
+        }
+
+        if (ok != Q_NULLPTR) {
+            *ok = success;
+        }
+
+        return result;
+    }
+
+
+    QByteArray PayloadTransport::contentEncoding(PayloadTransport::Compression compression) {
+        return compression == Compression::DEFLATE ? QByteArray("deflate") : QByteArray();
+    }
+
+
+    PayloadTransport::Compression PayloadTransport::compressionForEncoding(const QByteArray& encoding, bool* ok) {
+        Compression result  = Compression::NONE;
+        bool        success = true;
+
+        QByteArray normalized = encoding.trimmed().toLower();
+        if (normalized == "deflate") {
+            result = Compression::DEFLATE;
+        } else if (!normalized.isEmpty() && normalized != "identity") {
+            success = false;
+        }
+
+        if (ok != Q_NULLPTR) {
+            *ok = success;
+        }
+
+        return result;
+    }
+
+
+    QByteArray PayloadTransport::signature(
+            const QByteArray& sharedSecret,
+            const QByteArray& timestamp,
+            const QByteArray& body
+        ) {
+        QMessageAuthenticationCode code(QCryptographicHash::Sha256, sharedSecret);
+        code.addData(timestamp);
+        code.addData(".", 1);
+        code.addData(body);
+
+        return code.result().toHex();
+    }
+
+
+    void PayloadTransport::processReply(QNetworkReply* reply) {
+        QNetworkReply::NetworkError networkError = reply->error();
+
+        if (networkError == QNetworkReply::NoError) {
+            QJsonParseError parseError;
+            QJsonDocument   response = QJsonDocument::fromJson(reply->readAll(), &parseError);
+
+            if (parseError.error == QJsonParseError::NoError) {
+                emit responseReceived(response);
+            } else {
+                // Reported as a protocol failure so it is not mistaken for the collector rejecting the body.
+                emit failed(QNetworkReply::ProtocolFailure);
+            }
+        } else {
+            emit failed(networkError);
+        }
+
+        reply->deleteLater();
+    }
+}
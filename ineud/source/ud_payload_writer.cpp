@@ -0,0 +1,359 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::PayloadWriter class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QLocale>
+#include <QJsonValue>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCborStreamWriter>
+
+#include <cstdint>
+#include <cmath>
+
+#include "ud_payload_writer.h"
+
+namespace Ud {
+    PayloadWriter::PayloadWriter(PayloadWriter::Format format, int reservedBytes) {
+        currentFormat = format;
+        keyWritten    = false;
+        targetObject  = Q_NULLPTR;
+
+        if (reservedBytes > 0) {
+            buffer.reserve(reservedBytes);
+        }
+
+        if (format == Format::CBOR) {
+            cborWriter.reset(new QCborStreamWriter(&buffer));
+        }
+    }
+
+
+    PayloadWriter::PayloadWriter(QJsonObject* object) {
+        currentFormat = Format::JSON;
+        keyWritten    = false;
+        targetObject  = object;
+    }
+
+
+    PayloadWriter::~PayloadWriter() {}
+
+
+    PayloadWriter::Format PayloadWriter::format() const {
+        return currentFormat;
+    }
+
+
+    void PayloadWriter::startMap() {
+        if (targetObject != Q_NULLPTR) {
+            containerKeys.append(currentKey);
+            arrayContainers.append(false);
+            openObjects.append(QJsonObject());
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->startMap();
+        } else {
+            separate();
+            buffer.append('{');
+            emptyContainers.append(true);
+        }
+    }
+
+
+    void PayloadWriter::endMap() {
+        if (targetObject != Q_NULLPTR) {
+            QJsonObject object = openObjects.takeLast();
+            arrayContainers.removeLast();
+            currentKey = containerKeys.takeLast();
+
+            if (arrayContainers.isEmpty()) {
+                *targetObject = object;
+            } else {
+                appendValue(object);
+            }
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->endMap();
+        } else {
+            buffer.append('}');
+            emptyContainers.removeLast();
+        }
+    }
+
+
+    void PayloadWriter::startArray() {
+        if (targetObject != Q_NULLPTR) {
+            containerKeys.append(currentKey);
+            arrayContainers.append(true);
+            openArrays.append(QJsonArray());
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->startArray();
+        } else {
+            separate();
+            buffer.append('[');
+            emptyContainers.append(true);
+        }
+    }
+
+
+    void PayloadWriter::endArray() {
+        if (targetObject != Q_NULLPTR) {
+            QJsonArray array = openArrays.takeLast();
+            arrayContainers.removeLast();
+            currentKey = containerKeys.takeLast();
+
+            appendValue(array);
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->endArray();
+        } else {
+            buffer.append(']');
+            emptyContainers.removeLast();
+        }
+    }
+
+
+    void PayloadWriter::writeKey(const QString& key) {
+        if (targetObject != Q_NULLPTR) {
+            currentKey = key;
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(key);
+        } else {
+            separate();
+            writeQuoted(key);
+            buffer.append(':');
+            keyWritten = true;
+        }
+    }
+
+
+    void PayloadWriter::writeUnsigned(std::uint64_t value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(static_cast<double>(value));
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(static_cast<quint64>(value));
+        } else {
+            separate();
+            buffer.append(QByteArray::number(static_cast<qulonglong>(value)));
+        }
+    }
+
+
+    void PayloadWriter::writeInteger(std::int64_t value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(static_cast<double>(value));
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(static_cast<qint64>(value));
+        } else {
+            separate();
+            buffer.append(QByteArray::number(static_cast<qlonglong>(value)));
+        }
+    }
+
+
+    void PayloadWriter::writeDouble(double value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(std::isfinite(value) ? QJsonValue(value) : QJsonValue());
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(value);
+        } else {
+            separate();
+            if (std::isfinite(value)) {
+                buffer.append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+            } else {
+                buffer.append("null");
+            }
+        }
+    }
+
+
+    void PayloadWriter::writeBoolean(bool value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(value);
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(value);
+        } else {
+            separate();
+            buffer.append(value ? "true" : "false");
+        }
+    }
+
+
+    void PayloadWriter::writeString(const QString& value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(value);
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(value);
+        } else {
+            separate();
+            writeQuoted(value);
+        }
+    }
+
+
+    void PayloadWriter::writeBytes(const QByteArray& value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(QString::fromLatin1(value.toBase64()));
+        } else if (currentFormat == Format::CBOR) {
+            cborWriter->append(value);
+        } else {
+            separate();
+            buffer.append('"');
+            buffer.append(value.toBase64());
+            buffer.append('"');
+        }
+    }
+
+
+    void PayloadWriter::writeJson(const QJsonValue& value) {
+        if (targetObject != Q_NULLPTR) {
+            appendValue(value);
+        } else {
+            switch (value.type()) {
+                case QJsonValue::Bool: {
+                    writeBoolean(value.toBool());
+                    break;
+                }
+
+                case QJsonValue::Double: {
+                    double number = value.toDouble();
+                    if (std::trunc(number) == number && std::fabs(number) < 9007199254740992.0) {
+                        writeInteger(static_cast<std::int64_t>(number));
+                    } else {
+                        writeDouble(number);
+                    }
+
+                    break;
+                }
+
+                case QJsonValue::String: {
+                    writeString(value.toString());
+                    break;
+                }
+
+                case QJsonValue::Array: {
+                    QJsonArray array = value.toArray();
+
+                    startArray();
+                    for (auto it=array.constBegin(),end=array.constEnd() ; it!=end ; ++it) {
+                        writeJson(*it);
+                    }
+                    endArray();
+
+                    break;
+                }
+
+                case QJsonValue::Object: {
+                    QJsonObject object = value.toObject();
+
+                    startMap();
+                    for (auto it=object.constBegin(),end=object.constEnd() ; it!=end ; ++it) {
+                        writeKey(it.key());
+                        writeJson(it.value());
+                    }
+                    endMap();
+
+                    break;
+                }
+
+                case QJsonValue::Null:
+                case QJsonValue::Undefined: {
+                    if (currentFormat == Format::CBOR) {
+                        cborWriter->appendNull();
+                    } else {
+                        separate();
+                        buffer.append("null");
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+
+
+    const QByteArray& PayloadWriter::data() const {
+        return buffer;
+    }
+
+
+    void PayloadWriter::separate() {
+        if (keyWritten) {
+            keyWritten = false;
+        } else if (!emptyContainers.isEmpty()) {
+            bool& empty = emptyContainers.last();
+            if (empty) {
+                empty = false;
+            } else {
+                buffer.append(',');
+            }
+        }
+    }
+
+
+    void PayloadWriter::writeQuoted(const QString& value) {
+        static const char hexDigits[] = "0123456789abcdef";
+
+        QByteArray utf8 = value.toUtf8();
+
+        buffer.append('"');
+        for (const char* it=utf8.constData(),*end=it + utf8.size() ; it!=end ; ++it) {
+            unsigned char c = static_cast<unsigned char>(*it);
+            switch (c) {
+                case '"':  { buffer.append("\\\"");   break; }
+                case '\\': { buffer.append("\\\\");   break; }
+                case '\b': { buffer.append("\\b");    break; }
+                case '\f': { buffer.append("\\f");    break; }
+                case '\n': { buffer.append("\\n");    break; }
+                case '\r': { buffer.append("\\r");    break; }
+                case '\t': { buffer.append("\\t");    break; }
+                default: {
+                    if (c < 0x20) {
+                        buffer.append("\\u00");
+                        buffer.append(hexDigits[c >> 4]);
+                        buffer.append(hexDigits[c & 0x0F]);
+                    } else {
+                        buffer.append(static_cast<char>(c));
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        buffer.append('"');
+    }
+
+
+    void PayloadWriter::appendValue(const QJsonValue& value) {
+        if (arrayContainers.last()) {
+            openArrays.last().append(value);
+        } else {
+            openObjects.last().insert(currentKey, value);
+        }
+    }
+}
@@ -0,0 +1,272 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::QuantileSketch class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <cstdint>
+#include <cmath>
+
+#include "ud_quantile_sketch.h"
+
+namespace Ud {
+    const double   QuantileSketch::defaultRelativeAccuracy = 0.01;
+    const unsigned QuantileSketch::defaultMaximumBins      = 512;
+
+    QuantileSketch::QuantileSketch(double relativeAccuracy, unsigned maximumBins) {
+        Q_ASSERT(relativeAccuracy > 0 && relativeAccuracy < 1);
+        Q_ASSERT(maximumBins > 0);
+
+        currentRelativeAccuracy = relativeAccuracy;
+        currentMaximumBins      = maximumBins;
+        gamma                   = (1.0 + relativeAccuracy) / (1.0 - relativeAccuracy);
+        inverseLogGamma         = 1.0 / std::log(gamma);
+        minimumIndex            = 0;
+        zeroCount               = 0;
+        totalCount              = 0;
+    }
+
+
+    QuantileSketch::QuantileSketch(const QuantileSketch& other) {
+        QMutexLocker locker(&other.mutex);
+
+        currentRelativeAccuracy = other.currentRelativeAccuracy;
+        currentMaximumBins      = other.currentMaximumBins;
+        gamma                   = other.gamma;
+        inverseLogGamma         = other.inverseLogGamma;
+        minimumIndex            = other.minimumIndex;
+        counts                  = other.counts;
+        zeroCount               = other.zeroCount;
+        totalCount              = other.totalCount;
+    }
+
+
+    QuantileSketch::~QuantileSketch() {}
+
+
+    double QuantileSketch::relativeAccuracy() const {
+        return currentRelativeAccuracy;
+    }
+
+
+    unsigned QuantileSketch::maximumBins() const {
+        return currentMaximumBins;
+    }
+
+
+    void QuantileSketch::record(std::uint64_t value, std::uint64_t count) {
+        QMutexLocker locker(&mutex);
+
+        if (value == 0) {
+            zeroCount += count;
+        } else {
+            counts[position(binIndex(value))] += count;
+        }
+
+        totalCount += count;
+    }
+
+
+    std::uint64_t QuantileSketch::count() const {
+        QMutexLocker locker(&mutex);
+        return totalCount;
+    }
+
+
+    double QuantileSketch::valueAtQuantile(double quantile) const {
+        QMutexLocker locker(&mutex);
+
+        double result = 0;
+        if (totalCount > 0) {
+            double        clampedQuantile = qBound(0.0, quantile, 1.0);
+            std::uint64_t rank            = static_cast<std::uint64_t>(clampedQuantile * (totalCount - 1)) + 1;
+
+            if (rank > zeroCount) {
+                std::uint64_t cumulative = zeroCount;
+                unsigned      index      = 0;
+                unsigned      numberBins = static_cast<unsigned>(counts.size());
+                while (index < numberBins && cumulative + counts.at(index) < rank) {
+                    cumulative += counts.at(index);
+                    ++index;
+                }
+
+                result = binValue(minimumIndex + static_cast<int>(qMin(index, numberBins - 1)));
+            }
+        }
+
+        return result;
+    }
+
+
+    void QuantileSketch::merge(const QuantileSketch& other) {
+        QuantileSketch otherCopy(other);
+        Q_ASSERT(otherCopy.gamma == gamma);
+
+        QMutexLocker locker(&mutex);
+
+        unsigned numberBins = static_cast<unsigned>(otherCopy.counts.size());
+        for (unsigned i=0 ; i<numberBins ; ++i) {
+            std::uint64_t count = otherCopy.counts.at(i);
+            if (count != 0) {
+                counts[position(otherCopy.minimumIndex + static_cast<int>(i))] += count;
+            }
+        }
+
+        zeroCount  += otherCopy.zeroCount;
+        totalCount += otherCopy.totalCount;
+    }
+
+
+    void QuantileSketch::subtract(const QuantileSketch& other) {
+        QuantileSketch otherCopy(other);
+        Q_ASSERT(otherCopy.gamma == gamma);
+
+        QMutexLocker locker(&mutex);
+
+        int      maximumIndex = minimumIndex + counts.size() - 1;
+        unsigned numberBins   = static_cast<unsigned>(otherCopy.counts.size());
+        for (unsigned i=0 ; i<numberBins ; ++i) {
+            std::uint64_t count = otherCopy.counts.at(i);
+            int           index = otherCopy.minimumIndex + static_cast<int>(i);
+            if (count != 0 && index <= maximumIndex) {
+                // Bins collapsed since the copy was made were folded into our lowest bin.
+                std::uint64_t& binCount = counts[qMax(index, minimumIndex) - minimumIndex];
+                std::uint64_t  removed  = qMin(count, binCount);
+
+                binCount   -= removed;
+                totalCount -= removed;
+            }
+        }
+
+        std::uint64_t removedZeros = qMin(otherCopy.zeroCount, zeroCount);
+        zeroCount  -= removedZeros;
+        totalCount -= removedZeros;
+    }
+
+
+    void QuantileSketch::clear() {
+        QMutexLocker locker(&mutex);
+
+        minimumIndex = 0;
+        counts.clear();
+        zeroCount  = 0;
+        totalCount = 0;
+    }
+
+
+    QJsonObject QuantileSketch::toJson() const {
+        QMutexLocker locker(&mutex);
+
+        int first = 0;
+        int last  = counts.size() - 1;
+        while (first <= last && counts.at(first) == 0) {
+            ++first;
+        }
+
+        while (last >= first && counts.at(last) == 0) {
+            --last;
+        }
+
+        QJsonArray binCounts;
+        for (int i=first ; i<=last ; ++i) {
+            binCounts.append(static_cast<double>(counts.at(i)));
+        }
+
+        QJsonObject result;
+        result.insert("relative_accuracy", currentRelativeAccuracy);
+        result.insert("zero_count", static_cast<double>(zeroCount));
+        result.insert("offset", first <= last ? minimumIndex + first : 0);
+        result.insert("counts", binCounts);
+
+        return result;
+    }
+
+
+    QuantileSketch& QuantileSketch::operator=(const QuantileSketch& other) {
+        if (&other != this) {
+            QuantileSketch otherCopy(other);
+            QMutexLocker   locker(&mutex);
+
+            currentRelativeAccuracy = otherCopy.currentRelativeAccuracy;
+            currentMaximumBins      = otherCopy.currentMaximumBins;
+            gamma                   = otherCopy.gamma;
+            inverseLogGamma         = otherCopy.inverseLogGamma;
+            minimumIndex            = otherCopy.minimumIndex;
+            counts                  = otherCopy.counts;
+            zeroCount               = otherCopy.zeroCount;
+            totalCount              = otherCopy.totalCount;
+        }
+
+        return *this;
+    }
+
+
+    int QuantileSketch::binIndex(std::uint64_t value) const {
+        return static_cast<int>(std::ceil(std::log(static_cast<double>(value)) * inverseLogGamma));
+    }
+
+
+    double QuantileSketch::binValue(int index) const {
+        return 2.0 * std::pow(gamma, index) / (gamma + 1.0);
+    }
+
+
+    unsigned QuantileSketch::position(int index) {
+        unsigned result;
+
+        if (counts.isEmpty()) {
+            minimumIndex = index;
+            counts.append(0);
+            result = 0;
+        } else {
+            int maximumIndex = minimumIndex + counts.size() - 1;
+            if (index >= minimumIndex && index <= maximumIndex) {
+                result = static_cast<unsigned>(index - minimumIndex);
+            } else {
+                int limit        = static_cast<int>(currentMaximumBins);
+                int newMaximum   = qMax(index, maximumIndex);
+                int newMinimum   = qMax(qMin(index, minimumIndex), newMaximum - limit + 1);
+
+                // The lowest bins are collapsed so the upper quantiles, typically the tail latencies, stay accurate.
+                QVector<std::uint64_t> newCounts(newMaximum - newMinimum + 1, 0);
+                for (int i=0 ; i<counts.size() ; ++i) {
+                    newCounts[qMax(minimumIndex + i, newMinimum) - newMinimum] += counts.at(i);
+                }
+
+                counts       = newCounts;
+                minimumIndex = newMinimum;
+                result       = static_cast<unsigned>(qMax(index, newMinimum) - newMinimum);
+            }
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,363 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::ReportSpool class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileInfoList>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QMessageAuthenticationCode>
+
+#include <cstdint>
+
+#include "ud_payload_writer.h"
+#include "ud_report_spool.h"
+
+namespace {
+    /**
+     * Bytes placed at the start of every spool file.  The last byte is the spool file format version.
+     */
+    const char spoolMagic[] = { 'U', 'D', 'S', '\x01' };
+
+    /**
+     * The length of the spool file header, in bytes.  The header holds the magic bytes, an 8-bit format, a 64-bit
+     * creation time in milliseconds since the epoch, and a 32-bit payload length.
+     */
+    const int headerLength = static_cast<int>(sizeof(spoolMagic)) + 1 + 8 + 4;
+
+    /**
+     * The length of the seal, in bytes.
+     */
+    const int sealLength = 32;
+
+    /**
+     * Appends a little-endian unsigned value to a buffer.
+     *
+     * \param[in,out] buffer      The buffer to append to.
+     *
+     * \param[in]     value       The value to append.
+     *
+     * \param[in]     numberBytes The number of bytes to append.
+     */
+    void appendValue(QByteArray& buffer, std::uint64_t value, unsigned numberBytes) {
+        for (unsigned i=0 ; i<numberBytes ; ++i) {
+            buffer.append(static_cast<char>(static_cast<std::uint8_t>(value >> (8 * i))));
+        }
+    }
+
+    /**
+     * Reads a little-endian unsigned value from a buffer.
+     *
+     * \param[in] data        Pointer to the first byte of the value.
+     *
+     * \param[in] numberBytes The number of bytes to read.
+     *
+     * \return Returns the value.
+     */
+    std::uint64_t readValue(const char* data, unsigned numberBytes) {
+        std::uint64_t result = 0;
+        for (unsigned i=0 ; i<numberBytes ; ++i) {
+            result |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[i])) << (8 * i);
+        }
+
+        return result;
+    }
+}
+
+namespace Ud {
+    const qint64   ReportSpool::defaultMaximumBytes = 4 * 1024 * 1024;
+    const unsigned ReportSpool::defaultMaximumEntries = 64;
+    const unsigned ReportSpool::defaultMaximumFailures = 4;
+    const char     ReportSpool::fileSuffix[] = ".udspool";
+
+    ReportSpool::ReportSpool(const QString& directory, const QByteArray& sealKey) {
+        currentSealKey         = sealKey;
+        currentMaximumBytes    = defaultMaximumBytes;
+        currentMaximumEntries  = defaultMaximumEntries;
+        currentMaximumFailures = defaultMaximumFailures;
+        sequenceNumber         = 0;
+
+        setDirectory(directory);
+    }
+
+
+    ReportSpool::~ReportSpool() {}
+
+
+    QString ReportSpool::directory() const {
+        return currentDirectory;
+    }
+
+
+    void ReportSpool::setDirectory(const QString& newDirectory) {
+        currentDirectory = newDirectory;
+
+        if (!newDirectory.isEmpty()) {
+            QDir().mkpath(newDirectory);
+        }
+    }
+
+
+    void ReportSpool::setSealKey(const QByteArray& newSealKey) {
+        currentSealKey = newSealKey;
+    }
+
+
+    bool ReportSpool::isEnabled() const {
+        return !currentDirectory.isEmpty();
+    }
+
+
+    qint64 ReportSpool::maximumBytes() const {
+        return currentMaximumBytes;
+    }
+
+
+    void ReportSpool::setMaximumBytes(qint64 newMaximumBytes) {
+        currentMaximumBytes = newMaximumBytes;
+        evict();
+    }
+
+
+    unsigned ReportSpool::maximumEntries() const {
+        return currentMaximumEntries;
+    }
+
+
+    void ReportSpool::setMaximumEntries(unsigned newMaximumEntries) {
+        currentMaximumEntries = newMaximumEntries;
+        evict();
+    }
+
+
+    unsigned ReportSpool::maximumFailures() const {
+        return currentMaximumFailures;
+    }
+
+
+    void ReportSpool::setMaximumFailures(unsigned newMaximumFailures) {
+        currentMaximumFailures = newMaximumFailures;
+    }
+
+
+    bool ReportSpool::add(const QByteArray& payload, PayloadWriter::Format format) {
+        bool success = false;
+
+        qint64 fileSize = headerLength + payload.size() + sealLength;
+        if (isEnabled() && fileSize <= currentMaximumBytes && currentMaximumEntries > 0) {
+            qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+            QByteArray contents(spoolMagic, static_cast<int>(sizeof(spoolMagic)));
+            contents.reserve(static_cast<int>(fileSize));
+            appendValue(contents, static_cast<std::uint8_t>(format), 1);
+            appendValue(contents, static_cast<std::uint64_t>(now), 8);
+            appendValue(contents, static_cast<std::uint32_t>(payload.size()), 4);
+            contents.append(payload);
+            contents.append(seal(contents));
+
+            // Names sort in the order the reports were spooled.
+            QString filename = QString("%1-%2-%3%4")
+                               .arg(now, 16, 10, QChar('0'))
+                               .arg(QCoreApplication::applicationPid())
+                               .arg(sequenceNumber++, 8, 10, QChar('0'))
+                               .arg(QString::fromLatin1(fileSuffix));
+
+            QSaveFile file(QDir(currentDirectory).filePath(filename));
+            success = file.open(QFile::WriteOnly);
+            if (success) {
+                success = (file.write(contents) == contents.size() && file.commit());
+            }
+
+            if (success) {
+                evict();
+            }
+        }
+
+        return success;
+    }
+
+
+    QList<ReportSpool::Entry> ReportSpool::entries(PayloadWriter::Format format, unsigned maximumEntries) {
+        QList<Entry> result;
+
+        if (isEnabled()) {
+            QFileInfoList spoolFiles = files();
+            auto          it         = spoolFiles.constBegin();
+            auto          end        = spoolFiles.constEnd();
+            while (it != end && static_cast<unsigned>(result.size()) < maximumEntries) {
+                QString    filename = it->absoluteFilePath();
+                QByteArray contents;
+
+                QFile file(filename);
+                if (file.open(QFile::ReadOnly)) {
+                    contents = file.readAll();
+                    file.close();
+                }
+
+                bool valid = (
+                       contents.size() >= headerLength + sealLength
+                    && contents.startsWith(QByteArray(spoolMagic, static_cast<int>(sizeof(spoolMagic))))
+                );
+
+                int                   payloadLength = 0;
+                PayloadWriter::Format entryFormat   = PayloadWriter::Format::JSON;
+                if (valid) {
+                    const char* header = contents.constData() + sizeof(spoolMagic);
+                    entryFormat   = static_cast<PayloadWriter::Format>(readValue(header, 1));
+                    payloadLength = static_cast<int>(readValue(header + 9, 4));
+
+                    valid = (
+                           payloadLength == contents.size() - headerLength - sealLength
+                        && seal(contents.left(headerLength + payloadLength)) == contents.right(sealLength)
+                    );
+                }
+
+                if (!valid) {
+                    QFile::remove(filename);
+                    failureCounts.remove(filename);
+                } else if (entryFormat == format) {
+                    Entry entry;
+                    entry.filename = filename;
+                    entry.payload  = contents.mid(headerLength, payloadLength);
+
+                    result.append(entry);
+                }
+
+                ++it;
+            }
+        }
+
+        return result;
+    }
+
+
+    void ReportSpool::remove(const QStringList& filenames) {
+        for (auto it=filenames.constBegin(),end=filenames.constEnd() ; it!=end ; ++it) {
+            QFile::remove(*it);
+            failureCounts.remove(*it);
+        }
+    }
+
+
+    unsigned ReportSpool::recordFailure(const QStringList& filenames) {
+        unsigned numberRemoved = 0;
+
+        for (auto it=filenames.constBegin(),end=filenames.constEnd() ; it!=end ; ++it) {
+            unsigned& failures = failureCounts[*it];
+            ++failures;
+
+            if (currentMaximumFailures > 0 && failures >= currentMaximumFailures) {
+                QFile::remove(*it);
+                failureCounts.remove(*it);
+                ++numberRemoved;
+            }
+        }
+
+        return numberRemoved;
+    }
+
+
+    unsigned ReportSpool::numberEntries() const {
+        return isEnabled() ? static_cast<unsigned>(files().size()) : 0;
+    }
+
+
+    QByteArray ReportSpool::combine(const QList<QByteArray>& payloads, PayloadWriter::Format format) {
+        QByteArray result;
+
+        int size = 2 + payloads.size();
+        for (auto it=payloads.constBegin(),end=payloads.constEnd() ; it!=end ; ++it) {
+            size += it->size();
+        }
+
+        result.reserve(size);
+
+        if (format == PayloadWriter::Format::CBOR) {
+            result.append('\x9F'); // Start of an indefinite length array.
+            for (auto it=payloads.constBegin(),end=payloads.constEnd() ; it!=end ; ++it) {
+                result.append(*it);
+            }
+            result.append('\xFF'); // Break.
+        } else {
+            result.append('[');
+            for (auto it=payloads.constBegin(),end=payloads.constEnd() ; it!=end ; ++it) {
+                if (it != payloads.constBegin()) {
+                    result.append(',');
+                }
+
+                result.append(*it);
+            }
+            result.append(']');
+        }
+
+        return result;
+    }
+
+
+    QFileInfoList ReportSpool::files() const {
+        QStringList nameFilters;
+        nameFilters << (QString("*") + QString::fromLatin1(fileSuffix));
+
+        return QDir(currentDirectory).entryInfoList(nameFilters, QDir::Files, QDir::Name);
+    }
+
+
+    void ReportSpool::evict() {
+        if (isEnabled()) {
+            QFileInfoList spoolFiles = files();
+
+            qint64 totalBytes = 0;
+            for (auto it=spoolFiles.constBegin(),end=spoolFiles.constEnd() ; it!=end ; ++it) {
+                totalBytes += it->size();
+            }
+
+            unsigned numberFiles = static_cast<unsigned>(spoolFiles.size());
+            auto     it          = spoolFiles.constBegin();
+            while (numberFiles > currentMaximumEntries || totalBytes > currentMaximumBytes) {
+                QFile::remove(it->absoluteFilePath());
+                failureCounts.remove(it->absoluteFilePath());
+                totalBytes -= it->size();
+                --numberFiles;
+                ++it;
+            }
+        }
+    }
+
+
+    QByteArray ReportSpool::seal(const QByteArray& contents) const {
+        return QMessageAuthenticationCode::hash(contents, currentSealKey, QCryptographicHash::Sha256);
+    }
+}
@@ -0,0 +1,142 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::RetryPolicy class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QRandomGenerator>
+
+#include <cstdint>
+
+#include "ud_retry_policy.h"
+
+namespace Ud {
+    const unsigned long long RetryPolicy::defaultBaseDelay = 60;
+    const unsigned long long RetryPolicy::defaultMaximumDelay = 30 * 60;
+    const unsigned           RetryPolicy::defaultFailureThreshold = 8;
+    const unsigned long long RetryPolicy::defaultOpenPeriod = 24 * 60 * 60;
+
+    RetryPolicy::RetryPolicy() {
+        currentBaseDelay           = defaultBaseDelay;
+        currentMaximumDelay        = defaultMaximumDelay;
+        currentFailureThreshold    = defaultFailureThreshold;
+        currentOpenPeriod          = defaultOpenPeriod;
+        currentCircuitState        = CircuitState::CLOSED;
+        currentConsecutiveFailures = 0;
+    }
+
+
+    RetryPolicy::~RetryPolicy() {}
+
+
+    unsigned long long RetryPolicy::baseDelay() const {
+        return currentBaseDelay;
+    }
+
+
+    unsigned long long RetryPolicy::maximumDelay() const {
+        return currentMaximumDelay;
+    }
+
+
+    void RetryPolicy::setDelays(unsigned long long newBaseDelay, unsigned long long newMaximumDelay) {
+        currentBaseDelay    = qMax(newBaseDelay, 1ULL);
+        currentMaximumDelay = qMax(newMaximumDelay, currentBaseDelay);
+    }
+
+
+    unsigned RetryPolicy::failureThreshold() const {
+        return currentFailureThreshold;
+    }
+
+
+    void RetryPolicy::setFailureThreshold(unsigned newFailureThreshold) {
+        currentFailureThreshold = newFailureThreshold;
+    }
+
+
+    unsigned long long RetryPolicy::openPeriod() const {
+        return currentOpenPeriod;
+    }
+
+
+    void RetryPolicy::setOpenPeriod(unsigned long long newOpenPeriod) {
+        currentOpenPeriod = qMax(newOpenPeriod, 1ULL);
+    }
+
+
+    RetryPolicy::CircuitState RetryPolicy::circuitState() const {
+        return currentCircuitState;
+    }
+
+
+    unsigned RetryPolicy::consecutiveFailures() const {
+        return currentConsecutiveFailures;
+    }
+
+
+    void RetryPolicy::attemptStarted() {
+        if (currentCircuitState == CircuitState::OPEN) {
+            currentCircuitState = CircuitState::HALF_OPEN;
+        }
+    }
+
+
+    void RetryPolicy::recordSuccess() {
+        currentCircuitState        = CircuitState::CLOSED;
+        currentConsecutiveFailures = 0;
+    }
+
+
+    unsigned long long RetryPolicy::recordFailure() {
+        unsigned long long result;
+
+        ++currentConsecutiveFailures;
+
+        bool trip = (currentFailureThreshold > 0 && currentConsecutiveFailures >= currentFailureThreshold);
+        if (trip || currentCircuitState == CircuitState::HALF_OPEN) {
+            currentCircuitState = CircuitState::OPEN;
+            result              = uniform((currentOpenPeriod + 1) / 2, currentOpenPeriod);
+        } else {
+            // Doubling stops at the maximum so the ceiling can never overflow.
+            unsigned long long ceiling = currentBaseDelay;
+            unsigned           i       = 1;
+            while (i < currentConsecutiveFailures && ceiling < currentMaximumDelay) {
+                ceiling *= 2;
+                ++i;
+            }
+
+            result = uniform(1, qMin(ceiling, currentMaximumDelay));
+        }
+
+        return result;
+    }
+
+
+    unsigned long long RetryPolicy::uniform(unsigned long long minimum, unsigned long long maximum) {
+        unsigned long long span = maximum - minimum + 1;
+        return minimum + QRandomGenerator::global()->generate64() % span;
+    }
+}
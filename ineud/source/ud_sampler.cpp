@@ -0,0 +1,144 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::Sampler class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#include "ud_sampler.h"
+
+namespace {
+    /**
+     * Counter mixed into each thread's generator seed so threads draw different sequences.
+     */
+    std::atomic<std::uint64_t> nextSeed(0x9E3779B97F4A7C15ULL);
+
+    /**
+     * Calculates a generator seed using the splitmix64 finalizer.
+     *
+     * \return Returns a non-zero seed.
+     */
+    std::uint64_t newSeed() {
+        std::uint64_t result = nextSeed.fetch_add(0x9E3779B97F4A7C15ULL, std::memory_order_relaxed);
+
+        result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        result = (result ^ (result >> 27)) * 0x94D049BB133111EBULL;
+        result =  result ^ (result >> 31);
+
+        return result == 0 ? 1 : result;
+    }
+}
+
+namespace Ud {
+    const unsigned      Sampler::adaptationSamples;
+    const std::uint32_t Sampler::defaultMaximumRate;
+
+    Sampler::Sampler() {
+        currentTarget.store(0, std::memory_order_relaxed);
+        currentMaximumRate.store(defaultMaximumRate, std::memory_order_relaxed);
+        recordedSamples.store(0, std::memory_order_relaxed);
+        windowStartTime.store(0, std::memory_order_relaxed);
+
+        storeRate(1);
+    }
+
+
+    Sampler::~Sampler() {}
+
+
+    std::uint32_t Sampler::rate() const {
+        return currentRate.load(std::memory_order_relaxed);
+    }
+
+
+    void Sampler::setRate(std::uint32_t newRate) {
+        currentTarget.store(0, std::memory_order_relaxed);
+        storeRate(newRate);
+    }
+
+
+    void Sampler::setAdaptive(std::uint32_t targetPerSecond, std::uint32_t maximumRate) {
+        currentMaximumRate.store(qMax(maximumRate, 1U), std::memory_order_relaxed);
+        recordedSamples.store(0, std::memory_order_relaxed);
+        windowStartTime.store(now(), std::memory_order_relaxed);
+        currentTarget.store(targetPerSecond, std::memory_order_relaxed);
+    }
+
+
+    bool Sampler::isAdaptive() const {
+        return currentTarget.load(std::memory_order_relaxed) != 0;
+    }
+
+
+    std::uint64_t Sampler::nextRandom() {
+        static thread_local std::uint64_t state = newSeed();
+
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+
+    std::int64_t Sampler::now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+
+    void Sampler::storeRate(std::uint32_t newRate) {
+        std::uint32_t rate = qMax(newRate, 1U);
+
+        // Updates racing a rate change may pair the old threshold with the new weight, a negligible bias.
+        currentThreshold.store(~static_cast<std::uint64_t>(0) / rate, std::memory_order_relaxed);
+        currentRate.store(rate, std::memory_order_relaxed);
+    }
+
+
+    void Sampler::adapt(std::uint32_t sampledRate) {
+        std::uint64_t count = recordedSamples.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (count % adaptationSamples == 0) {
+            std::int64_t  currentTime = now();
+            std::int64_t  elapsedTime = currentTime - windowStartTime.exchange(currentTime, std::memory_order_relaxed);
+            std::uint32_t target      = currentTarget.load(std::memory_order_relaxed);
+
+            if (elapsedTime > 0 && target != 0) {
+                double updatesPerSecond = 1.0E9 * adaptationSamples * sampledRate / elapsedTime;
+                double desiredRate      = std::round(updatesPerSecond / target);
+                double maximumRate      = currentMaximumRate.load(std::memory_order_relaxed);
+
+                storeRate(static_cast<std::uint32_t>(qBound(1.0, desiredRate, maximumRate)));
+            }
+        }
+    }
+}
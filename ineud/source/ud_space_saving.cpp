@@ -0,0 +1,194 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::SpaceSaving class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QList>
+
+#include <cstdint>
+#include <algorithm>
+
+#include "ud_space_saving.h"
+
+namespace Ud {
+    const unsigned SpaceSaving::defaultCapacity;
+
+    SpaceSaving::SpaceSaving(unsigned capacity) {
+        currentCapacity = capacity;
+        currentTotal    = 0;
+    }
+
+
+    SpaceSaving::~SpaceSaving() {}
+
+
+    unsigned SpaceSaving::capacity() const {
+        return currentCapacity;
+    }
+
+
+    void SpaceSaving::setCapacity(unsigned newCapacity) {
+        currentCapacity = newCapacity;
+        clear();
+    }
+
+
+    void SpaceSaving::add(const QString& key, std::uint64_t value) {
+        currentTotal += value;
+
+        auto it = indexes.constFind(key);
+        if (it != indexes.constEnd()) {
+            unsigned index = it.value();
+            heap[index].count += value;
+            siftDown(index);
+        } else if (static_cast<unsigned>(heap.size()) < currentCapacity) {
+            Entry entry;
+            entry.key   = key;
+            entry.count = value;
+            entry.error = 0;
+
+            unsigned index = static_cast<unsigned>(heap.size());
+            heap.append(entry);
+            indexes.insert(key, index);
+            siftUp(index);
+        } else if (currentCapacity > 0) {
+            // Replace the key with the smallest count.  The new key may have been counted under the evicted key.
+            Entry& minimum = heap[0];
+            indexes.remove(minimum.key);
+
+            minimum.key    = key;
+            minimum.error  = minimum.count;
+            minimum.count += value;
+
+            indexes.insert(key, 0);
+            siftDown(0);
+        }
+    }
+
+
+    QList<SpaceSaving::Entry> SpaceSaving::entries() const {
+        QList<Entry> result;
+        result.reserve(heap.size());
+
+        for (auto it=heap.constBegin(),end=heap.constEnd() ; it!=end ; ++it) {
+            result.append(*it);
+        }
+
+        std::sort(result.begin(), result.end(), [](const Entry& a, const Entry& b) {
+            return a.count > b.count;
+        });
+
+        return result;
+    }
+
+
+    unsigned SpaceSaving::size() const {
+        return static_cast<unsigned>(heap.size());
+    }
+
+
+    bool SpaceSaving::isEmpty() const {
+        return heap.isEmpty();
+    }
+
+
+    std::uint64_t SpaceSaving::minimumCount() const {
+        bool full = (!heap.isEmpty() && static_cast<unsigned>(heap.size()) >= currentCapacity);
+        return full ? heap.first().count : 0;
+    }
+
+
+    std::uint64_t SpaceSaving::maximumCount() const {
+        std::uint64_t result = 0;
+        for (auto it=heap.constBegin(),end=heap.constEnd() ; it!=end ; ++it) {
+            result = qMax(result, it->count);
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t SpaceSaving::total() const {
+        return currentTotal;
+    }
+
+
+    void SpaceSaving::clear() {
+        heap.clear();
+        indexes.clear();
+        currentTotal = 0;
+    }
+
+
+    void SpaceSaving::siftUp(unsigned index) {
+        while (index > 0) {
+            unsigned parent = (index - 1) / 2;
+            if (heap.at(parent).count <= heap.at(index).count) {
+                break;
+            }
+
+            swapEntries(parent, index);
+            index = parent;
+        }
+    }
+
+
+    void SpaceSaving::siftDown(unsigned index) {
+        unsigned numberEntries = static_cast<unsigned>(heap.size());
+
+        bool done = false;
+        while (!done) {
+            unsigned smallest = index;
+            unsigned left     = 2 * index + 1;
+            unsigned right    = left + 1;
+
+            if (left < numberEntries && heap.at(left).count < heap.at(smallest).count) {
+                smallest = left;
+            }
+
+            if (right < numberEntries && heap.at(right).count < heap.at(smallest).count) {
+                smallest = right;
+            }
+
+            if (smallest != index) {
+                swapEntries(index, smallest);
+                index = smallest;
+            } else {
+                done = true;
+            }
+        }
+    }
+
+
+    void SpaceSaving::swapEntries(unsigned first, unsigned second) {
+        std::swap(heap[first], heap[second]);
+        indexes[heap.at(first).key]  = first;
+        indexes[heap.at(second).key] = second;
+    }
+}
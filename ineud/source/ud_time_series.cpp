@@ -0,0 +1,216 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::TimeSeries class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cstdint>
+#include <atomic>
+#include <ctime>
+
+#include "ud_key_registry.h"
+#include "ud_time_series.h"
+
+namespace Ud {
+    const unsigned TimeSeries::slotsPerChunk;
+    const unsigned TimeSeries::maximumChunks;
+    const unsigned TimeSeries::defaultBucketSeconds;
+    const unsigned TimeSeries::defaultNumberBuckets;
+
+    TimeSeries::Chunk::Chunk(unsigned numberBuckets) {
+        unsigned numberValues = numberBuckets * slotsPerChunk;
+
+        values = new std::atomic<std::uint64_t>[numberValues];
+        for (unsigned i=0 ; i<numberValues ; ++i) {
+            values[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+
+    TimeSeries::Chunk::~Chunk() {
+        delete[] values;
+    }
+
+
+    TimeSeries::TimeSeries(unsigned bucketSeconds, unsigned numberBuckets) {
+        currentBucketSeconds = qMax(bucketSeconds, 1U);
+        currentNumberBuckets = qMax(numberBuckets, 1U);
+
+        currentBucket.store(currentTime() / currentBucketSeconds, std::memory_order_relaxed);
+
+        for (unsigned i=0 ; i<maximumChunks ; ++i) {
+            chunks[i].store(Q_NULLPTR, std::memory_order_relaxed);
+        }
+    }
+
+
+    TimeSeries::~TimeSeries() {
+        for (unsigned i=0 ; i<maximumChunks ; ++i) {
+            delete chunks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+
+    unsigned TimeSeries::bucketSeconds() const {
+        return currentBucketSeconds;
+    }
+
+
+    unsigned TimeSeries::numberBuckets() const {
+        return currentNumberBuckets;
+    }
+
+
+    void TimeSeries::add(TimeSeries::Slot slot, std::uint64_t value) {
+        add(slot, value, currentTime());
+    }
+
+
+    void TimeSeries::add(TimeSeries::Slot slot, std::uint64_t value, std::int64_t time) {
+        if (slot < KeyRegistry::maximumSlots) {
+            std::int64_t bucket = time / currentBucketSeconds;
+            std::int64_t newest = currentBucket.load(std::memory_order_acquire);
+
+            if (bucket > newest) {
+                rotate(bucket);
+                newest = bucket;
+            }
+
+            if (bucket > newest - currentNumberBuckets) {
+                std::atomic<Chunk*>& chunkPointer = chunks[slot / slotsPerChunk];
+                Chunk*               chunk        = chunkPointer.load(std::memory_order_acquire);
+
+                if (chunk == Q_NULLPTR) {
+                    Chunk* newChunk = new Chunk(currentNumberBuckets);
+                    if (chunkPointer.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel)) {
+                        chunk = newChunk;
+                    } else {
+                        delete newChunk;
+                    }
+                }
+
+                chunk->values[position(bucket) * slotsPerChunk + slot % slotsPerChunk].fetch_add(
+                    value,
+                    std::memory_order_relaxed
+                );
+            }
+        }
+    }
+
+
+    QHash<TimeSeries::Slot, QVector<std::uint64_t>> TimeSeries::snapshot(
+            std::int64_t  time,
+            std::int64_t* firstBucketTime
+        ) {
+        QHash<Slot, QVector<std::uint64_t>> result;
+
+        std::int64_t bucket = time / currentBucketSeconds;
+        if (bucket > currentBucket.load(std::memory_order_acquire)) {
+            rotate(bucket);
+        }
+
+        std::int64_t newest = currentBucket.load(std::memory_order_acquire);
+        std::int64_t oldest = newest - currentNumberBuckets + 1;
+
+        if (firstBucketTime != Q_NULLPTR) {
+            *firstBucketTime = oldest * currentBucketSeconds;
+        }
+
+        for (unsigned chunkIndex=0 ; chunkIndex<maximumChunks ; ++chunkIndex) {
+            const Chunk* chunk = chunks[chunkIndex].load(std::memory_order_acquire);
+            if (chunk != Q_NULLPTR) {
+                for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+                    QVector<std::uint64_t> buckets(static_cast<int>(currentNumberBuckets));
+                    bool                   nonZero = false;
+
+                    for (unsigned j=0 ; j<currentNumberBuckets ; ++j) {
+                        std::uint64_t value = chunk->values[position(oldest + j) * slotsPerChunk + i].load(
+                            std::memory_order_relaxed
+                        );
+
+                        buckets[static_cast<int>(j)] = value;
+                        nonZero = nonZero || value != 0;
+                    }
+
+                    if (nonZero) {
+                        result.insert(static_cast<Slot>(chunkIndex * slotsPerChunk + i), buckets);
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t TimeSeries::memoryUsage() const {
+        std::uint64_t chunkBytes = sizeof(Chunk) + sizeof(std::uint64_t) * currentNumberBuckets * slotsPerChunk;
+        std::uint64_t result     = sizeof(TimeSeries);
+
+        for (unsigned i=0 ; i<maximumChunks ; ++i) {
+            if (chunks[i].load(std::memory_order_relaxed) != Q_NULLPTR) {
+                result += chunkBytes;
+            }
+        }
+
+        return result;
+    }
+
+
+    std::int64_t TimeSeries::currentTime() {
+        // time() reads the coarse clock and is far cheaper than a full resolution clock read.
+        return static_cast<std::int64_t>(std::time(Q_NULLPTR));
+    }
+
+
+    void TimeSeries::rotate(std::int64_t bucket) {
+        QMutexLocker locker(&rotationMutex);
+
+        std::int64_t newest = currentBucket.load(std::memory_order_relaxed);
+        if (bucket > newest) {
+            // Only the buckets between the old and new ends of the window are recycled.
+            std::int64_t firstRecycled = qMax(newest + 1, bucket - currentNumberBuckets + 1);
+
+            for (unsigned chunkIndex=0 ; chunkIndex<maximumChunks ; ++chunkIndex) {
+                Chunk* chunk = chunks[chunkIndex].load(std::memory_order_acquire);
+                if (chunk != Q_NULLPTR) {
+                    for (std::int64_t recycled=firstRecycled ; recycled<=bucket ; ++recycled) {
+                        std::atomic<std::uint64_t>* row = chunk->values + position(recycled) * slotsPerChunk;
+                        for (unsigned i=0 ; i<slotsPerChunk ; ++i) {
+                            row[i].store(0, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+
+            currentBucket.store(bucket, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,398 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::TimerTable class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+#include <QElapsedTimer>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_timer_table.h"
+
+namespace {
+    /**
+     * Timer state indicating that the timer is not running.  Only the owning thread moves a timer out of this state.
+     */
+    const unsigned stopped = 0;
+
+    /**
+     * Timer state indicating that the timer is running.
+     */
+    const unsigned running = 1;
+
+    /**
+     * Timer state indicating that a thread has claimed the running timer to stop or lap it.
+     */
+    const unsigned claimed = 2;
+
+    /**
+     * The number of timers a thread's table may hold before timers stopped by other threads are released.
+     */
+    const int minimumPruneSize = 64;
+}
+
+namespace Ud {
+    /**
+     * Structure holding a single timer.  The start time is only accessed by the thread that started the timer or by
+     * a thread that has claimed it.
+     */
+    struct TimerTable::Timer {
+        Timer(const QString& timerName, Timer* nextTimer) {
+            name      = timerName;
+            next      = nextTimer;
+            startTime = 0;
+            state.store(stopped, std::memory_order_relaxed);
+        }
+
+        /**
+         * Claims a running timer, waiting while another thread holds a claim.
+         *
+         * \return Returns true if the timer was claimed.  Returns false if the timer is not running.
+         */
+        bool claim() {
+            unsigned currentState = running;
+            bool     success      = false;
+
+            while (!success && currentState != stopped) {
+                success = state.compare_exchange_weak(
+                    currentState,
+                    claimed,
+                    std::memory_order_acquire,
+                    std::memory_order_relaxed
+                );
+
+                if (!success && currentState == claimed) {
+                    QThread::yieldCurrentThread();
+                    currentState = running;
+                }
+            }
+
+            return success;
+        }
+
+        QString               name;
+        Timer*                next;
+        std::int64_t          startTime;
+        std::atomic<unsigned> state;
+    };
+
+
+    /**
+     * Structure holding the timers of one thread.  The hash is only used by the owning thread.  Only the owning thread
+     * adds timers to the list.  Other threads only walk the list, and the owning thread only removes timers from it,
+     * with the tables mutex held.
+     */
+    struct TimerTable::ThreadTimers {
+        ThreadTimers(ThreadTimers* nextTable) {
+            next      = nextTable;
+            pruneSize = minimumPruneSize;
+            firstTimer.store(Q_NULLPTR, std::memory_order_relaxed);
+            orphaned.store(false, std::memory_order_relaxed);
+        }
+
+        ~ThreadTimers() {
+            Timer* timer = firstTimer.load(std::memory_order_relaxed);
+            while (timer != Q_NULLPTR) {
+                Timer* nextTimer = timer->next;
+                delete timer;
+                timer = nextTimer;
+            }
+        }
+
+        /**
+         * Determines if any timer in the table is running or claimed.
+         *
+         * \return Returns true if any timer is in use.
+         */
+        bool isBusy() const {
+            const Timer* timer = firstTimer.load(std::memory_order_acquire);
+            while (timer != Q_NULLPTR && timer->state.load(std::memory_order_acquire) == stopped) {
+                timer = timer->next;
+            }
+
+            return timer != Q_NULLPTR;
+        }
+
+        /**
+         * Removes and deletes every stopped timer, or only one timer if a timer is given.  Only the owning thread may
+         * call this method, with the tables mutex held.
+         *
+         * \param[in] onlyTimer If not null, the only timer to be removed.  The timer must be stopped.
+         */
+        void remove(Timer* onlyTimer = Q_NULLPTR) {
+            Timer* previous = Q_NULLPTR;
+            Timer* timer    = firstTimer.load(std::memory_order_relaxed);
+
+            while (timer != Q_NULLPTR) {
+                Timer* nextTimer = timer->next;
+                bool   matches   = (
+                      onlyTimer != Q_NULLPTR
+                    ? timer == onlyTimer
+                    : timer->state.load(std::memory_order_acquire) == stopped
+                );
+
+                if (matches) {
+                    if (previous == Q_NULLPTR) {
+                        firstTimer.store(nextTimer, std::memory_order_release);
+                    } else {
+                        previous->next = nextTimer;
+                    }
+
+                    timersByName.remove(timer->name);
+                    delete timer;
+                } else {
+                    previous = timer;
+                }
+
+                timer = nextTimer;
+            }
+        }
+
+        QHash<QString, Timer*> timersByName;
+        int                    pruneSize;
+        std::atomic<Timer*>    firstTimer;
+        std::atomic<bool>      orphaned;
+        ThreadTimers*          next;
+    };
+
+
+    /**
+     * Class held in thread local storage.  The table is marked as orphaned when the thread exits so that a new thread
+     * can reuse it.
+     */
+    class TimerTable::ThreadHandle {
+        public:
+            ThreadHandle(ThreadTimers* threadTimers) {
+                timers = threadTimers;
+            }
+
+            ~ThreadHandle() {
+                timers->orphaned.store(true, std::memory_order_release);
+            }
+
+            ThreadTimers* timers;
+    };
+
+
+    TimerTable::TimerTable() {
+        firstTable = Q_NULLPTR;
+        clock.start();
+    }
+
+
+    TimerTable::~TimerTable() {
+        // Handles held by other threads that are still running are abandoned by QThreadStorage.
+        handles.setLocalData(Q_NULLPTR);
+
+        ThreadTimers* table = firstTable;
+        while (table != Q_NULLPTR) {
+            ThreadTimers* nextTable = table->next;
+            delete table;
+            table = nextTable;
+        }
+    }
+
+
+    void TimerTable::start(const QString& timerName) {
+        ThreadTimers* table = threadTimers();
+        Timer*        timer = table->timersByName.value(timerName);
+
+        if (timer == Q_NULLPTR) {
+            if (table->timersByName.size() >= table->pruneSize) {
+                // Timers stopped by other threads, or by stopAll, are released here so the table stays bounded.
+                QMutexLocker locker(&tablesMutex);
+                table->remove();
+                table->pruneSize = qMax(minimumPruneSize, 2 * table->timersByName.size());
+            }
+
+            timer = new Timer(timerName, table->firstTimer.load(std::memory_order_relaxed));
+            table->firstTimer.store(timer, std::memory_order_release);
+            table->timersByName.insert(timerName, timer);
+        }
+
+        Q_ASSERT(timer->state.load(std::memory_order_relaxed) == stopped);
+
+        // A running timer is claimed first so that restarting it cannot race a lap from another thread.
+        timer->claim();
+        timer->startTime = clock.nsecsElapsed();
+        timer->state.store(running, std::memory_order_release);
+    }
+
+
+    bool TimerTable::stop(const QString& timerName, bool doStop, std::uint64_t& elapsedTime) {
+        ThreadTimers* table   = threadTimers();
+        Timer*        timer   = table->timersByName.value(timerName);
+        bool          success = timer != Q_NULLPTR && timer->claim();
+
+        if (success) {
+            elapsedTime = finish(timer, doStop);
+
+            if (doStop) {
+                // A stopped timer has nothing left to lap, so it is released.
+                QMutexLocker locker(&tablesMutex);
+                table->remove(timer);
+            }
+        } else {
+            // Fall back to a timer started on another thread.
+            QMutexLocker locker(&tablesMutex);
+
+            table = firstTable;
+            while (!success && table != Q_NULLPTR) {
+                timer = table->firstTimer.load(std::memory_order_acquire);
+                while (!success && timer != Q_NULLPTR) {
+                    success = timer->name == timerName && timer->claim();
+                    if (!success) {
+                        timer = timer->next;
+                    }
+                }
+
+                table = table->next;
+            }
+
+            if (success) {
+                elapsedTime = finish(timer, doStop);
+            }
+        }
+
+        return success;
+    }
+
+
+    bool TimerTable::isActive(const QString& timerName) const {
+        bool result = false;
+
+        const ThreadHandle* handle = handles.localData();
+        if (handle != Q_NULLPTR) {
+            const Timer* timer = handle->timers->timersByName.value(timerName);
+            result = timer != Q_NULLPTR && timer->state.load(std::memory_order_acquire) != stopped;
+        }
+
+        return result;
+    }
+
+
+    TimerTable::ElapsedTimes TimerTable::lapAll() {
+        return finishAll(false);
+    }
+
+
+    TimerTable::ElapsedTimes TimerTable::stopAll() {
+        return finishAll(true);
+    }
+
+
+    std::uint64_t TimerTable::memoryUsage() const {
+        std::uint64_t result = 0;
+
+        QMutexLocker locker(&tablesMutex);
+
+        for (const ThreadTimers* table=firstTable ; table!=Q_NULLPTR ; table=table->next) {
+            result += sizeof(ThreadTimers);
+
+            const Timer* timer = table->firstTimer.load(std::memory_order_acquire);
+            while (timer != Q_NULLPTR) {
+                result += sizeof(Timer) + 3 * sizeof(void*);
+                timer   = timer->next;
+            }
+        }
+
+        return result;
+    }
+
+
+    TimerTable::ThreadTimers* TimerTable::threadTimers() {
+        ThreadHandle* handle = handles.localData();
+
+        if (handle == Q_NULLPTR) {
+            QMutexLocker locker(&tablesMutex);
+
+            ThreadTimers* table = firstTable;
+            while (table != Q_NULLPTR && (!table->orphaned.load(std::memory_order_acquire) || table->isBusy())) {
+                table = table->next;
+            }
+
+            if (table != Q_NULLPTR) {
+                table->orphaned.store(false, std::memory_order_relaxed);
+            } else {
+                table      = new ThreadTimers(firstTable);
+                firstTable = table;
+            }
+
+            handle = new ThreadHandle(table);
+            handles.setLocalData(handle);
+        }
+
+        return handle->timers;
+    }
+
+
+    std::uint64_t TimerTable::finish(TimerTable::Timer* timer, bool doStop) {
+        std::int64_t  endTime = clock.nsecsElapsed();
+        std::uint64_t result  = 0;
+
+        if (endTime > timer->startTime) {
+            result = static_cast<std::uint64_t>(endTime - timer->startTime);
+        }
+
+        if (doStop) {
+            timer->state.store(stopped, std::memory_order_release);
+        } else {
+            timer->startTime = endTime;
+            timer->state.store(running, std::memory_order_release);
+        }
+
+        return result;
+    }
+
+
+    TimerTable::ElapsedTimes TimerTable::finishAll(bool doStop) {
+        ElapsedTimes result;
+
+        QMutexLocker locker(&tablesMutex);
+
+        for (ThreadTimers* table=firstTable ; table!=Q_NULLPTR ; table=table->next) {
+            Timer* timer = table->firstTimer.load(std::memory_order_acquire);
+            while (timer != Q_NULLPTR) {
+                if (timer->claim()) {
+                    result.append(qMakePair(timer->name, finish(timer, doStop)));
+                }
+
+                timer = timer->next;
+            }
+        }
+
+        return result;
+    }
+}
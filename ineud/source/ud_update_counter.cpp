@@ -0,0 +1,197 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref Ud::UpdateCounter class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cstdint>
+#include <atomic>
+
+#include "ud_update_counter.h"
+
+namespace {
+    /**
+     * Structure holding one thread's counts.
+     */
+    struct ThreadCounts {
+        /**
+         * The counts, indexed by counter.  Only the thread owning the block writes to it.
+         */
+        std::atomic<std::uint64_t> counts[Ud::UpdateCounter::maximumCounters];
+
+        /**
+         * Flag indicating that a running thread owns the block.  Guarded by the counts mutex.
+         */
+        bool inUse;
+
+        /**
+         * The next block.
+         */
+        ThreadCounts* next;
+    };
+
+    /**
+     * Class held in thread local storage that claims a block for the thread and releases it when the thread exits.
+     */
+    class ThreadHandle {
+        public:
+            ThreadHandle();
+
+            ~ThreadHandle();
+
+            /**
+             * The block owned by the thread.
+             */
+            ThreadCounts* threadCounts;
+    };
+
+    /**
+     * Obtains the mutex guarding the list of blocks and the counter indexes in use.  The mutex is created on first
+     * use so counters can be created during static initialization.
+     *
+     * \return Returns the mutex.
+     */
+    QMutex& countsMutex() {
+        static QMutex mutex;
+        return mutex;
+    }
+
+    /**
+     * The first block.  Blocks are never freed.
+     */
+    ThreadCounts* firstCounts = Q_NULLPTR;
+
+    /**
+     * Flags indicating which counter indexes are in use.
+     */
+    bool indexInUse[Ud::UpdateCounter::maximumCounters] = {};
+
+    ThreadHandle::ThreadHandle() {
+        QMutexLocker locker(&countsMutex());
+
+        threadCounts = firstCounts;
+        while (threadCounts != Q_NULLPTR && threadCounts->inUse) {
+            threadCounts = threadCounts->next;
+        }
+
+        if (threadCounts == Q_NULLPTR) {
+            threadCounts = new ThreadCounts;
+            for (unsigned i=0 ; i<Ud::UpdateCounter::maximumCounters ; ++i) {
+                threadCounts->counts[i].store(0, std::memory_order_relaxed);
+            }
+
+            threadCounts->next = firstCounts;
+            firstCounts        = threadCounts;
+        }
+
+        threadCounts->inUse = true;
+    }
+
+
+    ThreadHandle::~ThreadHandle() {
+        QMutexLocker locker(&countsMutex());
+        threadCounts->inUse = false;
+    }
+
+    /**
+     * Obtains the calling thread's block.
+     *
+     * \return Returns the calling thread's block.
+     */
+    inline ThreadCounts* localCounts() {
+        static thread_local ThreadHandle handle;
+        return handle.threadCounts;
+    }
+}
+
+namespace Ud {
+    const unsigned UpdateCounter::maximumCounters;
+
+    UpdateCounter::UpdateCounter() {
+        QMutexLocker locker(&countsMutex());
+
+        index = 0;
+        while (index < maximumCounters && indexInUse[index]) {
+            ++index;
+        }
+
+        if (index < maximumCounters) {
+            indexInUse[index] = true;
+            baseline          = sum();
+        } else {
+            baseline = 0;
+        }
+
+        overflowCount.store(0, std::memory_order_relaxed);
+    }
+
+
+    UpdateCounter::~UpdateCounter() {
+        if (index < maximumCounters) {
+            QMutexLocker locker(&countsMutex());
+            indexInUse[index] = false;
+        }
+    }
+
+
+    void UpdateCounter::increment() {
+        if (index < maximumCounters) {
+            // Only this thread writes the count, so a load and a store cannot lose an update.
+            std::atomic<std::uint64_t>& count = localCounts()->counts[index];
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            overflowCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+
+    std::uint64_t UpdateCounter::value() const {
+        std::uint64_t result = 0;
+
+        if (index < maximumCounters) {
+            QMutexLocker locker(&countsMutex());
+            result = sum() - baseline;
+        } else {
+            result = overflowCount.load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+
+    std::uint64_t UpdateCounter::sum() const {
+        std::uint64_t       result       = 0;
+        const ThreadCounts* threadCounts = firstCounts;
+        while (threadCounts != Q_NULLPTR) {
+            result       += threadCounts->counts[index].load(std::memory_order_relaxed);
+            threadCounts  = threadCounts->next;
+        }
+
+        return result;
+    }
+}
@@ -35,29 +35,169 @@
 #include <QDate>
 #include <QMutex>
 #include <QMap>
+#include <QList>
 #include <QByteArray>
-#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QMetaMethod>
 #include <QThread>
 #include <QVariant>
 #include <QJsonDocument>
+#include <QJsonValue>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QVector>
+#include <QPair>
+#include <QScopedPointer>
 #include <QSysInfo>
 #include <QUrl>
+#include <QDir>
+#include <QNetworkReply>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
 
 #include <cstring>
+#include <cmath>
 
 #include <crypto_trng.h>
 #include <crypto_aes_cbc_encryptor.h>
 #include <crypto_hmac.h>
 
+#include "ud_key_registry.h"
+#include "ud_counter_store.h"
+#include "ud_slot_table.h"
+#include "ud_histogram.h"
+#include "ud_quantile_sketch.h"
+#include "ud_hyper_log_log.h"
+#include "ud_sampler.h"
+#include "ud_counter_journal.h"
+#include "ud_payload_transport.h"
+#include "ud_payload_writer.h"
+#include "ud_report_spool.h"
+#include "ud_retry_policy.h"
 #include "ud_usage_data.h"
 
+namespace {
+    /**
+     * Mutex locker that measures the time spent waiting for a contended mutex.  An uncontended lock costs no more
+     * than a QMutexLocker.
+     */
+    class TimedMutexLocker {
+        public:
+            /**
+             * Constructor
+             *
+             * \param[in]     mutex          The mutex to lock.
+             *
+             * \param[in,out] waitTime       Total wait time, in nanoseconds, updated if the mutex is contended.
+             *
+             * \param[in,out] contendedLocks Count of contended locks, updated if the mutex is contended.
+             */
+            TimedMutexLocker(
+                    QMutex*                     mutex,
+                    std::atomic<std::uint64_t>& waitTime,
+                    std::atomic<std::uint64_t>& contendedLocks
+                ) {
+                currentMutex = mutex;
+
+                if (!mutex->tryLock()) {
+                    QElapsedTimer waitTimer;
+                    waitTimer.start();
+
+                    mutex->lock();
+
+                    waitTime.fetch_add(static_cast<std::uint64_t>(waitTimer.nsecsElapsed()), std::memory_order_relaxed);
+                    contendedLocks.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            ~TimedMutexLocker() {
+                currentMutex->unlock();
+            }
+
+        private:
+            Q_DISABLE_COPY(TimedMutexLocker)
+
+            /**
+             * The locked mutex.
+             */
+            QMutex* currentMutex;
+    };
+
+    /**
+     * Decides if an adjustment is recorded.
+     *
+     * \param[in] enabled  Flag indicating that any sampler exists.
+     *
+     * \param[in] samplers The table of samplers to consult.
+     *
+     * \param[in] slot     The slot of the event or activity being adjusted.
+     *
+     * \return Returns the weight to apply to the adjustment.  A value of zero indicates the adjustment is discarded.
+     */
+    inline std::uint32_t samplingWeight(
+            const std::atomic<bool>&          enabled,
+            const Ud::SlotTable<Ud::Sampler>& samplers,
+            Ud::KeyRegistry::Slot             slot
+        ) {
+        std::uint32_t result = 1;
+
+        if (enabled.load(std::memory_order_relaxed)) {
+            Ud::Sampler* sampler = samplers.at(slot);
+            if (sampler != Q_NULLPTR) {
+                result = sampler->sample();
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Adds a value to a time series, if time series are enabled.
+     *
+     * \param[in] series The time series to update.
+     *
+     * \param[in] slot   The slot the value was added to.
+     *
+     * \param[in] value  The value to add.
+     */
+    inline void addToSeries(
+            const std::atomic<Ud::TimeSeries*>& series,
+            Ud::KeyRegistry::Slot               slot,
+            std::uint64_t                       value
+        ) {
+        Ud::TimeSeries* timeSeries = series.load(std::memory_order_acquire);
+        if (timeSeries != Q_NULLPTR) {
+            timeSeries->add(slot, value);
+        }
+    }
+
+    /**
+     * Determines if a failure indicates the collector rejected the request body, an HTTP 4xx response other than an
+     * authentication failure.  Sending a rejected body again cannot succeed.
+     *
+     * \param[in] networkError The QNetworkReply::NetworkError code describing the failure.
+     *
+     * \return Returns true if the body was rejected.  Returns false if the request may succeed if retried.
+     */
+    bool isRejection(int networkError) {
+        return (
+               (   networkError >= QNetworkReply::ContentAccessDenied
+                && networkError <= QNetworkReply::UnknownContentError
+                && networkError != QNetworkReply::AuthenticationRequiredError)
+            || networkError == QNetworkReply::ProtocolInvalidOperationError
+        );
+    }
+}
+
 namespace Ud {
-    const unsigned long UsageData::defaultReportingInterval = 7 * 24 * 60 * 60;
-    const unsigned      UsageData::enableReportDelay = 60;
-    const unsigned      UsageData::reportRetrialPeriod = 30 * 60;
-    const QString       UsageData::defaultSettingsGroup("usageData");
+    const UsageData::EventId UsageData::invalidId = KeyRegistry::invalidSlot;
+    const unsigned long      UsageData::defaultReportingInterval = 7 * 24 * 60 * 60;
+    const unsigned           UsageData::enableReportDelay = 60;
+    const unsigned           UsageData::reportRetrialPeriod = 30 * 60;
+    const QString            UsageData::defaultSettingsGroup("usageData");
+    const std::uint64_t      UsageData::defaultActivityResolution = 1000000000ULL;
+    const unsigned           UsageData::maximumSpooledReportsPerUpload = 16;
 
     UsageData::UsageData(
             QSettings*             settings,
@@ -70,7 +210,7 @@ namespace Ud {
             sharedSecret,
             parent
         ) {
-        configure(settings, webhookUrl);
+        configure(settings, networkAccessManager, sharedSecret, webhookUrl);
     }
 
 
@@ -86,12 +226,18 @@ namespace Ud {
             sharedSecret,
             parent
         ) {
-        configure(settings, webhookUrl);
+        configure(settings, networkAccessManager, sharedSecret, webhookUrl);
         setSettingsGroup(settingsGroup);
     }
 
 
-    UsageData::~UsageData() {}
+    UsageData::~UsageData() {
+        // A report being built in the background still references this object.
+        reportWatcher->waitForFinished();
+
+        delete eventSeries.load(std::memory_order_relaxed);
+        delete activitySeries.load(std::memory_order_relaxed);
+    }
 
 
     bool UsageData::isConfigured() const {
@@ -123,6 +269,18 @@ namespace Ud {
     }
 
 
+    QByteArray UsageData::previewReport() {
+        QByteArray result;
+
+        if (isNotReporting()) {
+            result = buildReport(currentPayloadFormat, lastOperation.secsTo(QDateTime::currentDateTimeUtc()));
+            restoreEventsAndActivities();
+        }
+
+        return result;
+    }
+
+
     std::uint64_t UsageData::userSecret() const {
         return secret;
     }
@@ -138,6 +296,36 @@ namespace Ud {
     }
 
 
+    PayloadTransport::Compression UsageData::payloadCompression() const {
+        return payloadTransport->compression();
+    }
+
+
+    void UsageData::setPayloadCompression(PayloadTransport::Compression newCompression) {
+        payloadTransport->setCompression(newCompression);
+    }
+
+
+    UsageData::PayloadFormat UsageData::payloadFormat() const {
+        return currentPayloadFormat;
+    }
+
+
+    void UsageData::setPayloadFormat(UsageData::PayloadFormat newPayloadFormat) {
+        currentPayloadFormat = newPayloadFormat;
+    }
+
+
+    bool UsageData::backgroundReporting() const {
+        return currentBackgroundReporting;
+    }
+
+
+    void UsageData::setBackgroundReporting(bool nowEnabled) {
+        currentBackgroundReporting = nowEnabled;
+    }
+
+
     QString UsageData::settingsGroup() const {
         return currentSettingsGroup;
     }
@@ -148,6 +336,61 @@ namespace Ud {
     }
 
 
+    QString UsageData::journalFilename() const {
+        TimedMutexLocker locker(&journalMutex, mutexWaitTime, contendedLocks);
+        return journal.filename();
+    }
+
+
+    void UsageData::setJournalFilename(const QString& newJournalFilename) {
+        TimedMutexLocker locker(&journalMutex, mutexWaitTime, contendedLocks);
+
+        if (newJournalFilename != journal.filename()) {
+            journal.setFilename(newJournalFilename);
+
+            // Once settings are loaded, loadSettings will not read the journal so its counters are picked up now.
+            if (settingsLoaded && !events.isAttached()) {
+                importJournal();
+            }
+        }
+    }
+
+
+    QString UsageData::counterDirectory() const {
+        return currentCounterDirectory;
+    }
+
+
+    void UsageData::setCounterDirectory(const QString& newCounterDirectory) {
+        currentCounterDirectory = newCounterDirectory;
+
+        if (newCounterDirectory.isEmpty()) {
+            events.detach();
+            activities.detach();
+        }
+    }
+
+
+    QString UsageData::spoolDirectory() const {
+        return spool.directory();
+    }
+
+
+    void UsageData::setSpoolDirectory(const QString& newSpoolDirectory) {
+        spool.setDirectory(newSpoolDirectory);
+    }
+
+
+    qint64 UsageData::spoolLimit() const {
+        return spool.maximumBytes();
+    }
+
+
+    void UsageData::setSpoolLimit(qint64 newSpoolLimit) {
+        spool.setMaximumBytes(newSpoolLimit);
+    }
+
+
     unsigned long long UsageData::interval() const {
         return reportInterval;
     }
@@ -156,7 +399,8 @@ namespace Ud {
     void UsageData::setInterval(unsigned long long newInterval) {
         reportInterval = newInterval;
 
-        if (enabled && isNotReporting()) {
+        // An open circuit breaker keeps its scheduled trial so a new interval cannot bypass it.
+        if (enabled && isNotReporting() && retryPolicy.circuitState() != CircuitState::OPEN) {
             nextOperation = lastOperation.addSecs(reportInterval);
 
             QDateTime earliestDateTime = QDateTime::currentDateTimeUtc().addSecs(enableReportDelay);
@@ -169,6 +413,37 @@ namespace Ud {
     }
 
 
+    std::uint64_t UsageData::activityResolution() const {
+        return currentActivityResolution.load(std::memory_order_relaxed);
+    }
+
+
+    void UsageData::setActivityResolution(std::uint64_t nanosecondsPerUnit) {
+        Q_ASSERT(nanosecondsPerUnit > 0);
+        currentActivityResolution.store(nanosecondsPerUnit, std::memory_order_relaxed);
+    }
+
+
+    unsigned UsageData::maximumEventKeys() const {
+        return events.maximumKeys();
+    }
+
+
+    void UsageData::setMaximumEventKeys(unsigned newMaximumKeys) {
+        events.setMaximumKeys(newMaximumKeys);
+    }
+
+
+    unsigned UsageData::maximumActivityKeys() const {
+        return activities.maximumKeys();
+    }
+
+
+    void UsageData::setMaximumActivityKeys(unsigned newMaximumKeys) {
+        activities.setMaximumKeys(newMaximumKeys);
+    }
+
+
     QDateTime UsageData::lastReportTime() {
         return lastOperation;
     }
@@ -184,13 +459,112 @@ namespace Ud {
     }
 
 
+    unsigned long long UsageData::retryBaseDelay() const {
+        return retryPolicy.baseDelay();
+    }
+
+
+    unsigned long long UsageData::maximumRetryDelay() const {
+        return retryPolicy.maximumDelay();
+    }
+
+
+    void UsageData::setRetryDelays(unsigned long long newBaseDelay, unsigned long long newMaximumDelay) {
+        retryPolicy.setDelays(newBaseDelay, newMaximumDelay);
+    }
+
+
+    unsigned UsageData::circuitBreakerThreshold() const {
+        return retryPolicy.failureThreshold();
+    }
+
+
+    void UsageData::setCircuitBreakerThreshold(unsigned newThreshold) {
+        retryPolicy.setFailureThreshold(newThreshold);
+    }
+
+
+    unsigned long long UsageData::circuitBreakerOpenPeriod() const {
+        return retryPolicy.openPeriod();
+    }
+
+
+    void UsageData::setCircuitBreakerOpenPeriod(unsigned long long newOpenPeriod) {
+        retryPolicy.setOpenPeriod(newOpenPeriod);
+    }
+
+
+    UsageData::CircuitState UsageData::circuitState() const {
+        return retryPolicy.circuitState();
+    }
+
+
+    UsageData::Statistics UsageData::stats() const {
+        Statistics result;
+
+        std::int64_t  now         = monotonicClock.nsecsElapsed();
+        std::int64_t  rateElapsed = now - rateStartTime.load(std::memory_order_relaxed);
+        std::uint64_t adjustCalls = events.numberUpdates() + activities.numberUpdates();
+
+        result.adjustCalls          = adjustCalls;
+        result.adjustCallsPerSecond = (
+              rateElapsed > 0
+            ? 1.0E9 * (adjustCalls - rateStartCount.load(std::memory_order_relaxed)) / rateElapsed
+            : 0
+        );
+        result.mutexWaitTime        = mutexWaitTime.load(std::memory_order_relaxed);
+        result.contendedLocks       = contendedLocks.load(std::memory_order_relaxed);
+        result.snapshotTime         = lastSnapshotTime.load(std::memory_order_relaxed);
+        result.payloadBytes         = lastPayloadBytes.load(std::memory_order_relaxed);
+        result.encodedBytes         = lastEncodedBytes.load(std::memory_order_relaxed);
+        result.loadTime             = lastLoadTime.load(std::memory_order_relaxed);
+        result.saveTime             = lastSaveTime.load(std::memory_order_relaxed);
+
+        std::uint64_t memoryBytes = events.memoryUsage() + activities.memoryUsage();
+
+        histograms.forEach([&](ActivityId, const Histogram* histogram) {
+            memoryBytes += histogram->memoryUsage();
+        });
+
+        sketches.forEach([&](ActivityId, const QuantileSketch* sketch) {
+            memoryBytes += sizeof(QuantileSketch) + sizeof(std::uint64_t) * sketch->maximumBins();
+        });
+
+        // The registers are held inline, so the size of a sketch covers its register array.
+        static_assert(
+            sizeof(HyperLogLog) >= HyperLogLog::numberRegisters,
+            "HyperLogLog registers must be held inline."
+        );
+
+        distinctCounters.forEach([&](KeyRegistry::Slot, const HyperLogLog*) {
+            memoryBytes += sizeof(HyperLogLog);
+        });
+
+        const TimeSeries* eventTimeSeries = eventSeries.load(std::memory_order_acquire);
+        if (eventTimeSeries != Q_NULLPTR) {
+            memoryBytes += (
+                  eventTimeSeries->memoryUsage()
+                + activitySeries.load(std::memory_order_acquire)->memoryUsage()
+            );
+        }
+
+        memoryBytes       += timers.memoryUsage();
+        result.memoryBytes = memoryBytes;
+
+        result.unmappedKeys = events.unmappedKeys() + activities.unmappedKeys();
+
+        return result;
+    }
+
+
     bool UsageData::isTimerActive(const QString& timerName) const {
-        QMutexLocker locker(&timersMutex);
-        return timers.contains(timerName);
+        return timers.isActive(timerName);
     }
 
 
     void UsageData::loadSettings() {
+        std::int64_t startTime = monotonicClock.nsecsElapsed();
+
         currentSettings->beginGroup(currentSettingsGroup);
 
         enabled = currentSettings->value("enabled").toBool();
@@ -211,34 +585,95 @@ namespace Ud {
         lastOperation = currentSettings->value("last_operation", defaultLastOperation).toDateTime();
         nextOperation = currentSettings->value("next_operation", defaultNextOperation).toDateTime();
 
-        events.clear();
-        currentSettings->beginGroup("events");
+        // Counters held in memory-mapped files are already current once attached.
+        bool        mapped = !currentCounterDirectory.isEmpty();
+        QStringList keys;
+        if (!mapped || !events.isAttached()) {
+            events.clear();
+            savedEvents.clear();
+            currentSettings->beginGroup("events");
+
+            keys = currentSettings->allKeys();
+            for (QStringList::const_iterator it=keys.begin(), end=keys.end() ; it!=end ; ++it) {
+                std::uint64_t value = currentSettings->value(*it,0).toULongLong();
+                events.add(*it, value);
+                savedEvents.insert(*it, value);
+            }
 
-        eventsMutex.lock();
+            currentSettings->endGroup();
 
-        QStringList keys = currentSettings->allKeys();
-        for (QStringList::const_iterator it=keys.begin(), end=keys.end() ; it!=end ; ++it) {
-            std::uint64_t value = currentSettings->value(*it,0).toULongLong();
-            events.insert(*it, value);
-        }
+            activities.clear();
+            currentSettings->beginGroup("activities"); // Legacy values, in seconds.
 
-        eventsMutex.unlock();
+            keys = currentSettings->allKeys();
+            for (QStringList::const_iterator it=keys.begin(), end=keys.end() ; it!=end ; ++it) {
+                std::uint64_t value = currentSettings->value(*it,0).toULongLong();
+                activities.add(*it, value * defaultActivityResolution);
+            }
 
-        currentSettings->endGroup();
+            currentSettings->endGroup();
+
+            savedActivityTimes.clear();
+            currentSettings->beginGroup("activityTimes");
+
+            keys = currentSettings->allKeys();
+            for (QStringList::const_iterator it=keys.begin(), end=keys.end() ; it!=end ; ++it) {
+                std::uint64_t value = currentSettings->value(*it,0).toULongLong();
+                activities.add(*it, value);
+                savedActivityTimes.insert(*it, value);
+            }
 
-        activities.clear();
-        currentSettings->beginGroup("activities");
+            currentSettings->endGroup();
 
-        activitiesMutex.lock();
+            {
+                TimedMutexLocker locker(&journalMutex, mutexWaitTime, contendedLocks);
+                importJournal();
+            }
+
+            if (mapped) {
+                QDir directory(currentCounterDirectory);
+                directory.mkpath(".");
+
+                if (events.attach(directory.filePath("events.counters"))
+                    && activities.attach(directory.filePath("activities.counters"))) {
+                    // The files now hold these values so they must not be loaded from the settings or the journal
+                    // again.
+                    removeSettingIfPresent("events");
+                    removeSettingIfPresent("activities");
+                    removeSettingIfPresent("activityTimes");
+
+                    savedEvents.clear();
+                    savedActivityTimes.clear();
+
+                    TimedMutexLocker locker(&journalMutex, mutexWaitTime, contendedLocks);
+                    if (journal.isLoaded()) {
+                        journal.save(QHash<QString, std::uint64_t>(), QHash<QString, std::uint64_t>());
+                        journal.compact();
+                    }
+                } else {
+                    events.detach();
+                    activities.detach();
+                }
+            }
+        }
+
+        distinctCounters.forEach([](KeyRegistry::Slot, HyperLogLog* counter) {
+            counter->clear();
+        });
+
+        savedDistinct.clear();
+        currentSettings->beginGroup("distinct");
 
         keys = currentSettings->allKeys();
         for (QStringList::const_iterator it=keys.begin(), end=keys.end() ; it!=end ; ++it) {
-            std::uint64_t value = currentSettings->value(*it,0).toULongLong();
-            events.insert(*it, value);
+            HyperLogLog* counter = distinctCounter(KeyRegistry::slot(*it));
+            if (counter != Q_NULLPTR) {
+                QByteArray registers = currentSettings->value(*it).toByteArray();
+                counter->merge(registers);
+                savedDistinct.insert(*it, registers);
+            }
         }
 
-        activitiesMutex.unlock();
-
         currentSettings->endGroup();
 
         currentSettings->endGroup();
@@ -248,30 +683,254 @@ namespace Ud {
         } else {
             timer->stop();
         }
+
+        settingsLoaded = true;
+
+        lastLoadTime.store(
+            static_cast<std::uint64_t>(monotonicClock.nsecsElapsed() - startTime),
+            std::memory_order_relaxed
+        );
     }
 
 
     void UsageData::saveSettings() {
+        std::int64_t startTime = monotonicClock.nsecsElapsed();
+
         currentSettings->beginGroup(currentSettingsGroup);
 
-        currentSettings->setValue("enabled", enabled);
-        currentSettings->setValue("secret", static_cast<unsigned long long>(secret));
-        currentSettings->setValue("lastOperation", lastOperation);
-        currentSettings->setValue("nextOperation", nextOperation);
+        setSettingIfChanged("enabled", enabled);
+        setSettingIfChanged("secret", static_cast<unsigned long long>(secret));
+        setSettingIfChanged("last_operation", lastOperation);
+        setSettingIfChanged("next_operation", nextOperation);
 
-        currentSettings->beginGroup("events");
-        for (auto it=events.begin(), end=events.end() ; it!=end ; ++it) {
-            currentSettings->setValue(it.key(), static_cast<unsigned long long>(it.value()));
+        // Older releases saved the report times under keys that were never loaded.
+        removeSettingIfPresent("lastOperation");
+        removeSettingIfPresent("nextOperation");
+
+        QHash<QString, std::uint64_t> eventValues    = events.snapshot();
+        QHash<QString, std::uint64_t> activityValues = activities.snapshot();
+
+        bool journaled;
+        bool savedToJournal;
+        if (events.isAttached()) {
+            journaled      = true;
+            savedToJournal = true;
+        } else {
+            // A failed journal save leaves the journal consistent with the disk so the next save catches up.
+            TimedMutexLocker locker(&journalMutex, mutexWaitTime, contendedLocks);
+            journaled      = journal.isEnabled();
+            savedToJournal = journaled && journal.save(eventValues, activityValues);
         }
-        currentSettings->endGroup();
 
-        currentSettings->beginGroup("activities");
-        for (auto it=activities.begin(), end=activities.end() ; it!=end ; ++it) {
-            currentSettings->setValue(it.key(), static_cast<unsigned long long>(it.value()));
+        // The legacy activity totals, in seconds, are only dropped once the activity times are held elsewhere.
+        if (savedToJournal) {
+            removeSettingIfPresent("events");
+            removeSettingIfPresent("activities");
+            removeSettingIfPresent("activityTimes");
+
+            savedEvents.clear();
+            savedActivityTimes.clear();
+        } else if (!journaled) {
+            saveCounterGroup("events", eventValues, savedEvents);
+            saveCounterGroup("activityTimes", activityValues, savedActivityTimes);
+            removeSettingIfPresent("activities");
         }
+
+        QVector<QString> names = KeyRegistry::names();
+        currentSettings->beginGroup("distinct");
+        distinctCounters.forEach([&](KeyRegistry::Slot slot, const HyperLogLog* counter) {
+            const QString& name      = names.at(slot);
+            QByteArray     registers = counter->registerData();
+
+            if (HyperLogLog::estimate(registers) > 0) {
+                if (savedDistinct.value(name) != registers) {
+                    currentSettings->setValue(name, registers);
+                    savedDistinct.insert(name, registers);
+                }
+            } else if (savedDistinct.contains(name)) {
+                currentSettings->remove(name);
+                savedDistinct.remove(name);
+            }
+        });
         currentSettings->endGroup();
 
         currentSettings->endGroup();
+
+        lastSaveTime.store(
+            static_cast<std::uint64_t>(monotonicClock.nsecsElapsed() - startTime),
+            std::memory_order_relaxed
+        );
+    }
+
+
+    UsageData::EventId UsageData::registerEvent(const QString& eventName) {
+        return KeyRegistry::slot(eventName);
+    }
+
+
+    UsageData::ActivityId UsageData::registerActivity(const QString& activityName) {
+        return KeyRegistry::slot(activityName);
+    }
+
+
+    void UsageData::adjustEventById(UsageData::EventId eventId, unsigned adjustment) {
+        std::uint32_t weight = samplingWeight(samplingEnabled, eventSamplers, eventId);
+        if (weight != 0) {
+            std::uint64_t value = static_cast<std::uint64_t>(adjustment) * weight;
+            addToSeries(eventSeries, events.add(eventId, value), value);
+        }
+    }
+
+
+    void UsageData::adjustActivityById(UsageData::ActivityId activityId, std::int64_t adjustment) {
+        std::uint64_t resolution = currentActivityResolution.load(std::memory_order_relaxed);
+        std::uint32_t weight     = samplingWeight(samplingEnabled, activitySamplers, activityId);
+
+        if (weight != 0) {
+            recordAdjustment(activityId, adjustment, resolution, weight);
+        }
+    }
+
+
+    void UsageData::addActivityTime(UsageData::ActivityId activityId, std::uint64_t nanoseconds) {
+        recordActivity(activityId, nanoseconds);
+    }
+
+
+    void UsageData::addActivityTime(const QString& activityName, std::uint64_t nanoseconds) {
+        recordActivity(activities.admittedSlot(activityName, nanoseconds), nanoseconds);
+    }
+
+
+    void UsageData::enableHistogram(UsageData::ActivityId activityId) {
+        if (histograms.at(activityId) == Q_NULLPTR) {
+            histograms.insert(activityId, new Histogram);
+        }
+    }
+
+
+    void UsageData::enableHistogram(const QString& activityName) {
+        enableHistogram(KeyRegistry::slot(activityName));
+    }
+
+
+    void UsageData::enableSketch(UsageData::ActivityId activityId, double relativeAccuracy) {
+        if (sketches.at(activityId) == Q_NULLPTR) {
+            sketches.insert(activityId, new QuantileSketch(relativeAccuracy));
+        }
+    }
+
+
+    void UsageData::enableSketch(const QString& activityName, double relativeAccuracy) {
+        enableSketch(KeyRegistry::slot(activityName), relativeAccuracy);
+    }
+
+
+    void UsageData::observeDistinct(const QString& name, const QString& value) {
+        HyperLogLog* counter = distinctCounter(KeyRegistry::slot(name));
+        if (counter != Q_NULLPTR) {
+            counter->observe(value);
+        }
+    }
+
+
+    void UsageData::setEventSampling(UsageData::EventId eventId, std::uint32_t rate) {
+        Sampler* eventSampler = sampler(eventSamplers, eventId);
+        if (eventSampler != Q_NULLPTR) {
+            eventSampler->setRate(rate);
+        }
+    }
+
+
+    void UsageData::setEventSampling(const QString& eventName, std::uint32_t rate) {
+        setEventSampling(KeyRegistry::slot(eventName), rate);
+    }
+
+
+    void UsageData::setAdaptiveEventSampling(
+            UsageData::EventId eventId,
+            std::uint32_t      targetPerSecond,
+            std::uint32_t      maximumRate
+        ) {
+        Sampler* eventSampler = sampler(eventSamplers, eventId);
+        if (eventSampler != Q_NULLPTR) {
+            eventSampler->setAdaptive(targetPerSecond, maximumRate);
+        }
+    }
+
+
+    void UsageData::setAdaptiveEventSampling(
+            const QString& eventName,
+            std::uint32_t  targetPerSecond,
+            std::uint32_t  maximumRate
+        ) {
+        setAdaptiveEventSampling(KeyRegistry::slot(eventName), targetPerSecond, maximumRate);
+    }
+
+
+    std::uint32_t UsageData::eventSamplingRate(UsageData::EventId eventId) const {
+        const Sampler* eventSampler = eventSamplers.at(eventId);
+        return eventSampler == Q_NULLPTR ? 1 : eventSampler->rate();
+    }
+
+
+    void UsageData::setActivitySampling(UsageData::ActivityId activityId, std::uint32_t rate) {
+        Sampler* activitySampler = sampler(activitySamplers, activityId);
+        if (activitySampler != Q_NULLPTR) {
+            activitySampler->setRate(rate);
+        }
+    }
+
+
+    void UsageData::setActivitySampling(const QString& activityName, std::uint32_t rate) {
+        setActivitySampling(KeyRegistry::slot(activityName), rate);
+    }
+
+
+    void UsageData::setAdaptiveActivitySampling(
+            UsageData::ActivityId activityId,
+            std::uint32_t         targetPerSecond,
+            std::uint32_t         maximumRate
+        ) {
+        Sampler* activitySampler = sampler(activitySamplers, activityId);
+        if (activitySampler != Q_NULLPTR) {
+            activitySampler->setAdaptive(targetPerSecond, maximumRate);
+        }
+    }
+
+
+    void UsageData::setAdaptiveActivitySampling(
+            const QString& activityName,
+            std::uint32_t  targetPerSecond,
+            std::uint32_t  maximumRate
+        ) {
+        setAdaptiveActivitySampling(KeyRegistry::slot(activityName), targetPerSecond, maximumRate);
+    }
+
+
+    std::uint32_t UsageData::activitySamplingRate(UsageData::ActivityId activityId) const {
+        const Sampler* activitySampler = activitySamplers.at(activityId);
+        return activitySampler == Q_NULLPTR ? 1 : activitySampler->rate();
+    }
+
+
+    void UsageData::enableTimeSeries(unsigned bucketSeconds, unsigned numberBuckets) {
+        if (activitySeries.load(std::memory_order_acquire) == Q_NULLPTR) {
+            TimeSeries* newActivitySeries = new TimeSeries(bucketSeconds, numberBuckets);
+            TimeSeries* expected          = Q_NULLPTR;
+
+            // The activity series is published first so that a non-null event series implies both exist.
+            if (activitySeries.compare_exchange_strong(expected, newActivitySeries, std::memory_order_acq_rel)) {
+                eventSeries.store(new TimeSeries(bucketSeconds, numberBuckets), std::memory_order_release);
+            } else {
+                delete newActivitySeries;
+            }
+        }
+    }
+
+
+    bool UsageData::timeSeriesEnabled() const {
+        return eventSeries.load(std::memory_order_acquire) != Q_NULLPTR;
     }
 
 
@@ -298,68 +957,61 @@ namespace Ud {
 
 
     void UsageData::adjustEvent(const QString& eventName, unsigned adjustment) {
-        QMutexLocker locker(&eventsMutex);
-
-        if (events.contains(eventName)) {
-            events[eventName] += adjustment;
+        if (!samplingEnabled.load(std::memory_order_relaxed)) {
+            addToSeries(eventSeries, events.add(eventName, adjustment), adjustment);
         } else {
-            events.insert(eventName, adjustment);
+            std::uint32_t weight = samplingWeight(samplingEnabled, eventSamplers, KeyRegistry::find(eventName));
+            if (weight != 0) {
+                std::uint64_t value = static_cast<std::uint64_t>(adjustment) * weight;
+                addToSeries(eventSeries, events.add(eventName, value), value);
+            }
         }
     }
 
 
     void UsageData::adjustActivity(const QString& activityName, std::int64_t adjustment) {
-        QMutexLocker locker(&activitiesMutex);
+        std::uint64_t resolution = currentActivityResolution.load(std::memory_order_relaxed);
+        std::uint32_t weight     = samplingWeight(samplingEnabled, activitySamplers, KeyRegistry::find(activityName));
 
-        if (activities.contains(activityName)) {
-            activities[activityName] += adjustment;
-        } else {
-            activities.insert(activityName, adjustment);
+        if (weight != 0) {
+            // The name is admitted before it is registered so a bounded store also bounds the key registry.
+            std::uint64_t value = static_cast<std::uint64_t>(adjustment) * resolution * weight;
+            recordAdjustment(activities.admittedSlot(activityName, value), adjustment, resolution, weight);
         }
     }
 
 
     void UsageData::startTimer(const QString& timerName) {
-        QMutexLocker locker(&timersMutex);
-
-        Q_ASSERT(!timers.contains(timerName));
-        timers.insert(timerName, QDateTime::currentDateTimeUtc());
+        timers.start(timerName);
     }
 
 
     void UsageData::stopTimer(const QString& timerName, bool doStop) {
-        QMutexLocker locker(&timersMutex);
-        Q_ASSERT(timers.contains(timerName));
+        std::uint64_t elapsedTime;
+        bool          found = timers.stop(timerName, doStop, elapsedTime);
 
-        QDateTime endTime = QDateTime::currentDateTimeUtc();
-        QDateTime startTime;
+        Q_ASSERT(found);
 
-        if (doStop) {
-            startTime = timers.take(timerName);
-        } else {
-            startTime = timers.value(timerName);
-            timers[timerName] = endTime;
+        if (found) {
+            recordActivity(activities.admittedSlot(timerName, elapsedTime), elapsedTime);
         }
-
-        qint64 elapsedTime = startTime.secsTo(endTime);
-
-        adjustActivity(timerName, elapsedTime);
     }
 
 
     void UsageData::stopTimers() {
-        QMutexLocker locker(&timersMutex);
-        QDateTime endTime = QDateTime::currentDateTimeUtc();
+        TimerTable::ElapsedTimes elapsedTimes = timers.stopAll();
+        for (auto it=elapsedTimes.constBegin(),end=elapsedTimes.constEnd() ; it!=end ; ++it) {
+            recordActivity(activities.admittedSlot(it->first, it->second), it->second);
+        }
+    }
 
-        for (auto it=timers.begin(), end=timers.end() ; it!=end ; ++it) {
-            QString   timerName   = it.key();
-            QDateTime startTime   = it.value();
-            qint64    elapsedTime = startTime.secsTo(endTime);
 
-            adjustActivity(timerName, elapsedTime);
-        }
+    void UsageData::checkpoint() {
+        TimedMutexLocker locker(&journalMutex, mutexWaitTime, contendedLocks);
 
-        timers.clear();
+        if (journal.isEnabled() && !events.isAttached()) {
+            journal.save(events.snapshot(), activities.snapshot());
+        }
     }
 
 
@@ -368,32 +1020,64 @@ namespace Ud {
 
         adjustEventsAndActivities();
 
+        spool.remove(inFlightSpoolFiles);
+        inFlightSpoolFiles.clear();
+        inFlightPayload.clear();
+
         lastOperation = nextOperation;
         nextOperation = QDateTime::currentDateTimeUtc().addSecs(reportInterval);
 
         lastReportSuccessful = true;
 
-        if (enabled) {
-            scheduleReport(nextOperation);
+        CircuitState oldCircuitState = retryPolicy.circuitState();
+        retryPolicy.recordSuccess();
+
+        if (oldCircuitState != CircuitState::CLOSED) {
+            emit circuitStateChanged(CircuitState::CLOSED);
         }
 
-        emit reportingFinished(lastReportSuccessful);
-        currentlyIsReporting = false;
+        // The collector is reachable, so any reports still spooled are uploaded before the cycle completes.
+        if (!uploadSpool()) {
+            finishReport();
+        }
     }
 
 
     void UsageData::failed(int networkError) {
         Wh::WebHook::failed(networkError); // For test purposes.
 
-        nextOperation        = QDateTime::currentDateTimeUtc().addSecs(reportRetrialPeriod);
+        bool rejected = isRejection(networkError);
+        if (rejected) {
+            // Any spooled report in the batch may be the one rejected, so none of them are sent again.  The counters
+            // in the new report are restored and sent with the next report.
+            spool.remove(inFlightSpoolFiles);
+        } else {
+            spool.recordFailure(inFlightSpoolFiles);
+        }
+
+        if (!rejected && !inFlightPayload.isEmpty() && spool.add(inFlightPayload, inFlightFormat)) {
+            // The report is kept on disk, so the counters it holds are released rather than restored and the next
+            // report starts where this one ended.
+            adjustEventsAndActivities();
+            lastOperation = nextOperation;
+        } else {
+            restoreEventsAndActivities();
+        }
+
+        inFlightSpoolFiles.clear();
+        inFlightPayload.clear();
+
+        CircuitState       oldCircuitState = retryPolicy.circuitState();
+        unsigned long long retryDelay      = retryPolicy.recordFailure();
+
+        nextOperation        = QDateTime::currentDateTimeUtc().addSecs(static_cast<qint64>(retryDelay));
         lastReportSuccessful = false;
 
-        if (enabled) {
-            scheduleReport(nextOperation);
+        if (retryPolicy.circuitState() != oldCircuitState) {
+            emit circuitStateChanged(retryPolicy.circuitState());
         }
 
-        emit reportingFinished(false);
-        currentlyIsReporting = false;
+        finishReport();
     }
 
 
@@ -404,64 +1088,541 @@ namespace Ud {
         currentlyIsReporting = true;
         emit reportingStarted();
 
-        QJsonObject top;
+        if (retryPolicy.circuitState() == CircuitState::OPEN) {
+            retryPolicy.attemptStarted();
+            emit circuitStateChanged(CircuitState::HALF_OPEN);
+        }
+
+        PayloadFormat                 format       = currentPayloadFormat;
+        PayloadTransport::Compression compression  = payloadTransport->compression();
+        qint64                        elapsedTime  = lastOperation.secsTo(nextOperation);
+        bool                          useTransport = (
+               currentBackgroundReporting
+            || spool.isEnabled()
+            || format == PayloadFormat::CBOR
+            || compression != PayloadTransport::Compression::NONE
+        );
+
+        inFlightFormat = format;
+
+        // Every member is read or changed on this thread, so only the serialization is handed to a worker thread.
+        ReportSnapshot snapshot = snapshotReport(format, elapsedTime);
+        if (useTransport && spool.isEnabled()) {
+            snapshot.spooled = spool.entries(format, maximumSpooledReportsPerUpload);
+        }
+
+        if (currentBackgroundReporting) {
+            reportWatcher->setFuture(QtConcurrent::run([this, snapshot, compression, useTransport]() {
+                return prepareReport(snapshot, compression, useTransport);
+            }));
+        } else {
+            sendReport(prepareReport(snapshot, compression, useTransport));
+        }
+    }
 
-        top.insert("product", QCoreApplication::applicationName());
-        top.insert("version", QCoreApplication::applicationVersion());
-        top.insert("cpu_architecture", QSysInfo::currentCpuArchitecture());
-        top.insert("kernel_type", QSysInfo::kernelType());
-        top.insert("kernel_version", QSysInfo::kernelVersion());
-        top.insert("os_product_type", QSysInfo::productType());
-        top.insert("os_product_version", QSysInfo::productVersion());
-        top.insert("number_logical_cores", QThread::idealThreadCount());
-        top.insert("secret_id_low", static_cast<double>(static_cast<std::uint32_t>(secret      )));
-        top.insert("secret_id_high", static_cast<double>(static_cast<std::uint32_t>(secret >> 32)));
 
-        top.insert("elapsed_time", lastOperation.secsTo(nextOperation));
+    UsageData::ReportSnapshot UsageData::snapshotReport(UsageData::PayloadFormat format, qint64 elapsedTime) {
+        std::int64_t   startTime = monotonicClock.nsecsElapsed();
+        ReportSnapshot result;
 
-        eventsMutex.lock();
-        QStringList keys = events.keys();
-        eventsMutex.unlock();
+        result.format      = format;
+        result.elapsedTime = elapsedTime;
+        result.secret      = secret;
 
-        eventsAdjustment.clear();
-        QJsonObject eventsData;
-        for (QStringList::const_iterator it=keys.constBegin(),end=keys.constEnd() ; it!=end ; ++it) {
-            eventsMutex.lock();
-            std::uint64_t value = events.value(*it);
-            eventsMutex.unlock();
+        // Updates made while the report is in flight land in the newly active buffers.
+        result.eventCounts = events.retire();
 
-            eventsData.insert(*it, static_cast<double>(value));
-            eventsAdjustment.insert(*it, value);
+        updateTimers();
+        result.activityTimes = activities.retire();
+        result.resolution    = currentActivityResolution.load(std::memory_order_relaxed);
+        result.names         = KeyRegistry::names();
+
+        const QVector<QString>& names = result.names;
+
+        histogramsAdjustment.clear();
+        histograms.forEach([&](ActivityId activityId, const Histogram* histogram) {
+            QVector<std::uint64_t> bucketCounts = histogram->snapshot();
+
+            unsigned i = 0;
+            while (i < Histogram::numberBuckets && bucketCounts.at(i) == 0) {
+                ++i;
+            }
+
+            if (i < Histogram::numberBuckets) {
+                histogramsAdjustment.insert(activityId, bucketCounts);
+                result.detailedActivities.insert(names.at(activityId), activityId);
+            }
+        });
+
+        sketchesAdjustment.clear();
+        sketches.forEach([&](ActivityId activityId, const QuantileSketch* sketch) {
+            QuantileSketch sketchCopy(*sketch);
+            if (sketchCopy.count() > 0) {
+                sketchesAdjustment.insert(activityId, sketchCopy);
+                result.detailedActivities.insert(names.at(activityId), activityId);
+            }
+        });
+
+        distinctAdjustment.clear();
+        distinctCounters.forEach([&](KeyRegistry::Slot slot, const HyperLogLog* counter) {
+            QByteArray registers = counter->registerData();
+            if (HyperLogLog::estimate(registers) > 0) {
+                distinctAdjustment.insert(slot, registers);
+            }
+        });
+
+        result.histograms = histogramsAdjustment;
+        result.sketches   = sketchesAdjustment;
+        result.distinct   = distinctAdjustment;
+
+        // Time below the resolution is carried forward to the next report.
+        activitiesRemainder.clear();
+        for (auto it=result.activityTimes.constBegin(),end=result.activityTimes.constEnd() ; it!=end ; ++it) {
+            std::uint64_t remainder = it.value() % result.resolution;
+            if (remainder != 0) {
+                activitiesRemainder.insert(it.key(), remainder);
+            }
+        }
+
+        result.sampling = samplingEnabled.load(std::memory_order_relaxed);
+        if (result.sampling) {
+            auto captureRates = [&](const SlotTable<Sampler>& samplers, QVector<QPair<QString, std::uint32_t>>& rates) {
+                samplers.forEach([&](KeyRegistry::Slot slot, const Sampler* sampler) {
+                    std::uint32_t rate = sampler->rate();
+                    if (rate > 1 && slot < static_cast<KeyRegistry::Slot>(names.size())) {
+                        rates.append(qMakePair(names.at(slot), rate));
+                    }
+                });
+            };
+
+            captureRates(eventSamplers, result.eventRates);
+            captureRates(activitySamplers, result.activityRates);
+        }
+
+        TimeSeries* eventTimeSeries = eventSeries.load(std::memory_order_acquire);
+        result.timeSeries = (eventTimeSeries != Q_NULLPTR);
+        if (result.timeSeries) {
+            // Both series share one time so their windows line up.
+            std::int64_t now = TimeSeries::currentTime();
+
+            result.bucketSeconds   = eventTimeSeries->bucketSeconds();
+            result.firstTime       = 0;
+            result.eventBuckets    = eventTimeSeries->snapshot(now, &result.firstTime);
+            result.activityBuckets = activitySeries.load(std::memory_order_acquire)->snapshot(now);
+        }
+
+        // Upper bounds on any single key folded into the "__other__" counters.
+        result.eventsBound     = events.otherBound();
+        result.activitiesBound = (activities.otherBound() + result.resolution - 1) / result.resolution;
+
+        result.snapshotTime = static_cast<std::uint64_t>(monotonicClock.nsecsElapsed() - startTime);
+        return result;
+    }
+
+
+    QByteArray UsageData::writeReport(const UsageData::ReportSnapshot& snapshot, QJsonObject* object) {
+        std::int64_t startTime = monotonicClock.nsecsElapsed();
+
+        const QVector<QString>& names      = snapshot.names;
+        std::uint64_t           resolution = snapshot.resolution;
+
+        int reservedBytes = (
+              1024
+            + 48 * (snapshot.eventCounts.size() + snapshot.activityTimes.size())
+            + 6 * HyperLogLog::numberRegisters * snapshot.distinct.size() / 4
+        );
+
+        QScopedPointer<PayloadWriter> payloadWriter(
+              object == Q_NULLPTR
+            ? new PayloadWriter(snapshot.format, reservedBytes)
+            : new PayloadWriter(object)
+        );
+
+        PayloadWriter& writer = *payloadWriter;
+        writer.startMap();
+
+        writer.writeKey("product");
+        writer.writeString(QCoreApplication::applicationName());
+        writer.writeKey("version");
+        writer.writeString(QCoreApplication::applicationVersion());
+        writer.writeKey("cpu_architecture");
+        writer.writeString(QSysInfo::currentCpuArchitecture());
+        writer.writeKey("kernel_type");
+        writer.writeString(QSysInfo::kernelType());
+        writer.writeKey("kernel_version");
+        writer.writeString(QSysInfo::kernelVersion());
+        writer.writeKey("os_product_type");
+        writer.writeString(QSysInfo::productType());
+        writer.writeKey("os_product_version");
+        writer.writeString(QSysInfo::productVersion());
+        writer.writeKey("number_logical_cores");
+        writer.writeInteger(QThread::idealThreadCount());
+        writer.writeKey("secret_id_low");
+        writer.writeUnsigned(static_cast<std::uint32_t>(snapshot.secret      ));
+        writer.writeKey("secret_id_high");
+        writer.writeUnsigned(static_cast<std::uint32_t>(snapshot.secret >> 32));
+
+        writer.writeKey("elapsed_time");
+        writer.writeInteger(snapshot.elapsedTime);
+
+        writer.writeKey("events");
+        writer.startMap();
+        for (auto it=snapshot.eventCounts.constBegin(),end=snapshot.eventCounts.constEnd() ; it!=end ; ++it) {
+            writer.writeKey(it.key());
+            writer.writeUnsigned(it.value());
+        }
+        writer.endMap();
+
+        writer.writeKey("activity_resolution");
+        writer.writeUnsigned(resolution);
+
+        // Activities with a histogram or sketch are reported as an object holding the total and the distribution.
+        auto writeActivityDetails = [&](const QString& activityName, ActivityId activityId, std::uint64_t total) {
+            writer.writeKey(activityName);
+            writer.startMap();
+
+            writer.writeKey("total");
+            writer.writeUnsigned(total);
+
+            auto histogramIterator = snapshot.histograms.constFind(activityId);
+            if (histogramIterator != snapshot.histograms.constEnd()) {
+                const QVector<std::uint64_t>& bucketCounts = histogramIterator.value();
+
+                writer.writeKey("histogram");
+                writer.startArray();
+                for (unsigned i=0 ; i<Histogram::numberBuckets ; ++i) {
+                    std::uint64_t count = bucketCounts.at(i);
+                    if (count != 0) {
+                        writer.startArray();
+                        writer.writeUnsigned(Histogram::bucketLowerBound(i));
+                        writer.writeUnsigned(count);
+                        writer.endArray();
+                    }
+                }
+                writer.endArray();
+            }
+
+            auto sketchIterator = snapshot.sketches.constFind(activityId);
+            if (sketchIterator != snapshot.sketches.constEnd()) {
+                writer.writeKey("sketch");
+                writer.writeJson(sketchIterator.value().toJson());
+            }
+
+            writer.endMap();
+        };
+
+        QHash<QString, ActivityId> detailedActivities = snapshot.detailedActivities;
+
+        writer.writeKey("activities");
+        writer.startMap();
+        for (auto it=snapshot.activityTimes.constBegin(),end=snapshot.activityTimes.constEnd() ; it!=end ; ++it) {
+            std::uint64_t value = it.value() / resolution;
+
+            auto detailsIterator = detailedActivities.find(it.key());
+            if (detailsIterator != detailedActivities.end()) {
+                writeActivityDetails(it.key(), detailsIterator.value(), value);
+                detailedActivities.erase(detailsIterator);
+            } else if (value != 0) {
+                writer.writeKey(it.key());
+                writer.writeUnsigned(value);
+            }
+        }
+
+        for (auto it=detailedActivities.constBegin(),end=detailedActivities.constEnd() ; it!=end ; ++it) {
+            writeActivityDetails(it.key(), it.value(), 0);
+        }
+        writer.endMap();
+
+        writer.writeKey("distinct");
+        writer.startMap();
+        for (auto it=snapshot.distinct.constBegin(),end=snapshot.distinct.constEnd() ; it!=end ; ++it) {
+            writer.writeKey(names.at(it.key()));
+            writer.startMap();
+            writer.writeKey("estimate");
+            writer.writeUnsigned(static_cast<std::uint64_t>(std::round(HyperLogLog::estimate(it.value()))));
+            writer.writeKey("precision");
+            writer.writeUnsigned(HyperLogLog::precision);
+            writer.writeKey("registers");
+            writer.writeBytes(it.value());
+            writer.endMap();
+        }
+        writer.endMap();
+
+        if (snapshot.sampling) {
+            // Sampled values are already scaled up.  The rates let the collector judge their variance.
+            auto writeRates = [&](const QVector<QPair<QString, std::uint32_t>>& rates) {
+                writer.startMap();
+                for (auto it=rates.constBegin(),end=rates.constEnd() ; it!=end ; ++it) {
+                    writer.writeKey(it->first);
+                    writer.writeUnsigned(it->second);
+                }
+                writer.endMap();
+            };
+
+            writer.writeKey("sampling");
+            writer.startMap();
+            writer.writeKey("events");
+            writeRates(snapshot.eventRates);
+            writer.writeKey("activities");
+            writeRates(snapshot.activityRates);
+            writer.endMap();
         }
 
-        top.insert("events", eventsData);
+        if (snapshot.timeSeries) {
+            writer.writeKey("time_series");
+            writer.startMap();
+            writer.writeKey("bucket_seconds");
+            writer.writeUnsigned(snapshot.bucketSeconds);
+            writer.writeKey("start");
+            writer.writeInteger(snapshot.firstTime);
+
+            writer.writeKey("events");
+            writer.startMap();
+            for (auto it=snapshot.eventBuckets.constBegin(),end=snapshot.eventBuckets.constEnd() ; it!=end ; ++it) {
+                if (it.key() < static_cast<KeyRegistry::Slot>(names.size())) {
+                    const QVector<std::uint64_t>& buckets = it.value();
+
+                    writer.writeKey(names.at(it.key()));
+                    writer.startArray();
+                    for (auto bucket=buckets.constBegin(),last=buckets.constEnd() ; bucket!=last ; ++bucket) {
+                        writer.writeUnsigned(*bucket);
+                    }
+                    writer.endArray();
+                }
+            }
+            writer.endMap();
+
+            // Activity buckets may hold negative adjustments so they are written as signed values.
+            writer.writeKey("activities");
+            writer.startMap();
+            const QHash<KeyRegistry::Slot, QVector<std::uint64_t>>& activityBuckets = snapshot.activityBuckets;
+            for (auto it=activityBuckets.constBegin(),end=activityBuckets.constEnd() ; it!=end ; ++it) {
+                if (it.key() < static_cast<KeyRegistry::Slot>(names.size())) {
+                    const QVector<std::uint64_t>& buckets = it.value();
+
+                    writer.writeKey(names.at(it.key()));
+                    writer.startArray();
+                    for (auto bucket=buckets.constBegin(),last=buckets.constEnd() ; bucket!=last ; ++bucket) {
+                        writer.writeInteger(
+                            static_cast<std::int64_t>(*bucket) / static_cast<std::int64_t>(resolution)
+                        );
+                    }
+                    writer.endArray();
+                }
+            }
+            writer.endMap();
+
+            writer.endMap();
+        }
+
+        if (snapshot.eventsBound != 0 || snapshot.activitiesBound != 0) {
+            writer.writeKey("other_bound");
+            writer.startMap();
+            writer.writeKey("events");
+            writer.writeUnsigned(snapshot.eventsBound);
+            writer.writeKey("activities");
+            writer.writeUnsigned(snapshot.activitiesBound);
+            writer.endMap();
+        }
+
+        writer.endMap();
+
+        lastSnapshotTime.store(
+            snapshot.snapshotTime + static_cast<std::uint64_t>(monotonicClock.nsecsElapsed() - startTime),
+            std::memory_order_relaxed
+        );
+
+        return writer.data();
+    }
+
+
+    QByteArray UsageData::buildReport(UsageData::PayloadFormat format, qint64 elapsedTime) {
+        return writeReport(snapshotReport(format, elapsedTime));
+    }
+
 
-        timersMutex.lock();
-        keys = timers.keys();
-        timersMutex.unlock();
+    UsageData::PreparedReport UsageData::prepareReport(
+            const UsageData::ReportSnapshot& snapshot,
+            PayloadTransport::Compression    compression,
+            bool                             useTransport
+        ) {
+        PreparedReport result;
+
+        result.useTransport = useTransport;
+
+        if (!useTransport) {
+            // The web hook only accepts a JSON object, so the object is built directly rather than parsed back out
+            // of a streamed body.
+            writeReport(snapshot, &result.object);
+        } else {
+            result.payload = writeReport(snapshot);
+
+            QByteArray contentType = (
+                  snapshot.format == PayloadFormat::CBOR
+                ? QByteArray("application/cbor")
+                : QByteArray("application/json")
+            );
+
+            QByteArray body;
+            if (snapshot.spooled.isEmpty()) {
+                body = result.payload;
+            } else {
+                QList<QByteArray> payloads;
+                for (auto it=snapshot.spooled.constBegin(),end=snapshot.spooled.constEnd() ; it!=end ; ++it) {
+                    payloads.append(it->payload);
+                    result.spoolFiles.append(it->filename);
+                }
+
+                payloads.append(result.payload);
+                body = ReportSpool::combine(payloads, snapshot.format);
+            }
 
-        for (QStringList::const_iterator it=keys.constBegin(),end=keys.constEnd() ; it!=end ; ++it) {
-            stopTimer(*it, false);
+            result.request = PayloadTransport::prepare(body, contentType, compression, currentSharedSecret);
         }
 
-        activitiesMutex.lock();
-        keys = activities.keys();
-        activitiesMutex.unlock();
+        return result;
+    }
 
-        activitiesAdjustment.clear();
-        QJsonObject activitiesData;
-        for (QStringList::const_iterator it=keys.constBegin(),end=keys.constEnd() ; it!=end ; ++it) {
-            activitiesMutex.lock();
-            std::uint64_t value = activities.value(*it);
-            activitiesMutex.unlock();
 
-            activitiesData.insert(*it, static_cast<double>(value));
-            activitiesAdjustment.insert(*it, value);
+    void UsageData::sendReport(const UsageData::PreparedReport& report) {
+        if (spool.isEnabled()) {
+            inFlightPayload = report.payload;
         }
 
-        top.insert("activities", activitiesData);
+        inFlightSpoolFiles = report.spoolFiles;
+
+        lastPayloadBytes.store(static_cast<std::uint64_t>(report.payload.size()), std::memory_order_relaxed);
+        lastEncodedBytes.store(
+            static_cast<std::uint64_t>(report.useTransport ? report.request.body.size() : report.payload.size()),
+            std::memory_order_relaxed
+        );
 
-        send(currentDestinationUrl, top);
+        if (report.useTransport) {
+            payloadTransport->post(currentDestinationUrl, report.request);
+        } else {
+            send(currentDestinationUrl, report.object);
+        }
+    }
+
+
+    void UsageData::importJournal() {
+        if (journal.isEnabled() && journal.load()) {
+            QHash<QString, std::uint64_t> values = journal.values(CounterJournal::Table::EVENTS);
+            for (auto it=values.constBegin(), end=values.constEnd() ; it!=end ; ++it) {
+                events.add(it.key(), it.value());
+            }
+
+            values = journal.values(CounterJournal::Table::ACTIVITIES);
+            for (auto it=values.constBegin(), end=values.constEnd() ; it!=end ; ++it) {
+                activities.add(it.key(), it.value());
+            }
+        }
+    }
+
+
+    void UsageData::updateTimers() {
+        TimerTable::ElapsedTimes elapsedTimes = timers.lapAll();
+        for (auto it=elapsedTimes.constBegin(),end=elapsedTimes.constEnd() ; it!=end ; ++it) {
+            addToSeries(activitySeries, activities.add(it->first, it->second), it->second);
+        }
+    }
+
+
+    void UsageData::recordActivity(UsageData::ActivityId activityId, std::uint64_t nanoseconds, std::uint64_t weight) {
+        std::uint64_t value = nanoseconds * weight;
+        addToSeries(activitySeries, activities.add(activityId, value), value);
+
+        Histogram* histogram = histograms.at(activityId);
+        if (histogram != Q_NULLPTR) {
+            histogram->record(nanoseconds, weight);
+        }
+
+        QuantileSketch* sketch = sketches.at(activityId);
+        if (sketch != Q_NULLPTR) {
+            sketch->record(nanoseconds, weight);
+        }
+    }
+
+
+    void UsageData::recordAdjustment(
+            UsageData::ActivityId activityId,
+            std::int64_t          adjustment,
+            std::uint64_t         resolution,
+            std::uint64_t         weight
+        ) {
+        if (adjustment >= 0) {
+            recordActivity(activityId, static_cast<std::uint64_t>(adjustment) * resolution, weight);
+        } else {
+            std::uint64_t value = static_cast<std::uint64_t>(adjustment) * resolution * weight;
+            addToSeries(activitySeries, activities.add(activityId, value), value);
+        }
+    }
+
+
+    Sampler* UsageData::sampler(SlotTable<Sampler>& samplers, KeyRegistry::Slot slot) {
+        Sampler* result = samplers.at(slot);
+        if (result == Q_NULLPTR && slot != KeyRegistry::invalidSlot) {
+            result = samplers.insert(slot, new Sampler);
+            samplingEnabled.store(true, std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+
+    HyperLogLog* UsageData::distinctCounter(KeyRegistry::Slot slot) {
+        HyperLogLog* result = distinctCounters.at(slot);
+        if (result == Q_NULLPTR && slot != KeyRegistry::invalidSlot) {
+            result = distinctCounters.insert(slot, new HyperLogLog);
+        }
+
+        return result;
+    }
+
+
+    void UsageData::setSettingIfChanged(const QString& key, const QVariant& value) {
+        if (!currentSettings->contains(key) || currentSettings->value(key) != value) {
+            currentSettings->setValue(key, value);
+        }
+    }
+
+
+    void UsageData::removeSettingIfPresent(const QString& key) {
+        if (currentSettings->contains(key) || currentSettings->childGroups().contains(key)) {
+            currentSettings->remove(key);
+        }
+    }
+
+
+    void UsageData::saveCounterGroup(
+            const QString&                       group,
+            const QHash<QString, std::uint64_t>& values,
+            QHash<QString, std::uint64_t>&       savedValues
+        ) {
+        currentSettings->beginGroup(group);
+
+        // Keys that were fully reported are removed so they are not reloaded and reported again.
+        QList<QString> removedKeys;
+        for (auto it=savedValues.constBegin(), end=savedValues.constEnd() ; it!=end ; ++it) {
+            if (!values.contains(it.key())) {
+                removedKeys.append(it.key());
+            }
+        }
+
+        for (auto it=removedKeys.constBegin(), end=removedKeys.constEnd() ; it!=end ; ++it) {
+            currentSettings->remove(*it);
+            savedValues.remove(*it);
+        }
+
+        for (auto it=values.constBegin(), end=values.constEnd() ; it!=end ; ++it) {
+            auto savedIterator = savedValues.find(it.key());
+            if (savedIterator == savedValues.end() || savedIterator.value() != it.value()) {
+                currentSettings->setValue(it.key(), static_cast<unsigned long long>(it.value()));
+                savedValues.insert(it.key(), it.value());
+            }
+        }
+
+        currentSettings->endGroup();
     }
 
 
@@ -473,7 +1634,12 @@ namespace Ud {
     }
 
 
-    void UsageData::configure(QSettings* settings, const QUrl& destinationUrl) {
+    void UsageData::configure(
+            QSettings*             settings,
+            QNetworkAccessManager* networkAccessManager,
+            const QByteArray&      sharedSecret,
+            const QUrl&            destinationUrl
+        ) {
         currentSettings       = settings;
         currentDestinationUrl = destinationUrl;
         currentSettingsGroup  = defaultSettingsGroup;
@@ -481,59 +1647,181 @@ namespace Ud {
         reportInterval        = defaultReportingInterval;
         currentlyIsReporting  = false;
         lastReportSuccessful  = false;
+        currentPayloadFormat  = PayloadFormat::JSON;
+        currentSharedSecret   = sharedSecret;
+
+        currentBackgroundReporting = false;
+        settingsLoaded             = false;
+
+        currentActivityResolution.store(defaultActivityResolution, std::memory_order_relaxed);
+        monotonicClock.start();
+
+        samplingEnabled.store(false, std::memory_order_relaxed);
+        eventSeries.store(Q_NULLPTR, std::memory_order_relaxed);
+        activitySeries.store(Q_NULLPTR, std::memory_order_relaxed);
+
+        mutexWaitTime.store(0, std::memory_order_relaxed);
+        contendedLocks.store(0, std::memory_order_relaxed);
+        lastSnapshotTime.store(0, std::memory_order_relaxed);
+        lastPayloadBytes.store(0, std::memory_order_relaxed);
+        lastEncodedBytes.store(0, std::memory_order_relaxed);
+        lastLoadTime.store(0, std::memory_order_relaxed);
+        lastSaveTime.store(0, std::memory_order_relaxed);
+        rateStartTime.store(0, std::memory_order_relaxed);
+        rateStartCount.store(0, std::memory_order_relaxed);
+
+        qRegisterMetaType<Statistics>();
 
         timer = new QTimer(this);
         timer->setSingleShot(true);
         timer->setTimerType(Qt::VeryCoarseTimer);
 
         connect(timer, &QTimer::timeout, this, &UsageData::reportUsageData);
+
+        inFlightFormat = PayloadFormat::JSON;
+        spool.setSealKey(sharedSecret);
+        retryPolicy.setDelays(RetryPolicy::defaultBaseDelay, reportRetrialPeriod);
+
+        payloadTransport = new PayloadTransport(networkAccessManager, sharedSecret, this);
+        connect(payloadTransport, &PayloadTransport::responseReceived, this, &UsageData::jsonResponseWasReceived);
+        connect(payloadTransport, &PayloadTransport::failed, this, &UsageData::failed);
+
+        spoolTransport = new PayloadTransport(networkAccessManager, sharedSecret, this);
+        connect(spoolTransport, &PayloadTransport::responseReceived, this, &UsageData::spoolUploadFinished);
+        connect(spoolTransport, &PayloadTransport::failed, this, &UsageData::spoolUploadFailed);
+
+        reportWatcher = new QFutureWatcher<PreparedReport>(this);
+        connect(reportWatcher, &QFutureWatcher<PreparedReport>::finished, this, [this]() {
+            sendReport(reportWatcher->result());
+        });
     }
 
 
-    void UsageData::adjustEventsAndActivities() {
-        for (  QHash<QString, std::uint64_t>::const_iterator eventsIterator    = eventsAdjustment.constBegin(),
-                                                             eventsEndIterator = eventsAdjustment.constEnd()
-             ; eventsIterator != eventsEndIterator
-             ; ++eventsIterator
-            ) {
-            const QString& key        = eventsIterator.key();
-            std::uint64_t  adjustment = eventsIterator.value();
-
-            eventsMutex.lock();
-            std::uint64_t value = events.value(key);
-
-            if (value == adjustment) {
-                events.remove(key);
-            } else {
-                Q_ASSERT(adjustment < value);
-                events[key] = value - adjustment;
+    bool UsageData::uploadSpool() {
+        bool posted = false;
+
+        if (spool.isEnabled()) {
+            // Reports in the current format go first.  A batch only ever holds one format.
+            PayloadFormat formats[2] = {
+                currentPayloadFormat,
+                currentPayloadFormat == PayloadFormat::CBOR ? PayloadFormat::JSON : PayloadFormat::CBOR
+            };
+
+            unsigned i = 0;
+            while (!posted && i < 2) {
+                PayloadFormat             format  = formats[i];
+                QList<ReportSpool::Entry> spooled = spool.entries(format, maximumSpooledReportsPerUpload);
+
+                if (!spooled.isEmpty()) {
+                    QList<QByteArray> payloads;
+                    for (auto it=spooled.constBegin(),end=spooled.constEnd() ; it!=end ; ++it) {
+                        payloads.append(it->payload);
+                        inFlightSpoolBatch.append(it->filename);
+                    }
+
+                    spoolTransport->post(
+                        currentDestinationUrl,
+                        PayloadTransport::prepare(
+                            ReportSpool::combine(payloads, format),
+                              format == PayloadFormat::CBOR
+                            ? QByteArray("application/cbor")
+                            : QByteArray("application/json"),
+                            payloadTransport->compression(),
+                            currentSharedSecret
+                        )
+                    );
+
+                    posted = true;
+                }
+
+                ++i;
             }
+        }
+
+        return posted;
+    }
+
+
+    void UsageData::spoolUploadFinished(const QJsonDocument&) {
+        spool.remove(inFlightSpoolBatch);
+        inFlightSpoolBatch.clear();
 
-            eventsMutex.unlock();
+        if (!uploadSpool()) {
+            finishReport();
         }
+    }
 
-        for (  QHash<QString, std::uint64_t>::const_iterator activitiesIterator    = activitiesAdjustment.constBegin(),
-                                                             activitiesEndIterator = activitiesAdjustment.constEnd()
-             ; activitiesIterator != activitiesEndIterator
-             ; ++activitiesIterator
-            ) {
-            const QString& key        = activitiesIterator.key();
-            std::uint64_t  adjustment = activitiesIterator.value();
 
-            activitiesMutex.lock();
-            std::uint64_t value = activities.value(key);
+    void UsageData::spoolUploadFailed(int networkError) {
+        if (isRejection(networkError)) {
+            spool.remove(inFlightSpoolBatch);
+        } else {
+            spool.recordFailure(inFlightSpoolBatch);
+        }
 
-            if (value == adjustment) {
-                activities.remove(key);
-            } else {
-                Q_ASSERT(adjustment < value);
-                activities[key] = value - adjustment;
-            }
+        inFlightSpoolBatch.clear();
+
+        // The report that started the cycle succeeded.  Remaining reports wait for the next successful report.
+        finishReport();
+    }
 
-            activitiesMutex.unlock();
+
+    void UsageData::finishReport() {
+        if (enabled) {
+            scheduleReport(nextOperation);
+        }
+
+        emit reportingFinished(lastReportSuccessful);
+        currentlyIsReporting = false;
+
+        publishStatistics();
+    }
+
+
+    void UsageData::publishStatistics() {
+        if (isSignalConnected(QMetaMethod::fromSignal(&UsageData::statisticsUpdated))) {
+            emit statisticsUpdated(stats());
+        }
+
+        rateStartTime.store(monotonicClock.nsecsElapsed(), std::memory_order_relaxed);
+        rateStartCount.store(events.numberUpdates() + activities.numberUpdates(), std::memory_order_relaxed);
+    }
+
+
+    void UsageData::adjustEventsAndActivities() {
+        events.releaseRetired();
+        activities.releaseRetired();
+
+        for (auto it=activitiesRemainder.constBegin(),end=activitiesRemainder.constEnd() ; it!=end ; ++it) {
+            activities.add(it.key(), it.value());
+        }
+
+        for (auto it=histogramsAdjustment.constBegin(),end=histogramsAdjustment.constEnd() ; it!=end ; ++it) {
+            histograms.at(it.key())->subtract(it.value());
+        }
+
+        for (auto it=sketchesAdjustment.constBegin(),end=sketchesAdjustment.constEnd() ; it!=end ; ++it) {
+            sketches.at(it.key())->subtract(it.value());
+        }
+
+        for (auto it=distinctAdjustment.constBegin(),end=distinctAdjustment.constEnd() ; it!=end ; ++it) {
+            distinctCounters.at(it.key())->subtract(it.value());
         }
 
-        eventsAdjustment.clear();
-        activitiesAdjustment.clear();
+        activitiesRemainder.clear();
+        histogramsAdjustment.clear();
+        sketchesAdjustment.clear();
+        distinctAdjustment.clear();
+    }
+
+
+    void UsageData::restoreEventsAndActivities() {
+        events.restoreRetired();
+        activities.restoreRetired();
+
+        activitiesRemainder.clear();
+        histogramsAdjustment.clear();
+        sketchesAdjustment.clear();
+        distinctAdjustment.clear();
     }
 }
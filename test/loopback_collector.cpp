@@ -0,0 +1,260 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements a loopback stand-in for the usage data collector.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QUrl>
+#include <QString>
+#include <QTimer>
+#include <QPointer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+
+#include <ud_payload_transport.h>
+
+#include "loopback_collector.h"
+
+LoopbackCollector::LoopbackCollector(const QByteArray& sharedSecret, QObject* parent):QObject(parent) {
+    currentSharedSecret            = sharedSecret;
+    server                         = new QTcpServer(this);
+    currentResponse                = Response::ACKNOWLEDGE;
+    currentLatency                 = 0;
+    currentAcceptUnsignedRequests  = false;
+    currentNumberRequests          = 0;
+    currentNumberInvalidSignatures = 0;
+
+    connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+
+LoopbackCollector::~LoopbackCollector() {}
+
+
+bool LoopbackCollector::listen() {
+    return server->listen(QHostAddress::LocalHost);
+}
+
+
+void LoopbackCollector::close() {
+    server->close();
+}
+
+
+QUrl LoopbackCollector::url() const {
+    return QUrl(QString("http://127.0.0.1:%1/usage").arg(server->serverPort()));
+}
+
+
+LoopbackCollector::Response LoopbackCollector::response() const {
+    return currentResponse;
+}
+
+
+void LoopbackCollector::setResponse(LoopbackCollector::Response newResponse) {
+    currentResponse = newResponse;
+}
+
+
+unsigned LoopbackCollector::latency() const {
+    return currentLatency;
+}
+
+
+void LoopbackCollector::setLatency(unsigned newLatency) {
+    currentLatency = newLatency;
+}
+
+
+bool LoopbackCollector::acceptsUnsignedRequests() const {
+    return currentAcceptUnsignedRequests;
+}
+
+
+void LoopbackCollector::setAcceptUnsignedRequests(bool nowAccepted) {
+    currentAcceptUnsignedRequests = nowAccepted;
+}
+
+
+unsigned LoopbackCollector::numberRequests() const {
+    return currentNumberRequests;
+}
+
+
+unsigned LoopbackCollector::numberInvalidSignatures() const {
+    return currentNumberInvalidSignatures;
+}
+
+
+QHash<QByteArray, QByteArray> LoopbackCollector::lastHeaders() const {
+    return currentLastHeaders;
+}
+
+
+QByteArray LoopbackCollector::lastRawBody() const {
+    return currentLastRawBody;
+}
+
+
+QByteArray LoopbackCollector::lastBody() const {
+    return currentLastBody;
+}
+
+
+void LoopbackCollector::newConnection() {
+    QTcpSocket* socket = server->nextPendingConnection();
+    while (socket != Q_NULLPTR) {
+        pendingData.insert(socket, QByteArray());
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            pendingData.remove(socket);
+            socket->deleteLater();
+        });
+
+        socket = server->nextPendingConnection();
+    }
+}
+
+
+void LoopbackCollector::readyRead() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    QByteArray& data   = pendingData[socket];
+
+    data.append(socket->readAll());
+
+    int headerEnd = data.indexOf("\r\n\r\n");
+    if (headerEnd >= 0) {
+        QHash<QByteArray, QByteArray> headers;
+
+        QList<QByteArray> lines = data.left(headerEnd).split('\n');
+        for (int i=1 ; i<lines.size() ; ++i) {
+            const QByteArray& line      = lines.at(i);
+            int               separator = line.indexOf(':');
+            if (separator > 0) {
+                headers.insert(line.left(separator).trimmed().toLower(), line.mid(separator + 1).trimmed());
+            }
+        }
+
+        int contentLength = headers.value("content-length").toInt();
+        if (data.size() >= headerEnd + 4 + contentLength) {
+            QByteArray rawBody = data.mid(headerEnd + 4, contentLength);
+            data.clear();
+
+            QByteArray signature = Ud::PayloadTransport::signature(
+                currentSharedSecret,
+                headers.value(QByteArray(Ud::PayloadTransport::timestampHeader).toLower()),
+                rawBody
+            );
+            QByteArray signatureHeader = QByteArray(Ud::PayloadTransport::signatureHeader).toLower();
+            bool       signatureValid  = (signature == headers.value(signatureHeader));
+            bool       accepted        = (
+                   signatureValid
+                || (currentAcceptUnsignedRequests && !headers.contains(signatureHeader))
+            );
+
+            bool                              decoded     = false;
+            Ud::PayloadTransport::Compression compression = Ud::PayloadTransport::compressionForEncoding(
+                headers.value("content-encoding"),
+                &decoded
+            );
+
+            QByteArray body;
+            if (decoded) {
+                body = Ud::PayloadTransport::decompress(rawBody, compression, &decoded);
+            }
+
+            ++currentNumberRequests;
+            currentLastHeaders = headers;
+            currentLastRawBody = rawBody;
+            currentLastBody    = body;
+
+            int        statusCode;
+            QByteArray status;
+            if (!accepted) {
+                ++currentNumberInvalidSignatures;
+                statusCode = 401;
+                status     = "unauthorized";
+            } else if (!decoded) {
+                statusCode = 415;
+                status     = "unsupported encoding";
+            } else if (currentResponse == Response::FAIL) {
+                statusCode = 503;
+                status     = "failed";
+            } else if (currentResponse == Response::REJECT) {
+                statusCode = 400;
+                status     = "rejected";
+            } else {
+                statusCode = 200;
+                status     = "OK";
+            }
+
+            emit requestReceived(body, signatureValid);
+
+            if (currentLatency == 0) {
+                respond(socket, statusCode, status);
+            } else {
+                QPointer<QTcpSocket> guardedSocket(socket);
+                QTimer::singleShot(currentLatency, this, [guardedSocket, statusCode, status]() {
+                    if (!guardedSocket.isNull()) {
+                        respond(guardedSocket.data(), statusCode, status);
+                    }
+                });
+            }
+        }
+    }
+}
+
+
+void LoopbackCollector::respond(QTcpSocket* socket, int statusCode, const QByteArray& status) {
+    QByteArray reason;
+    switch (statusCode) {
+        case 200: { reason = "OK";                     break; }
+        case 400: { reason = "Bad Request";            break; }
+        case 401: { reason = "Unauthorized";           break; }
+        case 415: { reason = "Unsupported Media Type"; break; }
+        default:  { reason = "Service Unavailable";    break; }
+    }
+
+    QJsonObject responseObject;
+    responseObject.insert("status", QString::fromUtf8(status));
+
+    QByteArray response = QJsonDocument(responseObject).toJson(QJsonDocument::Compact);
+    socket->write(
+          QByteArray("HTTP/1.1 ") + QByteArray::number(statusCode) + " " + reason + "\r\n"
+        + QByteArray("Content-Type: application/json\r\nConnection: close\r\n")
+        + QByteArray("Content-Length: ") + QByteArray::number(response.size()) + QByteArray("\r\n\r\n")
+        + response
+    );
+
+    socket->disconnectFromHost();
+}
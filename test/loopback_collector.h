@@ -0,0 +1,229 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines a loopback stand-in for the usage data collector.
+***********************************************************************************************************************/
+
+#ifndef LOOPBACK_COLLECTOR_H
+#define LOOPBACK_COLLECTOR_H
+
+#include <QtGlobal>
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QUrl>
+
+#include <cstdint>
+
+class QTcpServer;
+class QTcpSocket;
+
+/**
+ * Class that accepts reports on the loopback interface the way the usage data collector does, so reporting can be
+ * tested and benchmarked without network access.
+ *
+ * The collector verifies the signature headers described in \ref Ud::PayloadTransport, decodes the body, and answers
+ * with a configurable response after an optional delay.  Requests with a missing or invalid signature are answered
+ * with HTTP status 401.
+ */
+class LoopbackCollector:public QObject {
+    Q_OBJECT
+
+    public:
+        /**
+         * Enumeration of responses sent to validly signed requests.
+         */
+        enum class Response : std::uint8_t {
+            /**
+             * Indicates the request is acknowledged with HTTP status 200 and a JSON status of "OK".
+             */
+            ACKNOWLEDGE = 0,
+
+            /**
+             * Indicates the request fails with HTTP status 503.
+             */
+            FAIL = 1,
+
+            /**
+             * Indicates the request body is rejected with HTTP status 400.
+             */
+            REJECT = 2
+        };
+
+        /**
+         * Constructor
+         *
+         * \param[in] sharedSecret The HMAC secret used to verify requests.
+         *
+         * \param[in] parent       Pointer to the parent object.
+         */
+        LoopbackCollector(const QByteArray& sharedSecret, QObject* parent = Q_NULLPTR);
+
+        ~LoopbackCollector() override;
+
+        /**
+         * Starts listening on an ephemeral loopback port.
+         *
+         * \return Returns true on success.  Returns false on error.
+         */
+        bool listen();
+
+        /**
+         * Stops listening.
+         */
+        void close();
+
+        /**
+         * Determines the URL reports should be posted to.
+         *
+         * \return Returns the collector URL.
+         */
+        QUrl url() const;
+
+        /**
+         * Determines the response sent to validly signed requests.
+         *
+         * \return Returns the current response.
+         */
+        Response response() const;
+
+        /**
+         * Sets the response sent to validly signed requests.
+         *
+         * \param[in] newResponse The new response.
+         */
+        void setResponse(Response newResponse);
+
+        /**
+         * Determines the delay added before each response.
+         *
+         * \return Returns the delay, in milliseconds.
+         */
+        unsigned latency() const;
+
+        /**
+         * Sets the delay added before each response.
+         *
+         * \param[in] newLatency The new delay, in milliseconds.
+         */
+        void setLatency(unsigned newLatency);
+
+        /**
+         * Determines if requests without a signature header are accepted.
+         *
+         * \return Returns true if unsigned requests are accepted.  Returns false if they are refused.
+         */
+        bool acceptsUnsignedRequests() const;
+
+        /**
+         * Sets whether requests without a signature header are accepted.  Reports sent through the web hook carry
+         * the web hook's own signature rather than the payload transport's headers, so this must be enabled to
+         * receive them.  Requests holding an invalid signature header are always refused.
+         *
+         * \param[in] nowAccepted If true, unsigned requests are accepted.  If false, they are refused.
+         */
+        void setAcceptUnsignedRequests(bool nowAccepted);
+
+        /**
+         * Determines the number of requests received.
+         *
+         * \return Returns the number of requests received.
+         */
+        unsigned numberRequests() const;
+
+        /**
+         * Determines the number of requests received with a missing or invalid signature.
+         *
+         * \return Returns the number of rejected requests.
+         */
+        unsigned numberInvalidSignatures() const;
+
+        /**
+         * Obtains the headers of the last request.  Header names are in lower case.
+         *
+         * \return Returns the request headers.
+         */
+        QHash<QByteArray, QByteArray> lastHeaders() const;
+
+        /**
+         * Obtains the body of the last request, as sent.
+         *
+         * \return Returns the raw request body.
+         */
+        QByteArray lastRawBody() const;
+
+        /**
+         * Obtains the body of the last request, after any content encoding is removed.
+         *
+         * \return Returns the decoded request body.
+         */
+        QByteArray lastBody() const;
+
+    signals:
+        /**
+         * Signal that is emitted when a complete request has been received, before the response is sent.
+         *
+         * \param[out] body           The decoded request body.
+         *
+         * \param[out] signatureValid Holds true if the request signature is valid.
+         */
+        void requestReceived(const QByteArray& body, bool signatureValid);
+
+    private slots:
+        /**
+         * Slot that accepts a new connection.
+         */
+        void newConnection();
+
+        /**
+         * Slot that reads request data from a connection.
+         */
+        void readyRead();
+
+    private:
+        /**
+         * Writes an HTTP response and closes the connection.
+         *
+         * \param[in] socket     The connection to respond on.
+         *
+         * \param[in] statusCode The HTTP status code.
+         *
+         * \param[in] status     The status reported in the JSON response body.
+         */
+        static void respond(QTcpSocket* socket, int statusCode, const QByteArray& status);
+
+        QByteArray                     currentSharedSecret;
+        QTcpServer*                    server;
+        Response                       currentResponse;
+        unsigned                       currentLatency;
+        bool                           currentAcceptUnsignedRequests;
+        unsigned                       currentNumberRequests;
+        unsigned                       currentNumberInvalidSignatures;
+        QHash<QTcpSocket*, QByteArray> pendingData;
+        QHash<QByteArray, QByteArray>  currentLastHeaders;
+        QByteArray                     currentLastRawBody;
+        QByteArray                     currentLastBody;
+};
+
+#endif
@@ -30,10 +30,40 @@ QT += core testlib gui widgets network
 CONFIG += testcase c++14
 
 HEADERS = application_wrapper.h \
+          loopback_collector.h \
+          test_update_counter.h \
+          test_counter_store.h \
+          test_histogram.h \
+          test_quantile_sketch.h \
+          test_hyper_log_log.h \
+          test_space_saving.h \
+          test_sampler.h \
+          test_time_series.h \
+          test_timer_table.h \
+          test_counter_journal.h \
+          test_payload_transport.h \
+          test_payload_writer.h \
+          test_report_spool.h \
+          test_retry_policy.h \
           test_usage_data.h \
 
 SOURCES = test_ineud.cpp \
           application_wrapper.cpp \
+          loopback_collector.cpp \
+          test_update_counter.cpp \
+          test_counter_store.cpp \
+          test_histogram.cpp \
+          test_quantile_sketch.cpp \
+          test_hyper_log_log.cpp \
+          test_space_saving.cpp \
+          test_sampler.cpp \
+          test_time_series.cpp \
+          test_timer_table.cpp \
+          test_counter_journal.cpp \
+          test_payload_transport.cpp \
+          test_payload_writer.cpp \
+          test_report_spool.cpp \
+          test_retry_policy.cpp \
           test_usage_data.cpp \
 
 ########################################################################################################################
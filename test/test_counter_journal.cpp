@@ -0,0 +1,199 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::CounterJournal class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <cstdint>
+
+#include <ud_counter_journal.h>
+
+#include "test_counter_journal.h"
+
+TestCounterJournal::TestCounterJournal() {}
+
+
+TestCounterJournal::~TestCounterJournal() {}
+
+
+void TestCounterJournal::testSaveAndLoad() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("counters.journal");
+
+    {
+        Ud::CounterJournal journal(filename);
+        QVERIFY(journal.load());
+
+        QHash<QString, std::uint64_t> events;
+        QHash<QString, std::uint64_t> activities;
+
+        events.insert("a", 3);
+        events.insert("b", 5);
+        activities.insert("t", 1000);
+        QVERIFY(journal.save(events, activities));
+
+        qint64 sizeAfterFirstSave = QFileInfo(filename).size();
+
+        QVERIFY(journal.save(events, activities));
+        QCOMPARE(QFileInfo(filename).size(), sizeAfterFirstSave);
+
+        events.insert("a", 4);
+        events.remove("b");
+        QVERIFY(journal.save(events, activities));
+    }
+
+    Ud::CounterJournal journal(filename);
+    QVERIFY(journal.load());
+
+    QHash<QString, std::uint64_t> events = journal.values(Ud::CounterJournal::Table::EVENTS);
+    QCOMPARE(events.size(), 1);
+    QCOMPARE(events.value("a"), std::uint64_t(4));
+    QCOMPARE(journal.values(Ud::CounterJournal::Table::ACTIVITIES).value("t"), std::uint64_t(1000));
+}
+
+
+void TestCounterJournal::testTornTail() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("counters.journal");
+
+    {
+        Ud::CounterJournal journal(filename);
+        QVERIFY(journal.load());
+
+        QHash<QString, std::uint64_t> events;
+        events.insert("a", 7);
+        QVERIFY(journal.save(events, QHash<QString, std::uint64_t>()));
+    }
+
+    qint64 validSize = QFileInfo(filename).size();
+
+    {
+        QFile file(filename);
+        QVERIFY(file.open(QFile::WriteOnly | QFile::Append));
+        file.write(QByteArray("\x02\x00\x01", 3));
+    }
+
+    Ud::CounterJournal journal(filename);
+    QVERIFY(journal.load());
+    QCOMPARE(QFileInfo(filename).size(), validSize);
+    QCOMPARE(journal.values(Ud::CounterJournal::Table::EVENTS).value("a"), std::uint64_t(7));
+}
+
+
+void TestCounterJournal::testUnknownHeader() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("counters.journal");
+    QByteArray    contents("not a counter journal");
+
+    {
+        QFile file(filename);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write(contents);
+    }
+
+    // A file that is not a journal must never be truncated or appended to.
+    Ud::CounterJournal journal(filename);
+    QCOMPARE(journal.load(), false);
+    QCOMPARE(journal.isLoaded(), false);
+    QCOMPARE(journal.save(QHash<QString, std::uint64_t>(), QHash<QString, std::uint64_t>()), false);
+
+    QFile file(filename);
+    QVERIFY(file.open(QFile::ReadOnly));
+    QCOMPARE(file.readAll(), contents);
+}
+
+
+void TestCounterJournal::testUnreadJournal() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("counters.journal");
+
+    QHash<QString, std::uint64_t> events;
+    events.insert("a", 3);
+
+    {
+        Ud::CounterJournal journal(filename);
+        QVERIFY(journal.load());
+        QVERIFY(journal.save(events, QHash<QString, std::uint64_t>()));
+    }
+
+    qint64 savedSize = QFileInfo(filename).size();
+
+    // A journal set but never loaded must not be appended to, or its values would be lost.
+    Ud::CounterJournal journal;
+    journal.setFilename(filename);
+    QCOMPARE(journal.isLoaded(), false);
+
+    events.insert("a", 1);
+    QCOMPARE(journal.save(events, QHash<QString, std::uint64_t>()), false);
+    QCOMPARE(journal.compact(), false);
+    QCOMPARE(QFileInfo(filename).size(), savedSize);
+
+    QVERIFY(journal.load());
+    QCOMPARE(journal.isLoaded(), true);
+    QCOMPARE(journal.values(Ud::CounterJournal::Table::EVENTS).value("a"), std::uint64_t(3));
+
+    events.insert("a", 4);
+    QVERIFY(journal.save(events, QHash<QString, std::uint64_t>()));
+
+    Ud::CounterJournal reloaded(filename);
+    QVERIFY(reloaded.load());
+    QCOMPARE(reloaded.values(Ud::CounterJournal::Table::EVENTS).value("a"), std::uint64_t(4));
+
+    // A journal that does not exist yet can be started without loading it.
+    Ud::CounterJournal fresh(directory.filePath("fresh.journal"));
+    QVERIFY(fresh.save(events, QHash<QString, std::uint64_t>()));
+}
+
+
+void TestCounterJournal::testCompaction() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("counters.journal");
+
+    {
+        Ud::CounterJournal journal(filename);
+        journal.setCompactionThreshold(1024);
+        QVERIFY(journal.load());
+
+        QHash<QString, std::uint64_t> events;
+        for (unsigned i=1 ; i<=1000 ; ++i) {
+            events.insert("a", i);
+            QVERIFY(journal.save(events, QHash<QString, std::uint64_t>()));
+        }
+
+        QVERIFY(QFileInfo(filename).size() <= 2048);
+    }
+
+    Ud::CounterJournal journal(filename);
+    QVERIFY(journal.load());
+    QCOMPARE(journal.values(Ud::CounterJournal::Table::EVENTS).value("a"), std::uint64_t(1000));
+}
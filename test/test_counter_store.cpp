@@ -0,0 +1,315 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::CounterStore and \ref Ud::KeyRegistry classes.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QHash>
+#include <QList>
+
+#include <cstdint>
+
+#include <ud_key_registry.h>
+#include <ud_counter_store.h>
+
+#include "test_counter_store.h"
+
+/**
+ * Static key resolved during static initialization.
+ */
+static const Ud::KeyRegistry::Slot staticInitializerSlot = UD_EVENT("test_counter_store_static_initializer");
+
+TestCounterStore::TestCounterStore() {}
+
+
+TestCounterStore::~TestCounterStore() {}
+
+
+void TestCounterStore::testSlotAssignment() {
+    QCOMPARE(Ud::KeyRegistry::find("test_counter_store_a"), Ud::KeyRegistry::invalidSlot);
+
+    Ud::KeyRegistry::Slot slotA = Ud::KeyRegistry::slot("test_counter_store_a");
+    Ud::KeyRegistry::Slot slotB = Ud::KeyRegistry::slot("test_counter_store_b");
+
+    QVERIFY(slotA != Ud::KeyRegistry::reservedSlot);
+    QVERIFY(slotA != slotB);
+    QCOMPARE(Ud::KeyRegistry::slot("test_counter_store_a"), slotA);
+    QCOMPARE(Ud::KeyRegistry::find("test_counter_store_b"), slotB);
+    QCOMPARE(Ud::KeyRegistry::names().at(slotA), QString("test_counter_store_a"));
+}
+
+
+void TestCounterStore::testStaticKeys() {
+    Ud::KeyRegistry::Slot staticSlot = UD_EVENT("test_counter_store_static");
+
+    QVERIFY(staticSlot != Ud::KeyRegistry::reservedSlot);
+    QCOMPARE(UD_EVENT("test_counter_store_static"), staticSlot);
+    QCOMPARE(Ud::KeyRegistry::slot("test_counter_store_static"), staticSlot);
+
+    QVERIFY(staticInitializerSlot != Ud::KeyRegistry::reservedSlot);
+    QCOMPARE(UD_EVENT("test_counter_store_static_initializer"), staticInitializerSlot);
+
+    Ud::CounterStore store;
+    store.add(UD_EVENT("test_counter_store_static"), 3);
+    QCOMPARE(store.snapshot().value("test_counter_store_static"), std::uint64_t(3));
+}
+
+
+void TestCounterStore::testSnapshot() {
+    Ud::CounterStore store;
+
+    store.add("a", 3);
+    store.add("b", 5);
+    store.add("a", 4);
+    store.add("c", static_cast<std::uint64_t>(std::int64_t(-2)));
+    store.add("c", 2);
+
+    QHash<QString, std::uint64_t> snapshot = store.snapshot();
+    QCOMPARE(snapshot.size(), 2);
+    QCOMPARE(snapshot.value("a"), std::uint64_t(7));
+    QCOMPARE(snapshot.value("b"), std::uint64_t(5));
+
+    // Keys registered elsewhere are skipped, while keys in later chunks are found once this store allocates them.
+    for (unsigned i=0 ; i<600 ; ++i) {
+        Ud::KeyRegistry::slot(QString("test_counter_store_spread_%1").arg(i));
+    }
+
+    QCOMPARE(store.snapshot().size(), 2);
+
+    store.add("test_counter_store_spread_599", 9);
+    snapshot = store.snapshot();
+    QCOMPARE(snapshot.size(), 3);
+    QCOMPARE(snapshot.value("test_counter_store_spread_599"), std::uint64_t(9));
+}
+
+
+void TestCounterStore::testRetireAndRestore() {
+    Ud::CounterStore store;
+
+    store.add("a", 3);
+    store.add("b", 5);
+
+    QHash<QString, std::uint64_t> retired = store.retire();
+    QCOMPARE(retired.size(), 2);
+    QCOMPARE(retired.value("a"), std::uint64_t(3));
+
+    store.add("a", 2);
+    QCOMPARE(store.snapshot().value("a"), std::uint64_t(5));
+
+    store.restoreRetired();
+    QCOMPARE(store.snapshot().value("a"), std::uint64_t(5));
+    QCOMPARE(store.snapshot().value("b"), std::uint64_t(5));
+
+    retired = store.retire();
+    QCOMPARE(retired.value("a"), std::uint64_t(5));
+
+    store.add("b", 1);
+    store.releaseRetired();
+
+    QHash<QString, std::uint64_t> snapshot = store.snapshot();
+    QCOMPARE(snapshot.size(), 1);
+    QCOMPARE(snapshot.value("b"), std::uint64_t(1));
+}
+
+
+void TestCounterStore::testMaximumKeys() {
+    Ud::CounterStore store;
+    store.setMaximumKeys(2);
+
+    QString otherName = QString::fromLatin1(Ud::CounterStore::otherName);
+
+    store.add("bounded_a", 10);
+    store.add("bounded_b", 1);
+    for (unsigned i=0 ; i<5 ; ++i) {
+        store.add("bounded_c", 1);
+    }
+    QCOMPARE(store.add("bounded_d", 1), Ud::KeyRegistry::find(otherName));
+
+    // Keys beyond the limit are folded into the other counter and never registered.
+    QCOMPARE(store.numberKeys(), 2U);
+    QCOMPARE(Ud::KeyRegistry::find("bounded_c"), Ud::CounterStore::invalidSlot);
+
+    QHash<QString, std::uint64_t> retired = store.retire();
+    QCOMPARE(retired.size(), 3);
+    QCOMPARE(retired.value("bounded_a"), std::uint64_t(10));
+    QCOMPARE(retired.value("bounded_b"), std::uint64_t(1));
+    QCOMPARE(retired.value(otherName), std::uint64_t(6));
+    QCOMPARE(store.otherBound(), std::uint64_t(5));
+    store.releaseRetired();
+
+    // The heavier overflow key replaces the lightest admitted key.
+    store.add("bounded_b", 1);
+    store.add("bounded_c", 1);
+
+    QHash<QString, std::uint64_t> snapshot = store.snapshot();
+    QCOMPARE(snapshot.value("bounded_c"), std::uint64_t(1));
+    QCOMPARE(snapshot.contains("bounded_b"), false);
+    QCOMPARE(snapshot.value(otherName), std::uint64_t(1));
+    QCOMPARE(store.numberKeys(), 2U);
+}
+
+
+void TestCounterStore::testMappedFile() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("test.counters");
+
+    {
+        Ud::CounterStore store;
+        store.add("mapped_a", 2);
+
+        QVERIFY(store.attach(filename, 1024));
+        QVERIFY(store.isAttached());
+        QCOMPARE(store.snapshot().value("mapped_a"), std::uint64_t(2));
+
+        store.add("mapped_a", 3);
+        store.add("mapped_b", 4);
+
+        // Retired values that were never released are treated as unreported.
+        store.retire();
+        store.add("mapped_c", 5);
+    }
+
+    {
+        Ud::CounterStore store;
+        QVERIFY(store.attach(filename, 1024));
+
+        QHash<QString, std::uint64_t> snapshot = store.snapshot();
+        QCOMPARE(snapshot.size(), 3);
+        QCOMPARE(snapshot.value("mapped_a"), std::uint64_t(5));
+        QCOMPARE(snapshot.value("mapped_b"), std::uint64_t(4));
+        QCOMPARE(snapshot.value("mapped_c"), std::uint64_t(5));
+
+        store.detach();
+        QVERIFY(!store.isAttached());
+        QCOMPARE(store.snapshot().value("mapped_a"), std::uint64_t(5));
+    }
+
+    Ud::CounterStore store;
+    QVERIFY(store.attach(filename, 1024));
+    QCOMPARE(store.snapshot().size(), 0);
+}
+
+
+void TestCounterStore::testUnmappedKeys() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("unmapped.counters");
+
+    Ud::CounterStore store;
+    for (unsigned i=0 ; i<600 ; ++i) {
+        store.add(QString("unmapped_%1").arg(i), 1);
+    }
+
+    QCOMPARE(store.unmappedKeys(), 0U);
+
+    // Only the first 512 slots fit in the file, so at least 88 of the 600 counters stay in memory.
+    QVERIFY(store.attach(filename, Ud::CounterStore::slotsPerChunk));
+    QVERIFY(store.unmappedKeys() >= 88U);
+    QCOMPARE(store.snapshot().value("unmapped_599"), std::uint64_t(1));
+
+    store.detach();
+    QCOMPARE(store.unmappedKeys(), 0U);
+    QCOMPARE(store.snapshot().value("unmapped_0"), std::uint64_t(1));
+}
+
+
+void TestCounterStore::testConcurrentUpdates() {
+    Ud::CounterStore store;
+    Ud::CounterStore::Slot slot = Ud::KeyRegistry::slot("shared");
+
+    QList<QThread*> threads;
+    for (unsigned i=0 ; i<numberThreads ; ++i) {
+        QThread* thread = QThread::create([&store, slot, i]() {
+            QString privateName = QString("private_%1").arg(i);
+            for (unsigned j=0 ; j<updatesPerThread ; ++j) {
+                store.add(slot, 1);
+                store.add(privateName, 2);
+            }
+        });
+
+        threads.append(thread);
+        thread->start();
+    }
+
+    for (auto it=threads.begin(),end=threads.end() ; it!=end ; ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+
+    QHash<QString, std::uint64_t> snapshot = store.snapshot();
+    QCOMPARE(snapshot.size(), static_cast<int>(numberThreads + 1));
+    QCOMPARE(snapshot.value("shared"), std::uint64_t(numberThreads) * updatesPerThread);
+
+    for (unsigned i=0 ; i<numberThreads ; ++i) {
+        QCOMPARE(snapshot.value(QString("private_%1").arg(i)), std::uint64_t(2) * updatesPerThread);
+    }
+}
+
+
+void TestCounterStore::testRetireDuringUpdates() {
+    Ud::CounterStore store;
+    Ud::CounterStore::Slot slot = Ud::KeyRegistry::slot("racing");
+
+    QList<QThread*> threads;
+    for (unsigned i=0 ; i<numberThreads ; ++i) {
+        QThread* thread = QThread::create([&store, slot]() {
+            for (unsigned j=0 ; j<updatesPerThread ; ++j) {
+                store.add(slot, 1);
+            }
+        });
+
+        threads.append(thread);
+        thread->start();
+    }
+
+    // Updates that race a retire land in either buffer but are reported exactly once.
+    std::uint64_t reported = 0;
+    bool          restore  = false;
+    for (auto it=threads.begin(),end=threads.end() ; it!=end ; ++it) {
+        while (!(*it)->isFinished()) {
+            std::uint64_t value = store.retire().value("racing");
+            if (restore) {
+                store.restoreRetired();
+            } else {
+                reported += value;
+                store.releaseRetired();
+            }
+
+            restore = !restore;
+        }
+
+        (*it)->wait();
+        delete *it;
+    }
+
+    reported += store.retire().value("racing");
+    store.releaseRetired();
+
+    QCOMPARE(reported, std::uint64_t(numberThreads) * updatesPerThread);
+    QCOMPARE(store.snapshot().value("racing"), std::uint64_t(0));
+}
@@ -0,0 +1,143 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::Histogram class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QVector>
+#include <QList>
+#include <QThread>
+
+#include <cstdint>
+
+#include <ud_histogram.h>
+
+#include "test_histogram.h"
+
+TestHistogram::TestHistogram() {}
+
+
+TestHistogram::~TestHistogram() {}
+
+
+void TestHistogram::testBucketBounds() {
+    QCOMPARE(Ud::Histogram::bucketLowerBound(0), std::uint64_t(0));
+    QCOMPARE(Ud::Histogram::bucketUpperBound(Ud::Histogram::numberBuckets - 1), ~std::uint64_t(0));
+
+    for (unsigned i=0 ; i<Ud::Histogram::numberBuckets - 1 ; ++i) {
+        QCOMPARE(Ud::Histogram::bucketUpperBound(i) + 1, Ud::Histogram::bucketLowerBound(i + 1));
+    }
+
+    std::uint64_t value = 1;
+    while (value < (std::uint64_t(1) << 62)) {
+        unsigned index = Ud::Histogram::bucketIndex(value);
+        QVERIFY(Ud::Histogram::bucketLowerBound(index) <= value);
+        QVERIFY(Ud::Histogram::bucketUpperBound(index) >= value);
+
+        value = value * 3 + 1;
+    }
+}
+
+
+void TestHistogram::testQuantiles() {
+    Ud::Histogram histogram;
+
+    for (std::uint64_t value=1 ; value<=100000 ; ++value) {
+        histogram.record(value * 1000);
+    }
+
+    QVector<std::uint64_t> counts = histogram.snapshot();
+
+    double p50 = static_cast<double>(Ud::Histogram::valueAtQuantile(counts, 0.50));
+    double p99 = static_cast<double>(Ud::Histogram::valueAtQuantile(counts, 0.99));
+
+    double maximumError = 1.0 / Ud::Histogram::subBucketCount;
+    QVERIFY(qAbs(p50 - 50000000.0) / 50000000.0 < maximumError);
+    QVERIFY(qAbs(p99 - 99000000.0) / 99000000.0 < maximumError);
+
+    QVector<std::uint64_t> empty(Ud::Histogram::numberBuckets, 0);
+    QCOMPARE(Ud::Histogram::valueAtQuantile(empty, 0.5), std::uint64_t(0));
+}
+
+
+void TestHistogram::testMerge() {
+    Ud::Histogram first;
+    Ud::Histogram second;
+
+    first.record(10);
+    first.record(1000);
+    second.record(1000, 3);
+
+    first.merge(second);
+
+    QVector<std::uint64_t> counts = first.snapshot();
+    QCOMPARE(counts.at(Ud::Histogram::bucketIndex(10)), std::uint64_t(1));
+    QCOMPARE(counts.at(Ud::Histogram::bucketIndex(1000)), std::uint64_t(4));
+
+    first.subtract(second.snapshot());
+
+    counts = first.snapshot();
+    QCOMPARE(counts.at(Ud::Histogram::bucketIndex(1000)), std::uint64_t(1));
+}
+
+
+void TestHistogram::testConcurrentRecording() {
+    Ud::Histogram histogram;
+
+    const unsigned numberThreads = 8;
+    const unsigned numberRecords = 100000;
+
+    QList<QThread*> threads;
+    for (unsigned i=0 ; i<numberThreads ; ++i) {
+        QThread* thread = QThread::create([&histogram, i]() {
+            for (unsigned j=0 ; j<numberRecords ; ++j) {
+                histogram.record(1000 * (i + 1));
+            }
+        });
+
+        threads.append(thread);
+        thread->start();
+    }
+
+    for (auto it=threads.begin(),end=threads.end() ; it!=end ; ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+
+    QVector<std::uint64_t> counts = histogram.snapshot();
+    for (unsigned i=0 ; i<numberThreads ; ++i) {
+        QCOMPARE(counts.at(Ud::Histogram::bucketIndex(1000 * (i + 1))), std::uint64_t(numberRecords));
+    }
+
+    // Subtracting a snapshot leaves every shard's contribution accounted for exactly once.
+    histogram.record(1000);
+    histogram.subtract(counts);
+
+    counts = histogram.snapshot();
+    QCOMPARE(counts.at(Ud::Histogram::bucketIndex(1000)), std::uint64_t(1));
+    QCOMPARE(counts.at(Ud::Histogram::bucketIndex(8000)), std::uint64_t(0));
+}
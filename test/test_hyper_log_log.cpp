@@ -0,0 +1,101 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::HyperLogLog class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QByteArray>
+#include <QScopedPointer>
+
+#include <cstdint>
+
+#include <ud_hyper_log_log.h>
+
+#include "test_hyper_log_log.h"
+
+TestHyperLogLog::TestHyperLogLog() {}
+
+
+TestHyperLogLog::~TestHyperLogLog() {}
+
+
+void TestHyperLogLog::testEstimate() {
+    QScopedPointer<Ud::HyperLogLog> counter(new Ud::HyperLogLog);
+    QCOMPARE(counter->estimate(), 0.0);
+
+    unsigned sizes[] = { 1, 10, 1000, 10000 };
+    for (unsigned size : sizes) {
+        counter->clear();
+
+        for (unsigned i=0 ; i<size ; ++i) {
+            counter->observe(QString("document_%1").arg(i));
+            counter->observe(QString("document_%1").arg(i));
+        }
+
+        double estimate = counter->estimate();
+        QVERIFY(qAbs(estimate - size) / size < 0.05);
+    }
+}
+
+
+void TestHyperLogLog::testMerge() {
+    QScopedPointer<Ud::HyperLogLog> first(new Ud::HyperLogLog);
+    QScopedPointer<Ud::HyperLogLog> second(new Ud::HyperLogLog);
+
+    for (unsigned i=0 ; i<20000 ; ++i) {
+        first->observe(QString::number(i));
+        second->observe(QString::number(i + 10000));
+    }
+
+    QByteArray registers = first->registerData();
+    Ud::HyperLogLog::mergeRegisters(
+        reinterpret_cast<std::uint8_t*>(registers.data()),
+        reinterpret_cast<const std::uint8_t*>(second->registerData().constData()),
+        Ud::HyperLogLog::numberRegisters
+    );
+
+    first->merge(second->registerData());
+
+    QCOMPARE(first->registerData(), registers);
+    QVERIFY(qAbs(first->estimate() - 30000.0) / 30000.0 < 0.05);
+}
+
+
+void TestHyperLogLog::testSubtract() {
+    QScopedPointer<Ud::HyperLogLog> counter(new Ud::HyperLogLog);
+
+    for (unsigned i=0 ; i<1000 ; ++i) {
+        counter->observe(QString::number(i));
+    }
+
+    QByteArray reported = counter->registerData();
+    counter->observe(QString("late_value"));
+    counter->subtract(reported);
+
+    QVERIFY(counter->estimate() < 1.5);
+}
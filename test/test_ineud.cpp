@@ -29,11 +29,39 @@
 
 #include "application_wrapper.h"
 
+#include "test_update_counter.h"
+#include "test_counter_store.h"
+#include "test_histogram.h"
+#include "test_quantile_sketch.h"
+#include "test_hyper_log_log.h"
+#include "test_space_saving.h"
+#include "test_sampler.h"
+#include "test_time_series.h"
+#include "test_timer_table.h"
+#include "test_counter_journal.h"
+#include "test_payload_transport.h"
+#include "test_payload_writer.h"
+#include "test_report_spool.h"
+#include "test_retry_policy.h"
 #include "test_usage_data.h"
 
 int main(int argumentCount, char** argumentValues) {
     ApplicationWrapper wrapper(argumentCount, argumentValues);
 
+    wrapper.includeTest(new TestUpdateCounter);
+    wrapper.includeTest(new TestCounterStore);
+    wrapper.includeTest(new TestHistogram);
+    wrapper.includeTest(new TestQuantileSketch);
+    wrapper.includeTest(new TestHyperLogLog);
+    wrapper.includeTest(new TestSpaceSaving);
+    wrapper.includeTest(new TestSampler);
+    wrapper.includeTest(new TestTimeSeries);
+    wrapper.includeTest(new TestTimerTable);
+    wrapper.includeTest(new TestCounterJournal);
+    wrapper.includeTest(new TestPayloadTransport);
+    wrapper.includeTest(new TestPayloadWriter);
+    wrapper.includeTest(new TestReportSpool);
+    wrapper.includeTest(new TestRetryPolicy);
     wrapper.includeTest(new TestUsageData);
     int status = wrapper.exec();
 
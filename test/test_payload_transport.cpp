@@ -0,0 +1,178 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::PayloadTransport class.  Payloads are posted to a
+* \ref LoopbackCollector.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include <QByteArray>
+#include <QUrl>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QThread>
+
+#include <ud_payload_transport.h>
+
+#include "loopback_collector.h"
+#include "test_payload_transport.h"
+
+const char TestPayloadTransport::testSecret[] = "test_payload_transport_secret";
+
+TestPayloadTransport::TestPayloadTransport() {
+    networkAccessManager = new QNetworkAccessManager(this);
+    collector            = new LoopbackCollector(QByteArray(testSecret), this);
+}
+
+
+TestPayloadTransport::~TestPayloadTransport() {}
+
+
+void TestPayloadTransport::initTestCase() {
+    QVERIFY(collector->listen());
+}
+
+
+void TestPayloadTransport::testCompression() {
+    QJsonObject events;
+    for (unsigned i=0 ; i<1000 ; ++i) {
+        events.insert(QString("application_event_%1").arg(i), static_cast<int>(i));
+    }
+
+    QJsonObject report;
+    report.insert("events", events);
+
+    QByteArray payload    = QJsonDocument(report).toJson(QJsonDocument::Compact);
+    QByteArray compressed = Ud::PayloadTransport::compress(payload, Ud::PayloadTransport::Compression::DEFLATE);
+    QVERIFY(compressed.size() < payload.size() / 4);
+
+    bool ok = false;
+    QCOMPARE(
+        Ud::PayloadTransport::decompress(compressed, Ud::PayloadTransport::Compression::DEFLATE, &ok),
+        payload
+    );
+    QCOMPARE(ok, true);
+
+    Ud::PayloadTransport::decompress(QByteArray("not a zlib stream"), Ud::PayloadTransport::Compression::DEFLATE, &ok);
+    QCOMPARE(ok, false);
+
+    QCOMPARE(Ud::PayloadTransport::compress(payload, Ud::PayloadTransport::Compression::NONE), payload);
+}
+
+
+void TestPayloadTransport::testSignature() {
+    QByteArray signature = Ud::PayloadTransport::signature("secret", "1000", "body");
+
+    QCOMPARE(signature.size(), 64);
+    QCOMPARE(Ud::PayloadTransport::signature("secret", "1000", "body"), signature);
+    QVERIFY(Ud::PayloadTransport::signature("secret", "1001", "body") != signature);
+    QVERIFY(Ud::PayloadTransport::signature("secreT", "1000", "body") != signature);
+    QVERIFY(Ud::PayloadTransport::signature("secret", "1000", "bodY") != signature);
+}
+
+
+void TestPayloadTransport::testCompressedRoundTrip() {
+    Ud::PayloadTransport transport(networkAccessManager, QByteArray(testSecret));
+    transport.setCompression(Ud::PayloadTransport::Compression::DEFLATE);
+
+    QSignalSpy responseSpy(&transport, &Ud::PayloadTransport::responseReceived);
+    QSignalSpy failedSpy(&transport, &Ud::PayloadTransport::failed);
+
+    QJsonObject report;
+    report.insert("product", QString("test_ineud"));
+    report.insert("elapsed_time", 3600);
+
+    QByteArray payload = QJsonDocument(report).toJson(QJsonDocument::Compact);
+    transport.send(collector->url(), payload);
+
+    QVERIFY(responseSpy.wait(10000));
+    QCOMPARE(failedSpy.count(), 0);
+
+    QJsonDocument response = responseSpy.at(0).at(0).value<QJsonDocument>();
+    QCOMPARE(response.object().value("status").toString(), QString("OK"));
+
+    QCOMPARE(collector->lastHeaders().value("content-encoding"), QByteArray("deflate"));
+    QCOMPARE(collector->lastBody(), payload);
+}
+
+
+void TestPayloadTransport::testPreparedRequest() {
+    Ud::PayloadTransport transport(networkAccessManager, QByteArray(testSecret));
+
+    QSignalSpy responseSpy(&transport, &Ud::PayloadTransport::responseReceived);
+    QSignalSpy failedSpy(&transport, &Ud::PayloadTransport::failed);
+
+    QByteArray payload("{\"product\":\"test_ineud\"}");
+
+    // Requests are compressed and signed on a worker thread and posted from the thread owning the manager.
+    Ud::PayloadTransport::Request request;
+    QThread* thread = QThread::create([&request, &payload]() {
+        request = Ud::PayloadTransport::prepare(
+            payload,
+            QByteArray("application/json"),
+            Ud::PayloadTransport::Compression::DEFLATE,
+            QByteArray(testSecret)
+        );
+    });
+
+    thread->start();
+    thread->wait();
+    delete thread;
+
+    QCOMPARE(request.contentEncoding, QByteArray("deflate"));
+    QCOMPARE(request.signature, Ud::PayloadTransport::signature(testSecret, request.timestamp, request.body));
+
+    transport.post(collector->url(), request);
+
+    QVERIFY(responseSpy.wait(10000));
+    QCOMPARE(failedSpy.count(), 0);
+
+    QJsonDocument response = responseSpy.at(0).at(0).value<QJsonDocument>();
+    QCOMPARE(response.object().value("status").toString(), QString("OK"));
+    QCOMPARE(collector->lastRawBody(), request.body);
+}
+
+
+void TestPayloadTransport::testInvalidSignature() {
+    Ud::PayloadTransport transport(networkAccessManager, QByteArray("wrong secret"));
+
+    QSignalSpy responseSpy(&transport, &Ud::PayloadTransport::responseReceived);
+    QSignalSpy failedSpy(&transport, &Ud::PayloadTransport::failed);
+
+    unsigned numberInvalidSignatures = collector->numberInvalidSignatures();
+    transport.send(collector->url(), QByteArray("{}"));
+
+    QVERIFY(failedSpy.wait(10000));
+    QCOMPARE(responseSpy.count(), 0);
+    QCOMPARE(collector->numberInvalidSignatures(), numberInvalidSignatures + 1);
+}
+
+
+void TestPayloadTransport::cleanupTestCase() {
+    collector->close();
+}
@@ -0,0 +1,191 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::PayloadWriter class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCborValue>
+#include <QCborMap>
+
+#include <cstdint>
+
+#include <ud_payload_writer.h>
+
+#include "test_payload_writer.h"
+
+TestPayloadWriter::TestPayloadWriter() {}
+
+
+TestPayloadWriter::~TestPayloadWriter() {}
+
+
+void TestPayloadWriter::testJsonStructure() {
+    QJsonObject sketch;
+    sketch.insert("relative_accuracy", 0.01);
+    sketch.insert("counts", QJsonArray({ 3, 4 }));
+
+    Ud::PayloadWriter writer(Ud::PayloadWriter::Format::JSON);
+    writer.startMap();
+    writer.writeKey("a");
+    writer.writeUnsigned(9007199254740993ULL);
+    writer.writeKey("b");
+    writer.startArray();
+    writer.writeInteger(-1);
+    writer.startArray();
+    writer.endArray();
+    writer.writeBoolean(true);
+    writer.endArray();
+    writer.writeKey("c");
+    writer.startMap();
+    writer.endMap();
+    writer.writeKey("d");
+    writer.writeDouble(0.5);
+    writer.writeKey("e");
+    writer.writeBytes(QByteArray("\x01\x02\x03", 3));
+    writer.writeKey("f");
+    writer.writeJson(sketch);
+    writer.endMap();
+
+    QCOMPARE(
+        writer.data(),
+        QByteArray(
+            "{\"a\":9007199254740993,\"b\":[-1,[],true],\"c\":{},\"d\":0.5,\"e\":\"AQID\","
+            "\"f\":{\"counts\":[3,4],\"relative_accuracy\":0.01}}"
+        )
+    );
+
+    QJsonParseError parseError;
+    QJsonDocument::fromJson(writer.data(), &parseError);
+    QCOMPARE(parseError.error, QJsonParseError::NoError);
+}
+
+
+void TestPayloadWriter::testJsonEscapes() {
+    QString key = QString("quote\" slash\\ tab\t bell\x07 ") + QChar(0x00E9);
+
+    Ud::PayloadWriter writer(Ud::PayloadWriter::Format::JSON);
+    writer.startMap();
+    writer.writeKey(key);
+    writer.writeUnsigned(1);
+    writer.endMap();
+
+    QCOMPARE(
+        writer.data(),
+        QByteArray("{\"quote\\\" slash\\\\ tab\\t bell\\u0007 \xC3\xA9\":1}")
+    );
+
+    QJsonObject object = QJsonDocument::fromJson(writer.data()).object();
+    QCOMPARE(object.keys().size(), 1);
+    QCOMPARE(object.keys().first(), key);
+}
+
+
+void TestPayloadWriter::testCbor() {
+    Ud::PayloadWriter writer(Ud::PayloadWriter::Format::CBOR);
+    writer.startMap();
+    writer.writeKey("counter");
+    writer.writeUnsigned(9007199254740993ULL);
+    writer.writeKey("registers");
+    writer.writeBytes(QByteArray("\x01\x02\x03", 3));
+    writer.writeKey("nested");
+    writer.startMap();
+    writer.writeKey("name");
+    writer.writeString("value");
+    writer.endMap();
+    writer.endMap();
+
+    QCborMap map = QCborValue::fromCbor(writer.data()).toMap();
+    QCOMPARE(map.value("counter").isInteger(), true);
+    QCOMPARE(map.value("counter").toInteger(), Q_INT64_C(9007199254740993));
+    QCOMPARE(map.value("registers").toByteArray(), QByteArray("\x01\x02\x03", 3));
+    QCOMPARE(map.value("nested").toMap().value("name").toString(), QString("value"));
+}
+
+
+void TestPayloadWriter::testJsonObject() {
+    QJsonObject sketch;
+    sketch.insert("relative_accuracy", 0.01);
+    sketch.insert("counts", QJsonArray({ 3, 4 }));
+
+    QJsonObject       object;
+    Ud::PayloadWriter writer(&object);
+    writer.startMap();
+    writer.writeKey("a");
+    writer.writeUnsigned(5);
+    writer.writeKey("b");
+    writer.startArray();
+    writer.writeInteger(-1);
+    writer.startArray();
+    writer.endArray();
+    writer.writeBoolean(true);
+    writer.endArray();
+    writer.writeKey("c");
+    writer.startMap();
+    writer.writeKey("name");
+    writer.writeString("value");
+    writer.endMap();
+    writer.writeKey("d");
+    writer.writeDouble(0.5);
+    writer.writeKey("e");
+    writer.writeBytes(QByteArray("\x01\x02\x03", 3));
+    writer.writeKey("f");
+    writer.writeJson(sketch);
+    writer.endMap();
+
+    QCOMPARE(writer.data().isEmpty(), true);
+
+    Ud::PayloadWriter streamed(Ud::PayloadWriter::Format::JSON);
+    streamed.startMap();
+    streamed.writeKey("a");
+    streamed.writeUnsigned(5);
+    streamed.writeKey("b");
+    streamed.startArray();
+    streamed.writeInteger(-1);
+    streamed.startArray();
+    streamed.endArray();
+    streamed.writeBoolean(true);
+    streamed.endArray();
+    streamed.writeKey("c");
+    streamed.startMap();
+    streamed.writeKey("name");
+    streamed.writeString("value");
+    streamed.endMap();
+    streamed.writeKey("d");
+    streamed.writeDouble(0.5);
+    streamed.writeKey("e");
+    streamed.writeBytes(QByteArray("\x01\x02\x03", 3));
+    streamed.writeKey("f");
+    streamed.writeJson(sketch);
+    streamed.endMap();
+
+    QCOMPARE(object, QJsonDocument::fromJson(streamed.data()).object());
+}
@@ -0,0 +1,130 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::QuantileSketch class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <cstdint>
+#include <cmath>
+
+#include <ud_quantile_sketch.h>
+
+#include "test_quantile_sketch.h"
+
+TestQuantileSketch::TestQuantileSketch() {}
+
+
+TestQuantileSketch::~TestQuantileSketch() {}
+
+
+void TestQuantileSketch::testAccuracy() {
+    Ud::QuantileSketch sketch(0.01);
+
+    for (std::uint64_t value=1 ; value<=10000 ; ++value) {
+        sketch.record(value * 1000);
+    }
+
+    QCOMPARE(sketch.count(), std::uint64_t(10000));
+
+    double quantiles[] = { 0.0, 0.5, 0.9, 0.99, 0.999, 1.0 };
+    for (double quantile : quantiles) {
+        double expected = 1000.0 * (1 + static_cast<std::uint64_t>(quantile * 9999));
+        double measured = sketch.valueAtQuantile(quantile);
+        QVERIFY(qAbs(measured - expected) / expected <= 0.01 + 1.0E-9);
+    }
+
+    QCOMPARE(Ud::QuantileSketch().valueAtQuantile(0.5), 0.0);
+}
+
+
+void TestQuantileSketch::testBoundedBins() {
+    Ud::QuantileSketch sketch(0.01, 64);
+
+    std::uint64_t value = 1;
+    for (unsigned i=0 ; i<60 ; ++i) {
+        sketch.record(value);
+        value *= 2;
+    }
+
+    QJsonObject json = sketch.toJson();
+    QVERIFY(json.value("counts").toArray().size() <= 64);
+
+    // The lowest values are collapsed, the maximum is still accurate.
+    double maximum = static_cast<double>(value / 2);
+    QVERIFY(qAbs(sketch.valueAtQuantile(1.0) - maximum) / maximum <= 0.01 + 1.0E-9);
+    QCOMPARE(sketch.count(), std::uint64_t(60));
+}
+
+
+void TestQuantileSketch::testMergeAndSubtract() {
+    Ud::QuantileSketch first;
+    Ud::QuantileSketch second;
+
+    for (std::uint64_t value=1 ; value<=1000 ; ++value) {
+        first.record(value);
+        second.record(value + 1000);
+    }
+
+    Ud::QuantileSketch earlier(first);
+
+    first.merge(second);
+    first.record(0, 10);
+
+    QCOMPARE(first.count(), std::uint64_t(2010));
+    QVERIFY(qAbs(first.valueAtQuantile(1.0) - 2000.0) / 2000.0 <= 0.01 + 1.0E-9);
+    QCOMPARE(first.valueAtQuantile(0.0), 0.0);
+
+    first.subtract(earlier);
+
+    QCOMPARE(first.count(), std::uint64_t(1010));
+    QVERIFY(qAbs(first.valueAtQuantile(0.5) - 1500.0) / 1500.0 <= 0.02);
+}
+
+
+void TestQuantileSketch::testSerialization() {
+    Ud::QuantileSketch sketch(0.02);
+
+    sketch.record(0);
+    sketch.record(1000, 3);
+    sketch.record(1001);
+
+    QJsonObject json = sketch.toJson();
+    QCOMPARE(json.value("relative_accuracy").toDouble(), 0.02);
+    QCOMPARE(json.value("zero_count").toInt(), 1);
+
+    QJsonArray counts = json.value("counts").toArray();
+    QCOMPARE(counts.size(), 1);
+    QCOMPARE(counts.at(0).toInt(), 4);
+
+    double gamma = 1.02 / 0.98;
+    int    index = json.value("offset").toInt();
+    double value = 2.0 * std::pow(gamma, index) / (gamma + 1.0);
+    QVERIFY(qAbs(value - 1000.0) / 1000.0 <= 0.02 + 1.0E-9);
+}
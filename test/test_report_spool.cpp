@@ -0,0 +1,189 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::ReportSpool class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QCborValue>
+#include <QCborArray>
+
+#include <ud_payload_writer.h>
+#include <ud_report_spool.h>
+
+#include "test_report_spool.h"
+
+TestReportSpool::TestReportSpool() {}
+
+
+TestReportSpool::~TestReportSpool() {}
+
+
+void TestReportSpool::testAddAndRead() {
+    QTemporaryDir directory;
+
+    {
+        Ud::ReportSpool spool(directory.path(), "key");
+        QVERIFY(spool.add("{\"report\":1}", Ud::PayloadWriter::Format::JSON));
+        QVERIFY(spool.add(QByteArray("\xA1\x61\x61\x01", 4), Ud::PayloadWriter::Format::CBOR));
+        QVERIFY(spool.add("{\"report\":2}", Ud::PayloadWriter::Format::JSON));
+    }
+
+    // A new instance stands in for an application restart.
+    Ud::ReportSpool spool(directory.path(), "key");
+    QCOMPARE(spool.numberEntries(), 3U);
+
+    QList<Ud::ReportSpool::Entry> entries = spool.entries(Ud::PayloadWriter::Format::JSON, 16);
+    QCOMPARE(entries.size(), 2);
+    QCOMPARE(entries.at(0).payload, QByteArray("{\"report\":1}"));
+    QCOMPARE(entries.at(1).payload, QByteArray("{\"report\":2}"));
+
+    QCOMPARE(spool.entries(Ud::PayloadWriter::Format::JSON, 1).size(), 1);
+
+    spool.remove(QStringList() << entries.at(0).filename << entries.at(1).filename);
+    QCOMPARE(spool.numberEntries(), 1U);
+    QCOMPARE(spool.entries(Ud::PayloadWriter::Format::CBOR, 16).at(0).payload, QByteArray("\xA1\x61\x61\x01", 4));
+}
+
+
+void TestReportSpool::testSeal() {
+    QTemporaryDir directory;
+
+    Ud::ReportSpool spool(directory.path(), "key");
+    QVERIFY(spool.add("{\"report\":1}", Ud::PayloadWriter::Format::JSON));
+    QVERIFY(spool.add("{\"report\":2}", Ud::PayloadWriter::Format::JSON));
+
+    QList<Ud::ReportSpool::Entry> entries = spool.entries(Ud::PayloadWriter::Format::JSON, 16);
+    QCOMPARE(entries.size(), 2);
+
+    QFile file(entries.at(0).filename);
+    QVERIFY(file.open(QFile::ReadWrite));
+    QByteArray contents = file.readAll();
+    contents[contents.indexOf("\":1}") + 2] = '9';
+    file.seek(0);
+    file.write(contents);
+    file.close();
+
+    entries = spool.entries(Ud::PayloadWriter::Format::JSON, 16);
+    QCOMPARE(entries.size(), 1);
+    QCOMPARE(entries.at(0).payload, QByteArray("{\"report\":2}"));
+    QCOMPARE(spool.numberEntries(), 1U);
+
+    Ud::ReportSpool otherKeySpool(directory.path(), "other key");
+    QCOMPARE(otherKeySpool.entries(Ud::PayloadWriter::Format::JSON, 16).size(), 0);
+}
+
+
+void TestReportSpool::testEviction() {
+    QTemporaryDir directory;
+
+    Ud::ReportSpool spool(directory.path(), "key");
+    spool.setMaximumEntries(3);
+
+    for (unsigned i=0 ; i<5 ; ++i) {
+        QVERIFY(spool.add(QString("{\"report\":%1}").arg(i).toUtf8(), Ud::PayloadWriter::Format::JSON));
+    }
+
+    QList<Ud::ReportSpool::Entry> entries = spool.entries(Ud::PayloadWriter::Format::JSON, 16);
+    QCOMPARE(entries.size(), 3);
+    QCOMPARE(entries.at(0).payload, QByteArray("{\"report\":2}"));
+    QCOMPARE(entries.at(2).payload, QByteArray("{\"report\":4}"));
+
+    QByteArray large(1024, 'x');
+    spool.setMaximumBytes(2 * 1024 + 512);
+    QVERIFY(spool.add(large, Ud::PayloadWriter::Format::JSON));
+    QVERIFY(spool.add(large, Ud::PayloadWriter::Format::JSON));
+    QVERIFY(spool.add(large, Ud::PayloadWriter::Format::JSON));
+    QCOMPARE(spool.numberEntries(), 2U);
+
+    QCOMPARE(spool.add(QByteArray(4096, 'x'), Ud::PayloadWriter::Format::JSON), false);
+}
+
+
+
+void TestReportSpool::testFailureLimit() {
+    QTemporaryDir directory;
+
+    Ud::ReportSpool spool(directory.path(), "key");
+    spool.setMaximumFailures(2);
+    QVERIFY(spool.add("{\"report\":1}", Ud::PayloadWriter::Format::JSON));
+    QVERIFY(spool.add("{\"report\":2}", Ud::PayloadWriter::Format::JSON));
+
+    QList<Ud::ReportSpool::Entry> entries = spool.entries(Ud::PayloadWriter::Format::JSON, 16);
+    QCOMPARE(entries.size(), 2);
+
+    QCOMPARE(spool.recordFailure(QStringList() << entries.at(0).filename), 0U);
+    QCOMPARE(spool.numberEntries(), 2U);
+
+    // The first report has now been part of two failed uploads and is dropped.
+    QCOMPARE(spool.recordFailure(QStringList() << entries.at(0).filename << entries.at(1).filename), 1U);
+
+    entries = spool.entries(Ud::PayloadWriter::Format::JSON, 16);
+    QCOMPARE(entries.size(), 1);
+    QCOMPARE(entries.at(0).payload, QByteArray("{\"report\":2}"));
+}
+
+void TestReportSpool::testCombine() {
+    QList<QByteArray> jsonPayloads;
+    jsonPayloads << QByteArray("{\"report\":1}") << QByteArray("{\"report\":2}");
+
+    QJsonArray jsonBatch = QJsonDocument::fromJson(
+        Ud::ReportSpool::combine(jsonPayloads, Ud::PayloadWriter::Format::JSON)
+    ).array();
+
+    QCOMPARE(jsonBatch.size(), 2);
+    QCOMPARE(jsonBatch.at(1).toObject().value("report").toInt(), 2);
+
+    Ud::PayloadWriter first(Ud::PayloadWriter::Format::CBOR);
+    first.startMap();
+    first.writeKey("report");
+    first.writeUnsigned(1);
+    first.endMap();
+
+    Ud::PayloadWriter second(Ud::PayloadWriter::Format::CBOR);
+    second.startMap();
+    second.writeKey("report");
+    second.writeUnsigned(2);
+    second.endMap();
+
+    QList<QByteArray> cborPayloads;
+    cborPayloads << first.data() << second.data();
+
+    QCborArray cborBatch = QCborValue::fromCbor(
+        Ud::ReportSpool::combine(cborPayloads, Ud::PayloadWriter::Format::CBOR)
+    ).toArray();
+
+    QCOMPARE(static_cast<int>(cborBatch.size()), 2);
+    QCOMPARE(cborBatch.at(1).toMap().value("report").toInteger(), Q_INT64_C(2));
+}
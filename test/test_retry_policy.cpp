@@ -0,0 +1,111 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests for the \ref Ud::RetryPolicy class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QSet>
+
+#include <ud_retry_policy.h>
+
+#include "test_retry_policy.h"
+
+TestRetryPolicy::TestRetryPolicy() {}
+
+
+TestRetryPolicy::~TestRetryPolicy() {}
+
+
+void TestRetryPolicy::testBackoff() {
+    Ud::RetryPolicy policy;
+    policy.setDelays(10, 100);
+    policy.setFailureThreshold(0);
+
+    unsigned long long expectedCeilings[] = { 10, 20, 40, 80, 100, 100 };
+    for (unsigned i=0 ; i<6 ; ++i) {
+        unsigned long long delay = policy.recordFailure();
+        QVERIFY(delay >= 1);
+        QVERIFY(delay <= expectedCeilings[i]);
+        QCOMPARE(policy.consecutiveFailures(), i + 1);
+        QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::CLOSED);
+    }
+
+    // Many failures must not overflow the ceiling.
+    for (unsigned i=0 ; i<100 ; ++i) {
+        QVERIFY(policy.recordFailure() <= 100);
+    }
+
+    policy.recordSuccess();
+    QCOMPARE(policy.consecutiveFailures(), 0U);
+    QVERIFY(policy.recordFailure() <= 10);
+}
+
+
+void TestRetryPolicy::testJitter() {
+    Ud::RetryPolicy policy;
+    policy.setDelays(1000, 1000);
+    policy.setFailureThreshold(0);
+
+    // Clients failing together should spread out rather than retry in lockstep.
+    QSet<unsigned long long> delays;
+    for (unsigned i=0 ; i<100 ; ++i) {
+        delays.insert(policy.recordFailure());
+    }
+
+    QVERIFY(delays.size() > 50);
+}
+
+
+void TestRetryPolicy::testCircuitBreaker() {
+    Ud::RetryPolicy policy;
+    policy.setDelays(10, 100);
+    policy.setFailureThreshold(3);
+    policy.setOpenPeriod(1000);
+
+    policy.recordFailure();
+    policy.recordFailure();
+    QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::CLOSED);
+
+    unsigned long long delay = policy.recordFailure();
+    QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::OPEN);
+    QVERIFY(delay >= 500 && delay <= 1000);
+
+    policy.attemptStarted();
+    QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::HALF_OPEN);
+
+    delay = policy.recordFailure();
+    QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::OPEN);
+    QVERIFY(delay >= 500 && delay <= 1000);
+
+    policy.attemptStarted();
+    policy.recordSuccess();
+    QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::CLOSED);
+    QCOMPARE(policy.consecutiveFailures(), 0U);
+
+    policy.attemptStarted();
+    QCOMPARE(policy.circuitState(), Ud::RetryPolicy::CircuitState::CLOSED);
+}
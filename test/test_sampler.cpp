@@ -0,0 +1,95 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+* \file
+*
+* This file implements tests for the \ref Ud::Sampler class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+
+#include <cstdint>
+
+#include <ud_sampler.h>
+
+#include "test_sampler.h"
+
+TestSampler::TestSampler() {}
+
+
+TestSampler::~TestSampler() {}
+
+
+void TestSampler::testFixedRate() {
+    Ud::Sampler sampler;
+    QCOMPARE(sampler.rate(), 1U);
+    QCOMPARE(sampler.sample(), 1U);
+
+    sampler.setRate(10);
+    QCOMPARE(sampler.rate(), 10U);
+    QCOMPARE(sampler.isAdaptive(), false);
+
+    const unsigned numberUpdates = 1000000;
+
+    std::uint64_t recorded = 0;
+    std::uint64_t total    = 0;
+    for (unsigned i=0 ; i<numberUpdates ; ++i) {
+        std::uint32_t weight = sampler.sample();
+        if (weight != 0) {
+            QCOMPARE(weight, 10U);
+            ++recorded;
+            total += weight;
+        }
+    }
+
+    // The scaled total is an unbiased estimate of the number of updates.  Its standard deviation is about 0.3%.
+    QVERIFY(recorded > numberUpdates / 12 && recorded < numberUpdates / 8);
+    QVERIFY(qAbs(static_cast<double>(total) - numberUpdates) / numberUpdates < 0.02);
+
+    sampler.setRate(0);
+    QCOMPARE(sampler.rate(), 1U);
+}
+
+
+void TestSampler::testAdaptiveRate() {
+    Ud::Sampler sampler;
+    sampler.setAdaptive(1000, 4096);
+    QCOMPARE(sampler.isAdaptive(), true);
+
+    // Tight loops make millions of updates per second so the rate should climb well above 1.
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 200) {
+        for (unsigned i=0 ; i<10000 ; ++i) {
+            sampler.sample();
+        }
+    }
+
+    QVERIFY(sampler.rate() > 1);
+    QVERIFY(sampler.rate() <= 4096);
+
+    sampler.setRate(1);
+    QCOMPARE(sampler.isAdaptive(), false);
+    QCOMPARE(sampler.rate(), 1U);
+}
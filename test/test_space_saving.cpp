@@ -0,0 +1,107 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+* \file
+*
+* This file implements tests for the \ref Ud::SpaceSaving class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QString>
+#include <QHash>
+#include <QList>
+
+#include <cstdint>
+
+#include <ud_space_saving.h>
+
+#include "test_space_saving.h"
+
+TestSpaceSaving::TestSpaceSaving() {}
+
+
+TestSpaceSaving::~TestSpaceSaving() {}
+
+
+void TestSpaceSaving::testExactCounts() {
+    Ud::SpaceSaving summary(4);
+
+    summary.add("a", 5);
+    summary.add("b", 3);
+    summary.add("c");
+    summary.add("a", 2);
+
+    QCOMPARE(summary.size(), 3U);
+    QCOMPARE(summary.total(), std::uint64_t(11));
+    QCOMPARE(summary.minimumCount(), std::uint64_t(0));
+    QCOMPARE(summary.maximumCount(), std::uint64_t(7));
+
+    QList<Ud::SpaceSaving::Entry> entries = summary.entries();
+    QCOMPARE(entries.size(), 3);
+    QCOMPARE(entries.at(0).key, QString("a"));
+    QCOMPARE(entries.at(0).count, std::uint64_t(7));
+    QCOMPARE(entries.at(0).error, std::uint64_t(0));
+    QCOMPARE(entries.at(2).key, QString("c"));
+
+    summary.clear();
+    QCOMPARE(summary.isEmpty(), true);
+    QCOMPARE(summary.total(), std::uint64_t(0));
+}
+
+
+void TestSpaceSaving::testHeavyHitters() {
+    const unsigned capacity = 16;
+    Ud::SpaceSaving summary(capacity);
+
+    // A few heavy keys mixed with a long tail of keys seen once.
+    QHash<QString, std::uint64_t> trueCounts;
+    for (unsigned i=0 ; i<10000 ; ++i) {
+        QString key = (i % 4 == 0) ? QString("heavy_%1").arg(i % 3) : QString("tail_%1").arg(i);
+        summary.add(key);
+        trueCounts[key] += 1;
+    }
+
+    QCOMPARE(summary.size(), capacity);
+    QCOMPARE(summary.total(), std::uint64_t(10000));
+
+    QList<Ud::SpaceSaving::Entry> entries = summary.entries();
+    for (auto it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+        std::uint64_t trueCount = trueCounts.value(it->key);
+        QVERIFY(it->count >= trueCount);
+        QVERIFY(it->count - it->error <= trueCount);
+    }
+
+    for (unsigned i=0 ; i<3 ; ++i) {
+        QString key = QString("heavy_%1").arg(i);
+
+        bool found = false;
+        for (auto it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+            found = found || it->key == key;
+        }
+
+        QVERIFY(found);
+    }
+
+    // No key outside the summary can exceed the smallest monitored count.
+    QVERIFY(summary.minimumCount() <= summary.total() / capacity);
+}
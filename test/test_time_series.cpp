@@ -0,0 +1,98 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+* \file
+*
+* This file implements tests for the \ref Ud::TimeSeries class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QHash>
+#include <QVector>
+
+#include <cstdint>
+
+#include <ud_key_registry.h>
+#include <ud_time_series.h>
+
+#include "test_time_series.h"
+
+TestTimeSeries::TestTimeSeries() {}
+
+
+TestTimeSeries::~TestTimeSeries() {}
+
+
+void TestTimeSeries::testBuckets() {
+    Ud::TimeSeries series(60, 4);
+    QCOMPARE(series.bucketSeconds(), 60U);
+    QCOMPARE(series.numberBuckets(), 4U);
+
+    Ud::KeyRegistry::Slot first  = Ud::KeyRegistry::slot("time_series_first");
+    Ud::KeyRegistry::Slot second = Ud::KeyRegistry::slot("time_series_second");
+
+    std::int64_t start = (Ud::TimeSeries::currentTime() / 60 + 10) * 60;
+
+    series.add(first, 1, start);
+    series.add(first, 2, start + 59);
+    series.add(first, 3, start + 120);
+    series.add(second, 5, start + 180);
+    series.add(Ud::KeyRegistry::invalidSlot, 7, start + 180);
+
+    std::int64_t firstBucketTime = 0;
+    QHash<Ud::KeyRegistry::Slot, QVector<std::uint64_t>> buckets = series.snapshot(start + 180, &firstBucketTime);
+
+    QCOMPARE(firstBucketTime, start);
+    QCOMPARE(buckets.size(), 2);
+    QCOMPARE(buckets.value(first), QVector<std::uint64_t>({ 3, 0, 3, 0 }));
+    QCOMPARE(buckets.value(second), QVector<std::uint64_t>({ 0, 0, 0, 5 }));
+
+    // Updates older than the window are dropped.
+    series.add(first, 11, start - 1);
+    QCOMPARE(series.snapshot(start + 180).value(first), QVector<std::uint64_t>({ 3, 0, 3, 0 }));
+}
+
+
+void TestTimeSeries::testRotation() {
+    Ud::TimeSeries series(60, 4);
+
+    Ud::KeyRegistry::Slot slot = Ud::KeyRegistry::slot("time_series_rotation");
+
+    std::int64_t start = (Ud::TimeSeries::currentTime() / 60 + 10) * 60;
+    for (unsigned i=0 ; i<4 ; ++i) {
+        series.add(slot, i + 1, start + 60 * i);
+    }
+
+    QCOMPARE(series.snapshot(start + 180).value(slot), QVector<std::uint64_t>({ 1, 2, 3, 4 }));
+
+    // Moving forward two buckets recycles the two oldest.
+    series.add(slot, 10, start + 300);
+
+    std::int64_t firstBucketTime = 0;
+    QCOMPARE(series.snapshot(start + 300, &firstBucketTime).value(slot), QVector<std::uint64_t>({ 3, 4, 0, 10 }));
+    QCOMPARE(firstBucketTime, start + 120);
+
+    // A snapshot taken after a long idle period sees an empty window.
+    QCOMPARE(series.snapshot(start + 3600).contains(slot), false);
+    QVERIFY(series.memoryUsage() >= sizeof(std::uint64_t) * 4 * Ud::TimeSeries::slotsPerChunk);
+}
@@ -0,0 +1,195 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+* \file
+*
+* This file implements tests for the \ref Ud::TimerTable class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QThread>
+
+#include <cstdint>
+
+#include <ud_timer_table.h>
+
+#include "test_timer_table.h"
+
+TestTimerTable::TestTimerTable() {}
+
+
+TestTimerTable::~TestTimerTable() {}
+
+
+void TestTimerTable::testStartStop() {
+    Ud::TimerTable timers;
+    std::uint64_t  elapsedTime = 0;
+
+    QCOMPARE(timers.isActive("timer"), false);
+    QCOMPARE(timers.stop("timer", true, elapsedTime), false);
+
+    timers.start("timer");
+    QCOMPARE(timers.isActive("timer"), true);
+
+    QTest::qSleep(20);
+    QCOMPARE(timers.stop("timer", false, elapsedTime), true);
+    QVERIFY(elapsedTime >= std::uint64_t(15000000));
+    QCOMPARE(timers.isActive("timer"), true);
+
+    QCOMPARE(timers.stop("timer", true, elapsedTime), true);
+    QVERIFY(elapsedTime < std::uint64_t(15000000));
+    QCOMPARE(timers.isActive("timer"), false);
+    QCOMPARE(timers.stop("timer", true, elapsedTime), false);
+}
+
+
+void TestTimerTable::testCrossThreadStop() {
+    Ud::TimerTable timers;
+
+    bool     activeOnThread = false;
+    QThread* thread         = QThread::create([&timers, &activeOnThread]() {
+        timers.start("shared_timer");
+        activeOnThread = timers.isActive("shared_timer");
+    });
+
+    thread->start();
+    thread->wait();
+    delete thread;
+
+    QCOMPARE(activeOnThread, true);
+
+    // The timer belongs to another thread so it is not active here but can still be stopped here.
+    QCOMPARE(timers.isActive("shared_timer"), false);
+
+    std::uint64_t elapsedTime = 0;
+    QCOMPARE(timers.stop("shared_timer", true, elapsedTime), true);
+    QCOMPARE(timers.stop("shared_timer", true, elapsedTime), false);
+}
+
+
+void TestTimerTable::testLapAll() {
+    Ud::TimerTable timers;
+
+    QList<QThread*> threads;
+    for (unsigned i=0 ; i<4 ; ++i) {
+        QThread* thread = QThread::create([&timers]() {
+            timers.start("parallel_timer");
+        });
+
+        threads.append(thread);
+        thread->start();
+    }
+
+    for (auto it=threads.begin(),end=threads.end() ; it!=end ; ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+
+    timers.start("main_timer");
+    QTest::qSleep(10);
+
+    Ud::TimerTable::ElapsedTimes lapped = timers.lapAll();
+    QCOMPARE(lapped.size(), 5);
+
+    unsigned numberParallel = 0;
+    for (auto it=lapped.constBegin(),end=lapped.constEnd() ; it!=end ; ++it) {
+        QVERIFY(it->second >= std::uint64_t(5000000));
+        if (it->first == QString("parallel_timer")) {
+            ++numberParallel;
+        }
+    }
+
+    QCOMPARE(numberParallel, 4U);
+    QCOMPARE(timers.isActive("main_timer"), true);
+
+    Ud::TimerTable::ElapsedTimes stopped = timers.stopAll();
+    QCOMPARE(stopped.size(), 5);
+    QCOMPARE(timers.isActive("main_timer"), false);
+    QCOMPARE(timers.stopAll().size(), 0);
+}
+
+
+void TestTimerTable::testTableReuse() {
+    Ud::TimerTable timers;
+
+    for (unsigned i=0 ; i<4 ; ++i) {
+        QThread* thread = QThread::create([&timers]() {
+            timers.start("short_timer");
+
+            std::uint64_t elapsedTime;
+            timers.stop("short_timer", true, elapsedTime);
+        });
+
+        thread->start();
+        thread->wait();
+        delete thread;
+    }
+
+    std::uint64_t memoryUsage = timers.memoryUsage();
+
+    for (unsigned i=0 ; i<16 ; ++i) {
+        QThread* thread = QThread::create([&timers]() {
+            timers.start("short_timer");
+
+            std::uint64_t elapsedTime;
+            timers.stop("short_timer", true, elapsedTime);
+        });
+
+        thread->start();
+        thread->wait();
+        delete thread;
+    }
+
+    // Threads that have exited leave idle tables behind that later threads reuse.
+    QCOMPARE(timers.memoryUsage(), memoryUsage);
+}
+
+
+void TestTimerTable::testStoppedTimersReleased() {
+    Ud::TimerTable timers;
+    std::uint64_t  elapsedTime;
+
+    timers.start("first_timer");
+    std::uint64_t timerMemoryUsage = timers.memoryUsage();
+    timers.stop("first_timer", true, elapsedTime);
+
+    std::uint64_t memoryUsage = timers.memoryUsage();
+    timerMemoryUsage -= memoryUsage;
+
+    for (unsigned i=0 ; i<1000 ; ++i) {
+        QString timerName = QString("dynamic_timer_%1").arg(i);
+        timers.start(timerName);
+        timers.stop(timerName, true, elapsedTime);
+    }
+
+    // Timers stopped on their own thread are released right away.
+    QCOMPARE(timers.memoryUsage(), memoryUsage);
+
+    for (unsigned i=0 ; i<1000 ; ++i) {
+        timers.start(QString("stopped_elsewhere_%1").arg(i));
+        QCOMPARE(timers.stopAll().size(), 1);
+    }
+
+    // Timers stopped by stopAll are released as the table grows, keeping it bounded.
+    QVERIFY(timers.memoryUsage() <= memoryUsage + 128 * timerMemoryUsage);
+}
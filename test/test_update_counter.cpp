@@ -0,0 +1,111 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2016 - 2022 Inesonic, LLC.
+* 
+* This file is licensed under two licenses.
+*
+* Inesonic Commercial License, Version 1:
+*   All rights reserved.  Inesonic, LLC retains all rights to this software, including the right to relicense the
+*   software in source or binary formats under different terms.  Unauthorized use under the terms of this license is
+*   strictly prohibited.
+*
+* GNU Public License, Version 2:
+*   This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation; either version 2 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program; if not, write to the Free
+*   Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+* \file
+*
+* This file implements tests for the \ref Ud::UpdateCounter class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QThread>
+#include <QList>
+
+#include <cstdint>
+
+#include <ud_update_counter.h>
+
+#include "test_update_counter.h"
+
+TestUpdateCounter::TestUpdateCounter() {}
+
+
+TestUpdateCounter::~TestUpdateCounter() {}
+
+
+void TestUpdateCounter::testConcurrentIncrements() {
+    const unsigned numberThreads    = 8;
+    const unsigned updatesPerThread = 100000;
+
+    Ud::UpdateCounter counter;
+
+    // Two rounds of threads check that blocks left by exited threads keep their counts when reused.
+    for (unsigned round=0 ; round<2 ; ++round) {
+        QList<QThread*> threads;
+        for (unsigned i=0 ; i<numberThreads ; ++i) {
+            QThread* thread = QThread::create([&counter, updatesPerThread]() {
+                for (unsigned j=0 ; j<updatesPerThread ; ++j) {
+                    counter.increment();
+                }
+            });
+
+            threads.append(thread);
+            thread->start();
+        }
+
+        for (auto it=threads.begin(),end=threads.end() ; it!=end ; ++it) {
+            (*it)->wait();
+            delete *it;
+        }
+    }
+
+    counter.increment();
+    QCOMPARE(counter.value(), std::uint64_t(2) * numberThreads * updatesPerThread + 1);
+}
+
+
+void TestUpdateCounter::testIndexReuse() {
+    {
+        Ud::UpdateCounter counter;
+        for (unsigned i=0 ; i<5 ; ++i) {
+            counter.increment();
+        }
+
+        QCOMPARE(counter.value(), std::uint64_t(5));
+    }
+
+    // A new counter may take the index just released but starts from zero.
+    Ud::UpdateCounter counter;
+    QCOMPARE(counter.value(), std::uint64_t(0));
+
+    counter.increment();
+    QCOMPARE(counter.value(), std::uint64_t(1));
+}
+
+
+void TestUpdateCounter::testTableFull() {
+    QList<Ud::UpdateCounter*> counters;
+    for (unsigned i=0 ; i<Ud::UpdateCounter::maximumCounters + 4 ; ++i) {
+        counters.append(new Ud::UpdateCounter);
+    }
+
+    // Counters beyond the table fall back to an atomic count and still count every increment.
+    for (auto it=counters.begin(),end=counters.end() ; it!=end ; ++it) {
+        (*it)->increment();
+        (*it)->increment();
+    }
+
+    for (auto it=counters.begin(),end=counters.end() ; it!=end ; ++it) {
+        QCOMPARE((*it)->value(), std::uint64_t(2));
+        delete *it;
+    }
+}
@@ -22,8 +22,8 @@
 ********************************************************************************************************************//**
 * \file
 *
-* This file implements tests for the \ref UsageData class.  Note that the class expects a properly configured local web
-* server to receive usage data packets.
+* This file implements tests for the \ref UsageData class.  Reports are sent to a \ref LoopbackCollector listening on
+* the loopback interface, so the tests need neither a web server nor network access.
 ***********************************************************************************************************************/
 
 #include <QDebug>
@@ -34,6 +34,17 @@
 #include <QByteArray>
 #include <QNetworkAccessManager>
 #include <QSettings>
+#include <QThread>
+#include <QList>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QDir>
+#include <QFile>
 
 #if (defined(Q_OS_WIN32))
 
@@ -47,11 +58,14 @@
 
 #include <cstdint>
 
+#include <ud_key_registry.h>
 #include <ud_usage_data.h>
+#include <ud_scoped_activity.h>
+#include <ud_payload_transport.h>
 
+#include "loopback_collector.h"
 #include "test_usage_data.h"
 
-const char         TestUsageData::testWebhook[] = "https://autonoma.inesonic.com/v2/test_usage_data";
 const std::uint8_t TestUsageData::testUsageDataHmacSecret[] = {
     0xB1, 0xD7, 0xAC, 0x38,   0x6C, 0xE4, 0xD3, 0x19,
     0x4F, 0xCC, 0x35, 0xE0,   0xA8, 0xFB, 0x65, 0x41,
@@ -76,15 +90,19 @@ TestUsageData::TestUsageData() {
     failureTimer       = new QTimer(this);
     operationTimedOut  = false;
 
+    QByteArray sharedSecret(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret));
+
+    // Reports go to a local collector so the tests need no network access.  Reports built in the background are
+    // always sent through a Ud::PayloadTransport, whose signatures the collector can verify.  The default web hook
+    // path is covered by testWebHookReport.
+    collector = new LoopbackCollector(sharedSecret, this);
+    collector->listen();
+
     networkAccessManager = new QNetworkAccessManager(this);
     settings             = new QSettings("Inesonic, LLC", "test_ineud", this);
-    usageData            = new Ud::UsageData(
-        settings,
-        networkAccessManager,
-        QByteArray(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret)),
-        QUrl(testWebhook),
-        this
-    );
+    usageData            = new Ud::UsageData(settings, networkAccessManager, sharedSecret, collector->url(), this);
+
+    usageData->setBackgroundReporting();
 
     connect(usageData, SIGNAL(reportingFinished(bool)), this, SLOT(reportingFinished(bool)));
     connect(failureTimer, SIGNAL(timeout()), this, SLOT(timedOut()));
@@ -117,16 +135,104 @@ void TestUsageData::timedOut() {
 
 
 void TestUsageData::initTestCase() {
+    QVERIFY(collector->url().port() > 0);
+
     usageData->loadSettings();
     usageData->setReportingDisabled();
 }
 
 
+void TestUsageData::testPerThreadTimers() {
+    QList<QThread*> threads;
+    bool            activeWhileRunning[4];
+    bool            activeAfterStop[4];
+    for (unsigned i=0 ; i<4 ; ++i) {
+        QThread* thread = QThread::create([this, i, &activeWhileRunning, &activeAfterStop]() {
+            usageData->startTimer("parallel_activity");
+            QTest::qSleep(50);
+            activeWhileRunning[i] = usageData->isTimerActive("parallel_activity");
+            usageData->stopTimer("parallel_activity");
+            activeAfterStop[i] = usageData->isTimerActive("parallel_activity");
+        });
+
+        threads.append(thread);
+        thread->start();
+    }
+
+    for (auto it=threads.begin(),end=threads.end() ; it!=end ; ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+
+    for (unsigned i=0 ; i<4 ; ++i) {
+        QCOMPARE(activeWhileRunning[i], true);
+        QCOMPARE(activeAfterStop[i], false);
+    }
+
+    QCOMPARE(usageData->isTimerActive("parallel_activity"), false);
+}
+
+
+void TestUsageData::testIncrementalSave() {
+    QString group = usageData->settingsGroup();
+
+    settings->setValue(group + "/lastOperation", 1);
+    usageData->adjustEvent("incremental_event", 3);
+    usageData->saveSettings();
+
+    QCOMPARE(settings->value(group + "/events/incremental_event").toULongLong(), 3ULL);
+    QCOMPARE(settings->contains(group + "/lastOperation"), false);
+
+    usageData->adjustEvent("incremental_event", 2);
+    usageData->saveSettings();
+
+    QCOMPARE(settings->value(group + "/events/incremental_event").toULongLong(), 5ULL);
+}
+
+
 void TestUsageData::testPrimaryInstance() {
     usageData->adjustEvent("test_event_1");
     usageData->adjustEvent("test_event_2");
     usageData->adjustEvent("test_event_1");
 
+    Ud::UsageData::EventId eventId = usageData->registerEvent("test_event_3");
+    QCOMPARE(usageData->registerEvent("test_event_3"), eventId);
+    usageData->adjustEventById(eventId, 2);
+
+    usageData->enableHistogram("activity_3");
+
+    auto activityDetails = [this]() {
+        QJsonObject report = QJsonDocument::fromJson(usageData->previewReport()).object();
+        return report.value("activities").toObject().value("activity_3").toObject();
+    };
+
+    auto numberSamples = [](const QJsonObject& details) {
+        int        result  = 0;
+        QJsonArray buckets = details.value("histogram").toArray();
+        for (auto it=buckets.constBegin(),end=buckets.constEnd() ; it!=end ; ++it) {
+            result += (*it).toArray().at(1).toInt();
+        }
+
+        return result;
+    };
+
+    // Times are read in nanoseconds so the 10 ms scopes are not rounded away.
+    usageData->setActivityResolution(1);
+    QJsonObject before = activityDetails();
+
+    {
+        Ud::ScopedActivity outerActivity(usageData, UD_ACTIVITY("activity_3"));
+        Ud::ScopedActivity innerActivity(usageData, "activity_3");
+        QTest::qSleep(10);
+    }
+
+    // Nested instances timing the same activity each contribute their own elapsed time.
+    QJsonObject after = activityDetails();
+    QVERIFY(after.value("total").toDouble() - before.value("total").toDouble() >= 2.0E7);
+    QCOMPARE(numberSamples(after), numberSamples(before) + 2);
+
+    usageData->setActivityResolution(Ud::UsageData::defaultActivityResolution);
+
     usageData->startTimer("activity_1");
     usageData->startTimer("activity_2");
     sleep(2);
@@ -140,6 +246,416 @@ void TestUsageData::testPrimaryInstance() {
 
     QCOMPARE(operationTimedOut, false);
     QCOMPARE(usageData->reportingSuccessful(), true);
+    QCOMPARE(collector->numberInvalidSignatures(), 0U);
+
+    QJsonObject report = QJsonDocument::fromJson(collector->lastBody()).object();
+    QVERIFY(report.value("events").toObject().value("test_event_1").toInt() >= 2);
+}
+
+
+void TestUsageData::testFailedReport() {
+    collector->setResponse(LoopbackCollector::Response::FAIL);
+
+    usageData->adjustEvent("failed_report_event", 4);
+    usageData->setReportingEnabled();
+
+    failureTimer->start(1000 * reportingTimeout);
+    QMetaObject::invokeMethod(usageData, "reportUsageData");
+    eventLoop->exec();
+
+    QCOMPARE(operationTimedOut, false);
+    QCOMPARE(operationFinished, false);
+    QCOMPARE(usageData->reportingSuccessful(), false);
+
+    // The failed report's counters are folded back in for the next attempt.
+    QJsonObject report = QJsonDocument::fromJson(usageData->previewReport()).object();
+    QCOMPARE(report.value("events").toObject().value("failed_report_event").toInt(), 4);
+
+    collector->setResponse(LoopbackCollector::Response::ACKNOWLEDGE);
+}
+
+
+void TestUsageData::testCollectorLatency() {
+    collector->setLatency(500);
+
+    usageData->adjustEvent("latency_event");
+    usageData->setReportingEnabled();
+
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+
+    failureTimer->start(1000 * reportingTimeout);
+    QMetaObject::invokeMethod(usageData, "reportUsageData");
+    eventLoop->exec();
+
+    QCOMPARE(operationTimedOut, false);
+    QCOMPARE(operationFinished, true);
+    QVERIFY(elapsedTimer.elapsed() >= 500);
+
+    collector->setLatency(0);
+}
+
+
+void TestUsageData::testStatistics() {
+    Ud::UsageData::Statistics before = usageData->stats();
+
+    usageData->adjustEvent("statistics_event", 2);
+    usageData->adjustActivity("statistics_activity", 100);
+    usageData->saveSettings();
+
+    Ud::UsageData::Statistics after = usageData->stats();
+    QVERIFY(after.adjustCalls >= before.adjustCalls + 2);
+    QVERIFY(after.memoryBytes > 0);
+    QVERIFY(after.saveTime > 0);
+    QVERIFY(after.loadTime > 0);
+
+    // The previous test case sent a report.
+    QVERIFY(after.snapshotTime > 0);
+    QVERIFY(after.payloadBytes > 0);
+    QVERIFY(after.encodedBytes > 0);
+}
+
+
+void TestUsageData::testSampling() {
+    usageData->setEventSampling("sampled_event", 8);
+    QCOMPARE(usageData->eventSamplingRate(usageData->registerEvent("sampled_event")), 8U);
+
+    for (unsigned i=0 ; i<80000 ; ++i) {
+        usageData->adjustEvent("sampled_event");
+    }
+
+    QJsonObject report = QJsonDocument::fromJson(usageData->previewReport()).object();
+
+    // Recorded updates are scaled up so the total stays close to the number of calls.
+    double total = report.value("events").toObject().value("sampled_event").toDouble();
+    QVERIFY(qAbs(total - 80000) / 80000 < 0.05);
+
+    QJsonObject sampling = report.value("sampling").toObject();
+    QCOMPARE(sampling.value("events").toObject().value("sampled_event").toInt(), 8);
+
+    usageData->setEventSampling("sampled_event", 1);
+}
+
+
+void TestUsageData::testTimeSeries() {
+    QCOMPARE(usageData->timeSeriesEnabled(), false);
+    usageData->enableTimeSeries(3600, 24);
+    QCOMPARE(usageData->timeSeriesEnabled(), true);
+
+    usageData->adjustEvent("series_event", 3);
+    usageData->adjustEventById(usageData->registerEvent("series_event"), 2);
+    usageData->adjustActivity("series_activity", 4);
+
+    QJsonObject report     = QJsonDocument::fromJson(usageData->previewReport()).object();
+    QJsonObject timeSeries = report.value("time_series").toObject();
+
+    QCOMPARE(timeSeries.value("bucket_seconds").toInt(), 3600);
+    QCOMPARE(static_cast<std::int64_t>(timeSeries.value("start").toDouble()) % 3600, std::int64_t(0));
+
+    // The current bucket is the last entry of each series.
+    QJsonArray events = timeSeries.value("events").toObject().value("series_event").toArray();
+    QCOMPARE(events.size(), 24);
+    QCOMPARE(events.at(23).toInt(), 5);
+
+    QJsonArray activities = timeSeries.value("activities").toObject().value("series_activity").toArray();
+    QCOMPARE(activities.size(), 24);
+    QCOMPARE(activities.at(23).toInt(), 4);
+
+    // Reports do not retire the window.
+    report = QJsonDocument::fromJson(usageData->previewReport()).object();
+    events = report.value("time_series").toObject().value("events").toObject().value("series_event").toArray();
+    QCOMPARE(events.at(23).toInt(), 5);
+}
+
+
+void TestUsageData::testJournalSetAfterLoad() {
+    QTemporaryDir directory;
+    QString       filename = directory.filePath("counters.journal");
+
+    {
+        Ud::CounterJournal journal(filename);
+        QVERIFY(journal.load());
+
+        QHash<QString, std::uint64_t> events;
+        events.insert("journaled_event", 3);
+        QVERIFY(journal.save(events, QHash<QString, std::uint64_t>()));
+    }
+
+    // Settings are already loaded so the journal's counters are picked up when the journal is set.
+    usageData->setJournalFilename(filename);
+    usageData->adjustEvent("journaled_event", 2);
+    usageData->saveSettings();
+    usageData->setJournalFilename(QString());
+
+    Ud::CounterJournal journal(filename);
+    QVERIFY(journal.load());
+    QCOMPARE(journal.values(Ud::CounterJournal::Table::EVENTS).value("journaled_event"), std::uint64_t(5));
+}
+
+
+void TestUsageData::testJournalMovedToCounterFiles() {
+    QTemporaryDir directory;
+    QString       journalFilename  = directory.filePath("counters.journal");
+    QString       counterDirectory = directory.filePath("counters");
+    QByteArray    sharedSecret(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret));
+
+    {
+        Ud::CounterJournal journal(journalFilename);
+        QVERIFY(journal.load());
+
+        QHash<QString, std::uint64_t> events;
+        events.insert("moved_event", 4);
+        QVERIFY(journal.save(events, QHash<QString, std::uint64_t>()));
+    }
+
+    QSettings mappedSettings(directory.filePath("settings.ini"), QSettings::IniFormat);
+
+    // Loading twice checks that the journal's counters are moved into the files exactly once.
+    for (unsigned i=0 ; i<2 ; ++i) {
+        Ud::UsageData mappedUsageData(&mappedSettings, networkAccessManager, sharedSecret, collector->url());
+        mappedUsageData.setJournalFilename(journalFilename);
+        mappedUsageData.setCounterDirectory(counterDirectory);
+        mappedUsageData.loadSettings();
+
+        QJsonObject report = QJsonDocument::fromJson(mappedUsageData.previewReport()).object();
+        QCOMPARE(report.value("events").toObject().value("moved_event").toInt(), 4);
+
+        Ud::CounterJournal journal(journalFilename);
+        QVERIFY(journal.load());
+        QCOMPARE(journal.values(Ud::CounterJournal::Table::EVENTS).isEmpty(), true);
+    }
+}
+
+
+void TestUsageData::testSpooledFormats() {
+    QTemporaryDir directory;
+    usageData->setSpoolDirectory(directory.path());
+
+    collector->setResponse(LoopbackCollector::Response::FAIL);
+    usageData->adjustEvent("spooled_json_event", 3);
+    usageData->setReportingEnabled();
+
+    failureTimer->start(1000 * reportingTimeout);
+    QMetaObject::invokeMethod(usageData, "reportUsageData");
+    eventLoop->exec();
+
+    QCOMPARE(operationFinished, false);
+    QCOMPARE(QDir(directory.path()).entryList(QDir::Files).size(), 1);
+
+    // The spooled JSON report is uploaded in its own batch after the CBOR report succeeds.
+    collector->setResponse(LoopbackCollector::Response::ACKNOWLEDGE);
+    usageData->setPayloadFormat(Ud::UsageData::PayloadFormat::CBOR);
+    usageData->setReportingEnabled();
+
+    unsigned numberRequests = collector->numberRequests();
+
+    failureTimer->start(1000 * reportingTimeout);
+    QMetaObject::invokeMethod(usageData, "reportUsageData");
+    eventLoop->exec();
+
+    QCOMPARE(operationTimedOut, false);
+    QCOMPARE(operationFinished, true);
+    QCOMPARE(collector->numberRequests(), numberRequests + 2);
+    QCOMPARE(QDir(directory.path()).entryList(QDir::Files).size(), 0);
+
+    QJsonArray batch = QJsonDocument::fromJson(collector->lastBody()).array();
+    QCOMPARE(batch.size(), 1);
+    QCOMPARE(batch.at(0).toObject().value("events").toObject().value("spooled_json_event").toInt(), 3);
+
+    usageData->setPayloadFormat(Ud::UsageData::PayloadFormat::JSON);
+    usageData->setSpoolDirectory(QString());
+}
+
+
+void TestUsageData::testRejectedReport() {
+    QTemporaryDir directory;
+    usageData->setSpoolDirectory(directory.path());
+
+    collector->setResponse(LoopbackCollector::Response::FAIL);
+    usageData->adjustEvent("rejected_spooled_event", 2);
+    usageData->setReportingEnabled();
+
+    failureTimer->start(1000 * reportingTimeout);
+    QMetaObject::invokeMethod(usageData, "reportUsageData");
+    eventLoop->exec();
+
+    QCOMPARE(QDir(directory.path()).entryList(QDir::Files).size(), 1);
+
+    // A rejected batch is not spooled again.  The new report's counters are kept for the next report.
+    collector->setResponse(LoopbackCollector::Response::REJECT);
+    usageData->adjustEvent("rejected_fresh_event", 5);
+    usageData->setReportingEnabled();
+
+    failureTimer->start(1000 * reportingTimeout);
+    QMetaObject::invokeMethod(usageData, "reportUsageData");
+    eventLoop->exec();
+
+    QCOMPARE(operationTimedOut, false);
+    QCOMPARE(operationFinished, false);
+    QCOMPARE(QDir(directory.path()).entryList(QDir::Files).size(), 0);
+
+    QJsonObject report = QJsonDocument::fromJson(usageData->previewReport()).object();
+    QCOMPARE(report.value("events").toObject().value("rejected_fresh_event").toInt(), 5);
+    QCOMPARE(report.value("events").toObject().contains("rejected_spooled_event"), false);
+
+    collector->setResponse(LoopbackCollector::Response::ACKNOWLEDGE);
+    usageData->setSpoolDirectory(QString());
+}
+
+
+void TestUsageData::testWebHookReport() {
+    QTemporaryDir directory;
+    QSettings     webHookSettings(directory.filePath("settings.ini"), QSettings::IniFormat);
+    QByteArray    sharedSecret(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret));
+
+    // Without background reporting, a spool, compression or CBOR, reports go through Wh::WebHook::send.
+    Ud::UsageData webHookUsageData(&webHookSettings, networkAccessManager, sharedSecret, collector->url());
+    webHookUsageData.loadSettings();
+
+    collector->setAcceptUnsignedRequests(true);
+    unsigned numberRequests = collector->numberRequests();
+
+    QSignalSpy finishedSpy(&webHookUsageData, &Ud::UsageData::reportingFinished);
+
+    webHookUsageData.adjustEvent("web_hook_event", 2);
+    webHookUsageData.setReportingEnabled();
+    QMetaObject::invokeMethod(&webHookUsageData, "reportUsageData");
+
+    QVERIFY(finishedSpy.wait(1000 * reportingTimeout));
+    webHookUsageData.setReportingDisabled();
+    collector->setAcceptUnsignedRequests(false);
+
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+    QCOMPARE(collector->numberRequests(), numberRequests + 1);
+    QCOMPARE(
+        collector->lastHeaders().contains(QByteArray(Ud::PayloadTransport::signatureHeader).toLower()),
+        false
+    );
+
+    // The acknowledged report's counters are released.
+    QJsonObject report = QJsonDocument::fromJson(webHookUsageData.previewReport()).object();
+    QCOMPARE(report.value("events").toObject().contains("web_hook_event"), false);
+}
+
+
+void TestUsageData::testBoundedActivityNames() {
+    static const unsigned maximumKeys = 8;
+    static const unsigned numberNames = 1000;
+
+    int registeredNames = Ud::KeyRegistry::names().size();
+    usageData->setMaximumActivityKeys(maximumKeys);
+
+    for (unsigned i=0 ; i<numberNames ; ++i) {
+        usageData->adjustActivity(QString("bounded_activity_%1").arg(i), 1);
+
+        QString timerName = QString("bounded_timer_%1").arg(i);
+        usageData->startTimer(timerName);
+        usageData->stopTimer(timerName);
+
+        usageData->startTimer(QString("bounded_timers_%1").arg(i));
+    }
+
+    usageData->stopTimers();
+
+    // Names that are not admitted are folded into "__other__" without ever being registered.
+    QVERIFY(Ud::KeyRegistry::names().size() - registeredNames <= static_cast<int>(maximumKeys));
+
+    usageData->setMaximumActivityKeys(0);
+}
+
+
+void TestUsageData::testActivityResolution() {
+    QTemporaryDir directory;
+    QSettings     resolutionSettings(directory.filePath("settings.ini"), QSettings::IniFormat);
+    QByteArray    sharedSecret(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret));
+
+    Ud::UsageData resolutionUsageData(&resolutionSettings, networkAccessManager, sharedSecret, collector->url());
+    resolutionUsageData.setBackgroundReporting();
+    resolutionUsageData.loadSettings();
+
+    QCOMPARE(resolutionUsageData.activityResolution(), std::uint64_t(1000000000));
+    resolutionUsageData.setActivityResolution(1000000);
+    QCOMPARE(resolutionUsageData.activityResolution(), std::uint64_t(1000000));
+
+    // Timings well below a second are kept once activities are reported in milliseconds.
+    Ud::UsageData::ActivityId activityId = resolutionUsageData.registerActivity("resolution_activity");
+    resolutionUsageData.addActivityTime(activityId, 2500000);
+
+    resolutionUsageData.startTimer("resolution_timer");
+    QThread::msleep(20);
+    resolutionUsageData.stopTimer("resolution_timer");
+
+    QJsonObject report     = QJsonDocument::fromJson(resolutionUsageData.previewReport()).object();
+    QJsonObject activities = report.value("activities").toObject();
+
+    QCOMPARE(report.value("activity_resolution").toInt(), 1000000);
+    QCOMPARE(activities.value("resolution_activity").toInt(), 2);
+    QVERIFY(activities.value("resolution_timer").toInt() >= 20);
+
+    QSignalSpy finishedSpy(&resolutionUsageData, &Ud::UsageData::reportingFinished);
+
+    resolutionUsageData.setReportingEnabled();
+    QMetaObject::invokeMethod(&resolutionUsageData, "reportUsageData");
+
+    QVERIFY(finishedSpy.wait(1000 * reportingTimeout));
+    resolutionUsageData.setReportingDisabled();
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+
+    // The half millisecond left over by the accepted report is carried into the next one.
+    resolutionUsageData.addActivityTime(activityId, 1500000);
+
+    report = QJsonDocument::fromJson(resolutionUsageData.previewReport()).object();
+    QCOMPARE(report.value("activities").toObject().value("resolution_activity").toInt(), 2);
+}
+
+
+void TestUsageData::testLegacyActivities() {
+    QTemporaryDir directory;
+    QSettings     legacySettings(directory.filePath("settings.ini"), QSettings::IniFormat);
+    QByteArray    sharedSecret(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret));
+
+    // Older releases saved activity totals in seconds under "activities".
+    legacySettings.setValue("usageData/activities/legacy_activity", 3);
+
+    Ud::UsageData legacyUsageData(&legacySettings, networkAccessManager, sharedSecret, collector->url());
+    legacyUsageData.loadSettings();
+    legacyUsageData.setActivityResolution(1);
+
+    QJsonObject report = QJsonDocument::fromJson(legacyUsageData.previewReport()).object();
+    QCOMPARE(report.value("activity_resolution").toInt(), 1);
+    QCOMPARE(report.value("activities").toObject().value("legacy_activity").toDouble(), 3.0E9);
+
+    // Saving moves the totals, now in nanoseconds, to "activityTimes".
+    legacyUsageData.saveSettings();
+    QCOMPARE(legacySettings.contains("usageData/activities/legacy_activity"), false);
+    QCOMPARE(
+        legacySettings.value("usageData/activityTimes/legacy_activity").toULongLong(),
+        Q_UINT64_C(3000000000)
+    );
+}
+
+
+void TestUsageData::testLegacyActivitiesKept() {
+    QTemporaryDir directory;
+    QString       journalFilename = directory.filePath("counters.journal");
+    QSettings     legacySettings(directory.filePath("settings.ini"), QSettings::IniFormat);
+    QByteArray    sharedSecret(reinterpret_cast<const char*>(testUsageDataHmacSecret), sizeof(testUsageDataHmacSecret));
+
+    legacySettings.setValue("usageData/activities/legacy_kept_activity", 2);
+
+    // A file that is not a journal can not be saved to, so the journal save fails.
+    {
+        QFile file(journalFilename);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write(QByteArray("not a counter journal"));
+    }
+
+    Ud::UsageData legacyUsageData(&legacySettings, networkAccessManager, sharedSecret, collector->url());
+    legacyUsageData.setJournalFilename(journalFilename);
+    legacyUsageData.loadSettings();
+    legacyUsageData.saveSettings();
+
+    QCOMPARE(legacySettings.value("usageData/activities/legacy_kept_activity").toInt(), 2);
 }
 
 
@@ -38,6 +38,7 @@ class QNetworkAccessManager;
 class QSettings;
 class QEventLoop;
 class QTimer;
+class LoopbackCollector;
 
 namespace Ud {
     class UsageData;
@@ -59,19 +60,51 @@ class TestUsageData:public QObject {
     private slots:
         void initTestCase();
 
+        void testPerThreadTimers();
+
+        void testIncrementalSave();
+
         void testPrimaryInstance();
 
+        void testFailedReport();
+
+        void testCollectorLatency();
+
+        void testStatistics();
+
+        void testSampling();
+
+        void testTimeSeries();
+
+        void testJournalSetAfterLoad();
+
+        void testJournalMovedToCounterFiles();
+
+        void testSpooledFormats();
+
+        void testRejectedReport();
+
+        void testWebHookReport();
+
+        void testBoundedActivityNames();
+
+        void testActivityResolution();
+
+        void testLegacyActivities();
+
+        void testLegacyActivitiesKept();
+
         void cleanupTestCase();
 
     private:
         static const unsigned     reportingInterval = 2; // Report every 2 seconds.
         static const unsigned     reportingTimeout = 60; // Give 60 seconds for things to happen.
-        static const char         testWebhook[];
         static const std::uint8_t testUsageDataHmacSecret[];
 
         QNetworkAccessManager* networkAccessManager;
         QSettings*             settings;
         Ud::UsageData*         usageData;
+        LoopbackCollector*     collector;
 
         QEventLoop*            eventLoop;
         QTimer*                failureTimer;